@@ -35,6 +35,7 @@ Software Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
 #include "bgpd/bgp_packet.h"
 #include "bgpd/bgp_fsm.h"
 #include "bgpd/bgp_mplsvpn.h"
+#include "bgpd/bgp_updgrp.h"
 
 /* BGP advertise attribute is used for pack same attribute update into
    one packet.  To do that we maintain attribute hash in struct
@@ -165,9 +166,10 @@ bgp_adj_out_lookup (struct peer *peer, struct prefix *p,
 		    afi_t afi, safi_t safi, struct bgp_node *rn)
 {
   struct bgp_adj_out *adj;
+  struct peer *owner = BGP_ADJ_OWNER (peer, afi, safi);
 
   for (adj = rn->adj_out; adj; adj = adj->next)
-    if (adj->peer == peer)
+    if (adj->peer == owner)
       break;
 
   if (! adj)
@@ -240,6 +242,8 @@ bgp_adj_out_set (struct bgp_node *rn, struct peer *peer, struct prefix *p,
         {
           BGP_ADJ_OUT_ADD (rn, adj);
           bgp_lock_node (rn);
+          adj->rn = rn;
+          BGP_PEER_LIST_ADD (peer->adj_out[afi][safi], adj);
         }
     }
 
@@ -300,12 +304,16 @@ bgp_adj_out_unset (struct bgp_node *rn, struct peer *peer, struct prefix *p,
       FIFO_ADD (&peer->sync[afi][safi]->withdraw, &adv->fifo);
 
       /* Schedule packet write. */
-      BGP_WRITE_ON (peer->t_write, bgp_write, peer->fd);
+      if (peer->updgrp[afi][safi])
+	bgp_updgrp_write_on (peer->updgrp[afi][safi]);
+      else
+	BGP_WRITE_ON (peer->t_write, bgp_write, peer->fd);
     }
   else
     {
       /* Remove myself from adjacency. */
       BGP_ADJ_OUT_DEL (rn, adj);
+      BGP_PEER_LIST_DEL (peer->adj_out[afi][safi], adj);
       
       /* Free allocated information.  */
       bgp_adj_out_free (adj);
@@ -325,6 +333,7 @@ bgp_adj_out_remove (struct bgp_node *rn, struct bgp_adj_out *adj,
     bgp_advertise_clean (peer, adj, afi, safi);
 
   BGP_ADJ_OUT_DEL (rn, adj);
+  BGP_PEER_LIST_DEL (peer->adj_out[afi][safi], adj);
   bgp_adj_out_free (adj);
 }
 
@@ -348,7 +357,10 @@ bgp_adj_in_set (struct bgp_node *rn, struct peer *peer, struct attr *attr)
   adj = XCALLOC (MTYPE_BGP_ADJ_IN, sizeof (struct bgp_adj_in));
   adj->peer = peer_lock (peer); /* adj_in peer reference */
   adj->attr = bgp_attr_intern (attr);
+  adj->rn = rn;
   BGP_ADJ_IN_ADD (rn, adj);
+  BGP_PEER_LIST_ADD (peer->adj_in[bgp_node_table (rn)->afi]
+				[bgp_node_table (rn)->safi], adj);
   bgp_lock_node (rn);
 }
 
@@ -357,6 +369,8 @@ bgp_adj_in_remove (struct bgp_node *rn, struct bgp_adj_in *bai)
 {
   bgp_attr_unintern (&bai->attr);
   BGP_ADJ_IN_DEL (rn, bai);
+  BGP_PEER_LIST_DEL (bai->peer->adj_in[bgp_node_table (rn)->afi]
+				      [bgp_node_table (rn)->safi], bai);
   peer_unlock (bai->peer); /* adj_in peer reference */
   XFREE (MTYPE_BGP_ADJ_IN, bai);
 }
@@ -66,6 +66,11 @@ struct bgp_adj_out
   /* Advertised peer.  */
   struct peer *peer;
 
+  /* Linked list of the peer's entries, and their node.  */
+  struct bgp_adj_out *peer_next;
+  struct bgp_adj_out *peer_prev;
+  struct bgp_node *rn;
+
   /* Advertised attribute.  */
   struct attr *attr;
 
@@ -83,6 +88,11 @@ struct bgp_adj_in
   /* Received peer.  */
   struct peer *peer;
 
+  /* Linked list of the peer's entries, and their node.  */
+  struct bgp_adj_in *peer_next;
+  struct bgp_adj_in *peer_prev;
+  struct bgp_node *rn;
+
   /* Received attribute.  */
   struct attr *attr;
 };
@@ -117,6 +127,26 @@ struct bgp_synchronize
       (N)->TYPE = (A)->next;                          \
   } while (0)
 
+/* Per peer linked list through peer_next and peer_prev, headed by H.  */
+#define BGP_PEER_LIST_ADD(H,A)                        \
+  do {                                                \
+    (A)->peer_prev = NULL;                            \
+    (A)->peer_next = (H);                             \
+    if (H)                                            \
+      (H)->peer_prev = (A);                           \
+    (H) = (A);                                        \
+  } while (0)
+
+#define BGP_PEER_LIST_DEL(H,A)                        \
+  do {                                                \
+    if ((A)->peer_next)                               \
+      (A)->peer_next->peer_prev = (A)->peer_prev;     \
+    if ((A)->peer_prev)                               \
+      (A)->peer_prev->peer_next = (A)->peer_next;     \
+    else                                              \
+      (H) = (A)->peer_next;                           \
+  } while (0)
+
 #define BGP_ADJ_IN_ADD(N,A)    BGP_INFO_ADD(N,A,adj_in)
 #define BGP_ADJ_IN_DEL(N,A)    BGP_INFO_DEL(N,A,adj_in)
 #define BGP_ADJ_OUT_ADD(N,A)   BGP_INFO_ADD(N,A,adj_out)
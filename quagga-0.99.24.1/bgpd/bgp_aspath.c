@@ -88,6 +88,11 @@ struct assegment_header
 /* Hash for aspath.  This is the top level structure of AS path. */
 static struct hash *ashash;
 
+/* Serial numbers of hashed AS paths; see struct aspath. */
+#define ASPATH_SERIAL_MAX 0x7fffffffU
+static u_int32_t aspath_serial_last;
+static unsigned int aspath_serial_epochs;
+
 /* Stream for SNMP. See aspath_snmp_pathseg */
 static struct stream *snmp_stream;
 
@@ -349,9 +354,7 @@ aspath_unintern (struct aspath **aspath)
 }
 
 /* Return the start or end delimiters for a particular Segment type */
-#define AS_SEG_START 0
-#define AS_SEG_END 1
-static char
+char
 aspath_delimiter_char (u_char type, u_char which)
 {
   int i;
@@ -613,12 +616,45 @@ aspath_make_str_count (struct aspath *as)
   return;
 }
 
+/* Forget the string of a changed AS path.  It is made again by
+   aspath_print when next wanted.  */
 static void
-aspath_str_update (struct aspath *as)
+aspath_str_reset (struct aspath *as)
 {
   if (as->str)
     XFREE (MTYPE_AS_STR, as->str);
-  aspath_make_str_count (as);
+  as->str_len = 0;
+}
+
+static void
+aspath_serial_renumber (struct hash_backet *backet, void *arg)
+{
+  struct aspath *as = backet->data;
+
+  as->serial = ++aspath_serial_last;
+}
+
+/* Number an AS path going into the hash.  When the numbers run out
+   they start over with the AS paths already hashed, so that no two
+   hashed AS paths ever share one.  */
+static void
+aspath_serial_set (struct aspath *as)
+{
+  if (aspath_serial_last >= ASPATH_SERIAL_MAX)
+    {
+      aspath_serial_last = 0;
+      hash_iterate (ashash, aspath_serial_renumber, NULL);
+      aspath_serial_epochs++;
+    }
+  as->serial = ++aspath_serial_last;
+}
+
+/* Changes when AS paths are numbered again, so anything remembered
+   against their serial numbers has to be forgotten.  */
+unsigned int
+aspath_serial_epoch (void)
+{
+  return aspath_serial_epochs;
 }
 
 /* Intern allocated AS path. */
@@ -627,15 +663,15 @@ aspath_intern (struct aspath *aspath)
 {
   struct aspath *find;
 
-  /* Assert this AS path structure is not interned and has the string
-     representation built. */
+  /* Assert this AS path structure is not interned. */
   assert (aspath->refcnt == 0);
-  assert (aspath->str);
 
   /* Check AS path hash. */
   find = hash_get (ashash, aspath, hash_alloc_intern);
   if (find != aspath)
     aspath_free (aspath);
+  else
+    aspath_serial_set (find);
 
   find->refcnt++;
 
@@ -676,11 +712,6 @@ aspath_hash_alloc (void *arg)
   const struct aspath *aspath = arg;
   struct aspath *new;
 
-  /* Malformed AS path value. */
-  assert (aspath->str);
-  if (! aspath->str)
-    return NULL;
-
   /* New aspath structure is needed. */
   new = XMALLOC (MTYPE_AS_PATH, sizeof (struct aspath));
 
@@ -689,6 +720,7 @@ aspath_hash_alloc (void *arg)
   new->segments = aspath->segments;
   new->str = aspath->str;
   new->str_len = aspath->str_len;
+  aspath_serial_set (new);
 
   return new;
 }
@@ -823,11 +855,7 @@ aspath_parse (struct stream *s, size_t length, int use32bit)
 
   /* if the aspath was already hashed free temporary memory. */
   if (find->refcnt)
-    {
-      assegment_free_all (as.segments);
-      /* aspath_key_make() always updates the string */
-      XFREE (MTYPE_AS_STR, as.str);
-    }
+    assegment_free_all (as.segments);
 
   find->refcnt++;
 
@@ -1087,7 +1115,7 @@ aspath_aggregate (struct aspath *as1, struct aspath *as2)
     }
   
   assegment_normalise (aspath->segments);
-  aspath_str_update (aspath);
+  aspath_str_reset (aspath);
   return aspath;
 }
 
@@ -1212,7 +1240,7 @@ aspath_merge (struct aspath *as1, struct aspath *as2)
   
   last->next = as2->segments;
   as2->segments = new;
-  aspath_str_update (as2);
+  aspath_str_reset (as2);
   return as2;
 }
 
@@ -1233,7 +1261,7 @@ aspath_prepend (struct aspath *as1, struct aspath *as2)
   if (seg2 == NULL)
     {
       as2->segments = assegment_dup_all (as1->segments);
-      aspath_str_update (as2);
+      aspath_str_reset (as2);
       return as2;
     }
   
@@ -1285,7 +1313,7 @@ aspath_prepend (struct aspath *as1, struct aspath *as2)
       /* we've now prepended as1's segment chain to as2, merging
        * the inbetween AS_SEQUENCE of seg2 in the process 
        */
-      aspath_str_update (as2);
+      aspath_str_reset (as2);
       return as2;
     }
   else
@@ -1364,7 +1392,7 @@ aspath_filter_exclude (struct aspath * source, struct aspath * exclude_list)
       lastseg->next = newseg;
     lastseg = newseg;
   }
-  aspath_str_update (newpath);
+  aspath_str_reset (newpath);
   /* We are happy returning even an empty AS_PATH, because the administrator
    * might expect this very behaviour. There's a mean to avoid this, if necessary,
    * by having a match rule against certain AS_PATH regexps in the route-map index.
@@ -1403,7 +1431,7 @@ aspath_add_asns (struct aspath *aspath, as_t asno, u_char type, unsigned num)
       aspath->segments = newsegment;
     }
 
-  aspath_str_update (aspath);
+  aspath_str_reset (aspath);
   return aspath;
 }
 
@@ -1493,7 +1521,7 @@ aspath_reconcile_as4 ( struct aspath *aspath, struct aspath *as4path)
   
   if ( BGP_DEBUG(as4, AS4))
     zlog_debug("[AS4] got AS_PATH %s and AS4_PATH %s synthesizing now",
-               aspath->str, as4path->str);
+               aspath_print (aspath), aspath_print (as4path));
 
   while (seg && hops > 0)
     {
@@ -1548,11 +1576,11 @@ aspath_reconcile_as4 ( struct aspath *aspath, struct aspath *as4path)
   mergedpath = aspath_merge (newpath, aspath_dup(as4path));
   aspath_free (newpath);
   mergedpath->segments = assegment_normalise (mergedpath->segments);
-  aspath_str_update (mergedpath);
+  aspath_str_reset (mergedpath);
   
   if ( BGP_DEBUG(as4, AS4))
     zlog_debug ("[AS4] result of synthesizing is %s",
-                mergedpath->str);
+                aspath_print (mergedpath));
   
   return mergedpath;
 }
@@ -1608,7 +1636,7 @@ aspath_delete_confed_seq (struct aspath *aspath)
       assegment_free (seg);
       seg = aspath->segments;
     }
-  aspath_str_update (aspath);
+  aspath_str_reset (aspath);
   return aspath;
 }
 
@@ -1665,7 +1693,6 @@ aspath_empty_get (void)
   struct aspath *aspath;
 
   aspath = aspath_new ();
-  aspath_make_str_count (aspath);
   return aspath;
 }
 
@@ -1824,8 +1851,6 @@ aspath_str2aspath (const char *str)
 	}
     }
 
-  aspath_make_str_count (aspath);
-
   return aspath;
 }
 
@@ -1834,12 +1859,16 @@ unsigned int
 aspath_key_make (void *p)
 {
   struct aspath *aspath = (struct aspath *) p;
-  unsigned int key = 0;
-
-  if (!aspath->str)
-    aspath_str_update (aspath);
+  struct assegment *seg;
+  unsigned int key = 2334325;
 
-  key = jhash (aspath->str, aspath->str_len, 2334325);
+  /* Over the segments, as aspath_cmp compares them, so no string has
+     to be made to look an AS path up. */
+  for (seg = aspath->segments; seg; seg = seg->next)
+    {
+      key = jhash_2words (seg->type, seg->length, key);
+      key = jhash2 (seg->as, seg->length, key);
+    }
 
   return key;
 }
@@ -1890,7 +1919,11 @@ aspath_finish (void)
 const char *
 aspath_print (struct aspath *as)
 {
-  return (as ? as->str : NULL);
+  if (! as)
+    return NULL;
+  if (! as->str)
+    aspath_make_str_count (as);
+  return as->str;
 }
 
 /* Printing functions */
@@ -1901,7 +1934,7 @@ void
 aspath_print_vty (struct vty *vty, const char *format, struct aspath *as, const char * suffix)
 {
   assert (format);
-  vty_out (vty, format, as->str);
+  vty_out (vty, format, aspath_print (as));
   if (as->str_len && strlen (suffix))
     vty_out (vty, "%s", suffix);
 }
@@ -1914,7 +1947,7 @@ aspath_show_all_iterator (struct hash_backet *backet, struct vty *vty)
   as = (struct aspath *) backet->data;
 
   vty_out (vty, "[%p:%u] (%ld) ", backet, backet->key, as->refcnt);
-  vty_out (vty, "%s%s", as->str, VTY_NEWLINE);
+  vty_out (vty, "%s%s", aspath_print (as), VTY_NEWLINE);
 }
 
 /* Print all aspath and hash information.  This function is used from
@@ -56,13 +56,25 @@ struct aspath
   struct assegment *segments;
   
   /* String expression of AS path.  This string is used by vty output
-     and AS path regular expression match.  */
+     and AS path regular expression match, and is only made when first
+     wanted; see aspath_print.  */
   char *str;
   unsigned short str_len;
+
+  /* Number given to the AS path when it is hashed, never 0 and never
+     that of another hashed AS path, and not reused before
+     aspath_serial_epoch changes, which all hashed AS paths are
+     numbered again for.  Results worked out for an interned AS path
+     can be remembered against it.  */
+  u_int32_t serial;
 };
 
 #define ASPATH_STR_DEFAULT_LEN 32
 
+/* Which delimiter of a segment aspath_delimiter_char returns.  */
+#define AS_SEG_START 0
+#define AS_SEG_END 1
+
 /* Prototypes. */
 extern void aspath_init (void);
 extern void aspath_finish (void);
@@ -85,6 +97,8 @@ extern void aspath_free (struct aspath *);
 extern struct aspath *aspath_intern (struct aspath *);
 extern void aspath_unintern (struct aspath **);
 extern const char *aspath_print (struct aspath *);
+extern char aspath_delimiter_char (u_char, u_char);
+extern unsigned int aspath_serial_epoch (void);
 extern void aspath_print_vty (struct vty *, const char *, struct aspath *, const char *);
 extern void aspath_print_all_vty (struct vty *);
 extern unsigned int aspath_key_make (void *);
@@ -2109,6 +2109,165 @@ bgp_attr_parse (struct peer *peer, struct attr *attr, bgp_size_t size,
   return BGP_ATTR_PARSE_PROCEED;
 }
 
+/* Attribute cache.  A full table carries far fewer distinct sets of
+   path attributes than prefixes, and a peer which sends a set again
+   sends the same bytes.  The raw attributes of each UPDATE which
+   parsed cleanly are kept, hashed, with the interned attribute they
+   parsed to, so the same bytes are not parsed again.  What the parse
+   depends on besides the bytes is fixed for a session, but for some
+   flags, which are checked on each lookup.  UPDATEs with MP_REACH_NLRI
+   or MP_UNREACH_NLRI carry NLRI in their attributes and are not
+   kept.  */
+struct bgp_attr_cache_entry
+{
+  u_int32_t key;
+  bgp_size_t length;
+  u_char *data;
+  struct attr *attr;
+};
+
+struct bgp_attr_cache
+{
+  /* What the parse depended on. */
+  u_int32_t bgp_flags;
+  u_int32_t peer_flags;
+  as_t change_local_as;
+
+  unsigned long count;
+  unsigned long hits;
+  unsigned long misses;
+
+  /* One entry a slot, the newest. */
+  struct bgp_attr_cache_entry *slot[BGP_ATTR_CACHE_SIZE];
+};
+
+static void
+bgp_attr_cache_entry_free (struct bgp_attr_cache_entry *entry)
+{
+  bgp_attr_unintern (&entry->attr);
+  XFREE (MTYPE_BGP_ATTR_CACHE, entry->data);
+  XFREE (MTYPE_BGP_ATTR_CACHE, entry);
+}
+
+static struct bgp_attr_cache *
+bgp_attr_cache_new (struct peer *peer)
+{
+  struct bgp_attr_cache *cache;
+
+  cache = XCALLOC (MTYPE_BGP_ATTR_CACHE, sizeof (struct bgp_attr_cache));
+  cache->bgp_flags = peer->bgp ? peer->bgp->flags : 0;
+  cache->peer_flags = peer->flags;
+  cache->change_local_as = peer->change_local_as;
+  return cache;
+}
+
+static int
+bgp_attr_cache_valid (struct peer *peer, struct bgp_attr_cache *cache)
+{
+  return (cache->bgp_flags == (peer->bgp ? peer->bgp->flags : 0)
+	  && cache->peer_flags == peer->flags
+	  && cache->change_local_as == peer->change_local_as);
+}
+
+/* Interned attribute which the LENGTH bytes of raw attributes at DATA
+   from PEER parsed to before, or NULL.  */
+struct attr *
+bgp_attr_cache_get (struct peer *peer, const u_char *data, bgp_size_t length)
+{
+  struct bgp_attr_cache *cache = peer->attr_cache;
+  struct bgp_attr_cache_entry *entry;
+  u_int32_t key;
+
+  if (cache && ! bgp_attr_cache_valid (peer, cache))
+    {
+      bgp_attr_cache_flush (peer);
+      cache = NULL;
+    }
+  if (! cache)
+    cache = peer->attr_cache = bgp_attr_cache_new (peer);
+
+  key = jhash (data, length, 0);
+  entry = cache->slot[key & (BGP_ATTR_CACHE_SIZE - 1)];
+  if (entry && entry->key == key && entry->length == length
+      && memcmp (entry->data, data, length) == 0)
+    {
+      cache->hits++;
+      return entry->attr;
+    }
+
+  cache->misses++;
+  return NULL;
+}
+
+/* Remember that the LENGTH bytes at DATA from PEER, just looked up
+   with bgp_attr_cache_get(), parsed to ATTR.  */
+void
+bgp_attr_cache_set (struct peer *peer, const u_char *data, bgp_size_t length,
+		    struct attr *attr)
+{
+  struct bgp_attr_cache *cache = peer->attr_cache;
+  struct bgp_attr_cache_entry *entry;
+  struct attr tmp;
+  struct attr_extra tmp_extra;
+  u_int32_t key;
+  int i;
+
+  if (! cache
+      || (attr->flag & (ATTR_FLAG_BIT (BGP_ATTR_MP_REACH_NLRI)
+			| ATTR_FLAG_BIT (BGP_ATTR_MP_UNREACH_NLRI))))
+    return;
+
+  key = jhash (data, length, 0);
+  i = key & (BGP_ATTR_CACHE_SIZE - 1);
+  if (cache->slot[i])
+    {
+      bgp_attr_cache_entry_free (cache->slot[i]);
+      cache->count--;
+    }
+
+  /* bgp_attr_intern() may change the sub-structures it is handed. */
+  tmp.extra = &tmp_extra;
+  bgp_attr_dup (&tmp, attr);
+
+  entry = XMALLOC (MTYPE_BGP_ATTR_CACHE, sizeof (struct bgp_attr_cache_entry));
+  entry->key = key;
+  entry->length = length;
+  entry->data = XMALLOC (MTYPE_BGP_ATTR_CACHE, length);
+  memcpy (entry->data, data, length);
+  entry->attr = bgp_attr_intern (&tmp);
+  cache->slot[i] = entry;
+  cache->count++;
+}
+
+/* Forget what PEER sent.  */
+void
+bgp_attr_cache_flush (struct peer *peer)
+{
+  struct bgp_attr_cache *cache = peer->attr_cache;
+  int i;
+
+  if (! cache)
+    return;
+
+  for (i = 0; i < BGP_ATTR_CACHE_SIZE; i++)
+    if (cache->slot[i])
+      bgp_attr_cache_entry_free (cache->slot[i]);
+  XFREE (MTYPE_BGP_ATTR_CACHE, cache);
+  peer->attr_cache = NULL;
+}
+
+void
+bgp_attr_cache_show (struct vty *vty, struct peer *peer)
+{
+  struct bgp_attr_cache *cache = peer->attr_cache;
+
+  if (! cache)
+    return;
+
+  vty_out (vty, "  Attribute cache: %lu entries, %lu hits, %lu misses%s",
+	   cache->count, cache->hits, cache->misses, VTY_NEWLINE);
+}
+
 int stream_put_prefix (struct stream *, struct prefix *);
 
 size_t
@@ -132,6 +132,9 @@ struct transit
 
 #define ATTR_FLAG_BIT(X)  (1 << ((X) - 1))
 
+/* Slots of a peer's cache of raw attributes.  A power of two.  */
+#define BGP_ATTR_CACHE_SIZE  4096
+
 typedef enum {
  BGP_ATTR_PARSE_PROCEED = 0,
  BGP_ATTR_PARSE_ERROR = -1,
@@ -171,6 +174,12 @@ extern unsigned int attrhash_key_make (void *);
 extern void attr_show_all (struct vty *);
 extern unsigned long int attr_count (void);
 extern unsigned long int attr_unknown_count (void);
+extern struct attr *bgp_attr_cache_get (struct peer *, const u_char *,
+					bgp_size_t);
+extern void bgp_attr_cache_set (struct peer *, const u_char *, bgp_size_t,
+				struct attr *);
+extern void bgp_attr_cache_flush (struct peer *);
+extern void bgp_attr_cache_show (struct vty *, struct peer *);
 
 /* Cluster list prototypes. */
 extern int cluster_loop_check (struct cluster_list *, struct in_addr);
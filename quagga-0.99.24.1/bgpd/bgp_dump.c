@@ -27,6 +27,8 @@ Software Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
 #include "prefix.h"
 #include "thread.h"
 #include "linklist.h"
+#include "memory.h"
+#include "sigevent.h"
 #include "bgpd/bgp_table.h"
 
 #include "bgpd/bgpd.h"
@@ -34,6 +36,37 @@ Software Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
 #include "bgpd/bgp_attr.h"
 #include "bgpd/bgp_dump.h"
 
+#ifdef HAVE_PTHREAD
+#include <pthread.h>
+#endif /* HAVE_PTHREAD */
+
+/* Records are gathered in buffers, which a thread of their own writes
+ * to the files, so bgpd does not wait on the disk.  A table dump walks
+ * the table a few nodes at a time, as a background thread, and pauses
+ * while the writer has much to catch up with.  Its records are of the
+ * table as the walk gets to them.  Packet dumps hand their buffer over
+ * when it is full, or a second after its first record, and wait only
+ * when the writer is far behind.
+ */
+
+/* Size of a buffer, enough for the largest record. */
+#define BGP_DUMP_BUF_SIZE        (1 << 18)
+
+/* Bytes handed to the writer and not yet written, beyond which packet
+   dumps wait and table dumps pause. */
+#define BGP_DUMP_QUEUE_MAX       (1 << 25)
+
+/* Nodes a table dump walks before other threads get a turn, and how
+   long it pauses, in milliseconds, for the writer to catch up. */
+#define BGP_DUMP_WALK_NODES      1000
+#define BGP_DUMP_WALK_PAUSE      100
+
+/* Seconds a packet record may wait in a buffer. */
+#define BGP_DUMP_FLUSH_INTERVAL  1
+
+/* Buffers kept for reuse once written. */
+#define BGP_DUMP_BUF_SPARE       4
+
 enum bgp_dump_type
 {
   BGP_DUMP_ALL,
@@ -73,6 +106,74 @@ struct bgp_dump
   char *interval_str;
 
   struct thread *t_interval;
+
+  /* Records not handed to the writer yet. */
+  struct bgp_dump_buf *buf;
+  struct thread *t_flush;
+
+  /* Walk of a table dump, under way as long as iter has a table. */
+  struct thread *t_walk;
+  bgp_table_iter_t iter;
+  afi_t afi;
+  unsigned int seq;
+  struct timeval start;
+
+  /* Statistics.  bytes and errors are counted by the writer. */
+  unsigned long records;
+  unsigned long long bytes;
+  unsigned long errors;
+  unsigned long dumps;
+  unsigned long skipped;
+  unsigned long last_records;
+  unsigned long last_msec;
+};
+
+/* Records for the writer to append to FP. */
+struct bgp_dump_buf
+{
+  struct bgp_dump_buf *next;
+  struct bgp_dump *dump;
+  FILE *fp;
+
+  /* Whether FP is closed once this is written. */
+  int close;
+
+  size_t len;
+  u_char data[BGP_DUMP_BUF_SIZE];
+};
+
+static struct bgp_dump_writer
+{
+#ifdef HAVE_PTHREAD
+  pthread_t thread;
+  int running;
+
+  /* Held to hand a buffer over, and back. */
+  pthread_mutex_t lock;
+  pthread_cond_t work;
+  pthread_cond_t room;
+  int stop;
+#endif /* HAVE_PTHREAD */
+
+  /* Buffers handed over, the one being written first, and bytes in
+     them.  Buffers written go on done. */
+  struct bgp_dump_buf *head;
+  struct bgp_dump_buf **tail;
+  size_t queued;
+  struct bgp_dump_buf *done;
+
+  /* The main thread's: buffers to reuse, and statistics. */
+  struct bgp_dump_buf *spare;
+  unsigned long buffers;
+  unsigned long waits;
+} bdw =
+{
+#ifdef HAVE_PTHREAD
+  .lock = PTHREAD_MUTEX_INITIALIZER,
+  .work = PTHREAD_COND_INITIALIZER,
+  .room = PTHREAD_COND_INITIALIZER,
+#endif /* HAVE_PTHREAD */
+  .tail = &bdw.head,
 };
 
 /* BGP packet dump output buffer. */
@@ -87,8 +188,296 @@ struct bgp_dump bgp_dump_updates;
 /* BGP dump structure for 'dump bgp routes' */
 struct bgp_dump bgp_dump_routes;
 
-/* Dump whole BGP table is very heavy process.  */
-struct thread *t_bgp_dump_routes;
+/* Write BUF out, and return 1 if that failed.  Runs on the writer
+   thread, which does not log. */
+static int
+bgp_dump_buf_write (struct bgp_dump_buf *buf)
+{
+  int error = 0;
+
+  if (buf->len && fwrite (buf->data, buf->len, 1, buf->fp) != 1)
+    error = 1;
+  if (fflush (buf->fp) != 0)
+    error = 1;
+  if (buf->close && fclose (buf->fp) != 0)
+    error = 1;
+  return error;
+}
+
+static void
+bgp_dump_buf_free_list (struct bgp_dump_buf *buf)
+{
+  struct bgp_dump_buf *next;
+
+  for (; buf; buf = next)
+    {
+      next = buf->next;
+      XFREE (MTYPE_BGP_DUMP_BUF, buf);
+    }
+}
+
+#ifdef HAVE_PTHREAD
+
+static void *
+bgp_dump_writer_loop (void *arg)
+{
+  struct bgp_dump_buf *buf;
+  int error;
+
+  pthread_mutex_lock (&bdw.lock);
+  while (1)
+    {
+      while (! bdw.head && ! bdw.stop)
+        pthread_cond_wait (&bdw.work, &bdw.lock);
+      if (! bdw.head)
+        break;
+
+      /* The buffer stays first while it is written; the main thread
+         only ever appends. */
+      buf = bdw.head;
+      pthread_mutex_unlock (&bdw.lock);
+
+      error = bgp_dump_buf_write (buf);
+
+      pthread_mutex_lock (&bdw.lock);
+      buf->dump->bytes += buf->len;
+      buf->dump->errors += error;
+      bdw.queued -= buf->len;
+      bdw.head = buf->next;
+      if (! bdw.head)
+        bdw.tail = &bdw.head;
+      buf->next = bdw.done;
+      bdw.done = buf;
+      pthread_cond_signal (&bdw.room);
+    }
+  pthread_mutex_unlock (&bdw.lock);
+  return NULL;
+}
+
+/* Started the first time there is something to write, so not before
+   bgpd has daemonized.  */
+static void
+bgp_dump_writer_start (void)
+{
+  int ret;
+
+  bdw.stop = 0;
+
+  ret = quagga_pthread_create (&bdw.thread, bgp_dump_writer_loop, NULL);
+  if (ret)
+    {
+      zlog_err ("Can't start dump writer thread, writing dumps"
+                " synchronously: %s", safe_strerror (ret));
+      return;
+    }
+  bdw.running = 1;
+}
+
+/* Stop the writer once it has written all it was handed. */
+static void
+bgp_dump_writer_stop (void)
+{
+  if (! bdw.running)
+    return;
+
+  pthread_mutex_lock (&bdw.lock);
+  bdw.stop = 1;
+  pthread_cond_signal (&bdw.work);
+  pthread_mutex_unlock (&bdw.lock);
+
+  pthread_join (bdw.thread, NULL);
+  bdw.running = 0;
+}
+
+/* Whether the writer is too far behind. */
+static int
+bgp_dump_backlog (void)
+{
+  int backlog;
+
+  pthread_mutex_lock (&bdw.lock);
+  backlog = bdw.queued > BGP_DUMP_QUEUE_MAX;
+  pthread_mutex_unlock (&bdw.lock);
+  return backlog;
+}
+
+/* Wait until the writer is no longer too far behind. */
+static void
+bgp_dump_wait (void)
+{
+  pthread_mutex_lock (&bdw.lock);
+  if (bdw.queued > BGP_DUMP_QUEUE_MAX)
+    {
+      bdw.waits++;
+      while (bdw.queued > BGP_DUMP_QUEUE_MAX)
+        pthread_cond_wait (&bdw.room, &bdw.lock);
+    }
+  pthread_mutex_unlock (&bdw.lock);
+}
+
+#else /* HAVE_PTHREAD */
+
+static void
+bgp_dump_writer_stop (void)
+{
+}
+
+static int
+bgp_dump_backlog (void)
+{
+  return 0;
+}
+
+static void
+bgp_dump_wait (void)
+{
+}
+
+#endif /* HAVE_PTHREAD */
+
+/* Hand BUF over to the writer.  Without a writer thread, it is written
+   right away. */
+static void
+bgp_dump_buf_queue (struct bgp_dump_buf *buf)
+{
+  bdw.buffers++;
+  buf->next = NULL;
+
+#ifdef HAVE_PTHREAD
+  if (! bdw.running)
+    bgp_dump_writer_start ();
+  if (bdw.running)
+    {
+      pthread_mutex_lock (&bdw.lock);
+      *bdw.tail = buf;
+      bdw.tail = &buf->next;
+      bdw.queued += buf->len;
+      pthread_cond_signal (&bdw.work);
+      pthread_mutex_unlock (&bdw.lock);
+      return;
+    }
+#endif /* HAVE_PTHREAD */
+
+  buf->dump->errors += bgp_dump_buf_write (buf);
+  buf->dump->bytes += buf->len;
+  buf->next = bdw.done;
+  bdw.done = buf;
+}
+
+/* A buffer for the file of BGP_DUMP, one written already if there is. */
+static struct bgp_dump_buf *
+bgp_dump_buf_get (struct bgp_dump *bgp_dump)
+{
+  struct bgp_dump_buf *buf;
+  int spare = 0;
+
+  if (! bdw.spare)
+    {
+#ifdef HAVE_PTHREAD
+      pthread_mutex_lock (&bdw.lock);
+#endif /* HAVE_PTHREAD */
+      bdw.spare = bdw.done;
+      bdw.done = NULL;
+#ifdef HAVE_PTHREAD
+      pthread_mutex_unlock (&bdw.lock);
+#endif /* HAVE_PTHREAD */
+
+      /* Let go of what a burst left over. */
+      for (buf = bdw.spare; buf && ++spare < BGP_DUMP_BUF_SPARE;
+           buf = buf->next)
+        ;
+      if (buf)
+        {
+          bgp_dump_buf_free_list (buf->next);
+          buf->next = NULL;
+        }
+    }
+
+  if ((buf = bdw.spare) != NULL)
+    bdw.spare = buf->next;
+  else
+    buf = XMALLOC (MTYPE_BGP_DUMP_BUF, sizeof (struct bgp_dump_buf));
+
+  buf->next = NULL;
+  buf->dump = bgp_dump;
+  buf->fp = bgp_dump->fp;
+  buf->close = 0;
+  buf->len = 0;
+  return buf;
+}
+
+/* Hand the records of BGP_DUMP gathered so far to the writer. */
+static void
+bgp_dump_flush (struct bgp_dump *bgp_dump)
+{
+  THREAD_OFF (bgp_dump->t_flush);
+  if (bgp_dump->buf)
+    {
+      bgp_dump_buf_queue (bgp_dump->buf);
+      bgp_dump->buf = NULL;
+    }
+}
+
+static int
+bgp_dump_flush_timer (struct thread *t)
+{
+  struct bgp_dump *bgp_dump = THREAD_ARG (t);
+
+  bgp_dump->t_flush = NULL;
+  bgp_dump_flush (bgp_dump);
+  return 0;
+}
+
+/* Append the record in OBUF to the file of BGP_DUMP. */
+static void
+bgp_dump_put (struct bgp_dump *bgp_dump, struct stream *obuf)
+{
+  size_t len = stream_get_endp (obuf);
+
+  if (bgp_dump->buf && bgp_dump->buf->len + len > BGP_DUMP_BUF_SIZE)
+    bgp_dump_flush (bgp_dump);
+  if (! bgp_dump->buf)
+    bgp_dump->buf = bgp_dump_buf_get (bgp_dump);
+
+  memcpy (bgp_dump->buf->data + bgp_dump->buf->len, STREAM_DATA (obuf), len);
+  bgp_dump->buf->len += len;
+  bgp_dump->records++;
+}
+
+/* Append a packet or state change record, written out shortly. */
+static void
+bgp_dump_record (struct bgp_dump *bgp_dump, struct stream *obuf)
+{
+  bgp_dump_wait ();
+  bgp_dump_put (bgp_dump, obuf);
+  if (! bgp_dump->t_flush)
+    bgp_dump->t_flush = thread_add_timer (master, bgp_dump_flush_timer,
+                                          bgp_dump, BGP_DUMP_FLUSH_INTERVAL);
+}
+
+/* Stop a table dump under way. */
+static void
+bgp_dump_walk_stop (struct bgp_dump *bgp_dump)
+{
+  THREAD_OFF (bgp_dump->t_walk);
+  if (bgp_dump->iter.table)
+    bgp_table_iter_cleanup (&bgp_dump->iter);
+}
+
+/* Have the file of BGP_DUMP closed once all of it is written. */
+static void
+bgp_dump_close (struct bgp_dump *bgp_dump)
+{
+  bgp_dump_walk_stop (bgp_dump);
+  if (! bgp_dump->fp)
+    return;
+
+  if (! bgp_dump->buf)
+    bgp_dump->buf = bgp_dump_buf_get (bgp_dump);
+  bgp_dump->buf->close = 1;
+  bgp_dump_flush (bgp_dump);
+  bgp_dump->fp = NULL;
+}
 
 /* Some define for BGP packet dump. */
 static FILE *
@@ -118,9 +507,7 @@ bgp_dump_open_file (struct bgp_dump *bgp_dump)
       return NULL;
     }
 
-  if (bgp_dump->fp)
-    fclose (bgp_dump->fp);
-
+  bgp_dump_close (bgp_dump);
 
   oldumask = umask(0777 & ~LOGFILE_MASK);
   bgp_dump->fp = fopen (realpath, "w");
@@ -266,120 +653,193 @@ bgp_dump_routes_index_table(struct bgp *bgp)
 
   bgp_dump_set_size(obuf, MSG_TABLE_DUMP_V2);
 
-  fwrite (STREAM_DATA (obuf), stream_get_endp (obuf), 1, bgp_dump_routes.fp);
-  fflush (bgp_dump_routes.fp);
+  bgp_dump_put (&bgp_dump_routes, obuf);
 }
 
 
-/* Runs under child process. */
-static unsigned int
-bgp_dump_routes_func (int afi, int first_run, unsigned int seq)
+/* Dump the paths of RN, of the table being walked. */
+static void
+bgp_dump_routes_node (struct bgp_dump *bgp_dump, struct bgp_node *rn)
 {
   struct stream *obuf;
   struct bgp_info *info;
-  struct bgp_node *rn;
-  struct bgp *bgp;
-  struct bgp_table *table;
-
-  bgp = bgp_get_default ();
-  if (!bgp)
-    return seq;
-
-  if (bgp_dump_routes.fp == NULL)
-    return seq;
-
-  /* Note that bgp_dump_routes_index_table will do ipv4 and ipv6 peers,
-     so this should only be done on the first call to bgp_dump_routes_func.
-     ( this function will be called once for ipv4 and once for ipv6 ) */
-  if(first_run)
-    bgp_dump_routes_index_table(bgp);
+  afi_t afi = bgp_dump->afi;
 
   obuf = bgp_dump_obuf;
   stream_reset(obuf);
 
-  /* Walk down each BGP route. */
-  table = bgp->rib[afi][SAFI_UNICAST];
-
-  for (rn = bgp_table_top (table); rn; rn = bgp_route_next (rn))
+  /* MRT header */
+  if (afi == AFI_IP)
     {
-      if(!rn->info)
-        continue;
-
-      stream_reset(obuf);
-
-      /* MRT header */
-      if (afi == AFI_IP)
-        {
-          bgp_dump_header (obuf, MSG_TABLE_DUMP_V2, TABLE_DUMP_V2_RIB_IPV4_UNICAST);
-        }
+      bgp_dump_header (obuf, MSG_TABLE_DUMP_V2, TABLE_DUMP_V2_RIB_IPV4_UNICAST);
+    }
 #ifdef HAVE_IPV6
-      else if (afi == AFI_IP6)
-        {
-          bgp_dump_header (obuf, MSG_TABLE_DUMP_V2, TABLE_DUMP_V2_RIB_IPV6_UNICAST);
-        }
+  else if (afi == AFI_IP6)
+    {
+      bgp_dump_header (obuf, MSG_TABLE_DUMP_V2, TABLE_DUMP_V2_RIB_IPV6_UNICAST);
+    }
 #endif /* HAVE_IPV6 */
 
-      /* Sequence number */
-      stream_putl(obuf, seq);
+  /* Sequence number */
+  stream_putl(obuf, bgp_dump->seq);
 
-      /* Prefix length */
-      stream_putc (obuf, rn->p.prefixlen);
+  /* Prefix length */
+  stream_putc (obuf, rn->p.prefixlen);
 
-      /* Prefix */
-      if (afi == AFI_IP)
-        {
-          /* We'll dump only the useful bits (those not 0), but have to align on 8 bits */
-          stream_write(obuf, (u_char *)&rn->p.u.prefix4, (rn->p.prefixlen+7)/8);
-        }
+  /* Prefix */
+  if (afi == AFI_IP)
+    {
+      /* We'll dump only the useful bits (those not 0), but have to align on 8 bits */
+      stream_write(obuf, (u_char *)&rn->p.u.prefix4, (rn->p.prefixlen+7)/8);
+    }
 #ifdef HAVE_IPV6
-      else if (afi == AFI_IP6)
-        {
-          /* We'll dump only the useful bits (those not 0), but have to align on 8 bits */
-          stream_write (obuf, (u_char *)&rn->p.u.prefix6, (rn->p.prefixlen+7)/8);
-        }
+  else if (afi == AFI_IP6)
+    {
+      /* We'll dump only the useful bits (those not 0), but have to align on 8 bits */
+      stream_write (obuf, (u_char *)&rn->p.u.prefix6, (rn->p.prefixlen+7)/8);
+    }
 #endif /* HAVE_IPV6 */
 
-      /* Save where we are now, so we can overwride the entry count later */
-      int sizep = stream_get_endp(obuf);
+  /* Save where we are now, so we can overwride the entry count later */
+  int sizep = stream_get_endp(obuf);
 
-      /* Entry count */
-      uint16_t entry_count = 0;
+  /* Entry count */
+  uint16_t entry_count = 0;
 
-      /* Entry count, note that this is overwritten later */
-      stream_putw(obuf, 0);
+  /* Entry count, note that this is overwritten later */
+  stream_putw(obuf, 0);
 
-      for (info = rn->info; info; info = info->next)
-        {
-          entry_count++;
+  for (info = rn->info; info; info = info->next)
+    {
+      /* Paths of peers newer than the walk are left out. */
+      if (info->peer->table_dump_index == TABLE_DUMP_V2_PEER_INDEX_NONE)
+        continue;
+
+      entry_count++;
 
-          /* Peer index */
-          stream_putw(obuf, info->peer->table_dump_index);
+      /* Peer index */
+      stream_putw(obuf, info->peer->table_dump_index);
 
-          /* Originated */
+      /* Originated */
 #ifdef HAVE_CLOCK_MONOTONIC
-          stream_putl (obuf, time(NULL) - (bgp_clock() - info->uptime));
+      stream_putl (obuf, time(NULL) - (bgp_clock() - info->uptime));
 #else
-          stream_putl (obuf, info->uptime);
+      stream_putl (obuf, info->uptime);
 #endif /* HAVE_CLOCK_MONOTONIC */
 
-          /* Dump attribute. */
-          /* Skip prefix & AFI/SAFI for MP_NLRI */
-          bgp_dump_routes_attr (obuf, info->attr, &rn->p);
+      /* Dump attribute. */
+      /* Skip prefix & AFI/SAFI for MP_NLRI */
+      bgp_dump_routes_attr (obuf, info->attr, &rn->p);
+    }
+
+  if (! entry_count)
+    return;
+
+  /* Overwrite the entry count, now that we know the right number */
+  stream_putw_at (obuf, sizep, entry_count);
+
+  bgp_dump->seq++;
+
+  bgp_dump_set_size(obuf, MSG_TABLE_DUMP_V2);
+  bgp_dump_put (bgp_dump, obuf);
+}
+
+/* Start walking the AFI table of the default instance.  0 if there is
+   none. */
+static int
+bgp_dump_walk_table (struct bgp_dump *bgp_dump, afi_t afi)
+{
+  struct bgp *bgp;
+
+  bgp = bgp_get_default ();
+  if (! bgp)
+    return 0;
+
+  bgp_dump->afi = afi;
+  bgp_table_iter_init (&bgp_dump->iter, bgp->rib[afi][SAFI_UNICAST]);
+  return 1;
+}
+
+/* The whole table is dumped. */
+static void
+bgp_dump_walk_end (struct bgp_dump *bgp_dump)
+{
+  struct timeval now;
+
+  quagga_gettime (QUAGGA_CLK_MONOTONIC, &now);
+  bgp_dump->dumps++;
+  bgp_dump->last_records = bgp_dump->seq;
+  bgp_dump->last_msec = timeval_elapsed (now, bgp_dump->start) / 1000;
+
+  /* Close the file now. For a RIB dump there's no point in leaving
+   * it open until the next scheduled dump starts. */
+  bgp_dump_close (bgp_dump);
+}
+
+/* Dump the next few nodes, or pause while the writer catches up. */
+static int
+bgp_dump_walk (struct thread *t)
+{
+  struct bgp_dump *bgp_dump = THREAD_ARG (t);
+  struct bgp_node *rn;
+  int n;
+
+  bgp_dump->t_walk = NULL;
+
+  if (bgp_dump_backlog ())
+    {
+      bgp_dump->t_walk = thread_add_background (master, bgp_dump_walk,
+                                                bgp_dump, BGP_DUMP_WALK_PAUSE);
+      return 0;
+    }
+
+  for (n = 0; n < BGP_DUMP_WALK_NODES; n++)
+    {
+      rn = bgp_table_iter_next (&bgp_dump->iter);
+      if (! rn)
+        {
+          bgp_table_iter_cleanup (&bgp_dump->iter);
+#ifdef HAVE_IPV6
+          if (bgp_dump->afi == AFI_IP
+              && bgp_dump_walk_table (bgp_dump, AFI_IP6))
+            continue;
+#endif /* HAVE_IPV6 */
+          bgp_dump_walk_end (bgp_dump);
+          return 0;
         }
 
-      /* Overwrite the entry count, now that we know the right number */
-      stream_putw_at (obuf, sizep, entry_count);
+      if (rn->info)
+        bgp_dump_routes_node (bgp_dump, rn);
+    }
 
-      seq++;
+  bgp_table_iter_pause (&bgp_dump->iter);
+  bgp_dump->t_walk = thread_add_background (master, bgp_dump_walk,
+                                            bgp_dump, 0);
+  return 0;
+}
 
-      bgp_dump_set_size(obuf, MSG_TABLE_DUMP_V2);
-      fwrite (STREAM_DATA (obuf), stream_get_endp (obuf), 1, bgp_dump_routes.fp);
+/* Start a table dump into the file just opened. */
+static void
+bgp_dump_walk_start (struct bgp_dump *bgp_dump)
+{
+  struct bgp *bgp;
 
+  bgp = bgp_get_default ();
+  if (! bgp)
+    {
+      bgp_dump_close (bgp_dump);
+      return;
     }
 
-  fflush (bgp_dump_routes.fp);
+  quagga_gettime (QUAGGA_CLK_MONOTONIC, &bgp_dump->start);
+  bgp_dump->seq = 0;
 
-  return seq;
+  /* The peer index table covers IPv4 and IPv6 peers alike. */
+  bgp_dump_routes_index_table (bgp);
+
+  bgp_dump_walk_table (bgp_dump, AFI_IP);
+  bgp_dump->t_walk = thread_add_background (master, bgp_dump_walk,
+                                            bgp_dump, 0);
 }
 
 static int
@@ -389,20 +849,20 @@ bgp_dump_interval_func (struct thread *t)
   bgp_dump = THREAD_ARG (t);
   bgp_dump->t_interval = NULL;
 
+  /* A table dump still under way is let finish. */
+  if (bgp_dump->iter.table)
+    {
+      zlog_warn ("%s: table dump still under way, skipping this one",
+                 bgp_dump->filename);
+      bgp_dump->skipped++;
+    }
   /* Reschedule dump even if file couldn't be opened this time... */
-  if (bgp_dump_open_file (bgp_dump) != NULL)
+  else if (bgp_dump_open_file (bgp_dump) != NULL)
     {
-      /* In case of bgp_dump_routes, we need special route dump function. */
+      /* In case of bgp_dump_routes, the table is walked a bit at a
+         time. */
       if (bgp_dump->type == BGP_DUMP_ROUTES)
-	{
-	  unsigned int seq = bgp_dump_routes_func (AFI_IP, 1, 0);
-#ifdef HAVE_IPV6
-	  bgp_dump_routes_func (AFI_IP6, 0, seq);
-#endif /* HAVE_IPV6 */
-	  /* Close the file now. For a RIB dump there's no point in leaving
-	   * it open until the next scheduled dump starts. */
-	  fclose(bgp_dump->fp); bgp_dump->fp = NULL;
-	}
+	bgp_dump_walk_start (bgp_dump);
     }
 
   /* if interval is set reschedule */
@@ -484,8 +944,7 @@ bgp_dump_state (struct peer *peer, int status_old, int status_new)
   bgp_dump_set_size (obuf, MSG_PROTOCOL_BGP4MP);
 
   /* Write to the stream. */
-  fwrite (STREAM_DATA (obuf), stream_get_endp (obuf), 1, bgp_dump_all.fp);
-  fflush (bgp_dump_all.fp);
+  bgp_dump_record (&bgp_dump_all, obuf);
 }
 
 static void
@@ -520,8 +979,7 @@ bgp_dump_packet_func (struct bgp_dump *bgp_dump, struct peer *peer,
   bgp_dump_set_size (obuf, MSG_PROTOCOL_BGP4MP);
 
   /* Write to the stream. */
-  fwrite (STREAM_DATA (obuf), stream_get_endp (obuf), 1, bgp_dump->fp);
-  fflush (bgp_dump->fp);
+  bgp_dump_record (bgp_dump, obuf);
 }
 
 /* Called from bgp_packet.c when BGP packet is received. */
@@ -649,11 +1107,7 @@ bgp_dump_unset (struct vty *vty, struct bgp_dump *bgp_dump)
     }
 
   /* This should be called when interval is expired. */
-  if (bgp_dump->fp)
-    {
-      fclose (bgp_dump->fp);
-      bgp_dump->fp = NULL;
-    }
+  bgp_dump_close (bgp_dump);
 
   /* Create interval thread. */
   if (bgp_dump->t_interval)
@@ -776,6 +1230,71 @@ DEFUN (no_dump_bgp_routes,
   return bgp_dump_unset (vty, &bgp_dump_routes);
 }
 
+static void
+bgp_dump_show (struct vty *vty, const char *name, struct bgp_dump *bgp_dump)
+{
+  unsigned long long bytes;
+  unsigned long errors;
+
+  if (! bgp_dump->filename)
+    return;
+
+#ifdef HAVE_PTHREAD
+  pthread_mutex_lock (&bdw.lock);
+#endif /* HAVE_PTHREAD */
+  bytes = bgp_dump->bytes;
+  errors = bgp_dump->errors;
+#ifdef HAVE_PTHREAD
+  pthread_mutex_unlock (&bdw.lock);
+#endif /* HAVE_PTHREAD */
+
+  vty_out (vty, "Dump bgp %s to %s%s", name, bgp_dump->filename, VTY_NEWLINE);
+  vty_out (vty, "  %lu records, %llu bytes written, %lu write errors%s",
+           bgp_dump->records, bytes, errors, VTY_NEWLINE);
+  if (bgp_dump->type == BGP_DUMP_ROUTES)
+    {
+      vty_out (vty, "  %lu table dumps, %lu skipped while one was under way%s",
+               bgp_dump->dumps, bgp_dump->skipped, VTY_NEWLINE);
+      if (bgp_dump->dumps)
+        vty_out (vty, "  Last took %lu msec for %lu prefixes%s",
+                 bgp_dump->last_msec, bgp_dump->last_records, VTY_NEWLINE);
+      if (bgp_dump->iter.table)
+        vty_out (vty, "  Under way, %u prefixes so far%s",
+                 bgp_dump->seq, VTY_NEWLINE);
+    }
+}
+
+DEFUN (show_bgp_dump,
+       show_bgp_dump_cmd,
+       "show bgp dump",
+       SHOW_STR
+       BGP_STR
+       "BGP packet and table dumps\n")
+{
+  size_t queued;
+
+#ifdef HAVE_PTHREAD
+  pthread_mutex_lock (&bdw.lock);
+#endif /* HAVE_PTHREAD */
+  queued = bdw.queued;
+#ifdef HAVE_PTHREAD
+  pthread_mutex_unlock (&bdw.lock);
+#endif /* HAVE_PTHREAD */
+
+  bgp_dump_show (vty, "all", &bgp_dump_all);
+  bgp_dump_show (vty, "updates", &bgp_dump_updates);
+  bgp_dump_show (vty, "routes-mrt", &bgp_dump_routes);
+
+#ifdef HAVE_PTHREAD
+  vty_out (vty, "Writer thread %s%s",
+           bdw.running ? "running" : "not running", VTY_NEWLINE);
+#endif /* HAVE_PTHREAD */
+  vty_out (vty, "%lu buffers handed to the writer, %lu bytes not yet"
+           " written, %lu waits for it%s",
+           bdw.buffers, (unsigned long) queued, bdw.waits, VTY_NEWLINE);
+  return CMD_SUCCESS;
+}
+
 /* BGP node structure. */
 static struct cmd_node bgp_dump_node =
 {
@@ -854,8 +1373,8 @@ bgp_dump_init (void)
   memset (&bgp_dump_updates, 0, sizeof (struct bgp_dump));
   memset (&bgp_dump_routes, 0, sizeof (struct bgp_dump));
 
-  bgp_dump_obuf = stream_new (BGP_MAX_PACKET_SIZE + BGP_DUMP_MSG_HEADER
-                              + BGP_DUMP_HEADER_SIZE);
+  bgp_dump_obuf = stream_new (BGP_EXTENDED_MESSAGE_MAX_PACKET_SIZE
+                              + BGP_DUMP_MSG_HEADER + BGP_DUMP_HEADER_SIZE);
 
   install_node (&bgp_dump_node, config_write_bgp_dump);
 
@@ -868,11 +1387,23 @@ bgp_dump_init (void)
   install_element (CONFIG_NODE, &dump_bgp_routes_cmd);
   install_element (CONFIG_NODE, &dump_bgp_routes_interval_cmd);
   install_element (CONFIG_NODE, &no_dump_bgp_routes_cmd);
+  install_element (VIEW_NODE, &show_bgp_dump_cmd);
+  install_element (ENABLE_NODE, &show_bgp_dump_cmd);
 }
 
 void
 bgp_dump_finish (void)
 {
+  /* Whatever was gathered is written before the writer stops. */
+  bgp_dump_close (&bgp_dump_all);
+  bgp_dump_close (&bgp_dump_updates);
+  bgp_dump_close (&bgp_dump_routes);
+  bgp_dump_writer_stop ();
+
+  bgp_dump_buf_free_list (bdw.done);
+  bgp_dump_buf_free_list (bdw.spare);
+  bdw.done = bdw.spare = NULL;
+
   stream_free (bgp_dump_obuf);
   bgp_dump_obuf = NULL;
 }
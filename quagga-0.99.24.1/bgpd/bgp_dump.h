@@ -47,6 +47,9 @@ Software Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
 #define TABLE_DUMP_V2_PEER_INDEX_TABLE_AS2 0
 #define TABLE_DUMP_V2_PEER_INDEX_TABLE_AS4 2
 
+/* Index of a peer created after the peer index table was written. */
+#define TABLE_DUMP_V2_PEER_INDEX_NONE      0xffff
+
 extern void bgp_dump_init (void);
 extern void bgp_dump_finish (void);
 extern void bgp_dump_state (struct peer *, int, int);
@@ -61,10 +61,18 @@ struct as_filter
 
   enum as_filter_type type;
 
-  regex_t *reg;
+  struct bgp_asregex *reg;
   char *reg_str;
+
+  /* Whether the expression matched interned AS paths, by their serial
+     numbers: (serial << 1) | matched.  Made when first wanted.  */
+  u_int32_t *cache;
+  unsigned int cache_epoch;
 };
 
+/* AS paths whose results each filter remembers. */
+#define AS_FILTER_CACHE_SIZE 16384
+
 enum as_list_type
 {
   ACCESS_TYPE_STRING,
@@ -107,15 +115,17 @@ static void
 as_filter_free (struct as_filter *asfilter)
 {
   if (asfilter->reg)
-    bgp_regex_free (asfilter->reg);
+    bgp_asregex_free (asfilter->reg);
   if (asfilter->reg_str)
     XFREE (MTYPE_AS_FILTER_STR, asfilter->reg_str);
+  if (asfilter->cache)
+    XFREE (MTYPE_AS_FILTER_CACHE, asfilter->cache);
   XFREE (MTYPE_AS_FILTER, asfilter);
 }
 
 /* Make new AS filter. */
 static struct as_filter *
-as_filter_make (regex_t *reg, const char *reg_str, enum as_filter_type type)
+as_filter_make (struct bgp_asregex *reg, const char *reg_str, enum as_filter_type type)
 {
   struct as_filter *asfilter;
 
@@ -371,12 +381,38 @@ as_list_filter_delete (struct as_list *aslist, struct as_filter *asfilter)
     (*as_list_master.delete_hook) ();
 }
 
+/* The same policy is applied to the same few AS paths over and over,
+   so the result for an interned AS path is remembered by the filter.
+   A filter's expression never changes; a changed list has new
+   filters.  */
 static int
 as_filter_match (struct as_filter *asfilter, struct aspath *aspath)
 {
-  if (bgp_regexec (asfilter->reg, aspath) != REG_NOMATCH)
-    return 1;
-  return 0;
+  u_int32_t *slot;
+  int match;
+
+  if (! aspath->serial)
+    return bgp_asregex_match (asfilter->reg, aspath);
+
+  if (! asfilter->cache)
+    {
+      asfilter->cache = XCALLOC (MTYPE_AS_FILTER_CACHE,
+                                 AS_FILTER_CACHE_SIZE * sizeof (u_int32_t));
+      asfilter->cache_epoch = aspath_serial_epoch ();
+    }
+  else if (asfilter->cache_epoch != aspath_serial_epoch ())
+    {
+      memset (asfilter->cache, 0, AS_FILTER_CACHE_SIZE * sizeof (u_int32_t));
+      asfilter->cache_epoch = aspath_serial_epoch ();
+    }
+
+  slot = &asfilter->cache[aspath->serial & (AS_FILTER_CACHE_SIZE - 1)];
+  if ((*slot >> 1) == aspath->serial)
+    return *slot & 1;
+
+  match = bgp_asregex_match (asfilter->reg, aspath);
+  *slot = (aspath->serial << 1) | match;
+  return match;
 }
 
 /* Apply AS path filter to AS. */
@@ -440,7 +476,7 @@ DEFUN (ip_as_path, ip_as_path_cmd,
   enum as_filter_type type;
   struct as_filter *asfilter;
   struct as_list *aslist;
-  regex_t *regex;
+  struct bgp_asregex *regex;
   char *regstr;
 
   /* Check the filter type. */
@@ -457,7 +493,7 @@ DEFUN (ip_as_path, ip_as_path_cmd,
   /* Check AS path regex. */
   regstr = argv_concat(argv, argc, 2);
 
-  regex = bgp_regcomp (regstr);
+  regex = bgp_asregex_compile (regstr);
   if (!regex)
     {
       XFREE (MTYPE_TMP, regstr);
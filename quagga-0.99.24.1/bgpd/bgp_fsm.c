@@ -40,6 +40,8 @@ Software Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
 #include "bgpd/bgp_route.h"
 #include "bgpd/bgp_dump.h"
 #include "bgpd/bgp_open.h"
+#include "bgpd/bgp_updgrp.h"
+#include "bgpd/bgp_io.h"
 #ifdef HAVE_SNMP
 #include "bgpd/bgp_snmp.h"
 #endif /* HAVE_SNMP */
@@ -194,8 +196,12 @@ bgp_timer_set (struct peer *peer)
 	{
 	  BGP_TIMER_ON (peer->t_holdtime, bgp_holdtime_timer,
 			peer->v_holdtime);
-	  BGP_TIMER_ON (peer->t_keepalive, bgp_keepalive_timer,
-			peer->v_keepalive);
+	  /* The I/O thread sends the KEEPALIVEs of its peers. */
+	  if (peer->io)
+	    BGP_TIMER_OFF (peer->t_keepalive);
+	  else
+	    BGP_TIMER_ON (peer->t_keepalive, bgp_keepalive_timer,
+			  peer->v_keepalive);
 	}
       BGP_TIMER_OFF (peer->t_asorig);
       break;
@@ -261,6 +267,19 @@ bgp_holdtime_timer (struct thread *thread)
   peer = THREAD_ARG (thread);
   peer->t_holdtime = NULL;
 
+  /* The I/O thread may have read packets the main thread has not got
+     round to yet. */
+  if (peer->io)
+    {
+      long left = bgp_io_readtime (peer) + peer->v_holdtime - bgp_clock ();
+
+      if (left > 0)
+	{
+	  BGP_TIMER_ON (peer->t_holdtime, bgp_holdtime_timer, left);
+	  return 0;
+	}
+    }
+
   if (BGP_DEBUG (fsm, FSM))
     zlog (peer->log, LOG_DEBUG,
 	  "%s [FSM] Timer (holdtime timer expire)",
@@ -306,6 +325,7 @@ bgp_routeadv_timer (struct thread *thread)
 	  peer->host);
 
   peer->synctime = bgp_clock ();
+  bgp_updgrp_routeadv (peer);
 
   BGP_WRITE_ON (peer->t_write, bgp_write, peer->fd);
 
@@ -496,6 +516,15 @@ bgp_stop (struct peer *peer)
       peer->synctime = 0;
     }
 
+  /* Leave update groups before the output buffer is cleared. */
+  bgp_updgrp_leave_all (peer);
+
+  /* Take the socket back from the I/O thread. */
+  bgp_io_detach (peer);
+
+  /* The next session may parse the same bytes differently. */
+  bgp_attr_cache_flush (peer);
+
   /* Stop read and write threads when exists. */
   BGP_READ_OFF (peer->t_read);
   BGP_WRITE_OFF (peer->t_write);
@@ -518,6 +547,7 @@ bgp_stop (struct peer *peer)
     stream_reset (peer->work);
   if (peer->obuf)
     stream_fifo_clean (peer->obuf);
+  bgp_packet_size_set (peer, BGP_MAX_PACKET_SIZE);
 
   /* Close of file descriptor. */
   if (peer->fd >= 0)
@@ -815,6 +845,14 @@ bgp_establish (struct peer *peer)
   peer->established++;
   bgp_fsm_change_status (peer, Established);
 
+  /* Extended messages are used when both sides asked for them. */
+  if (CHECK_FLAG (peer->cap, PEER_CAP_EXTENDED_MSG_ADV)
+      && CHECK_FLAG (peer->cap, PEER_CAP_EXTENDED_MSG_RCV))
+    bgp_packet_size_set (peer, BGP_EXTENDED_MESSAGE_MAX_PACKET_SIZE);
+
+  /* Hand the socket to the I/O thread, if it is on. */
+  bgp_io_attach (peer);
+
   /* bgp log-neighbor-changes of neighbor Up */
   if (bgp_flag_check (peer->bgp, BGP_FLAG_LOG_NEIGHBOR_CHANGES))
     zlog_info ("%%ADJCHANGE: neighbor %s Up", peer->host);
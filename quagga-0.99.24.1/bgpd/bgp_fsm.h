@@ -23,9 +23,11 @@ Software Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
 #define _QUAGGA_BGP_FSM_H
 
 /* Macro for BGP read, write and timer thread.  */
+/* The socket of a peer on the I/O thread is the thread's to read,
+   and packets are handed to it for writing from an event.  */
 #define BGP_READ_ON(T,F,V)			\
   do {						\
-    if (!(T) && (peer->status != Deleted))	\
+    if (!(T) && (peer->status != Deleted) && !peer->io) \
       THREAD_READ_ON(master,T,F,peer,V);	\
   } while (0)
 
@@ -38,7 +40,12 @@ Software Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
 #define BGP_WRITE_ON(T,F,V)			\
   do {						\
     if (!(T) && (peer->status != Deleted))	\
-      THREAD_WRITE_ON(master,(T),(F),peer,(V)); \
+      {						\
+	if (peer->io)				\
+	  (T) = thread_add_event (master, (F), peer, 0); \
+	else					\
+	  THREAD_WRITE_ON(master,(T),(F),peer,(V)); \
+      }						\
   } while (0)
     
 #define BGP_WRITE_OFF(T)			\
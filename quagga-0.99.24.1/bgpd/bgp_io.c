@@ -0,0 +1,922 @@
+/* BGP socket I/O thread.
+
+This file is part of GNU Zebra.
+
+GNU Zebra is free software; you can redistribute it and/or modify it
+under the terms of the GNU General Public License as published by the
+Free Software Foundation; either version 2, or (at your option) any
+later version.
+
+GNU Zebra is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with GNU Zebra; see the file COPYING.  If not, write to the Free
+Software Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
+02111-1307, USA.  */
+
+/* With "bgp io-thread", a session which becomes Established has its
+ * socket handed to the I/O thread.  The thread reads, cuts the stream
+ * into packets and checks their headers, writes, and sends KEEPALIVEs
+ * when nothing else went out for the keepalive interval, so none of it
+ * waits for the main thread to be done with best-path selection or
+ * UPDATE generation.
+ *
+ * Packets pass between the two threads through a pair of rings per
+ * peer, each with one producer and one consumer, which move their own
+ * end of the ring only.  A pipe each way wakes the other side when a
+ * ring goes from empty to not, or from full to not.  The set of peers
+ * on the thread only changes while the thread is parked at the top of
+ * its loop.  The thread allocates nothing and does not log.
+ */
+
+#include <zebra.h>
+
+#include "linklist.h"
+#include "memory.h"
+#include "command.h"
+#include "stream.h"
+#include "thread.h"
+#include "log.h"
+#include "network.h"
+#include "sockunion.h"
+#include "sigevent.h"
+
+#include "bgpd/bgpd.h"
+#include "bgpd/bgp_attr.h"
+#include "bgpd/bgp_fsm.h"
+#include "bgpd/bgp_packet.h"
+#include "bgpd/bgp_debug.h"
+#include "bgpd/bgp_io.h"
+
+#ifdef HAVE_BGP_IO
+
+#include <pthread.h>
+#include <poll.h>
+
+/* Packets end to end.  head and tail run freely and are masked on
+   use; the producer alone moves tail, the consumer alone head.  */
+struct bgp_io_ring
+{
+  u_char data[BGP_IO_RING_SIZE];
+  size_t head;
+  size_t tail;
+};
+
+#define BGP_IO_RING_MASK        (BGP_IO_RING_SIZE - 1)
+
+/* Why the thread stopped serving a peer. */
+enum bgp_io_error
+{
+  BGP_IO_OK = 0,
+  BGP_IO_CLOSED,        /* the peer closed the connection */
+  BGP_IO_READ,          /* read failed, errno in error_errno */
+  BGP_IO_WRITE,         /* write failed, errno in error_errno */
+  BGP_IO_HEADER,        /* bad header in error_hdr, subcode in error_code */
+};
+
+struct bgp_io
+{
+  struct peer *peer;
+  int fd;
+
+  /* Packets read by the thread, and packets for it to write. */
+  struct bgp_io_ring in;
+  struct bgp_io_ring out;
+
+  /* The thread's own: how far it has read past in.tail, and how much
+     of a KEEPALIVE of its own it has yet to write. */
+  size_t rpos;
+  size_t kleft;
+
+  /* Interval of the KEEPALIVEs the thread sends, 0 for none. */
+  time_t v_keepalive;
+
+  /* Largest packet the peer may send. */
+  bgp_size_t max_packet_size;
+
+  /* When the thread last read a whole packet, and last wrote. */
+  time_t readtime;
+  time_t writetime;
+
+  /* Set by the thread once it has stopped serving the peer. */
+  int error;
+  int error_errno;
+  int error_code;
+  u_char error_hdr[BGP_HEADER_SIZE];
+
+  /* Handshakes: the main thread waits for room in out, the thread for
+     room in in, and the thread found room in out. */
+  int wblocked;
+  int rstall;
+  int wready;
+
+  /* Statistics.  keepalives is handed over to the main thread. */
+  unsigned long packets_in;
+  unsigned long packets_out;
+  unsigned long keepalives;
+  unsigned long keepalives_sent;
+  unsigned long stalls;
+};
+
+static struct bgp_io_master
+{
+  pthread_t thread;
+  int running;
+
+  /* Held, and the thread parked, to change the set of peers. */
+  pthread_mutex_t lock;
+  pthread_cond_t cond;
+  int park;
+  int parked;
+  int stop;
+
+  /* Peers on the thread, and the thread's poll set for them. */
+  struct bgp_io **io;
+  struct pollfd *pfd;
+  int count;
+  int size;
+
+  /* Pipes waking the thread, and the main thread.  A flag is set while
+     a byte is in each, so there is never more than one. */
+  int kick[2];
+  int wake[2];
+  int kicked;
+  int woken;
+
+  struct thread *t_wake;
+  struct thread *t_pass;
+} bio =
+{
+  .lock = PTHREAD_MUTEX_INITIALIZER,
+  .cond = PTHREAD_COND_INITIALIZER,
+  .kick = { -1, -1 },
+  .wake = { -1, -1 },
+};
+
+/* The KEEPALIVE the thread sends. */
+static const u_char bgp_io_keepalive[BGP_HEADER_SIZE] =
+{
+  0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+  0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+  0x00, BGP_HEADER_SIZE, BGP_MSG_KEEPALIVE
+};
+
+#define BGP_IO_LOAD(V)          __atomic_load_n (&(V), __ATOMIC_ACQUIRE)
+#define BGP_IO_STORE(V,X)       __atomic_store_n (&(V), (X), __ATOMIC_RELEASE)
+#define BGP_IO_TAKE(V)          __atomic_exchange_n (&(V), 0, __ATOMIC_SEQ_CST)
+#define BGP_IO_FLAG(V)          __atomic_exchange_n (&(V), 1, __ATOMIC_SEQ_CST)
+
+/* Same clock as bgp_clock (), which the thread may not call. */
+static time_t
+bgp_io_clock (void)
+{
+  struct timespec tp;
+
+  clock_gettime (CLOCK_MONOTONIC, &tp);
+  return tp.tv_sec;
+}
+
+static void
+bgp_io_ring_get (const struct bgp_io_ring *ring, size_t pos, u_char *buf,
+                 size_t len)
+{
+  size_t off = pos & BGP_IO_RING_MASK;
+  size_t first = BGP_IO_RING_SIZE - off;
+
+  if (first > len)
+    first = len;
+  memcpy (buf, ring->data + off, first);
+  memcpy (buf + first, ring->data, len - first);
+}
+
+static void
+bgp_io_ring_put (struct bgp_io_ring *ring, size_t pos, const u_char *buf,
+                 size_t len)
+{
+  size_t off = pos & BGP_IO_RING_MASK;
+  size_t first = BGP_IO_RING_SIZE - off;
+
+  if (first > len)
+    first = len;
+  memcpy (ring->data + off, buf, first);
+  memcpy (ring->data, buf + first, len - first);
+}
+
+/* The bytes from pos on, as at most two pieces of the ring. */
+static int
+bgp_io_ring_iov (struct bgp_io_ring *ring, size_t pos, size_t len,
+                 struct iovec *iov)
+{
+  size_t off = pos & BGP_IO_RING_MASK;
+  size_t first = BGP_IO_RING_SIZE - off;
+
+  iov[0].iov_base = ring->data + off;
+  if (first >= len)
+    {
+      iov[0].iov_len = len;
+      return 1;
+    }
+  iov[0].iov_len = first;
+  iov[1].iov_base = ring->data;
+  iov[1].iov_len = len - first;
+  return 2;
+}
+
+static void
+bgp_io_signal (int fd, int *flag)
+{
+  if (! BGP_IO_FLAG (*flag))
+    if (write (fd, "", 1) < 0)
+      BGP_IO_TAKE (*flag);
+}
+
+static void
+bgp_io_drain (int fd, int *flag)
+{
+  char buf[64];
+
+  while (read (fd, buf, sizeof (buf)) > 0)
+    ;
+  BGP_IO_TAKE (*flag);
+}
+
+/* Thread side. */
+
+static void
+bgp_io_fail (struct bgp_io *io, int error, int code)
+{
+  io->error_errno = errno;
+  io->error_code = code;
+  BGP_IO_STORE (io->error, error);
+  bgp_io_signal (bio.wake[1], &bio.woken);
+}
+
+/* Read what there is room for, and hand over the whole packets. */
+static void
+bgp_io_read (struct bgp_io *io, time_t now)
+{
+  struct iovec iov[2];
+  size_t head, tail, size;
+  ssize_t nbytes;
+  int cnt, code, published = 0;
+
+  head = BGP_IO_LOAD (io->in.head);
+  size = BGP_IO_RING_SIZE - (io->rpos - head);
+  if (! size)
+    return;
+
+  cnt = bgp_io_ring_iov (&io->in, io->rpos, size, iov);
+  nbytes = readv (io->fd, iov, cnt);
+  if (nbytes < 0)
+    {
+      if (! ERRNO_IO_RETRY (errno))
+        bgp_io_fail (io, BGP_IO_READ, 0);
+      return;
+    }
+  io->rpos += nbytes;
+
+  /* Publish the packets read in full, as long as their headers hold. */
+  tail = io->in.tail;
+  while (io->rpos - tail >= BGP_HEADER_SIZE)
+    {
+      u_char *hdr = io->error_hdr;
+
+      bgp_io_ring_get (&io->in, tail, hdr, BGP_HEADER_SIZE);
+      if ((code = bgp_packet_header_check (hdr, io->max_packet_size)) != 0)
+        {
+          if (published)
+            BGP_IO_STORE (io->in.tail, tail);
+          bgp_io_fail (io, BGP_IO_HEADER, code);
+          return;
+        }
+      size = (hdr[BGP_MARKER_SIZE] << 8) | hdr[BGP_MARKER_SIZE + 1];
+      if (io->rpos - tail < size)
+        break;
+      tail += size;
+      published++;
+    }
+
+  if (published)
+    {
+      BGP_IO_STORE (io->in.tail, tail);
+      BGP_IO_STORE (io->readtime, now);
+      bgp_io_signal (bio.wake[1], &bio.woken);
+    }
+
+  if (nbytes == 0)
+    bgp_io_fail (io, BGP_IO_CLOSED, 0);
+}
+
+/* Write the KEEPALIVE under way, then what the main thread handed
+   over, until the socket is full. */
+static void
+bgp_io_write (struct bgp_io *io, time_t now)
+{
+  struct iovec iov[2];
+  size_t head, len;
+  ssize_t nbytes;
+  int cnt;
+
+  while (1)
+    {
+      if (io->kleft)
+        {
+          nbytes = write (io->fd,
+                          bgp_io_keepalive + BGP_HEADER_SIZE - io->kleft,
+                          io->kleft);
+          if (nbytes < 0)
+            break;
+          io->writetime = now;
+          io->kleft -= nbytes;
+          if (io->kleft)
+            return;
+          __atomic_fetch_add (&io->keepalives, 1, __ATOMIC_RELAXED);
+          __atomic_fetch_add (&io->keepalives_sent, 1, __ATOMIC_RELAXED);
+          bgp_io_signal (bio.wake[1], &bio.woken);
+          continue;
+        }
+
+      head = io->out.head;
+      len = BGP_IO_LOAD (io->out.tail) - head;
+      if (! len)
+        return;
+
+      cnt = bgp_io_ring_iov (&io->out, head, len, iov);
+      nbytes = writev (io->fd, iov, cnt);
+      if (nbytes < 0)
+        break;
+      io->writetime = now;
+      BGP_IO_STORE (io->out.head, head + nbytes);
+
+      if (BGP_IO_TAKE (io->wblocked))
+        {
+          BGP_IO_STORE (io->wready, 1);
+          bgp_io_signal (bio.wake[1], &bio.woken);
+        }
+      if ((size_t) nbytes < len)
+        return;
+    }
+
+  if (! ERRNO_IO_RETRY (errno))
+    bgp_io_fail (io, BGP_IO_WRITE, 0);
+}
+
+/* What the thread waits for on io's socket.  Starts a KEEPALIVE if
+   one is due, and lowers *timeout to when the next one is. */
+static short
+bgp_io_events (struct bgp_io *io, time_t now, int *timeout)
+{
+  short events = 0;
+  time_t due;
+
+  if (io->error)
+    return 0;
+
+  if (io->v_keepalive && ! io->kleft
+      && io->out.head == BGP_IO_LOAD (io->out.tail))
+    {
+      due = io->writetime + io->v_keepalive;
+      if (due <= now)
+        io->kleft = BGP_HEADER_SIZE;
+      else if (*timeout < 0 || (due - now) * 1000 < *timeout)
+        *timeout = (due - now) * 1000;
+    }
+
+  if (io->rpos - BGP_IO_LOAD (io->in.head) < BGP_IO_RING_SIZE)
+    events |= POLLIN;
+  else if (! BGP_IO_FLAG (io->rstall))
+    io->stalls++;
+  if (io->kleft || io->out.head != BGP_IO_LOAD (io->out.tail))
+    events |= POLLOUT;
+  return events;
+}
+
+static void *
+bgp_io_loop (void *arg)
+{
+  struct pollfd *pfd;
+  struct bgp_io *io;
+  time_t now;
+  int i, n, timeout;
+
+  while (1)
+    {
+      pthread_mutex_lock (&bio.lock);
+      if (bio.park)
+        {
+          bio.parked = 1;
+          pthread_cond_broadcast (&bio.cond);
+          while (bio.park)
+            pthread_cond_wait (&bio.cond, &bio.lock);
+          bio.parked = 0;
+        }
+      if (bio.stop)
+        {
+          pthread_mutex_unlock (&bio.lock);
+          break;
+        }
+      pthread_mutex_unlock (&bio.lock);
+
+      /* Anything handed over from here on kicks again. */
+      BGP_IO_TAKE (bio.kicked);
+
+      now = bgp_io_clock ();
+      timeout = -1;
+      pfd = bio.pfd;
+      n = bio.count;
+      pfd[n].fd = bio.kick[0];
+      pfd[n].events = POLLIN;
+      pfd[n].revents = 0;
+      for (i = 0; i < n; i++)
+        {
+          io = bio.io[i];
+          pfd[i].events = bgp_io_events (io, now, &timeout);
+          pfd[i].fd = pfd[i].events ? io->fd : -1;
+          pfd[i].revents = 0;
+        }
+
+      if (poll (pfd, n + 1, timeout) < 0)
+        {
+          if (ERRNO_IO_RETRY (errno))
+            continue;
+          break;
+        }
+
+      if (pfd[n].revents)
+        bgp_io_drain (bio.kick[0], &bio.kicked);
+
+      now = bgp_io_clock ();
+      for (i = 0; i < n; i++)
+        {
+          io = bio.io[i];
+          if (! pfd[i].revents)
+            continue;
+          if (pfd[i].revents & (POLLIN | POLLHUP | POLLERR))
+            bgp_io_read (io, now);
+          if ((pfd[i].revents & POLLOUT) && ! io->error)
+            bgp_io_write (io, now);
+        }
+    }
+  return NULL;
+}
+
+/* Main thread side. */
+
+static int bgp_io_wake (struct thread *);
+static int bgp_io_pass (struct thread *);
+
+/* Hold the thread at the top of its loop, where it does not look at
+   the peers. */
+static void
+bgp_io_park (void)
+{
+  if (! bio.running)
+    return;
+  pthread_mutex_lock (&bio.lock);
+  bio.park = 1;
+  bgp_io_signal (bio.kick[1], &bio.kicked);
+  while (! bio.parked)
+    pthread_cond_wait (&bio.cond, &bio.lock);
+}
+
+static void
+bgp_io_unpark (void)
+{
+  if (! bio.running)
+    return;
+  bio.park = 0;
+  pthread_cond_broadcast (&bio.cond);
+  pthread_mutex_unlock (&bio.lock);
+}
+
+static int
+bgp_io_start (void)
+{
+  int ret;
+
+  if (pipe (bio.kick) < 0 || pipe (bio.wake) < 0)
+    {
+      zlog_err ("Can't create I/O thread pipes: %s", safe_strerror (errno));
+      return -1;
+    }
+  set_nonblocking (bio.kick[0]);
+  set_nonblocking (bio.kick[1]);
+  set_nonblocking (bio.wake[0]);
+  set_nonblocking (bio.wake[1]);
+  bio.stop = 0;
+
+  ret = quagga_pthread_create (&bio.thread, bgp_io_loop, NULL);
+  if (ret)
+    {
+      zlog_err ("Can't start I/O thread: %s", safe_strerror (ret));
+      return -1;
+    }
+  bio.running = 1;
+  bio.t_wake = thread_add_read (master, bgp_io_wake, NULL, bio.wake[0]);
+  return 0;
+}
+
+static void
+bgp_io_stop (void)
+{
+  if (bio.running)
+    {
+      pthread_mutex_lock (&bio.lock);
+      bio.stop = 1;
+      pthread_mutex_unlock (&bio.lock);
+      bgp_io_signal (bio.kick[1], &bio.kicked);
+      pthread_join (bio.thread, NULL);
+      bio.running = 0;
+    }
+  THREAD_OFF (bio.t_wake);
+  THREAD_OFF (bio.t_pass);
+  if (bio.kick[0] >= 0)
+    {
+      close (bio.kick[0]);
+      close (bio.kick[1]);
+    }
+  if (bio.wake[0] >= 0)
+    {
+      close (bio.wake[0]);
+      close (bio.wake[1]);
+    }
+  bio.kick[0] = bio.kick[1] = bio.wake[0] = bio.wake[1] = -1;
+  bio.kicked = bio.woken = 0;
+}
+
+void
+bgp_io_attach (struct peer *peer)
+{
+  struct bgp_io *io;
+
+  if (! bgp_option_check (BGP_OPT_IO_THREAD) || peer->io || peer->fd < 0)
+    return;
+
+  /* Part of a packet read already stays with the main thread. */
+  if (stream_get_endp (peer->ibuf))
+    return;
+
+  if (! bio.running && bgp_io_start () < 0)
+    {
+      bgp_io_stop ();
+      return;
+    }
+
+  io = XCALLOC (MTYPE_BGP_IO, sizeof (struct bgp_io));
+  io->peer = peer;
+  io->fd = peer->fd;
+  io->v_keepalive = peer->v_holdtime ? peer->v_keepalive : 0;
+  io->max_packet_size = peer->max_packet_size;
+  io->readtime = io->writetime = bgp_clock ();
+
+  BGP_READ_OFF (peer->t_read);
+  BGP_WRITE_OFF (peer->t_write);
+
+  bgp_io_park ();
+  if (bio.count == bio.size)
+    {
+      bio.size = bio.size ? bio.size * 2 : 16;
+      bio.io = XREALLOC (MTYPE_BGP_IO, bio.io,
+                         bio.size * sizeof (struct bgp_io *));
+      bio.pfd = XREALLOC (MTYPE_BGP_IO, bio.pfd,
+                          (bio.size + 1) * sizeof (struct pollfd));
+    }
+  bio.io[bio.count++] = io;
+  bgp_io_unpark ();
+
+  peer->io = io;
+  if (BGP_DEBUG (events, EVENTS))
+    zlog_debug ("%s socket I/O moves to the I/O thread", peer->host);
+
+  /* Packets queued before the move. */
+  if (stream_fifo_head (peer->obuf))
+    BGP_WRITE_ON (peer->t_write, bgp_write, peer->fd);
+}
+
+/* Take the socket back.  What the thread had not written yet is lost,
+   as the session is about to go down. */
+void
+bgp_io_detach (struct peer *peer)
+{
+  struct bgp_io *io = peer->io;
+  int i;
+
+  if (! io)
+    return;
+
+  bgp_io_park ();
+  for (i = 0; i < bio.count; i++)
+    if (bio.io[i] == io)
+      {
+        bio.io[i] = bio.io[--bio.count];
+        break;
+      }
+  bgp_io_unpark ();
+
+  BGP_WRITE_OFF (peer->t_write);
+  peer->keepalive_out += io->keepalives;
+  peer->io = NULL;
+  XFREE (MTYPE_BGP_IO, io);
+
+  if (BGP_DEBUG (events, EVENTS))
+    zlog_debug ("%s socket I/O is back on the main thread", peer->host);
+
+  if (! bio.count && ! bgp_option_check (BGP_OPT_IO_THREAD))
+    bgp_io_stop ();
+}
+
+/* Hand a packet over to the thread.  -1 if there is no room for it;
+   bgp_write is scheduled again once there is. */
+int
+bgp_io_put (struct peer *peer, struct stream *s)
+{
+  struct bgp_io *io = peer->io;
+  size_t len = stream_get_endp (s) - stream_get_getp (s);
+  size_t tail = io->out.tail;
+
+  while (BGP_IO_RING_SIZE - (tail - BGP_IO_LOAD (io->out.head)) < len)
+    {
+      /* Look again once the thread can see we wait, lest it made room
+         just before. */
+      if (! BGP_IO_FLAG (io->wblocked))
+        continue;
+      return -1;
+    }
+
+  bgp_io_ring_put (&io->out, tail, STREAM_PNT (s), len);
+  BGP_IO_STORE (io->out.tail, tail + len);
+  io->packets_out++;
+  bgp_io_signal (bio.kick[1], &bio.kicked);
+  return 0;
+}
+
+time_t
+bgp_io_readtime (struct peer *peer)
+{
+  return BGP_IO_LOAD (peer->io->readtime);
+}
+
+/* The thread stopped serving the peer: take the socket back and go on
+   as the main thread would have had it met the error itself. */
+static void
+bgp_io_error (struct peer *peer)
+{
+  struct bgp_io *io = peer->io;
+  u_char hdr[BGP_HEADER_SIZE];
+  int error = io->error;
+  int code = io->error_code;
+  int err = io->error_errno;
+
+  memcpy (hdr, io->error_hdr, BGP_HEADER_SIZE);
+  bgp_io_detach (peer);
+
+  switch (error)
+    {
+    case BGP_IO_CLOSED:
+      if (BGP_DEBUG (events, EVENTS))
+        plog_debug (peer->log, "%s [Event] BGP connection closed fd %d",
+                    peer->host, peer->fd);
+      bgp_read_closed (peer);
+      BGP_EVENT_ADD (peer, TCP_connection_closed);
+      break;
+    case BGP_IO_READ:
+      plog_err (peer->log, "%s [Error] bgp_read_packet error: %s",
+                peer->host, safe_strerror (err));
+      bgp_read_closed (peer);
+      BGP_EVENT_ADD (peer, TCP_fatal_error);
+      break;
+    case BGP_IO_WRITE:
+      BGP_EVENT_ADD (peer, TCP_fatal_error);
+      break;
+    case BGP_IO_HEADER:
+      bgp_packet_header_error (peer, hdr, code);
+      break;
+    }
+}
+
+/* Process what the thread read for the peer.  Returns whether some of
+   it is left for another pass. */
+static int
+bgp_io_service (struct peer *peer)
+{
+  struct bgp_io *io = peer->io;
+  u_char hdr[BGP_HEADER_SIZE];
+  bgp_size_t size;
+  size_t head;
+  int n;
+
+  if (io->keepalives)
+    peer->keepalive_out += BGP_IO_TAKE (io->keepalives);
+
+  if (BGP_IO_TAKE (io->wready))
+    BGP_WRITE_ON (peer->t_write, bgp_write, peer->fd);
+
+  for (n = 0; n < BGP_IO_PACKET_MAX; n++)
+    {
+      head = io->in.head;
+      if (head == BGP_IO_LOAD (io->in.tail))
+        break;
+
+      bgp_io_ring_get (&io->in, head, hdr, BGP_HEADER_SIZE);
+      size = (hdr[BGP_MARKER_SIZE] << 8) | hdr[BGP_MARKER_SIZE + 1];
+
+      stream_reset (peer->ibuf);
+      bgp_io_ring_get (&io->in, head, STREAM_DATA (peer->ibuf), size);
+      stream_set_endp (peer->ibuf, size);
+      stream_set_getp (peer->ibuf, BGP_HEADER_SIZE);
+      peer->packet_size = size;
+
+      BGP_IO_STORE (io->in.head, head + size);
+      io->packets_in++;
+      if (BGP_IO_TAKE (io->rstall))
+        bgp_io_signal (bio.kick[1], &bio.kicked);
+
+      if (BGP_DEBUG (normal, NORMAL) && hdr[BGP_MARKER_SIZE + 2] != 2)
+        zlog_debug ("%s rcv message type %d, length (excl. header) %d",
+                    peer->host, hdr[BGP_MARKER_SIZE + 2],
+                    size - BGP_HEADER_SIZE);
+
+      bgp_read_process (peer);
+
+      /* The packet may have ended the session. */
+      if (peer->io != io)
+        return 0;
+    }
+
+  if (io->in.head != BGP_IO_LOAD (io->in.tail))
+    return 1;
+  if (BGP_IO_LOAD (io->error))
+    bgp_io_error (peer);
+  return 0;
+}
+
+static void
+bgp_io_run (void)
+{
+  struct peer **peers;
+  int i, count = bio.count, more = 0;
+
+  if (! count)
+    return;
+
+  /* Peers may leave the thread on the way. */
+  peers = XMALLOC (MTYPE_TMP, count * sizeof (struct peer *));
+  for (i = 0; i < count; i++)
+    peers[i] = peer_lock (bio.io[i]->peer);
+
+  for (i = 0; i < count; i++)
+    {
+      if (peers[i]->io)
+        more |= bgp_io_service (peers[i]);
+      peer_unlock (peers[i]);
+    }
+  XFREE (MTYPE_TMP, peers);
+
+  if (more && ! bio.t_pass)
+    bio.t_pass = thread_add_event (master, bgp_io_pass, NULL, 0);
+}
+
+static int
+bgp_io_wake (struct thread *thread)
+{
+  bio.t_wake = NULL;
+
+  /* Anything handed over from here on wakes again. */
+  bgp_io_drain (bio.wake[0], &bio.woken);
+  bio.t_wake = thread_add_read (master, bgp_io_wake, NULL, bio.wake[0]);
+
+  bgp_io_run ();
+  return 0;
+}
+
+static int
+bgp_io_pass (struct thread *thread)
+{
+  bio.t_pass = NULL;
+  bgp_io_run ();
+  return 0;
+}
+
+DEFUN (bgp_io_thread,
+       bgp_io_thread_cmd,
+       "bgp io-thread",
+       BGP_STR
+       "Read and write the sockets of established sessions on a thread of their own\n")
+{
+  bgp_option_set (BGP_OPT_IO_THREAD);
+  return CMD_SUCCESS;
+}
+
+DEFUN (no_bgp_io_thread,
+       no_bgp_io_thread_cmd,
+       "no bgp io-thread",
+       NO_STR
+       BGP_STR
+       "Read and write the sockets of established sessions on a thread of their own\n")
+{
+  bgp_option_unset (BGP_OPT_IO_THREAD);
+
+  /* Sessions on the thread stay there until they go down. */
+  if (! bio.count)
+    bgp_io_stop ();
+  return CMD_SUCCESS;
+}
+
+DEFUN (show_bgp_io_thread,
+       show_bgp_io_thread_cmd,
+       "show bgp io-thread",
+       SHOW_STR
+       BGP_STR
+       "Socket I/O thread\n")
+{
+  struct bgp_io *io;
+  int i;
+
+  if (! bio.running)
+    {
+      vty_out (vty, "I/O thread is not running%s", VTY_NEWLINE);
+      return CMD_SUCCESS;
+    }
+
+  vty_out (vty, "I/O thread serving %d sessions, rings of %d bytes%s",
+           bio.count, BGP_IO_RING_SIZE, VTY_NEWLINE);
+  if (! bio.count)
+    return CMD_SUCCESS;
+
+  vty_out (vty, "%sNeighbor          InQ    OutQ    PktsIn   PktsOut"
+           "  KeepAlive  Stalls%s", VTY_NEWLINE, VTY_NEWLINE);
+  for (i = 0; i < bio.count; i++)
+    {
+      io = bio.io[i];
+      vty_out (vty, "%-15s %6lu  %6lu %9lu %9lu %10lu %7lu%s",
+               io->peer->host,
+               (unsigned long) (BGP_IO_LOAD (io->in.tail) - io->in.head),
+               (unsigned long) (io->out.tail - BGP_IO_LOAD (io->out.head)),
+               io->packets_in, io->packets_out,
+               __atomic_load_n (&io->keepalives_sent, __ATOMIC_RELAXED),
+               __atomic_load_n (&io->stalls, __ATOMIC_RELAXED),
+               VTY_NEWLINE);
+    }
+  return CMD_SUCCESS;
+}
+
+void
+bgp_io_init (void)
+{
+  install_element (CONFIG_NODE, &bgp_io_thread_cmd);
+  install_element (CONFIG_NODE, &no_bgp_io_thread_cmd);
+  install_element (VIEW_NODE, &show_bgp_io_thread_cmd);
+  install_element (ENABLE_NODE, &show_bgp_io_thread_cmd);
+}
+
+void
+bgp_io_finish (void)
+{
+  bgp_io_stop ();
+  if (bio.io)
+    XFREE (MTYPE_BGP_IO, bio.io);
+  if (bio.pfd)
+    XFREE (MTYPE_BGP_IO, bio.pfd);
+  bio.io = NULL;
+  bio.pfd = NULL;
+  bio.count = bio.size = 0;
+}
+
+#else /* HAVE_BGP_IO */
+
+void
+bgp_io_init (void)
+{
+}
+
+void
+bgp_io_finish (void)
+{
+}
+
+void
+bgp_io_attach (struct peer *peer)
+{
+}
+
+void
+bgp_io_detach (struct peer *peer)
+{
+}
+
+int
+bgp_io_put (struct peer *peer, struct stream *s)
+{
+  return -1;
+}
+
+time_t
+bgp_io_readtime (struct peer *peer)
+{
+  return 0;
+}
+
+#endif /* HAVE_BGP_IO */
@@ -0,0 +1,45 @@
+/* BGP socket I/O thread.
+
+This file is part of GNU Zebra.
+
+GNU Zebra is free software; you can redistribute it and/or modify it
+under the terms of the GNU General Public License as published by the
+Free Software Foundation; either version 2, or (at your option) any
+later version.
+
+GNU Zebra is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with GNU Zebra; see the file COPYING.  If not, write to the Free
+Software Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
+02111-1307, USA.  */
+
+#ifndef _QUAGGA_BGP_IO_H
+#define _QUAGGA_BGP_IO_H
+
+/* Established sessions may have their socket read and written by a
+   thread of their own.  */
+#if defined(HAVE_PTHREAD) && defined(HAVE_CLOCK_MONOTONIC)
+#define HAVE_BGP_IO
+#endif
+
+/* Bytes of packets each way between a peer and the thread.  A power of
+   two, and room for a couple of packets of the largest size, extended
+   messages included.  */
+#define BGP_IO_RING_SIZE        (1 << 17)
+
+/* Packets taken from a peer's ring at a time, before others get a
+   turn.  */
+#define BGP_IO_PACKET_MAX       32
+
+extern void bgp_io_init (void);
+extern void bgp_io_finish (void);
+extern void bgp_io_attach (struct peer *);
+extern void bgp_io_detach (struct peer *);
+extern int bgp_io_put (struct peer *, struct stream *);
+extern time_t bgp_io_readtime (struct peer *);
+
+#endif /* _QUAGGA_BGP_IO_H */
@@ -49,6 +49,9 @@ Software Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
 #include "bgpd/bgp_debug.h"
 #include "bgpd/bgp_filter.h"
 #include "bgpd/bgp_zebra.h"
+#include "bgpd/bgp_updgrp.h"
+#include "bgpd/bgp_io.h"
+#include "bgpd/bgp_select.h"
 
 /* bgpd options, we use GNU getopt library. */
 static const struct option longopts[] = 
@@ -57,6 +60,7 @@ static const struct option longopts[] =
   { "config_file", required_argument, NULL, 'f'},
   { "pid_file",    required_argument, NULL, 'i'},
   { "socket",      required_argument, NULL, 'z'},
+  { "zebra_ring",  required_argument, NULL, 'R'},
   { "bgp_port",    required_argument, NULL, 'p'},
   { "listenon",    required_argument, NULL, 'l'},
   { "vty_addr",    required_argument, NULL, 'A'},
@@ -154,6 +158,7 @@ redistribution between different routing protocols.\n\n\
 -f, --config_file  Set configuration file name\n\
 -i, --pid_file     Set process identifier file name\n\
 -z, --socket       Set path of zebra socket\n\
+-R, --zebra_ring   Pass routes to zebra through a shared ring of this size\n\
 -p, --bgp_port     Set bgp protocol's port number\n\
 -l, --listenon     Listen on specified address (implies -n)\n\
 -A, --vty_addr     Set vty's bind address\n\
@@ -275,6 +280,15 @@ bgp_exit (int status)
   /* reverse bgp_scan_init */
   bgp_scan_finish ();
 
+  /* reverse bgp_updgrp_init */
+  bgp_updgrp_finish ();
+
+  /* reverse bgp_io_init */
+  bgp_io_finish ();
+
+  /* reverse bgp_select_init */
+  bgp_select_finish ();
+
   /* reverse access_list_init */
   access_list_add_hook (NULL);
   access_list_delete_hook (NULL);
@@ -306,6 +320,10 @@ bgp_exit (int status)
   if (master)
     thread_master_free (master);
 
+  /* Routes and nodes are all gone by now. */
+  bgp_slab_finish (&bgp_info_slab);
+  bgp_slab_finish (&bgp_node_slab);
+
   if (zlog_default)
     closezlog (zlog_default);
 
@@ -343,7 +361,7 @@ main (int argc, char **argv)
   /* Command line argument treatment. */
   while (1) 
     {
-      opt = getopt_long (argc, argv, "df:i:z:hp:l:A:P:rnu:g:vC", longopts, 0);
+      opt = getopt_long (argc, argv, "df:i:z:R:hp:l:A:P:rnu:g:vC", longopts, 0);
     
       if (opt == EOF)
 	break;
@@ -364,6 +382,9 @@ main (int argc, char **argv)
 	case 'z':
 	  zclient_serv_path_set (optarg);
 	  break;
+	case 'R':
+	  zclient_ring_slots_set (atoi (optarg));
+	  break;
 	case 'p':
 	  tmp_port = atoi (optarg);
 	  if (tmp_port <= 0 || tmp_port > 0xffff)
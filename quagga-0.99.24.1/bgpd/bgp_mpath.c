@@ -246,15 +246,15 @@ static struct bgp_info_mpath *
 bgp_info_mpath_get (struct bgp_info *binfo)
 {
   struct bgp_info_mpath *mpath;
-  if (!binfo->mpath)
+  if (!BGP_INFO_MPATH (binfo))
     {
       mpath = bgp_info_mpath_new();
       if (!mpath)
         return NULL;
-      binfo->mpath = mpath;
+      bgp_info_extra_get (binfo)->mpath = mpath;
       mpath->mp_info = binfo;
     }
-  return binfo->mpath;
+  return binfo->extra->mpath;
 }
 
 /*
@@ -290,7 +290,7 @@ bgp_info_mpath_enqueue (struct bgp_info *prev_info, struct bgp_info *binfo)
 void
 bgp_info_mpath_dequeue (struct bgp_info *binfo)
 {
-  struct bgp_info_mpath *mpath = binfo->mpath;
+  struct bgp_info_mpath *mpath = BGP_INFO_MPATH (binfo);
   if (!mpath)
     return;
   if (mpath->mp_prev)
@@ -309,9 +309,9 @@ bgp_info_mpath_dequeue (struct bgp_info *binfo)
 struct bgp_info *
 bgp_info_mpath_next (struct bgp_info *binfo)
 {
-  if (!binfo->mpath || !binfo->mpath->mp_next)
+  if (!BGP_INFO_MPATH (binfo) || !BGP_INFO_MPATH (binfo)->mp_next)
     return NULL;
-  return binfo->mpath->mp_next->mp_info;
+  return BGP_INFO_MPATH (binfo)->mp_next->mp_info;
 }
 
 /*
@@ -333,9 +333,9 @@ bgp_info_mpath_first (struct bgp_info *binfo)
 u_int32_t
 bgp_info_mpath_count (struct bgp_info *binfo)
 {
-  if (!binfo->mpath)
+  if (!BGP_INFO_MPATH (binfo))
     return 0;
-  return binfo->mpath->mp_count;
+  return BGP_INFO_MPATH (binfo)->mp_count;
 }
 
 /*
@@ -347,7 +347,7 @@ static void
 bgp_info_mpath_count_set (struct bgp_info *binfo, u_int32_t count)
 {
   struct bgp_info_mpath *mpath;
-  if (!count && !binfo->mpath)
+  if (!count && !BGP_INFO_MPATH (binfo))
     return;
   mpath = bgp_info_mpath_get (binfo);
   if (!mpath)
@@ -364,9 +364,9 @@ bgp_info_mpath_count_set (struct bgp_info *binfo, u_int32_t count)
 struct attr *
 bgp_info_mpath_attr (struct bgp_info *binfo)
 {
-  if (!binfo->mpath)
+  if (!BGP_INFO_MPATH (binfo))
     return NULL;
-  return binfo->mpath->mp_attr;
+  return BGP_INFO_MPATH (binfo)->mp_attr;
 }
 
 /*
@@ -378,7 +378,7 @@ static void
 bgp_info_mpath_attr_set (struct bgp_info *binfo, struct attr *attr)
 {
   struct bgp_info_mpath *mpath;
-  if (!attr && !binfo->mpath)
+  if (!attr && !BGP_INFO_MPATH (binfo))
     return;
   mpath = bgp_info_mpath_get (binfo);
   if (!mpath)
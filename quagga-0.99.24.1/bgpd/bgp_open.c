@@ -421,6 +421,7 @@ static const struct message capcode_str[] =
   { CAPABILITY_CODE_MP,			"MultiProtocol Extensions"	},
   { CAPABILITY_CODE_REFRESH,		"Route Refresh"			},
   { CAPABILITY_CODE_ORF,		"Cooperative Route Filtering" 	},
+  { CAPABILITY_CODE_EXTENDED_MSG,	"Extended Message"		},
   { CAPABILITY_CODE_RESTART,		"Graceful Restart"		},
   { CAPABILITY_CODE_AS4,		"4-octet AS number"		},
   { CAPABILITY_CODE_DYNAMIC,		"Dynamic"			},
@@ -435,6 +436,7 @@ static const size_t cap_minsizes[] =
   [CAPABILITY_CODE_MP]		= sizeof (struct capability_mp_data),
   [CAPABILITY_CODE_REFRESH]	= CAPABILITY_CODE_REFRESH_LEN,
   [CAPABILITY_CODE_ORF]		= sizeof (struct capability_orf_entry),
+  [CAPABILITY_CODE_EXTENDED_MSG]	= CAPABILITY_CODE_EXTENDED_MSG_LEN,
   [CAPABILITY_CODE_RESTART]	= sizeof (struct capability_gr),
   [CAPABILITY_CODE_AS4]		= CAPABILITY_CODE_AS4_LEN,
   [CAPABILITY_CODE_DYNAMIC]	= CAPABILITY_CODE_DYNAMIC_LEN,
@@ -499,6 +501,7 @@ bgp_capability_parse (struct peer *peer, size_t length, int *mp_capability,
           case CAPABILITY_CODE_REFRESH_OLD:
           case CAPABILITY_CODE_ORF:
           case CAPABILITY_CODE_ORF_OLD:
+          case CAPABILITY_CODE_EXTENDED_MSG:
           case CAPABILITY_CODE_RESTART:
           case CAPABILITY_CODE_AS4:
           case CAPABILITY_CODE_DYNAMIC:
@@ -563,6 +566,9 @@ bgp_capability_parse (struct peer *peer, size_t length, int *mp_capability,
           case CAPABILITY_CODE_DYNAMIC:
             SET_FLAG (peer->cap, PEER_CAP_DYNAMIC_RCV);
             break;
+          case CAPABILITY_CODE_EXTENDED_MSG:
+            SET_FLAG (peer->cap, PEER_CAP_EXTENDED_MSG_RCV);
+            break;
           case CAPABILITY_CODE_AS4:
               /* Already handled as a special-case parsing of the capabilities
                * at the beginning of OPEN processing. So we care not a jot
@@ -1023,6 +1029,17 @@ bgp_open_capability (struct stream *s, struct peer *peer)
       stream_putc (s, CAPABILITY_CODE_DYNAMIC_LEN);
     }
 
+  /* Extended message capability.  OPEN and KEEPALIVE stay within 4096
+     octets whatever is negotiated. */
+  if (CHECK_FLAG (peer->flags, PEER_FLAG_EXTENDED_MESSAGE))
+    {
+      SET_FLAG (peer->cap, PEER_CAP_EXTENDED_MSG_ADV);
+      stream_putc (s, BGP_OPEN_OPT_CAP);
+      stream_putc (s, CAPABILITY_CODE_EXTENDED_MSG_LEN + 2);
+      stream_putc (s, CAPABILITY_CODE_EXTENDED_MSG);
+      stream_putc (s, CAPABILITY_CODE_EXTENDED_MSG_LEN);
+    }
+
   /* Sending base graceful-restart capability irrespective of the config */
   SET_FLAG (peer->cap, PEER_CAP_RESTART_ADV);
   stream_putc (s, BGP_OPEN_OPT_CAP);
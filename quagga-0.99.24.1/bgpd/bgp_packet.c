@@ -47,6 +47,8 @@ Software Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
 #include "bgpd/bgp_mplsvpn.h"
 #include "bgpd/bgp_advertise.h"
 #include "bgpd/bgp_vty.h"
+#include "bgpd/bgp_updgrp.h"
+#include "bgpd/bgp_io.h"
 
 int stream_put_prefix (struct stream *, struct prefix *);
 
@@ -84,6 +86,21 @@ bgp_packet_set_size (struct stream *s)
   return cp;
 }
 
+/* Make SIZE the largest packet PEER sends and reads, and size its
+   packet buffers for it.  Updates are packed up to the size of the
+   buffers.  */
+void
+bgp_packet_size_set (struct peer *peer, bgp_size_t size)
+{
+  peer->max_packet_size = size;
+  if (peer->ibuf && STREAM_SIZE (peer->ibuf) != size)
+    stream_resize (peer->ibuf, size);
+  if (peer->work && STREAM_SIZE (peer->work) != size)
+    stream_resize (peer->work, size);
+  if (peer->scratch && STREAM_SIZE (peer->scratch) != size)
+    stream_resize (peer->scratch, size);
+}
+
 /* Add new packet to the peer. */
 static void
 bgp_packet_add (struct peer *peer, struct stream *s)
@@ -92,6 +109,41 @@ bgp_packet_add (struct peer *peer, struct stream *s)
   stream_fifo_push (peer->obuf, s);
 }
 
+/* Whether a member of an update group is kept from routes which came
+   from EXCEPT, with ORIGINATOR_ID ORIGINATOR if not NULL.  A route is
+   not sent back to the peer it came from, nor once reflected to the
+   router it originated at (RFC 4456).  */
+static int
+bgp_packet_excepted (struct peer *peer, struct peer *except,
+		     struct in_addr *originator)
+{
+  return peer == except
+	 || (originator && IPV4_ADDR_SAME (&peer->remote_id, originator));
+}
+
+/* Hand packet S to every member of GROUP but those excepted, and let
+   go of it.  Members share its data.  */
+static void
+bgp_packet_add_group (struct update_group *group, struct stream *s,
+		      struct peer *except, struct in_addr *originator)
+{
+  struct listnode *node;
+  struct peer *peer;
+
+  group->packets++;
+  for (ALL_LIST_ELEMENTS_RO (group->peers, node, peer))
+    {
+      BGP_WRITE_ON (peer->t_write, bgp_write, peer->fd);
+      if (bgp_packet_excepted (peer, except, originator))
+	continue;
+      bgp_packet_add (peer, stream_share (s));
+      group->copies++;
+      if (peer->obuf->count >= BGP_UPDGRP_OBUF_MAX)
+	group->blocked = 1;
+    }
+  stream_free (s);
+}
+
 /* Free first packet. */
 static void
 bgp_packet_delete (struct peer *peer)
@@ -137,7 +189,83 @@ bgp_connect_check (struct peer *peer)
     }
 }
 
-/* Make BGP update packet.  */
+/* Positions in a withdraw packet under construction.  */
+struct bgp_withdraw_pos
+{
+  size_t mp_start;
+  size_t attrlen_pos;
+  size_t mplen_pos;
+};
+
+/* Add RN to the withdraw packet being built in S.  */
+static void
+bgp_withdraw_prefix (struct stream *s, struct bgp_node *rn,
+		     afi_t afi, safi_t safi, struct bgp_withdraw_pos *pos)
+{
+  int first_time = stream_empty (s);
+
+  if (first_time)
+    {
+      bgp_packet_set_marker (s, BGP_MSG_UPDATE);
+      stream_putw (s, 0); /* unfeasible routes length */
+    }
+
+  if (afi == AFI_IP && safi == SAFI_UNICAST)
+    stream_put_prefix (s, &rn->p);
+  else
+    {
+      struct prefix_rd *prd = NULL;
+
+      if (rn->prn)
+	prd = (struct prefix_rd *) &rn->prn->p;
+
+      /* If first time, format the MP_UNREACH header */
+      if (first_time)
+	{
+	  pos->attrlen_pos = stream_get_endp (s);
+	  /* total attr length = 0 for now. reevaluate later */
+	  stream_putw (s, 0);
+	  pos->mp_start = stream_get_endp (s);
+	  pos->mplen_pos = bgp_packet_mpunreach_start(s, afi, safi);
+	}
+
+      bgp_packet_mpunreach_prefix(s, &rn->p, afi, safi, prd, NULL);
+    }
+}
+
+/* Finish the withdraw packet in S and return a copy of it.  */
+static struct stream *
+bgp_withdraw_end (struct stream *s, afi_t afi, safi_t safi,
+		  struct bgp_withdraw_pos *pos)
+{
+  struct stream *packet;
+  bgp_size_t unfeasible_len;
+  bgp_size_t total_attr_len;
+
+  if (afi == AFI_IP && safi == SAFI_UNICAST)
+    {
+      unfeasible_len
+	= stream_get_endp (s) - BGP_HEADER_SIZE - BGP_UNFEASIBLE_LEN;
+      stream_putw_at (s, BGP_HEADER_SIZE, unfeasible_len);
+      stream_putw (s, 0);
+    }
+  else
+    {
+      /* Set the mp_unreach attr's length */
+      bgp_packet_mpunreach_end(s, pos->mplen_pos);
+
+      /* Set total path attribute length. */
+      total_attr_len = stream_get_endp(s) - pos->mp_start;
+      stream_putw_at (s, pos->attrlen_pos, total_attr_len);
+    }
+  bgp_packet_set_size (s);
+  packet = stream_dup (s);
+  stream_reset (s);
+  return packet;
+}
+
+/* Make BGP update packet.  For an update group it is built once, on
+   behalf of PEER, and queued to all members.  */
 static struct stream *
 bgp_update_packet (struct peer *peer, afi_t afi, safi_t safi)
 {
@@ -152,13 +280,26 @@ bgp_update_packet (struct peer *peer, afi_t afi, safi_t safi)
   unsigned long attrlen_pos = 0;
   size_t mpattrlen_pos = 0;
   size_t mpattr_pos = 0;
+  struct update_group *group = peer->updgrp[afi][safi];
+  struct peer *owner = BGP_ADJ_OWNER (peer, afi, safi);
+  struct peer *except = NULL;
+  struct in_addr originator_id;
+  struct in_addr *originator = NULL;
+  struct stream *w = NULL;
+  struct bgp_withdraw_pos wpos;
 
   s = peer->work;
   stream_reset (s);
   snlri = peer->scratch;
   stream_reset (snlri);
 
-  adv = BGP_ADV_FIFO_HEAD (&peer->sync[afi][safi]->update);
+  if (group)
+    {
+      w = owner->work;
+      stream_reset (w);
+    }
+
+  adv = BGP_ADV_FIFO_HEAD (&owner->sync[afi][safi]->update);
 
   while (adv)
     {
@@ -173,6 +314,36 @@ bgp_update_packet (struct peer *peer, afi_t afi, safi_t safi)
 	  (BGP_NLRI_LENGTH + PSIZE (rn->p.prefixlen)))
 	break;
 
+      /* A member is not sent the routes it advertised, nor reflected
+	 routes it originated, the packet is for the others.  It is
+	 withdrawn what it was sent before.  The routes of a packet
+	 share their attributes, so their ORIGINATOR_ID.  */
+      if (group)
+	{
+	  struct peer *source = adv->binfo ? adv->binfo->peer : NULL;
+	  struct attr *attr = adv->baa->attr;
+
+	  if (source && source->updgrp[afi][safi] != group)
+	    source = NULL;
+	  if (stream_empty (s))
+	    {
+	      except = source;
+	      originator = NULL;
+	      if ((attr->flag & ATTR_FLAG_BIT (BGP_ATTR_ORIGINATOR_ID))
+		  && attr->extra)
+		{
+		  originator_id = attr->extra->originator_id;
+		  originator = &originator_id;
+		}
+	    }
+	  else if (source != except)
+	    break;
+	  else if ((except || originator) && adj->attr
+		   && STREAM_REMAIN (w) < (BGP_NLRI_LENGTH + BGP_TOTAL_ATTR_LEN
+					   + PSIZE (rn->p.prefixlen)))
+	    break;
+	}
+
       /* If packet is empty, set attribute. */
       if (stream_empty (s))
 	{
@@ -229,20 +400,24 @@ bgp_update_packet (struct peer *peer, afi_t afi, safi_t safi)
           char buf[INET6_BUFSIZ];
 
           zlog (peer->log, LOG_DEBUG, "%s send UPDATE %s/%d",
-                peer->host,
+                owner->host,
                 inet_ntop (rn->p.family, &(rn->p.u.prefix), buf, INET6_BUFSIZ),
                 rn->p.prefixlen);
         }
 
       /* Synchnorize attribute.  */
       if (adj->attr)
-	bgp_attr_unintern (&adj->attr);
+	{
+	  if (except || originator)
+	    bgp_withdraw_prefix (w, rn, afi, safi, &wpos);
+	  bgp_attr_unintern (&adj->attr);
+	}
       else
-	peer->scount[afi][safi]++;
+	owner->scount[afi][safi]++;
 
       adj->attr = bgp_attr_intern (adv->baa->attr);
 
-      adv = bgp_advertise_clean (peer, adj, afi, safi);
+      adv = bgp_advertise_clean (owner, adj, afi, safi);
     }
 
   if (! stream_empty (s))
@@ -261,10 +436,28 @@ bgp_update_packet (struct peer *peer, afi_t afi, safi_t safi)
       else
 	packet = stream_dup (s);
       bgp_packet_set_size (packet);
-      bgp_packet_add (peer, packet);
-      BGP_WRITE_ON (peer->t_write, bgp_write, peer->fd);
       stream_reset (s);
       stream_reset (snlri);
+
+      if (group)
+	{
+	  if (! stream_empty (w))
+	    {
+	      struct stream *withdraw = bgp_withdraw_end (w, afi, safi, &wpos);
+	      struct listnode *node;
+	      struct peer *member;
+
+	      for (ALL_LIST_ELEMENTS_RO (group->peers, node, member))
+		if (bgp_packet_excepted (member, except, originator))
+		  bgp_packet_add (member, stream_share (withdraw));
+	      stream_free (withdraw);
+	    }
+	  bgp_packet_add_group (group, packet, except, originator);
+	  return stream_fifo_head (peer->obuf);
+	}
+
+      bgp_packet_add (peer, packet);
+      BGP_WRITE_ON (peer->t_write, bgp_write, peer->fd);
       return packet;
     }
   return NULL;
@@ -331,17 +524,14 @@ bgp_withdraw_packet (struct peer *peer, afi_t afi, safi_t safi)
   struct bgp_adj_out *adj;
   struct bgp_advertise *adv;
   struct bgp_node *rn;
-  bgp_size_t unfeasible_len;
-  bgp_size_t total_attr_len;
-  size_t mp_start = 0;
-  size_t attrlen_pos = 0;
-  size_t mplen_pos = 0;
-  u_char first_time = 1;
+  struct bgp_withdraw_pos pos;
+  struct update_group *group = peer->updgrp[afi][safi];
+  struct peer *owner = BGP_ADJ_OWNER (peer, afi, safi);
 
   s = peer->work;
   stream_reset (s);
 
-  while ((adv = BGP_ADV_FIFO_HEAD (&peer->sync[afi][safi]->withdraw)) != NULL)
+  while ((adv = BGP_ADV_FIFO_HEAD (&owner->sync[afi][safi]->withdraw)) != NULL)
     {
       assert (adv->rn);
       adj = adv->adj;
@@ -351,74 +541,33 @@ bgp_withdraw_packet (struct peer *peer, afi_t afi, safi_t safi)
 	  < (BGP_NLRI_LENGTH + BGP_TOTAL_ATTR_LEN + PSIZE (rn->p.prefixlen)))
 	break;
 
-      if (stream_empty (s))
-	{
-	  bgp_packet_set_marker (s, BGP_MSG_UPDATE);
-	  stream_putw (s, 0); /* unfeasible routes length */
-	}
-      else
-	first_time = 0;
-
-      if (afi == AFI_IP && safi == SAFI_UNICAST)
-	stream_put_prefix (s, &rn->p);
-      else
-	{
-	  struct prefix_rd *prd = NULL;
-
-	  if (rn->prn)
-	    prd = (struct prefix_rd *) &rn->prn->p;
-
-	  /* If first time, format the MP_UNREACH header */
-	  if (first_time)
-	    {
-	      attrlen_pos = stream_get_endp (s);
-	      /* total attr length = 0 for now. reevaluate later */
-	      stream_putw (s, 0);
-	      mp_start = stream_get_endp (s);
-	      mplen_pos = bgp_packet_mpunreach_start(s, afi, safi);
-	    }
-
-	  bgp_packet_mpunreach_prefix(s, &rn->p, afi, safi, prd, NULL);
-	}
+      bgp_withdraw_prefix (s, rn, afi, safi, &pos);
 
       if (BGP_DEBUG (update, UPDATE_OUT))
         {
           char buf[INET6_BUFSIZ];
 
           zlog (peer->log, LOG_DEBUG, "%s send UPDATE %s/%d -- unreachable",
-                peer->host,
+                owner->host,
                 inet_ntop (rn->p.family, &(rn->p.u.prefix), buf, INET6_BUFSIZ),
                 rn->p.prefixlen);
         }
 
-      peer->scount[afi][safi]--;
+      owner->scount[afi][safi]--;
 
-      bgp_adj_out_remove (rn, adj, peer, afi, safi);
+      bgp_adj_out_remove (rn, adj, owner, afi, safi);
       bgp_unlock_node (rn);
     }
 
   if (! stream_empty (s))
     {
-      if (afi == AFI_IP && safi == SAFI_UNICAST)
+      packet = bgp_withdraw_end (s, afi, safi, &pos);
+      if (group)
 	{
-	  unfeasible_len
-	    = stream_get_endp (s) - BGP_HEADER_SIZE - BGP_UNFEASIBLE_LEN;
-	  stream_putw_at (s, BGP_HEADER_SIZE, unfeasible_len);
-	  stream_putw (s, 0);
+	  bgp_packet_add_group (group, packet, NULL, NULL);
+	  return stream_fifo_head (peer->obuf);
 	}
-      else
-	{
-	  /* Set the mp_unreach attr's length */
-	  bgp_packet_mpunreach_end(s, mplen_pos);
-
-	  /* Set total path attribute length. */
-	  total_attr_len = stream_get_endp(s) - mp_start;
-	  stream_putw_at (s, attrlen_pos, total_attr_len);
-	}
-      bgp_packet_set_size (s);
-      packet = stream_dup (s);
       bgp_packet_add (peer, packet);
-      stream_reset (s);
       return packet;
     }
 
@@ -586,6 +735,8 @@ bgp_write_packet (struct peer *peer)
   safi_t safi;
   struct stream *s = NULL;
   struct bgp_advertise *adv;
+  struct update_group *group;
+  struct peer *owner;
 
   s = stream_fifo_head (peer->obuf);
   if (s)
@@ -594,7 +745,12 @@ bgp_write_packet (struct peer *peer)
   for (afi = AFI_IP; afi < AFI_MAX; afi++)
     for (safi = SAFI_UNICAST; safi < SAFI_MAX; safi++)
       {
-	adv = BGP_ADV_FIFO_HEAD (&peer->sync[afi][safi]->withdraw);
+	group = peer->updgrp[afi][safi];
+	if (group && bgp_updgrp_blocked (group))
+	  continue;
+	owner = BGP_ADJ_OWNER (peer, afi, safi);
+
+	adv = BGP_ADV_FIFO_HEAD (&owner->sync[afi][safi]->withdraw);
 	if (adv)
 	  {
 	    s = bgp_withdraw_packet (peer, afi, safi);
@@ -606,10 +762,17 @@ bgp_write_packet (struct peer *peer)
   for (afi = AFI_IP; afi < AFI_MAX; afi++)
     for (safi = SAFI_UNICAST; safi < SAFI_MAX; safi++)
       {
-	adv = BGP_ADV_FIFO_HEAD (&peer->sync[afi][safi]->update);
-	if (adv)
+	group = peer->updgrp[afi][safi];
+	owner = BGP_ADJ_OWNER (peer, afi, safi);
+
+	/* A group packet may leave PEER out, then try the next one.  */
+	while ((adv = BGP_ADV_FIFO_HEAD (&owner->sync[afi][safi]->update)))
 	  {
-            if (adv->binfo && adv->binfo->uptime < peer->synctime)
+	    if (group && bgp_updgrp_blocked (group))
+	      break;
+
+            if (adv->binfo && adv->binfo->uptime < (group ? group->synctime
+						    : peer->synctime))
 	      {
 		if (CHECK_FLAG (adv->binfo->peer->cap, PEER_CAP_RESTART_RCV)
 		    && CHECK_FLAG (adv->binfo->peer->cap, PEER_CAP_RESTART_ADV)
@@ -630,6 +793,9 @@ bgp_write_packet (struct peer *peer)
 
 	    if (s)
 	      return s;
+	    if (! group
+		|| BGP_ADV_FIFO_HEAD (&owner->sync[afi][safi]->update) == adv)
+	      break;
 	  }
 
 	if (CHECK_FLAG (peer->cap, PEER_CAP_RESTART_RCV))
@@ -655,24 +821,55 @@ bgp_write_proceed (struct peer *peer)
   afi_t afi;
   safi_t safi;
   struct bgp_advertise *adv;
+  struct update_group *group;
+  struct peer *owner;
 
   if (stream_fifo_head (peer->obuf))
     return 1;
 
   for (afi = AFI_IP; afi < AFI_MAX; afi++)
     for (safi = SAFI_UNICAST; safi < SAFI_MAX; safi++)
-      if (FIFO_HEAD (&peer->sync[afi][safi]->withdraw))
-	return 1;
+      {
+	group = peer->updgrp[afi][safi];
+	if (group && group->blocked)
+	  continue;
+	owner = BGP_ADJ_OWNER (peer, afi, safi);
 
-  for (afi = AFI_IP; afi < AFI_MAX; afi++)
-    for (safi = SAFI_UNICAST; safi < SAFI_MAX; safi++)
-      if ((adv = BGP_ADV_FIFO_HEAD (&peer->sync[afi][safi]->update)) != NULL)
-	if (adv->binfo->uptime < peer->synctime)
+	if (FIFO_HEAD (&owner->sync[afi][safi]->withdraw))
 	  return 1;
+	if ((adv = BGP_ADV_FIFO_HEAD (&owner->sync[afi][safi]->update)) != NULL)
+	  if (adv->binfo->uptime < (group ? group->synctime : peer->synctime))
+	    return 1;
+      }
 
   return 0;
 }
 
+/* Count a packet other than a NOTIFICATION going out. */
+static void
+bgp_packet_count_out (struct peer *peer, u_char type)
+{
+  switch (type)
+    {
+    case BGP_MSG_OPEN:
+      peer->open_out++;
+      break;
+    case BGP_MSG_UPDATE:
+      peer->update_out++;
+      break;
+    case BGP_MSG_KEEPALIVE:
+      peer->keepalive_out++;
+      break;
+    case BGP_MSG_ROUTE_REFRESH_NEW:
+    case BGP_MSG_ROUTE_REFRESH_OLD:
+      peer->refresh_out++;
+      break;
+    case BGP_MSG_CAPABILITY:
+      peer->dynamic_cap_out++;
+      break;
+    }
+}
+
 /* Write packet to the peer. */
 int
 bgp_write (struct thread *thread)
@@ -698,6 +895,25 @@ bgp_write (struct thread *thread)
   if (!s)
     return 0;	/* nothing to send */
 
+  /* The I/O thread writes for its peers: hand the packets over, until
+     it has no room left.  It makes us write again once it has.  */
+  if (peer->io)
+    {
+      do
+	{
+	  if (bgp_io_put (peer, s) < 0)
+	    return 0;
+	  bgp_packet_count_out (peer, stream_getc_from (s, BGP_MARKER_SIZE + 2));
+	  bgp_packet_delete (peer);
+	}
+      while (++count < BGP_WRITE_PACKET_MAX &&
+	     (s = bgp_write_packet (peer)) != NULL);
+
+      if (bgp_write_proceed (peer))
+	BGP_WRITE_ON (peer->t_write, bgp_write, peer->fd);
+      return 0;
+    }
+
   sockopt_cork (peer->fd, 1);
 
   /* Nonblocking write until TCP output buffer is full.  */
@@ -733,12 +949,6 @@ bgp_write (struct thread *thread)
 
       switch (type)
 	{
-	case BGP_MSG_OPEN:
-	  peer->open_out++;
-	  break;
-	case BGP_MSG_UPDATE:
-	  peer->update_out++;
-	  break;
 	case BGP_MSG_NOTIFY:
 	  peer->notify_out++;
 	  /* Double start timer. */
@@ -752,15 +962,8 @@ bgp_write (struct thread *thread)
 	  BGP_EVENT_ADD (peer, BGP_Stop);
 	  goto done;
 
-	case BGP_MSG_KEEPALIVE:
-	  peer->keepalive_out++;
-	  break;
-	case BGP_MSG_ROUTE_REFRESH_NEW:
-	case BGP_MSG_ROUTE_REFRESH_OLD:
-	  peer->refresh_out++;
-	  break;
-	case BGP_MSG_CAPABILITY:
-	  peer->dynamic_cap_out++;
+	default:
+	  bgp_packet_count_out (peer, type);
 	  break;
 	}
 
@@ -1009,7 +1212,8 @@ bgp_notify_send_with_data (struct peer *peer, u_char code, u_char sub_code,
      zlog_info ("Notification sent to neighbor %s: configuration change",
                 peer->host);
 
-  /* Call immediately. */
+  /* Call immediately, on the socket taken back from the I/O thread. */
+  bgp_io_detach (peer);
   BGP_WRITE_OFF (peer->t_write);
 
   bgp_write_notify (peer);
@@ -1605,6 +1809,8 @@ bgp_update_receive (struct peer *peer, bgp_size_t size)
   struct stream *s;
   struct attr attr;
   struct attr_extra extra;
+  struct attr *cached = NULL;
+  u_char *attribute;
   bgp_size_t attribute_len;
   bgp_size_t update_len;
   bgp_size_t withdraw_len;
@@ -1717,8 +1923,18 @@ bgp_update_receive (struct peer *peer, bgp_size_t size)
    */
 #define NLRI_ATTR_ARG (attr_parse_ret != BGP_ATTR_PARSE_WITHDRAW ? &attr : NULL)
 
-  /* Parse attribute when it exists. */
+  /* Parse attribute when it exists, unless the same bytes were parsed
+     before.  The cached attribute is held until the UPDATE is done. */
+  attribute = stream_pnt (s);
   if (attribute_len)
+    cached = bgp_attr_cache_get (peer, attribute, attribute_len);
+  if (cached)
+    {
+      cached = bgp_attr_intern (cached);
+      bgp_attr_dup (&attr, cached);
+      stream_forward_getp (s, attribute_len);
+    }
+  else if (attribute_len)
     {
       attr_parse_ret = bgp_attr_parse (peer, &attr, attribute_len, 
 			    &mp_update, &mp_withdraw);
@@ -1727,6 +1943,8 @@ bgp_update_receive (struct peer *peer, bgp_size_t size)
 	  bgp_attr_unintern_sub (&attr);
 	  return -1;
 	}
+      if (attr_parse_ret == BGP_ATTR_PARSE_PROCEED)
+	bgp_attr_cache_set (peer, attribute, attribute_len, &attr);
     }
   
   /* Logging the attribute. */
@@ -1759,7 +1977,10 @@ bgp_update_receive (struct peer *peer, bgp_size_t size)
       ret = bgp_nlri_sanity_check (peer, AFI_IP, stream_pnt (s), update_len);
       if (ret < 0)
         {
-          bgp_attr_unintern_sub (&attr);
+          if (cached)
+            bgp_attr_unintern (&cached);
+          else
+            bgp_attr_unintern_sub (&attr);
 	  return -1;
 	}
 
@@ -1920,7 +2141,10 @@ bgp_update_receive (struct peer *peer, bgp_size_t size)
 
   /* Everything is done.  We unintern temporary structures which
      interned in bgp_attr_parse(). */
-  bgp_attr_unintern_sub (&attr);
+  if (cached)
+    bgp_attr_unintern (&cached);
+  else
+    bgp_attr_unintern_sub (&attr);
 
   /* If peering is stopped due to some reason, do not generate BGP
      event.  */
@@ -2375,6 +2599,22 @@ bgp_capability_receive (struct peer *peer, bgp_size_t size)
   return bgp_capability_msg_parse (peer, pnt, size);
 }
 
+/* The connection went away under an established session: note why. */
+void
+bgp_read_closed (struct peer *peer)
+{
+  if (peer->status == Established) 
+    {
+      if (CHECK_FLAG (peer->sflags, PEER_STATUS_NSF_MODE))
+	{
+	  peer->last_reset = PEER_DOWN_NSF_CLOSE_SESSION;
+	  SET_FLAG (peer->sflags, PEER_STATUS_NSF_WAIT);
+	}
+      else
+	peer->last_reset = PEER_DOWN_CLOSE_SESSION;
+    }
+}
+
 /* BGP read utility function. */
 static int
 bgp_read_packet (struct peer *peer)
@@ -2401,17 +2641,7 @@ bgp_read_packet (struct peer *peer)
       plog_err (peer->log, "%s [Error] bgp_read_packet error: %s",
 		 peer->host, safe_strerror (errno));
 
-      if (peer->status == Established) 
-	{
-	  if (CHECK_FLAG (peer->sflags, PEER_STATUS_NSF_MODE))
-	    {
-	      peer->last_reset = PEER_DOWN_NSF_CLOSE_SESSION;
-	      SET_FLAG (peer->sflags, PEER_STATUS_NSF_WAIT);
-	    }
-	  else
-	    peer->last_reset = PEER_DOWN_CLOSE_SESSION;
-	}
-
+      bgp_read_closed (peer);
       BGP_EVENT_ADD (peer, TCP_fatal_error);
       return -1;
     }  
@@ -2423,17 +2653,7 @@ bgp_read_packet (struct peer *peer)
 	plog_debug (peer->log, "%s [Event] BGP connection closed fd %d",
 		   peer->host, peer->fd);
 
-      if (peer->status == Established) 
-	{
-	  if (CHECK_FLAG (peer->sflags, PEER_STATUS_NSF_MODE))
-	    {
-	      peer->last_reset = PEER_DOWN_NSF_CLOSE_SESSION;
-	      SET_FLAG (peer->sflags, PEER_STATUS_NSF_WAIT);
-	    }
-	  else
-	    peer->last_reset = PEER_DOWN_CLOSE_SESSION;
-	}
-
+      bgp_read_closed (peer);
       BGP_EVENT_ADD (peer, TCP_connection_closed);
       return -1;
     }
@@ -2445,17 +2665,85 @@ bgp_read_packet (struct peer *peer)
   return 0;
 }
 
-/* Marker check. */
-static int
-bgp_marker_all_one (struct stream *s, int length)
+/* Check a packet header, for packets of up to MAX octets.  Returns 0
+   if it is good, or the subcode of the Message Header Error otherwise.
+   Called from the I/O thread as well, so it only looks at HDR.  */
+int
+bgp_packet_header_check (const u_char *hdr, bgp_size_t max)
 {
+  bgp_size_t size;
+  u_char type;
   int i;
 
-  for (i = 0; i < length; i++)
-    if (s->data[i] != 0xff)
-      return 0;
+  size = (hdr[BGP_MARKER_SIZE] << 8) | hdr[BGP_MARKER_SIZE + 1];
+  type = hdr[BGP_MARKER_SIZE + 2];
+
+  /* Marker check */
+  if (type == BGP_MSG_OPEN || type == BGP_MSG_KEEPALIVE)
+    for (i = 0; i < BGP_MARKER_SIZE; i++)
+      if (hdr[i] != 0xff)
+	return BGP_NOTIFY_HEADER_NOT_SYNC;
+
+  /* BGP type check. */
+  if (type != BGP_MSG_OPEN && type != BGP_MSG_UPDATE 
+      && type != BGP_MSG_NOTIFY && type != BGP_MSG_KEEPALIVE 
+      && type != BGP_MSG_ROUTE_REFRESH_NEW
+      && type != BGP_MSG_ROUTE_REFRESH_OLD
+      && type != BGP_MSG_CAPABILITY)
+    return BGP_NOTIFY_HEADER_BAD_MESTYPE;
+
+  /* Mimimum packet length check. */
+  if ((size < BGP_HEADER_SIZE)
+      || (size > max)
+      || (type == BGP_MSG_OPEN && size < BGP_MSG_OPEN_MIN_SIZE)
+      || (type == BGP_MSG_OPEN && size > BGP_MAX_PACKET_SIZE)
+      || (type == BGP_MSG_UPDATE && size < BGP_MSG_UPDATE_MIN_SIZE)
+      || (type == BGP_MSG_NOTIFY && size < BGP_MSG_NOTIFY_MIN_SIZE)
+      || (type == BGP_MSG_KEEPALIVE && size != BGP_MSG_KEEPALIVE_MIN_SIZE)
+      || (type == BGP_MSG_ROUTE_REFRESH_NEW && size < BGP_MSG_ROUTE_REFRESH_MIN_SIZE)
+      || (type == BGP_MSG_ROUTE_REFRESH_OLD && size < BGP_MSG_ROUTE_REFRESH_MIN_SIZE)
+      || (type == BGP_MSG_CAPABILITY && size < BGP_MSG_CAPABILITY_MIN_SIZE))
+    return BGP_NOTIFY_HEADER_BAD_MESLEN;
 
-  return 1;
+  return 0;
+}
+
+/* Send the NOTIFICATION for a header which failed the check above. */
+void
+bgp_packet_header_error (struct peer *peer, const u_char *hdr, int subcode)
+{
+  bgp_size_t size;
+  u_char type;
+  u_char data[2];
+
+  size = (hdr[BGP_MARKER_SIZE] << 8) | hdr[BGP_MARKER_SIZE + 1];
+  type = hdr[BGP_MARKER_SIZE + 2];
+
+  switch (subcode)
+    {
+    case BGP_NOTIFY_HEADER_NOT_SYNC:
+      bgp_notify_send (peer, BGP_NOTIFY_HEADER_ERR, subcode);
+      break;
+    case BGP_NOTIFY_HEADER_BAD_MESTYPE:
+      if (BGP_DEBUG (normal, NORMAL))
+	plog_debug (peer->log,
+		  "%s unknown message type 0x%02x",
+		  peer->host, type);
+      bgp_notify_send_with_data (peer, BGP_NOTIFY_HEADER_ERR, subcode,
+				 &type, 1);
+      break;
+    case BGP_NOTIFY_HEADER_BAD_MESLEN:
+      if (BGP_DEBUG (normal, NORMAL))
+	plog_debug (peer->log,
+		  "%s bad message length - %d for %s",
+		  peer->host, size, 
+		  type == 128 ? "ROUTE-REFRESH" :
+		  bgp_type_str[(int) type]);
+      memcpy (data, hdr + BGP_MARKER_SIZE, 2);
+      bgp_notify_send_with_data (peer, BGP_NOTIFY_HEADER_ERR, subcode,
+				 data, 2);
+      break;
+    }
 }
 
 /* Recent thread time.
@@ -2467,15 +2755,64 @@ bgp_recent_clock (void)
   return recent_relative_time().tv_sec;
 }
 
+/* Process the packet read in full into the input buffer. */
+void
+bgp_read_process (struct peer *peer)
+{
+  u_char type;
+  bgp_size_t size;
+
+  type = stream_getc_from (peer->ibuf, BGP_MARKER_SIZE + 2);
+
+  /* BGP packet dump function. */
+  bgp_dump_packet (peer, type, peer->ibuf);
+  
+  size = (peer->packet_size - BGP_HEADER_SIZE);
+
+  /* Read rest of the packet and call each sort of packet routine */
+  switch (type) 
+    {
+    case BGP_MSG_OPEN:
+      peer->open_in++;
+      bgp_open_receive (peer, size); /* XXX return value ignored! */
+      break;
+    case BGP_MSG_UPDATE:
+      peer->readtime = bgp_recent_clock ();
+      bgp_update_receive (peer, size);
+      break;
+    case BGP_MSG_NOTIFY:
+      bgp_notify_receive (peer, size);
+      break;
+    case BGP_MSG_KEEPALIVE:
+      peer->readtime = bgp_recent_clock ();
+      bgp_keepalive_receive (peer, size);
+      break;
+    case BGP_MSG_ROUTE_REFRESH_NEW:
+    case BGP_MSG_ROUTE_REFRESH_OLD:
+      peer->refresh_in++;
+      bgp_route_refresh_receive (peer, size);
+      break;
+    case BGP_MSG_CAPABILITY:
+      peer->dynamic_cap_in++;
+      bgp_capability_receive (peer, size);
+      break;
+    }
+
+  /* Clear input buffer. */
+  peer->packet_size = 0;
+  if (peer->ibuf)
+    stream_reset (peer->ibuf);
+}
+
 /* Starting point of packet process function. */
 int
 bgp_read (struct thread *thread)
 {
   int ret;
+  int subcode;
   u_char type = 0;
   struct peer *peer;
   bgp_size_t size;
-  char notify_data_length[2];
 
   /* Yes first of all get peer pointer. */
   peer = THREAD_ARG (thread);
@@ -2511,7 +2848,6 @@ bgp_read (struct thread *thread)
 
       /* Get size and type. */
       stream_forward_getp (peer->ibuf, BGP_MARKER_SIZE);
-      memcpy (notify_data_length, stream_pnt (peer->ibuf), 2);
       size = stream_getw (peer->ibuf);
       type = stream_getc (peer->ibuf);
 
@@ -2519,54 +2855,12 @@ bgp_read (struct thread *thread)
 	zlog_debug ("%s rcv message type %d, length (excl. header) %d",
 		   peer->host, type, size - BGP_HEADER_SIZE);
 
-      /* Marker check */
-      if (((type == BGP_MSG_OPEN) || (type == BGP_MSG_KEEPALIVE))
-	  && ! bgp_marker_all_one (peer->ibuf, BGP_MARKER_SIZE))
-	{
-	  bgp_notify_send (peer,
-			   BGP_NOTIFY_HEADER_ERR, 
-			   BGP_NOTIFY_HEADER_NOT_SYNC);
-	  goto done;
-	}
-
-      /* BGP type check. */
-      if (type != BGP_MSG_OPEN && type != BGP_MSG_UPDATE 
-	  && type != BGP_MSG_NOTIFY && type != BGP_MSG_KEEPALIVE 
-	  && type != BGP_MSG_ROUTE_REFRESH_NEW
-	  && type != BGP_MSG_ROUTE_REFRESH_OLD
-	  && type != BGP_MSG_CAPABILITY)
+      /* Marker, type and length check. */
+      subcode = bgp_packet_header_check (STREAM_DATA (peer->ibuf),
+					 peer->max_packet_size);
+      if (subcode)
 	{
-	  if (BGP_DEBUG (normal, NORMAL))
-	    plog_debug (peer->log,
-		      "%s unknown message type 0x%02x",
-		      peer->host, type);
-	  bgp_notify_send_with_data (peer,
-				     BGP_NOTIFY_HEADER_ERR,
-			 	     BGP_NOTIFY_HEADER_BAD_MESTYPE,
-				     &type, 1);
-	  goto done;
-	}
-      /* Mimimum packet length check. */
-      if ((size < BGP_HEADER_SIZE)
-	  || (size > BGP_MAX_PACKET_SIZE)
-	  || (type == BGP_MSG_OPEN && size < BGP_MSG_OPEN_MIN_SIZE)
-	  || (type == BGP_MSG_UPDATE && size < BGP_MSG_UPDATE_MIN_SIZE)
-	  || (type == BGP_MSG_NOTIFY && size < BGP_MSG_NOTIFY_MIN_SIZE)
-	  || (type == BGP_MSG_KEEPALIVE && size != BGP_MSG_KEEPALIVE_MIN_SIZE)
-	  || (type == BGP_MSG_ROUTE_REFRESH_NEW && size < BGP_MSG_ROUTE_REFRESH_MIN_SIZE)
-	  || (type == BGP_MSG_ROUTE_REFRESH_OLD && size < BGP_MSG_ROUTE_REFRESH_MIN_SIZE)
-	  || (type == BGP_MSG_CAPABILITY && size < BGP_MSG_CAPABILITY_MIN_SIZE))
-	{
-	  if (BGP_DEBUG (normal, NORMAL))
-	    plog_debug (peer->log,
-		      "%s bad message length - %d for %s",
-		      peer->host, size, 
-		      type == 128 ? "ROUTE-REFRESH" :
-		      bgp_type_str[(int) type]);
-	  bgp_notify_send_with_data (peer,
-				     BGP_NOTIFY_HEADER_ERR,
-			  	     BGP_NOTIFY_HEADER_BAD_MESLEN,
-				     (u_char *) notify_data_length, 2);
+	  bgp_packet_header_error (peer, STREAM_DATA (peer->ibuf), subcode);
 	  goto done;
 	}
 
@@ -2578,48 +2872,7 @@ bgp_read (struct thread *thread)
   if (ret < 0) 
     goto done;
 
-  /* Get size and type again. */
-  size = stream_getw_from (peer->ibuf, BGP_MARKER_SIZE);
-  type = stream_getc_from (peer->ibuf, BGP_MARKER_SIZE + 2);
-
-  /* BGP packet dump function. */
-  bgp_dump_packet (peer, type, peer->ibuf);
-  
-  size = (peer->packet_size - BGP_HEADER_SIZE);
-
-  /* Read rest of the packet and call each sort of packet routine */
-  switch (type) 
-    {
-    case BGP_MSG_OPEN:
-      peer->open_in++;
-      bgp_open_receive (peer, size); /* XXX return value ignored! */
-      break;
-    case BGP_MSG_UPDATE:
-      peer->readtime = bgp_recent_clock ();
-      bgp_update_receive (peer, size);
-      break;
-    case BGP_MSG_NOTIFY:
-      bgp_notify_receive (peer, size);
-      break;
-    case BGP_MSG_KEEPALIVE:
-      peer->readtime = bgp_recent_clock ();
-      bgp_keepalive_receive (peer, size);
-      break;
-    case BGP_MSG_ROUTE_REFRESH_NEW:
-    case BGP_MSG_ROUTE_REFRESH_OLD:
-      peer->refresh_in++;
-      bgp_route_refresh_receive (peer, size);
-      break;
-    case BGP_MSG_CAPABILITY:
-      peer->dynamic_cap_in++;
-      bgp_capability_receive (peer, size);
-      break;
-    }
-
-  /* Clear input buffer. */
-  peer->packet_size = 0;
-  if (peer->ibuf)
-    stream_reset (peer->ibuf);
+  bgp_read_process (peer);
 
  done:
   if (CHECK_FLAG (peer->sflags, PEER_STATUS_ACCEPT_PEER))
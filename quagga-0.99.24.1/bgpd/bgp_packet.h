@@ -40,6 +40,12 @@ Software Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
 /* Packet send and receive function prototypes. */
 extern int bgp_read (struct thread *);
 extern int bgp_write (struct thread *);
+extern void bgp_read_process (struct peer *);
+extern void bgp_read_closed (struct peer *);
+extern int bgp_packet_header_check (const u_char *, bgp_size_t);
+extern void bgp_packet_header_error (struct peer *, const u_char *, int);
+
+extern void bgp_packet_size_set (struct peer *, bgp_size_t);
 
 extern void bgp_keepalive_send (struct peer *);
 extern void bgp_open_send (struct peer *);
@@ -23,6 +23,8 @@ Software Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
 #include "log.h"
 #include "command.h"
 #include "memory.h"
+#include "hash.h"
+#include "jhash.h"
 
 #include "bgpd.h"
 #include "bgp_aspath.h"
@@ -33,8 +35,8 @@ Software Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
 
    (^|[,{}() ]|$) */
 
-regex_t *
-bgp_regcomp (const char *regstr)
+static char *
+bgp_regex_magic (const char *regstr)
 {
   /* Convert _ character to generic regular expression. */
   int i, j;
@@ -42,8 +44,6 @@ bgp_regcomp (const char *regstr)
   int magic = 0;
   char *magic_str;
   char magic_regexp[] = "(^|[,{}() ]|$)";
-  int ret;
-  regex_t *regex;
 
   len = strlen (regstr);
   for (i = 0; i < len; i++)
@@ -64,6 +64,18 @@ bgp_regcomp (const char *regstr)
     }
   magic_str[j] = '\0';
 
+  return magic_str;
+}
+
+regex_t *
+bgp_regcomp (const char *regstr)
+{
+  char *magic_str;
+  int ret;
+  regex_t *regex;
+
+  magic_str = bgp_regex_magic (regstr);
+
   regex = XMALLOC (MTYPE_BGP_REGEXP, sizeof (regex_t));
 
   ret = regcomp (regex, magic_str, REG_EXTENDED|REG_NOSUB);
@@ -82,7 +94,7 @@ bgp_regcomp (const char *regstr)
 int
 bgp_regexec (regex_t *regex, struct aspath *aspath)
 {
-  return regexec (regex, aspath->str, 0, NULL, 0);
+  return regexec (regex, aspath_print (aspath), 0, NULL, 0);
 }
 
 void
@@ -91,3 +103,735 @@ bgp_regex_free (regex_t *regex)
   regfree (regex);
   XFREE (MTYPE_BGP_REGEXP, regex);
 }
+
+/* AS path expressions are compiled, after `_' is expanded as above,
+ * into an NFA over the symbols AS paths are written with: digits and
+ * the delimiters of aspath_print.  The NFA is searched with a DFA made
+ * as it is needed and kept, a step per symbol, with the symbols taken
+ * straight from the segments, so no string is made and a match takes
+ * time linear in the length of the AS path whatever the expression.
+ * The meaning is that of regexec on the string, which the tests check;
+ * the few constructs whose meaning in the POSIX syntax is unclear, such
+ * as back references, character classes and `{' that isn't an interval,
+ * leave the expression to regexec.
+ */
+
+/* Symbols: the digits are 0 to 9, then these. */
+static const char asregex_delims[] = " ,{}()[]";
+#define ASREGEX_SYMBOLS         18
+#define ASREGEX_ALL             ((1U << ASREGEX_SYMBOLS) - 1)
+
+/* Beyond these an expression is left to regexec. */
+#define ASREGEX_NFA_MAX         4096
+#define ASREGEX_DUP_MAX         255
+
+/* DFA states kept.  When there would be more they are all forgotten
+   and made again as needed.  */
+#define ASREGEX_DFA_MAX         1024
+
+enum asregex_type
+{
+  ASREGEX_SYM,
+  ASREGEX_SPLIT,
+  ASREGEX_BOL,
+  ASREGEX_EOL,
+  ASREGEX_MATCH,
+  ASREGEX_CAT,
+  ASREGEX_ALT,
+  ASREGEX_REPEAT,
+};
+
+/* Parsed expression. */
+struct asregex_node
+{
+  enum asregex_type type;
+  u_int32_t mask;
+  int min;
+  int max;                      /* -1 for no limit */
+  struct asregex_node *left;
+  struct asregex_node *right;
+};
+
+struct asregex_parse
+{
+  const char *p;
+  struct asregex_node *node;
+  int count;
+  int max;
+};
+
+/* NFA state.  SYM states move to out on a symbol of mask, SPLIT to
+   both out and out1, BOL and EOL to out at the start and end.  */
+struct asregex_state
+{
+  u_char type;
+  u_int32_t mask;
+  int out;
+  int out1;
+};
+
+/* DFA state: the SYM and MATCH states the NFA may be in, and the EOL
+   states waiting for the end, sorted.  */
+struct asregex_dstate
+{
+  int *states;
+  int count;
+  u_char initial;
+  u_char ready;
+  u_char accept;
+  u_char accept_end;
+  struct asregex_dstate *next[ASREGEX_SYMBOLS];
+};
+
+struct bgp_asregex
+{
+  /* Either the NFA or, failing that, the expression for regexec. */
+  struct asregex_state *nfa;
+  int nfa_count;
+  int start;
+  regex_t *reg;
+
+  struct hash *dfa;
+  struct asregex_dstate *initial;
+  unsigned long flushes;
+
+  /* Scratch space for making DFA states. */
+  u_int32_t *mark;
+  u_int32_t generation;
+  int *stack;
+  int *set;
+  int *end;
+};
+
+static int
+asregex_symbol (int c)
+{
+  const char *d;
+
+  if (c >= '0' && c <= '9')
+    return c - '0';
+  if (c && (d = strchr (asregex_delims, c)) != NULL)
+    return 10 + (d - asregex_delims);
+  return -1;
+}
+
+static u_int32_t
+asregex_mask (int c)
+{
+  int sym = asregex_symbol (c);
+
+  return (sym < 0) ? 0 : (1U << sym);
+}
+
+static struct asregex_node *
+asregex_node (struct asregex_parse *ps, enum asregex_type type,
+              struct asregex_node *left, struct asregex_node *right)
+{
+  struct asregex_node *n;
+
+  if (ps->count == ps->max)
+    return NULL;
+  n = &ps->node[ps->count++];
+  n->type = type;
+  n->left = left;
+  n->right = right;
+  return n;
+}
+
+static struct asregex_node *
+asregex_sym (struct asregex_parse *ps, u_int32_t mask)
+{
+  struct asregex_node *n = asregex_node (ps, ASREGEX_SYM, NULL, NULL);
+
+  if (n)
+    n->mask = mask;
+  return n;
+}
+
+static struct asregex_node *asregex_parse_alt (struct asregex_parse *);
+
+/* [...], with ps->p just past the `['. */
+static struct asregex_node *
+asregex_parse_bracket (struct asregex_parse *ps)
+{
+  const u_char *p = (const u_char *) ps->p;
+  u_int32_t mask = 0;
+  int negate = 0;
+  int first = 1;
+  int lo, hi, c;
+
+  if (*p == '^')
+    {
+      negate = 1;
+      p++;
+    }
+
+  while (*p != ']' || first)
+    {
+      if (! *p)
+        return NULL;
+      if (*p == '[' && (p[1] == ':' || p[1] == '=' || p[1] == '.'))
+        return NULL;
+
+      lo = hi = *p++;
+      if (*p == '-' && p[1] && p[1] != ']')
+        {
+          hi = p[1];
+          p += 2;
+          if (hi == '[' || lo > hi)
+            return NULL;
+        }
+      for (c = lo; c <= hi; c++)
+        mask |= asregex_mask (c);
+      first = 0;
+    }
+  ps->p = (const char *) p + 1;
+
+  return asregex_sym (ps, negate ? (ASREGEX_ALL & ~mask) : mask);
+}
+
+static struct asregex_node *
+asregex_parse_atom (struct asregex_parse *ps)
+{
+  struct asregex_node *n;
+  int c = (u_char) *ps->p;
+
+  switch (c)
+    {
+    case '(':
+      ps->p++;
+      if (*ps->p == ')')
+        return NULL;
+      n = asregex_parse_alt (ps);
+      if (! n || *ps->p != ')')
+        return NULL;
+      ps->p++;
+      return n;
+    case '.':
+      ps->p++;
+      return asregex_sym (ps, ASREGEX_ALL);
+    case '^':
+      ps->p++;
+      return asregex_node (ps, ASREGEX_BOL, NULL, NULL);
+    case '$':
+      ps->p++;
+      return asregex_node (ps, ASREGEX_EOL, NULL, NULL);
+    case '[':
+      ps->p++;
+      return asregex_parse_bracket (ps);
+    case '\\':
+      c = (u_char) ps->p[1];
+      if (! c || isalnum (c) || strchr ("<>`'", c))
+        return NULL;
+      ps->p += 2;
+      return asregex_sym (ps, asregex_mask (c));
+    case '*':
+    case '+':
+    case '?':
+    case '{':
+    case '|':
+    case ')':
+    case '\0':
+      return NULL;
+    default:
+      ps->p++;
+      return asregex_sym (ps, asregex_mask (c));
+    }
+}
+
+/* {m}, {m,} or {m,n}, with ps->p just past the `{'. */
+static int
+asregex_parse_interval (struct asregex_parse *ps, int *min, int *max)
+{
+  char *end;
+  unsigned long m, n;
+
+  if (! isdigit ((u_char) *ps->p))
+    return -1;
+  m = strtoul (ps->p, &end, 10);
+  n = m;
+  if (*end == ',')
+    {
+      end++;
+      if (isdigit ((u_char) *end))
+        n = strtoul (end, &end, 10);
+      else
+        n = ULONG_MAX;
+    }
+  if (*end != '}' || m > ASREGEX_DUP_MAX
+      || (n != ULONG_MAX && (n > ASREGEX_DUP_MAX || n < m)))
+    return -1;
+
+  ps->p = end + 1;
+  *min = m;
+  *max = (n == ULONG_MAX) ? -1 : (int) n;
+  return 0;
+}
+
+static struct asregex_node *
+asregex_parse_piece (struct asregex_parse *ps)
+{
+  struct asregex_node *n, *r;
+  int min, max;
+  int c;
+
+  n = asregex_parse_atom (ps);
+  while (n)
+    {
+      c = *ps->p;
+      if (c != '*' && c != '+' && c != '?' && c != '{')
+        return n;
+
+      /* Anchors repeated are left to regexec. */
+      if (n->type == ASREGEX_BOL || n->type == ASREGEX_EOL)
+        return NULL;
+
+      ps->p++;
+      if (c == '{')
+        {
+          if (asregex_parse_interval (ps, &min, &max) < 0)
+            return NULL;
+        }
+      else
+        {
+          min = (c == '+');
+          max = (c == '?') ? 1 : -1;
+        }
+
+      r = asregex_node (ps, ASREGEX_REPEAT, n, NULL);
+      if (! r)
+        return NULL;
+      r->min = min;
+      r->max = max;
+      n = r;
+    }
+  return n;
+}
+
+static struct asregex_node *
+asregex_parse_branch (struct asregex_parse *ps)
+{
+  struct asregex_node *n = NULL;
+  struct asregex_node *piece;
+
+  while (*ps->p && *ps->p != '|' && *ps->p != ')')
+    {
+      piece = asregex_parse_piece (ps);
+      if (! piece)
+        return NULL;
+      n = n ? asregex_node (ps, ASREGEX_CAT, n, piece) : piece;
+      if (! n)
+        return NULL;
+    }
+  return n;
+}
+
+static struct asregex_node *
+asregex_parse_alt (struct asregex_parse *ps)
+{
+  struct asregex_node *n;
+  struct asregex_node *branch;
+
+  n = asregex_parse_branch (ps);
+  while (n && *ps->p == '|')
+    {
+      ps->p++;
+      branch = asregex_parse_branch (ps);
+      if (! branch)
+        return NULL;
+      n = asregex_node (ps, ASREGEX_ALT, n, branch);
+    }
+  return n;
+}
+
+static int
+asregex_state_new (struct bgp_asregex *re, u_char type, u_int32_t mask,
+                   int out, int out1)
+{
+  struct asregex_state *s;
+
+  if (out < 0 || (type == ASREGEX_SPLIT && out1 < 0)
+      || re->nfa_count == ASREGEX_NFA_MAX)
+    return -1;
+  s = &re->nfa[re->nfa_count];
+  s->type = type;
+  s->mask = mask;
+  s->out = out;
+  s->out1 = out1;
+  return re->nfa_count++;
+}
+
+/* NFA states for N, going on to NEXT, working backwards.  Returns the
+   first, or -1 if there would be too many.  */
+static int
+asregex_emit (struct bgp_asregex *re, struct asregex_node *n, int next)
+{
+  int split, body, i;
+
+  if (next < 0)
+    return -1;
+
+  switch (n->type)
+    {
+    case ASREGEX_SYM:
+      return asregex_state_new (re, ASREGEX_SYM, n->mask, next, -1);
+    case ASREGEX_BOL:
+    case ASREGEX_EOL:
+      return asregex_state_new (re, n->type, 0, next, -1);
+    case ASREGEX_CAT:
+      return asregex_emit (re, n->left, asregex_emit (re, n->right, next));
+    case ASREGEX_ALT:
+      return asregex_state_new (re, ASREGEX_SPLIT, 0,
+                                asregex_emit (re, n->left, next),
+                                asregex_emit (re, n->right, next));
+    case ASREGEX_REPEAT:
+      /* x{m,n} is m x's then n - m optional ones, nested; x{m,} ends
+         with x*.  */
+      if (n->max < 0)
+        {
+          split = asregex_state_new (re, ASREGEX_SPLIT, 0, next, next);
+          if (split < 0)
+            return -1;
+          body = asregex_emit (re, n->left, split);
+          if (body < 0)
+            return -1;
+          re->nfa[split].out = body;
+          next = split;
+        }
+      else
+        for (i = n->min; i < n->max; i++)
+          next = asregex_state_new (re, ASREGEX_SPLIT, 0,
+                                    asregex_emit (re, n->left, next), next);
+      for (i = 0; i < n->min; i++)
+        next = asregex_emit (re, n->left, next);
+      return next;
+    default:
+      return -1;
+    }
+}
+
+static unsigned int
+asregex_dstate_key (void *arg)
+{
+  struct asregex_dstate *d = arg;
+
+  return jhash2 ((u_int32_t *) d->states, d->count, d->initial);
+}
+
+static int
+asregex_dstate_cmp (const void *arg1, const void *arg2)
+{
+  const struct asregex_dstate *d1 = arg1;
+  const struct asregex_dstate *d2 = arg2;
+
+  return d1->count == d2->count && d1->initial == d2->initial
+    && ! memcmp (d1->states, d2->states, d1->count * sizeof (int));
+}
+
+static void *
+asregex_dstate_alloc (void *arg)
+{
+  struct asregex_dstate *key = arg;
+  struct asregex_dstate *d;
+
+  d = XCALLOC (MTYPE_BGP_ASREGEX, sizeof (struct asregex_dstate));
+  d->states = XMALLOC (MTYPE_BGP_ASREGEX, key->count * sizeof (int));
+  memcpy (d->states, key->states, key->count * sizeof (int));
+  d->count = key->count;
+  d->initial = key->initial;
+  return d;
+}
+
+static void
+asregex_dstate_free (void *arg)
+{
+  struct asregex_dstate *d = arg;
+
+  XFREE (MTYPE_BGP_ASREGEX, d->states);
+  XFREE (MTYPE_BGP_ASREGEX, d);
+}
+
+static int
+asregex_int_cmp (const void *a, const void *b)
+{
+  return *(const int *) a - *(const int *) b;
+}
+
+/* The states reached from the COUNT in FROM, and the start too if
+   WITH_START, without a symbol, into SET.  Returns how many.  */
+static int
+asregex_closure (struct bgp_asregex *re, const int *from, int count,
+                 int with_start, int bol, int eol, int *set)
+{
+  struct asregex_state *st;
+  int sp = 0;
+  int n = 0;
+  int s;
+
+  if (++re->generation == 0)
+    {
+      memset (re->mark, 0, re->nfa_count * sizeof (u_int32_t));
+      re->generation = 1;
+    }
+
+  if (with_start)
+    re->stack[sp++] = re->start;
+  while (count)
+    re->stack[sp++] = from[--count];
+
+  while (sp)
+    {
+      s = re->stack[--sp];
+      if (re->mark[s] == re->generation)
+        continue;
+      re->mark[s] = re->generation;
+      st = &re->nfa[s];
+
+      switch (st->type)
+        {
+        case ASREGEX_SPLIT:
+          re->stack[sp++] = st->out1;
+          re->stack[sp++] = st->out;
+          break;
+        case ASREGEX_BOL:
+          if (bol)
+            re->stack[sp++] = st->out;
+          break;
+        case ASREGEX_EOL:
+          if (eol)
+            re->stack[sp++] = st->out;
+          else
+            set[n++] = s;
+          break;
+        default:
+          set[n++] = s;
+          break;
+        }
+    }
+
+  qsort (set, n, sizeof (int), asregex_int_cmp);
+  return n;
+}
+
+/* The DFA state of the COUNT NFA states in re->set.  */
+static struct asregex_dstate *
+asregex_dstate_get (struct bgp_asregex *re, int count, int initial)
+{
+  struct asregex_dstate key;
+  struct asregex_dstate *d;
+  int i, n;
+
+  if (re->dfa->count >= ASREGEX_DFA_MAX)
+    {
+      hash_clean (re->dfa, asregex_dstate_free);
+      re->initial = NULL;
+      re->flushes++;
+    }
+
+  key.states = re->set;
+  key.count = count;
+  key.initial = initial;
+  d = hash_get (re->dfa, &key, asregex_dstate_alloc);
+
+  if (! d->ready)
+    {
+      /* MATCH is state 0, so first if there. */
+      d->accept = (count && re->set[0] == 0);
+      d->accept_end = d->accept;
+      if (! d->accept)
+        {
+          n = 0;
+          for (i = 0; i < count; i++)
+            if (re->nfa[re->set[i]].type == ASREGEX_EOL)
+              re->end[n++] = re->set[i];
+          n = asregex_closure (re, re->end, n, 0, initial, 1, re->end);
+          d->accept_end = (n && re->end[0] == 0);
+        }
+      d->ready = 1;
+    }
+  return d;
+}
+
+static struct asregex_dstate *
+asregex_step (struct bgp_asregex *re, struct asregex_dstate *d, int sym)
+{
+  struct asregex_dstate *next;
+  struct asregex_state *st;
+  unsigned long flushes;
+  int i, n = 0;
+
+  if (d->next[sym])
+    return d->next[sym];
+
+  for (i = 0; i < d->count; i++)
+    {
+      st = &re->nfa[d->states[i]];
+      if (st->type == ASREGEX_SYM && (st->mask & (1U << sym)))
+        re->end[n++] = st->out;
+    }
+  n = asregex_closure (re, re->end, n, 1, 0, 0, re->set);
+
+  flushes = re->flushes;
+  next = asregex_dstate_get (re, n, 0);
+  if (re->flushes == flushes)
+    d->next[sym] = next;
+  return next;
+}
+
+/* Compile REGSTR for bgp_asregex_match.  NULL if it isn't a regular
+   expression.  */
+struct bgp_asregex *
+bgp_asregex_compile (const char *regstr)
+{
+  struct bgp_asregex *re;
+  struct asregex_parse ps;
+  struct asregex_node *root;
+  struct asregex_state *nfa;
+  char *magic_str;
+
+  re = XCALLOC (MTYPE_BGP_ASREGEX, sizeof (struct bgp_asregex));
+
+  magic_str = bgp_regex_magic (regstr);
+  ps.p = magic_str;
+  ps.count = 0;
+  ps.max = 4 * strlen (magic_str) + 4;
+  ps.node = XCALLOC (MTYPE_TMP, ps.max * sizeof (struct asregex_node));
+
+  root = asregex_parse_alt (&ps);
+  if (root && ! *ps.p)
+    {
+      re->nfa = XCALLOC (MTYPE_TMP,
+                         ASREGEX_NFA_MAX * sizeof (struct asregex_state));
+      asregex_state_new (re, ASREGEX_MATCH, 0, 0, -1);
+      re->start = asregex_emit (re, root, 0);
+      if (re->start < 0)
+        {
+          XFREE (MTYPE_TMP, re->nfa);
+          re->nfa_count = 0;
+        }
+    }
+
+  XFREE (MTYPE_TMP, ps.node);
+  XFREE (MTYPE_TMP, magic_str);
+
+  /* What the parser above accepts is a POSIX regular expression, and
+     what it doesn't is up to regcomp, which may refuse it. */
+  if (! re->nfa)
+    {
+      re->reg = bgp_regcomp (regstr);
+      if (! re->reg)
+        {
+          XFREE (MTYPE_BGP_ASREGEX, re);
+          return NULL;
+        }
+      return re;
+    }
+
+  nfa = XMALLOC (MTYPE_BGP_ASREGEX,
+                 re->nfa_count * sizeof (struct asregex_state));
+  memcpy (nfa, re->nfa, re->nfa_count * sizeof (struct asregex_state));
+  XFREE (MTYPE_TMP, re->nfa);
+  re->nfa = nfa;
+
+  re->dfa = hash_create (asregex_dstate_key, asregex_dstate_cmp);
+  re->mark = XCALLOC (MTYPE_BGP_ASREGEX,
+                      re->nfa_count * sizeof (u_int32_t));
+  re->stack = XMALLOC (MTYPE_BGP_ASREGEX,
+                       (3 * re->nfa_count + 1) * sizeof (int));
+  re->set = XMALLOC (MTYPE_BGP_ASREGEX, re->nfa_count * sizeof (int));
+  re->end = XMALLOC (MTYPE_BGP_ASREGEX, re->nfa_count * sizeof (int));
+
+  return re;
+}
+
+#define ASREGEX_STEP(RE,D,SYM) \
+  ((D)->next[SYM] ? (D)->next[SYM] : asregex_step ((RE), (D), (SYM)))
+
+/* Whether RE matches somewhere in ASPATH, as written by aspath_print.  */
+int
+bgp_asregex_match (struct bgp_asregex *re, struct aspath *aspath)
+{
+  struct asregex_dstate *d;
+  struct assegment *seg;
+  u_char digits[10];
+  as_t as;
+  int i, j;
+
+  if (! re->nfa)
+    return regexec (re->reg, aspath_print (aspath), 0, NULL, 0) == 0;
+
+  if (! re->initial)
+    re->initial = asregex_dstate_get
+      (re, asregex_closure (re, NULL, 0, 1, 1, 0, re->set), 1);
+  d = re->initial;
+
+#define ASREGEX_FEED(SYM) \
+  do { \
+    d = ASREGEX_STEP (re, d, (SYM)); \
+    if (d->accept) \
+      return 1; \
+  } while (0)
+
+  if (d->accept)
+    return 1;
+
+  for (seg = aspath->segments; seg; seg = seg->next)
+    {
+      if (seg->type != AS_SEQUENCE)
+        ASREGEX_FEED (asregex_symbol
+                      (aspath_delimiter_char (seg->type, AS_SEG_START)));
+
+      for (i = 0; i < seg->length; i++)
+        {
+          as = seg->as[i];
+          j = sizeof (digits);
+          do
+            {
+              digits[--j] = as % 10;
+              as /= 10;
+            }
+          while (as);
+          for (; j < (int) sizeof (digits); j++)
+            ASREGEX_FEED (digits[j]);
+
+          if (i < seg->length - 1)
+            ASREGEX_FEED (asregex_symbol ((seg->type == AS_SET
+                                           || seg->type == AS_CONFED_SET)
+                                          ? ',' : ' '));
+        }
+
+      if (seg->type != AS_SEQUENCE)
+        ASREGEX_FEED (asregex_symbol
+                      (aspath_delimiter_char (seg->type, AS_SEG_END)));
+      if (seg->next)
+        ASREGEX_FEED (asregex_symbol (' '));
+    }
+#undef ASREGEX_FEED
+
+  return d->accept_end;
+}
+
+void
+bgp_asregex_free (struct bgp_asregex *re)
+{
+  if (re->reg)
+    bgp_regex_free (re->reg);
+  if (re->nfa)
+    {
+      hash_clean (re->dfa, asregex_dstate_free);
+      hash_free (re->dfa);
+      XFREE (MTYPE_BGP_ASREGEX, re->nfa);
+      XFREE (MTYPE_BGP_ASREGEX, re->mark);
+      XFREE (MTYPE_BGP_ASREGEX, re->stack);
+      XFREE (MTYPE_BGP_ASREGEX, re->set);
+      XFREE (MTYPE_BGP_ASREGEX, re->end);
+    }
+  XFREE (MTYPE_BGP_ASREGEX, re);
+}
+
+/* Whether the DFA is used, for the tests. */
+int
+bgp_asregex_compiled (struct bgp_asregex *re)
+{
+  return re->nfa != NULL;
+}
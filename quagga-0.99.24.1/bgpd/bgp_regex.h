@@ -37,4 +37,12 @@ extern void bgp_regex_free (regex_t *regex);
 extern regex_t *bgp_regcomp (const char *str);
 extern int bgp_regexec (regex_t *regex, struct aspath *aspath);
 
+/* AS path regular expression, matched without a string. */
+struct bgp_asregex;
+
+extern struct bgp_asregex *bgp_asregex_compile (const char *);
+extern int bgp_asregex_match (struct bgp_asregex *, struct aspath *);
+extern int bgp_asregex_compiled (struct bgp_asregex *);
+extern void bgp_asregex_free (struct bgp_asregex *);
+
 #endif /* _QUAGGA_BGP_REGEX_H */
@@ -34,6 +34,7 @@ Software Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
 #include "plist.h"
 #include "thread.h"
 #include "workqueue.h"
+#include "jhash.h"
 
 #include "bgpd/bgpd.h"
 #include "bgpd/bgp_table.h"
@@ -55,6 +56,8 @@ Software Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
 #include "bgpd/bgp_zebra.h"
 #include "bgpd/bgp_vty.h"
 #include "bgpd/bgp_mpath.h"
+#include "bgpd/bgp_updgrp.h"
+#include "bgpd/bgp_select.h"
 
 /* Extern from bgp_dump.c */
 extern const char *bgp_origin_str[];
@@ -109,6 +112,8 @@ bgp_info_extra_free (struct bgp_info_extra **extra)
       
       (*extra)->damp_info = NULL;
       
+      bgp_info_mpath_free (&(*extra)->mpath);
+
       XFREE (MTYPE_BGP_ROUTE_EXTRA, *extra);
       
       *extra = NULL;
@@ -126,11 +131,14 @@ bgp_info_extra_get (struct bgp_info *ri)
   return ri->extra;
 }
 
+struct bgp_slab bgp_info_slab =
+  BGP_SLAB_INITIALIZER ("BGP route", sizeof (struct bgp_info));
+
 /* Allocate new bgp info structure. */
 static struct bgp_info *
 bgp_info_new (void)
 {
-  return XCALLOC (MTYPE_BGP_ROUTE, sizeof (struct bgp_info));
+  return bgp_slab_alloc (&bgp_info_slab);
 }
 
 /* Free bgp route information. */
@@ -141,11 +149,10 @@ bgp_info_free (struct bgp_info *binfo)
     bgp_attr_unintern (&binfo->attr);
   
   bgp_info_extra_free (&binfo->extra);
-  bgp_info_mpath_free (&binfo->mpath);
 
   peer_unlock (binfo->peer); /* bgp_info peer reference */
 
-  XFREE (MTYPE_BGP_ROUTE, binfo);
+  bgp_slab_free (&bgp_info_slab, binfo);
 }
 
 struct bgp_info *
@@ -182,19 +189,43 @@ bgp_info_unlock (struct bgp_info *binfo)
   return binfo;
 }
 
+/* Link RI at the head of the routes of its peer in AFI/SAFI.  */
+static void
+bgp_info_peer_add (struct bgp_info *ri, afi_t afi, safi_t safi)
+{
+  struct bgp_info **head = &ri->peer->routes[afi][safi];
+
+  ri->peer_prev = 0;
+  ri->peer_next = bgp_slab_index (&bgp_info_slab, *head);
+  if (*head)
+    (*head)->peer_prev = bgp_slab_index (&bgp_info_slab, ri);
+  *head = ri;
+}
+
+static void
+bgp_info_peer_del (struct bgp_info *ri, afi_t afi, safi_t safi)
+{
+  struct bgp_info *next = BGP_INFO_PEER_NEXT (ri);
+  struct bgp_info *prev = bgp_slab_ptr (&bgp_info_slab, ri->peer_prev);
+
+  if (next)
+    next->peer_prev = ri->peer_prev;
+  if (prev)
+    prev->peer_next = ri->peer_next;
+  else
+    ri->peer->routes[afi][safi] = next;
+  ri->peer_next = ri->peer_prev = 0;
+}
+
 void
 bgp_info_add (struct bgp_node *rn, struct bgp_info *ri)
 {
-  struct bgp_info *top;
-
-  top = rn->info;
-  
   ri->next = rn->info;
-  ri->prev = NULL;
-  if (top)
-    top->prev = ri;
   rn->info = ri;
   
+  ri->net = bgp_slab_index (&bgp_node_slab, rn);
+  bgp_info_peer_add (ri, bgp_node_table (rn)->afi, bgp_node_table (rn)->safi);
+
   bgp_info_lock (ri);
   bgp_lock_node (rn);
   peer_lock (ri->peer); /* bgp_info peer reference */
@@ -205,12 +236,16 @@ bgp_info_add (struct bgp_node *rn, struct bgp_info *ri)
 static void
 bgp_info_reap (struct bgp_node *rn, struct bgp_info *ri)
 {
-  if (ri->next)
-    ri->next->prev = ri->prev;
-  if (ri->prev)
-    ri->prev->next = ri->next;
-  else
-    rn->info = ri->next;
+  struct bgp_info **prev;
+
+  /* A node has a path from a handful of peers at most. */
+  for (prev = (struct bgp_info **) &rn->info; *prev; prev = &(*prev)->next)
+    if (*prev == ri)
+      {
+	*prev = ri->next;
+	break;
+      }
+  bgp_info_peer_del (ri, bgp_node_table (rn)->afi, bgp_node_table (rn)->safi);
   
   bgp_info_mpath_dequeue (ri);
   bgp_info_unlock (ri);
@@ -816,8 +851,9 @@ bgp_announce_check (struct bgp_info *ri, struct peer *peer, struct prefix *p,
   if (CHECK_FLAG(peer->af_flags[afi][safi], PEER_FLAG_RSERVER_CLIENT))
     return 0;
 
-  /* Do not send back route to sender. */
-  if (from == peer)
+  /* Do not send back route to sender.  Update groups leave that to
+     the packet builder, PEER only stands in for the group.  */
+  if (from == peer && ! peer->updgrp[afi][safi])
     return 0;
 
   /* Aggregate-address suppress check. */
@@ -848,8 +884,10 @@ bgp_announce_check (struct bgp_info *ri, struct peer *peer, struct prefix *p,
     return 0;
 
   /* If the attribute has originator-id and it is same as remote
-     peer's id. */
-  if (riattr->flag & ATTR_FLAG_BIT (BGP_ATTR_ORIGINATOR_ID))
+     peer's id.  Update groups leave that to the packet builder too,
+     which checks every member.  */
+  if ((riattr->flag & ATTR_FLAG_BIT (BGP_ATTR_ORIGINATOR_ID))
+      && ! peer->updgrp[afi][safi])
     {
       if (IPV4_ADDR_SAME (&peer->remote_id, &riattr->extra->originator_id))
 	{
@@ -1488,14 +1526,54 @@ bgp_process_announce_selected (struct peer *peer, struct bgp_info *selected,
   return 0;
 }
 
+/* Run SELECTED through the outbound policy of update group GROUP, on
+   behalf of all its members.  */
+void
+bgp_process_announce_group (struct update_group *group,
+			    struct bgp_info *selected, struct bgp_node *rn)
+{
+  struct peer *peer;
+  struct attr attr;
+  struct attr_extra extra;
+
+  peer = listgetdata (listhead (group->peers));
+  attr.extra = &extra;
+
+  if (selected && bgp_announce_check (selected, peer, &rn->p, &attr,
+				      group->afi, group->safi))
+    bgp_adj_out_set (rn, group->peer, &rn->p, &attr, group->afi, group->safi,
+		     selected);
+  else
+    bgp_adj_out_unset (rn, group->peer, &rn->p, group->afi, group->safi);
+}
+
 struct bgp_process_queue 
 {
   struct bgp *bgp;
   struct bgp_node *rn;
   afi_t afi;
   safi_t safi;
+
+  /* Shard of a batch the node is selected in, or -1 for the main
+     thread, and what the shard found.  */
+  int shard;
+  int computed;
+  struct bgp_info_pair old_and_new;
+  struct bgp_info **mp;
+  unsigned int mpcount;
 };
 
+/* Nodes of the main tables selected together, when selection is
+   shared among threads.  */
+struct bgp_process_batch
+{
+  unsigned int count;
+  struct bgp_process_queue *pq[BGP_SELECT_BATCH_MAX];
+};
+
+/* Batch new nodes are added to, until it is run.  */
+static struct bgp_process_batch *bgp_process_batch_open;
+
 static wq_item_status
 bgp_process_rsclient (struct work_queue *wq, void *data)
 {
@@ -1558,10 +1636,12 @@ bgp_process_rsclient (struct work_queue *wq, void *data)
   return WQ_SUCCESS;
 }
 
-static wq_item_status
-bgp_process_main (struct work_queue *wq, void *data)
+/* Act on the outcome of best-path selection for a node of a main
+   table.  */
+static void
+bgp_process_main_node (struct bgp_process_queue *pq,
+		       struct bgp_info_pair *old_and_new)
 {
-  struct bgp_process_queue *pq = data;
   struct bgp *bgp = pq->bgp;
   struct bgp_node *rn = pq->rn;
   afi_t afi = pq->afi;
@@ -1569,14 +1649,12 @@ bgp_process_main (struct work_queue *wq, void *data)
   struct prefix *p = &rn->p;
   struct bgp_info *new_select;
   struct bgp_info *old_select;
-  struct bgp_info_pair old_and_new;
   struct listnode *node, *nnode;
   struct peer *peer;
+  struct update_group *group;
   
-  /* Best path selection. */
-  bgp_best_selection (bgp, rn, &bgp->maxpaths[afi][safi], &old_and_new);
-  old_select = old_and_new.old;
-  new_select = old_and_new.new;
+  old_select = old_and_new->old;
+  new_select = old_and_new->new;
 
   /* Nothing to do. */
   if (old_select && old_select == new_select)
@@ -1589,7 +1667,7 @@ bgp_process_main (struct work_queue *wq, void *data)
           
 	  UNSET_FLAG (old_select->flags, BGP_INFO_MULTIPATH_CHG);
           UNSET_FLAG (rn->flags, BGP_NODE_PROCESS_SCHEDULED);
-          return WQ_SUCCESS;
+          return;
         }
     }
 
@@ -1606,9 +1684,16 @@ bgp_process_main (struct work_queue *wq, void *data)
   /* Check each BGP peer. */
   for (ALL_LIST_ELEMENTS (bgp->peer, node, nnode, peer))
     {
+      if (peer->updgrp[afi][safi])
+	continue;
       bgp_process_announce_selected (peer, new_select, rn, afi, safi);
     }
 
+  /* And each update group once for all its members. */
+  for (ALL_LIST_ELEMENTS_RO (bgp->update_groups, node, group))
+    if (group->afi == afi && group->safi == safi)
+      bgp_process_announce_group (group, new_select, rn);
+
   /* FIB update. */
   if ((safi == SAFI_UNICAST || safi == SAFI_MULTICAST) && (! bgp->name &&
       ! bgp_option_check (BGP_OPT_NO_FIB)))
@@ -1632,6 +1717,168 @@ bgp_process_main (struct work_queue *wq, void *data)
     bgp_info_reap (rn, old_select);
   
   UNSET_FLAG (rn->flags, BGP_NODE_PROCESS_SCHEDULED);
+}
+
+static wq_item_status
+bgp_process_main (struct work_queue *wq, void *data)
+{
+  struct bgp_process_queue *pq = data;
+  struct bgp_info_pair old_and_new;
+
+  /* Best path selection. */
+  bgp_best_selection (pq->bgp, pq->rn, &pq->bgp->maxpaths[pq->afi][pq->safi],
+		      &old_and_new);
+  bgp_process_main_node (pq, &old_and_new);
+  return WQ_SUCCESS;
+}
+
+/* The comparisons of bgp_best_selection(), without deterministic-med,
+   for a selection thread: they only read the paths.  The selected
+   paths and the multipath candidates are left in PQ.  */
+static void
+bgp_best_compute (struct bgp_process_queue *pq)
+{
+  struct bgp *bgp = pq->bgp;
+  struct bgp_info *new_select = NULL;
+  struct bgp_info *old_select = NULL;
+  struct bgp_info *ri;
+  int paths_eq;
+
+  pq->mpcount = 0;
+  for (ri = pq->rn->info; ri; ri = ri->next)
+    {
+      if (CHECK_FLAG (ri->flags, BGP_INFO_SELECTED))
+	old_select = ri;
+
+      if (BGP_INFO_HOLDDOWN (ri))
+	continue;
+
+      if (bgp_info_cmp (bgp, ri, new_select, &paths_eq))
+	{
+	  new_select = ri;
+	  if (pq->mp && !paths_eq)
+	    {
+	      pq->mpcount = 0;
+	      pq->mp[pq->mpcount++] = ri;
+	    }
+	}
+
+      if (pq->mp && paths_eq)
+	pq->mp[pq->mpcount++] = ri;
+    }
+
+  pq->old_and_new.old = old_select;
+  pq->old_and_new.new = new_select;
+  pq->computed = 1;
+}
+
+/* The rest of bgp_best_selection() for a node done by
+   bgp_best_compute(): reap removed paths and update multipath.  */
+static void
+bgp_best_apply (struct bgp_process_queue *pq)
+{
+  struct bgp_node *rn = pq->rn;
+  struct bgp_info *new_select = pq->old_and_new.new;
+  struct bgp_info *old_select = pq->old_and_new.old;
+  struct bgp_info *ri;
+  struct bgp_info *nextri = NULL;
+  struct list mp_list;
+  unsigned int i;
+
+  for (ri = rn->info; (ri != NULL) && (nextri = ri->next, 1); ri = nextri)
+    {
+      if (BGP_INFO_HOLDDOWN (ri))
+	{
+	  if (CHECK_FLAG (ri->flags, BGP_INFO_REMOVED)
+	      && (ri != old_select))
+	    bgp_info_reap (rn, ri);
+	  continue;
+	}
+      bgp_info_unset_flag (rn, ri, BGP_INFO_DMED_CHECK);
+      bgp_info_unset_flag (rn, ri, BGP_INFO_DMED_SELECTED);
+    }
+
+  bgp_mp_list_init (&mp_list);
+  for (i = 0; i < pq->mpcount; i++)
+    bgp_mp_list_add (&mp_list, pq->mp[i]);
+
+  bgp_info_mpath_update (rn, new_select, old_select, &mp_list,
+			 &pq->bgp->maxpaths[pq->afi][pq->safi]);
+  bgp_info_mpath_aggregate_update (new_select, old_select);
+  bgp_mp_list_clear (&mp_list);
+}
+
+static unsigned int
+bgp_process_batch_shard (void *arg, int shard)
+{
+  struct bgp_process_batch *batch = arg;
+  unsigned int i, count = 0;
+
+  for (i = 0; i < batch->count; i++)
+    if (batch->pq[i]->shard == shard)
+      {
+	bgp_best_compute (batch->pq[i]);
+	count++;
+      }
+  return count;
+}
+
+static wq_item_status
+bgp_process_batch (struct work_queue *wq, void *data)
+{
+  struct bgp_process_batch *batch = data;
+  struct bgp_process_queue *pq;
+  struct bgp_maxpaths_cfg *mpath_cfg;
+  struct bgp_info *ri;
+  struct prefix *p;
+  unsigned int i, paths;
+  int shards;
+
+  /* Nodes scheduled from here on go in the next batch. */
+  if (bgp_process_batch_open == batch)
+    bgp_process_batch_open = NULL;
+
+  shards = bgp_select_shards ();
+  if (shards > 1)
+    {
+      for (i = 0; i < batch->count; i++)
+	{
+	  pq = batch->pq[i];
+	  pq->shard = -1;
+
+	  /* Deterministic-med marks paths as it goes. */
+	  if (bgp_flag_check (pq->bgp, BGP_FLAG_DETERMINISTIC_MED))
+	    continue;
+
+	  p = &pq->rn->p;
+	  pq->shard = jhash (&p->u.prefix, PSIZE (p->prefixlen),
+			     p->prefixlen) % shards;
+
+	  mpath_cfg = &pq->bgp->maxpaths[pq->afi][pq->safi];
+	  if (mpath_cfg->maxpaths_ebgp != BGP_DEFAULT_MAXPATHS
+	      || mpath_cfg->maxpaths_ibgp != BGP_DEFAULT_MAXPATHS)
+	    {
+	      for (paths = 0, ri = pq->rn->info; ri; ri = ri->next)
+		paths++;
+	      if (paths)
+		pq->mp = XMALLOC (MTYPE_BGP_PROCESS_QUEUE,
+				  paths * sizeof (struct bgp_info *));
+	    }
+	}
+      bgp_select_run (bgp_process_batch_shard, batch, shards);
+    }
+
+  for (i = 0; i < batch->count; i++)
+    {
+      pq = batch->pq[i];
+      if (pq->computed)
+	bgp_best_apply (pq);
+      else
+	bgp_best_selection (pq->bgp, pq->rn,
+			    &pq->bgp->maxpaths[pq->afi][pq->safi],
+			    &pq->old_and_new);
+      bgp_process_main_node (pq, &pq->old_and_new);
+    }
   return WQ_SUCCESS;
 }
 
@@ -1644,9 +1891,40 @@ bgp_processq_del (struct work_queue *wq, void *data)
   bgp_unlock (pq->bgp);
   bgp_unlock_node (pq->rn);
   bgp_table_unlock (table);
+  if (pq->mp)
+    XFREE (MTYPE_BGP_PROCESS_QUEUE, pq->mp);
   XFREE (MTYPE_BGP_PROCESS_QUEUE, pq);
 }
 
+static void
+bgp_process_batch_del (struct work_queue *wq, void *data)
+{
+  struct bgp_process_batch *batch = data;
+  unsigned int i;
+
+  if (bgp_process_batch_open == batch)
+    bgp_process_batch_open = NULL;
+  for (i = 0; i < batch->count; i++)
+    bgp_processq_del (wq, batch->pq[i]);
+  XFREE (MTYPE_BGP_PROCESS_BATCH, batch);
+}
+
+/* Queue PQ for selection with other nodes.  */
+static void
+bgp_process_batch_add (struct bgp_process_queue *pq)
+{
+  struct bgp_process_batch *batch = bgp_process_batch_open;
+
+  if (! batch || batch->count == BGP_SELECT_BATCH_MAX)
+    {
+      batch = XCALLOC (MTYPE_BGP_PROCESS_BATCH,
+		       sizeof (struct bgp_process_batch));
+      work_queue_add (bm->process_batch_queue, batch);
+      bgp_process_batch_open = batch;
+    }
+  batch->pq[batch->count++] = pq;
+}
+
 static void
 bgp_process_queue_init (void)
 {
@@ -1654,8 +1932,11 @@ bgp_process_queue_init (void)
     = work_queue_new (bm->master, "process_main_queue");
   bm->process_rsclient_queue
     = work_queue_new (bm->master, "process_rsclient_queue");
+  bm->process_batch_queue
+    = work_queue_new (bm->master, "process_batch_queue");
   
-  if ( !(bm->process_main_queue && bm->process_rsclient_queue) )
+  if ( !(bm->process_main_queue && bm->process_rsclient_queue
+         && bm->process_batch_queue) )
     {
       zlog_err ("%s: Failed to allocate work queue", __func__);
       exit (1);
@@ -1669,6 +1950,11 @@ bgp_process_queue_init (void)
   memcpy (bm->process_rsclient_queue, bm->process_main_queue,
           sizeof (struct work_queue *));
   bm->process_rsclient_queue->spec.workfunc = &bgp_process_rsclient;
+
+  bm->process_batch_queue->spec.workfunc = &bgp_process_batch;
+  bm->process_batch_queue->spec.del_item_data = &bgp_process_batch_del;
+  bm->process_batch_queue->spec.max_retries = 0;
+  bm->process_batch_queue->spec.hold = 50;
 }
 
 void
@@ -1681,7 +1967,8 @@ bgp_process (struct bgp *bgp, struct bgp_node *rn, afi_t afi, safi_t safi)
     return;
   
   if ( (bm->process_main_queue == NULL) ||
-       (bm->process_rsclient_queue == NULL) )
+       (bm->process_rsclient_queue == NULL) ||
+       (bm->process_batch_queue == NULL) )
     bgp_process_queue_init ();
   
   pqnode = XCALLOC (MTYPE_BGP_PROCESS_QUEUE, 
@@ -1696,11 +1983,15 @@ bgp_process (struct bgp *bgp, struct bgp_node *rn, afi_t afi, safi_t safi)
   bgp_lock (bgp);
   pqnode->afi = afi;
   pqnode->safi = safi;
+  pqnode->shard = -1;
   
   switch (bgp_node_table (rn)->type)
     {
       case BGP_TABLE_MAIN:
-        work_queue_add (bm->process_main_queue, pqnode);
+        if (bgp_select_shards () > 1)
+          bgp_process_batch_add (pqnode);
+        else
+          work_queue_add (bm->process_main_queue, pqnode);
         break;
       case BGP_TABLE_RSCLIENT:
         work_queue_add (bm->process_rsclient_queue, pqnode);
@@ -2624,6 +2915,10 @@ bgp_announce_route (struct peer *peer, afi_t afi, safi_t safi)
   if (CHECK_FLAG (peer->af_sflags[afi][safi], PEER_STATUS_ORF_WAIT_REFRESH))
     return;
 
+  /* Announce to the peer alone, it is put back into a group once it
+     has caught up. */
+  bgp_updgrp_leave (peer, afi, safi, 1);
+
   if (safi != SAFI_MPLS_VPN)
     bgp_announce_table (peer, afi, safi, NULL, 0);
   else
@@ -2830,6 +3125,61 @@ bgp_clear_node_queue_init (struct peer *peer)
   peer->clear_node_queue->spec.data = peer;
 }
 
+static void
+bgp_clear_node_queue_add (struct peer *peer, struct bgp_node *rn,
+                          enum bgp_clear_route_type purpose)
+{
+  struct bgp_clear_node_queue *cnq;
+
+  /* both unlocked in bgp_clear_node_queue_del */
+  bgp_table_lock (bgp_node_table (rn));
+  bgp_lock_node (rn);
+  cnq = XCALLOC (MTYPE_BGP_CLEAR_NODE_QUEUE,
+                 sizeof (struct bgp_clear_node_queue));
+  cnq->rn = rn;
+  cnq->purpose = purpose;
+  work_queue_add (peer->clear_node_queue, cnq);
+}
+
+/* Scrub what the peer left in the adj-RIBs and queue the nodes holding
+ * its routes.  There are 3 indices which refer to a peer:
+ *
+ * 1 peer's routes visible via the RIB (ie accepted routes)
+ * 2 peer's routes visible by the (optional) peer's adj-in index
+ * 3 other routes visible by the peer's adj-out index
+ *
+ * The peer keeps a list of its entries in each, over the main, VPN and
+ * RS-client tables alike, so only nodes relevant to the peer at hand
+ * are touched.
+ */
+static void
+bgp_clear_route_peer (struct peer *peer, afi_t afi, safi_t safi,
+                      enum bgp_clear_route_type purpose)
+{
+  struct bgp_info *ri;
+  struct bgp_adj_in *ain;
+  struct bgp_adj_out *aout;
+  struct bgp_node *rn;
+
+  while ((ain = peer->adj_in[afi][safi]) != NULL)
+    {
+      rn = ain->rn;
+      bgp_adj_in_remove (rn, ain);
+      bgp_unlock_node (rn);
+    }
+  while ((aout = peer->adj_out[afi][safi]) != NULL)
+    {
+      rn = aout->rn;
+      bgp_adj_out_remove (rn, aout, peer, afi, safi);
+      bgp_unlock_node (rn);
+    }
+
+  for (ri = peer->routes[afi][safi]; ri; ri = BGP_INFO_PEER_NEXT (ri))
+    bgp_clear_node_queue_add (peer, BGP_INFO_NODE (ri), purpose);
+}
+
+/* Clear every entry of TABLE, for a peer which stops being an RS
+ * client.  */
 static void
 bgp_clear_route_table (struct peer *peer, afi_t afi, safi_t safi,
                        struct bgp_table *table, struct peer *rsclient,
@@ -2851,37 +3201,6 @@ bgp_clear_route_table (struct peer *peer, afi_t afi, safi_t safi,
       struct bgp_adj_in *ain;
       struct bgp_adj_out *aout;
 
-      /* XXX:TODO: This is suboptimal, every non-empty route_node is
-       * queued for every clearing peer, regardless of whether it is
-       * relevant to the peer at hand.
-       *
-       * Overview: There are 3 different indices which need to be
-       * scrubbed, potentially, when a peer is removed:
-       *
-       * 1 peer's routes visible via the RIB (ie accepted routes)
-       * 2 peer's routes visible by the (optional) peer's adj-in index
-       * 3 other routes visible by the peer's adj-out index
-       *
-       * 3 there is no hurry in scrubbing, once the struct peer is
-       * removed from bgp->peer, we could just GC such deleted peer's
-       * adj-outs at our leisure.
-       *
-       * 1 and 2 must be 'scrubbed' in some way, at least made
-       * invisible via RIB index before peer session is allowed to be
-       * brought back up. So one needs to know when such a 'search' is
-       * complete.
-       *
-       * Ideally:
-       *
-       * - there'd be a single global queue or a single RIB walker
-       * - rather than tracking which route_nodes still need to be
-       *   examined on a peer basis, we'd track which peers still
-       *   aren't cleared
-       *
-       * Given that our per-peer prefix-counts now should be reliable,
-       * this may actually be achievable. It doesn't seem to be a huge
-       * problem at this time,
-       */
       for (ain = rn->adj_in; ain; ain = ain->next)
         if (ain->peer == peer || purpose == BGP_CLEAR_ROUTE_MY_RSCLIENT)
           {
@@ -2900,16 +3219,7 @@ bgp_clear_route_table (struct peer *peer, afi_t afi, safi_t safi,
       for (ri = rn->info; ri; ri = ri->next)
         if (ri->peer == peer || purpose == BGP_CLEAR_ROUTE_MY_RSCLIENT)
           {
-            struct bgp_clear_node_queue *cnq;
-
-            /* both unlocked in bgp_clear_node_queue_del */
-            bgp_table_lock (bgp_node_table (rn));
-            bgp_lock_node (rn);
-            cnq = XCALLOC (MTYPE_BGP_CLEAR_NODE_QUEUE,
-                           sizeof (struct bgp_clear_node_queue));
-            cnq->rn = rn;
-            cnq->purpose = purpose;
-            work_queue_add (peer->clear_node_queue, cnq);
+            bgp_clear_node_queue_add (peer, rn, purpose);
             break;
           }
     }
@@ -2920,11 +3230,6 @@ void
 bgp_clear_route (struct peer *peer, afi_t afi, safi_t safi,
                  enum bgp_clear_route_type purpose)
 {
-  struct bgp_node *rn;
-  struct bgp_table *table;
-  struct peer *rsclient;
-  struct listnode *node, *nnode;
-
   if (peer->clear_node_queue == NULL)
     bgp_clear_node_queue_init (peer);
   
@@ -2946,18 +3251,7 @@ bgp_clear_route (struct peer *peer, afi_t afi, safi_t safi,
   switch (purpose)
     {
     case BGP_CLEAR_ROUTE_NORMAL:
-      if (safi != SAFI_MPLS_VPN)
-        bgp_clear_route_table (peer, afi, safi, NULL, NULL, purpose);
-      else
-        for (rn = bgp_table_top (peer->bgp->rib[afi][safi]); rn;
-             rn = bgp_route_next (rn))
-          if ((table = rn->info) != NULL)
-            bgp_clear_route_table (peer, afi, safi, table, NULL, purpose);
-
-      for (ALL_LIST_ELEMENTS (peer->bgp->rsclient, node, nnode, rsclient))
-        if (CHECK_FLAG(rsclient->af_flags[afi][safi],
-                       PEER_FLAG_RSERVER_CLIENT))
-          bgp_clear_route_table (peer, afi, safi, NULL, rsclient, purpose);
+      bgp_clear_route_peer (peer, afi, safi, purpose);
       break;
 
     case BGP_CLEAR_ROUTE_MY_RSCLIENT:
@@ -2971,8 +3265,6 @@ bgp_clear_route (struct peer *peer, afi_t afi, safi_t safi,
   
   /* If no routes were cleared, nothing was added to workqueue, the
    * completion function won't be run by workqueue code - call it here. 
-   * XXX: Actually, this assumption doesn't hold, see
-   * bgp_clear_route_table(), we queue all non-empty nodes.
    *
    * Additionally, there is a presumption in FSM that clearing is only
    * really needed if peer state is Established - peers in
@@ -3006,20 +3298,15 @@ bgp_clear_route_all (struct peer *peer)
 void
 bgp_clear_adj_in (struct peer *peer, afi_t afi, safi_t safi)
 {
-  struct bgp_table *table;
   struct bgp_node *rn;
   struct bgp_adj_in *ain;
 
-  table = peer->bgp->rib[afi][safi];
-
-  for (rn = bgp_table_top (table); rn; rn = bgp_route_next (rn))
-    for (ain = rn->adj_in; ain ; ain = ain->next)
-      if (ain->peer == peer)
-	{
-          bgp_adj_in_remove (rn, ain);
-          bgp_unlock_node (rn);
-          break;
-	}
+  while ((ain = peer->adj_in[afi][safi]) != NULL)
+    {
+      rn = ain->rn;
+      bgp_adj_in_remove (rn, ain);
+      bgp_unlock_node (rn);
+    }
 }
 
 void
@@ -3027,19 +3314,15 @@ bgp_clear_stale_route (struct peer *peer, afi_t afi, safi_t safi)
 {
   struct bgp_node *rn;
   struct bgp_info *ri;
-  struct bgp_table *table;
+  struct bgp_info *next;
 
-  table = peer->bgp->rib[afi][safi];
-
-  for (rn = bgp_table_top (table); rn; rn = bgp_route_next (rn))
+  for (ri = peer->routes[afi][safi]; ri; ri = next)
     {
-      for (ri = rn->info; ri; ri = ri->next)
-	if (ri->peer == peer)
-	  {
-	    if (CHECK_FLAG (ri->flags, BGP_INFO_STALE))
-	      bgp_rib_remove (rn, ri, peer, afi, safi);
-	    break;
-	  }
+      next = BGP_INFO_PEER_NEXT (ri);
+      rn = BGP_INFO_NODE (ri);
+      if (bgp_node_table (rn)->type == BGP_TABLE_MAIN
+	  && CHECK_FLAG (ri->flags, BGP_INFO_STALE))
+	bgp_rib_remove (rn, ri, peer, afi, safi);
     }
 }
 
@@ -6113,7 +6396,8 @@ route_vty_out_detail (struct vty *vty, struct bgp *bgp, struct prefix *p,
       tbuf = time(NULL) - (bgp_clock() - binfo->uptime);
       vty_out (vty, "      Last update: %s", ctime(&tbuf));
 #else
-      vty_out (vty, "      Last update: %s", ctime(&binfo->uptime));
+      tbuf = binfo->uptime;
+      vty_out (vty, "      Last update: %s", ctime(&tbuf));
 #endif /* HAVE_CLOCK_MONOTONIC */
     }
   vty_out (vty, "%s", VTY_NEWLINE);
@@ -6196,9 +6480,9 @@ bgp_show_table (struct vty *vty, struct bgp_table *table, struct in_addr *router
 	    if (type == bgp_show_type_regexp
 		|| type == bgp_show_type_flap_regexp)
 	      {
-		regex_t *regex = output_arg;
+		struct bgp_asregex *regex = output_arg;
 		    
-		if (bgp_regexec (regex, ri->attr->aspath) == REG_NOMATCH)
+		if (! bgp_asregex_match (regex, ri->attr->aspath))
 		  continue;
 	      }
 	    if (type == bgp_show_type_prefix_list
@@ -7104,7 +7388,7 @@ bgp_show_regexp (struct vty *vty, int argc, const char **argv, afi_t afi,
   struct buffer *b;
   char *regstr;
   int first;
-  regex_t *regex;
+  struct bgp_asregex *regex;
   int rc;
   
   first = 0;
@@ -7127,7 +7411,7 @@ bgp_show_regexp (struct vty *vty, int argc, const char **argv, afi_t afi,
   regstr = buffer_getstr (b);
   buffer_free (b);
 
-  regex = bgp_regcomp (regstr);
+  regex = bgp_asregex_compile (regstr);
   XFREE(MTYPE_TMP, regstr);
   if (! regex)
     {
@@ -7137,7 +7421,7 @@ bgp_show_regexp (struct vty *vty, int argc, const char **argv, afi_t afi,
     }
 
   rc = bgp_show (vty, NULL, afi, safi, type, regex);
-  bgp_regex_free (regex);
+  bgp_asregex_free (regex);
   return rc;
 }
 
@@ -9891,7 +10175,7 @@ show_adj_route (struct vty *vty, struct peer *peer, afi_t afi, safi_t safi,
     else
       {
 	for (adj = rn->adj_out; adj; adj = adj->next)
-	  if (adj->peer == peer)
+	  if (adj->peer == BGP_ADJ_OWNER (peer, afi, safi))
 	    {
 	      if (header1)
 		{
@@ -22,6 +22,7 @@ Software Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
 #define _QUAGGA_BGP_ROUTE_H
 
 #include "bgp_table.h"
+#include "bgp_slab.h"
 
 /* Ancillary information to struct bgp_info, 
  * used for uncommonly used data (aggregation, MPLS, etc.)
@@ -32,6 +33,9 @@ struct bgp_info_extra
   /* Pointer to dampening structure.  */
   struct bgp_damp_info *damp_info;
 
+  /* Multipath information */
+  struct bgp_info_mpath *mpath;
+
   /* This route is suppressed with aggregation.  */
   int suppress;
 
@@ -42,11 +46,16 @@ struct bgp_info_extra
   u_char tag[3];  
 };
 
+/* There is one of these for each path of each prefix from each peer,
+ * so it is kept small: it is allocated from bgp_info_slab, without a
+ * malloc header, what is not needed for most paths is in the extra,
+ * and the links which are only followed to clear a peer's routes are
+ * 32-bit slab indices rather than pointers.
+ */
 struct bgp_info
 {
   /* For linked list. */
   struct bgp_info *next;
-  struct bgp_info *prev;
   
   /* Peer structure.  */
   struct peer *peer;
@@ -57,12 +66,15 @@ struct bgp_info
   /* Extra information */
   struct bgp_info_extra *extra;
   
+  /* Node the route is on, by index in bgp_node_slab.  */
+  u_int32_t net;
 
-  /* Multipath information */
-  struct bgp_info_mpath *mpath;
+  /* Linked list of the peer's routes, by index in bgp_info_slab.  */
+  u_int32_t peer_next;
+  u_int32_t peer_prev;
 
-  /* Uptime.  */
-  time_t uptime;
+  /* Uptime, in bgp_clock() seconds.  */
+  u_int32_t uptime;
 
   /* reference count */
   int lock;
@@ -95,6 +107,20 @@ struct bgp_info
 #define BGP_ROUTE_REDISTRIBUTE 3 
 };
 
+extern struct bgp_slab bgp_info_slab;
+
+/* Node RI is on.  */
+#define BGP_INFO_NODE(RI) \
+  ((struct bgp_node *) bgp_slab_ptr (&bgp_node_slab, (RI)->net))
+
+/* Next of the routes of RI's peer.  */
+#define BGP_INFO_PEER_NEXT(RI) \
+  ((struct bgp_info *) bgp_slab_ptr (&bgp_info_slab, (RI)->peer_next))
+
+/* Multipath information of RI, if any.  */
+#define BGP_INFO_MPATH(RI) \
+  ((RI)->extra ? (RI)->extra->mpath : NULL)
+
 /* BGP static route configuration. */
 struct bgp_static
 {
@@ -175,6 +201,8 @@ extern void bgp_route_finish (void);
 extern void bgp_cleanup_routes (void);
 extern void bgp_announce_route (struct peer *, afi_t, safi_t);
 extern void bgp_announce_route_all (struct peer *);
+extern void bgp_process_announce_group (struct update_group *,
+					struct bgp_info *, struct bgp_node *);
 extern void bgp_default_originate (struct peer *, afi_t, safi_t, int);
 extern void bgp_soft_reconfig_in (struct peer *, afi_t, safi_t);
 extern void bgp_soft_reconfig_rsclient (struct peer *, afi_t, safi_t);
@@ -0,0 +1,320 @@
+/* BGP best-path selection threads.
+
+This file is part of GNU Zebra.
+
+GNU Zebra is free software; you can redistribute it and/or modify it
+under the terms of the GNU General Public License as published by the
+Free Software Foundation; either version 2, or (at your option) any
+later version.
+
+GNU Zebra is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with GNU Zebra; see the file COPYING.  If not, write to the Free
+Software Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
+02111-1307, USA.  */
+
+/* With "bgp bestpath-threads N", nodes of the main tables are queued
+ * for selection in batches, each node hashed by prefix to one of N
+ * shards.  The main thread hands the shards of a batch out, works on
+ * the first itself, and waits until the other threads are done with
+ * theirs.  The threads only compare paths, which nothing changes while
+ * the main thread waits; flags, multipath state, announcements and the
+ * FIB are dealt with by the main thread afterwards, a batch at a time.
+ * The threads allocate nothing and do not log.
+ */
+
+#include <zebra.h>
+
+#include "command.h"
+#include "log.h"
+#include "sigevent.h"
+
+#include "bgpd/bgpd.h"
+#include "bgpd/bgp_select.h"
+
+#ifdef HAVE_PTHREAD
+
+#include <pthread.h>
+
+static struct bgp_select_master
+{
+  pthread_t thread[BGP_SELECT_THREADS_MAX];
+
+  /* Threads configured, the main one included, and started. */
+  int threads;
+  int running;
+
+  /* Held to hand out a batch, and to hand back a shard. */
+  pthread_mutex_t lock;
+  pthread_cond_t start;
+  pthread_cond_t done;
+  unsigned long generation;
+  unsigned long origin;
+  int pending;
+  int stop;
+
+  bgp_select_func func;
+  void *arg;
+  int shards;
+
+  /* Statistics.  Each thread counts into its own slot. */
+  unsigned long batches;
+  unsigned long nodes[BGP_SELECT_THREADS_MAX];
+} bsel =
+{
+  .lock = PTHREAD_MUTEX_INITIALIZER,
+  .start = PTHREAD_COND_INITIALIZER,
+  .done = PTHREAD_COND_INITIALIZER,
+};
+
+static void *
+bgp_select_loop (void *arg)
+{
+  int shard = (int) (intptr_t) arg;
+  unsigned long seen;
+
+  /* Only batches handed out after the thread was started are its. */
+  pthread_mutex_lock (&bsel.lock);
+  seen = bsel.origin;
+  while (1)
+    {
+      while (bsel.generation == seen && ! bsel.stop)
+        pthread_cond_wait (&bsel.start, &bsel.lock);
+      if (bsel.stop)
+        break;
+      seen = bsel.generation;
+      pthread_mutex_unlock (&bsel.lock);
+
+      if (shard < bsel.shards)
+        bsel.nodes[shard] += bsel.func (bsel.arg, shard);
+
+      pthread_mutex_lock (&bsel.lock);
+      if (--bsel.pending == 0)
+        pthread_cond_signal (&bsel.done);
+    }
+  pthread_mutex_unlock (&bsel.lock);
+  return NULL;
+}
+
+static void
+bgp_select_start (void)
+{
+  int i, ret;
+
+  bsel.stop = 0;
+  bsel.origin = bsel.generation;
+
+  for (i = 1; i < bsel.threads; i++)
+    {
+      ret = quagga_pthread_create (&bsel.thread[i], bgp_select_loop,
+                                   (void *) (intptr_t) i);
+      if (ret)
+        {
+          zlog_err ("Can't start best-path selection thread: %s",
+                    safe_strerror (ret));
+          break;
+        }
+      bsel.running++;
+    }
+}
+
+static void
+bgp_select_stop (void)
+{
+  int i;
+
+  if (! bsel.running)
+    return;
+
+  pthread_mutex_lock (&bsel.lock);
+  bsel.stop = 1;
+  pthread_cond_broadcast (&bsel.start);
+  pthread_mutex_unlock (&bsel.lock);
+
+  for (i = 1; i <= bsel.running; i++)
+    pthread_join (bsel.thread[i], NULL);
+  bsel.running = 0;
+}
+
+/* Shards to cut a batch into: one per thread, or 1 when selection is
+   not shared.  */
+int
+bgp_select_shards (void)
+{
+  return bsel.threads ? bsel.threads : 1;
+}
+
+/* Call FUNC on ARG for each of SHARDS shards, on as many threads, and
+   return when all are done.  The threads are started the first time,
+   so not before bgpd has daemonized.  */
+void
+bgp_select_run (bgp_select_func func, void *arg, int shards)
+{
+  int shard;
+
+  if (! bsel.running && bsel.threads > 1)
+    bgp_select_start ();
+
+  bsel.batches++;
+
+  /* Whatever the threads can't take is done here. */
+  if (shards > bsel.running + 1)
+    {
+      for (shard = bsel.running + 1; shard < shards; shard++)
+        bsel.nodes[shard] += func (arg, shard);
+      shards = bsel.running + 1;
+    }
+
+  if (shards > 1)
+    {
+      pthread_mutex_lock (&bsel.lock);
+      bsel.func = func;
+      bsel.arg = arg;
+      bsel.shards = shards;
+      bsel.pending = bsel.running;
+      bsel.generation++;
+      pthread_cond_broadcast (&bsel.start);
+      pthread_mutex_unlock (&bsel.lock);
+    }
+
+  bsel.nodes[0] += func (arg, 0);
+
+  if (shards > 1)
+    {
+      pthread_mutex_lock (&bsel.lock);
+      while (bsel.pending)
+        pthread_cond_wait (&bsel.done, &bsel.lock);
+      pthread_mutex_unlock (&bsel.lock);
+    }
+}
+
+int
+bgp_select_config_write (struct vty *vty)
+{
+  if (! bsel.threads)
+    return 0;
+  vty_out (vty, "bgp bestpath-threads %d%s", bsel.threads, VTY_NEWLINE);
+  return 1;
+}
+
+DEFUN (bgp_bestpath_threads,
+       bgp_bestpath_threads_cmd,
+       "bgp bestpath-threads <2-16>",
+       BGP_STR
+       "Share best-path selection among threads\n"
+       "Number of threads, the main one included\n")
+{
+  int threads;
+
+  VTY_GET_INTEGER_RANGE ("threads", threads, argv[0],
+                         2, BGP_SELECT_THREADS_MAX);
+
+  if (threads == bsel.threads)
+    return CMD_SUCCESS;
+
+  /* Started again, with the new number, by the next batch. */
+  bgp_select_stop ();
+  bsel.threads = threads;
+  return CMD_SUCCESS;
+}
+
+DEFUN (no_bgp_bestpath_threads,
+       no_bgp_bestpath_threads_cmd,
+       "no bgp bestpath-threads",
+       NO_STR
+       BGP_STR
+       "Share best-path selection among threads\n")
+{
+  /* Batches already queued are done on the main thread. */
+  bgp_select_stop ();
+  bsel.threads = 0;
+  return CMD_SUCCESS;
+}
+
+ALIAS (no_bgp_bestpath_threads,
+       no_bgp_bestpath_threads_val_cmd,
+       "no bgp bestpath-threads <2-16>",
+       NO_STR
+       BGP_STR
+       "Share best-path selection among threads\n"
+       "Number of threads, the main one included\n")
+
+DEFUN (show_bgp_bestpath_threads,
+       show_bgp_bestpath_threads_cmd,
+       "show bgp bestpath-threads",
+       SHOW_STR
+       BGP_STR
+       "Best-path selection threads\n")
+{
+  int i;
+
+  if (! bsel.threads)
+    {
+      vty_out (vty, "Best-path selection is not shared%s", VTY_NEWLINE);
+      return CMD_SUCCESS;
+    }
+
+  vty_out (vty, "%d threads configured, %d running besides the main one%s",
+           bsel.threads, bsel.running, VTY_NEWLINE);
+  vty_out (vty, "%lu batches of up to %d nodes%s",
+           bsel.batches, BGP_SELECT_BATCH_MAX, VTY_NEWLINE);
+  vty_out (vty, "%sShard      Nodes%s", VTY_NEWLINE, VTY_NEWLINE);
+  for (i = 0; i < bsel.threads; i++)
+    vty_out (vty, "%5d %10lu%s", i, bsel.nodes[i], VTY_NEWLINE);
+  return CMD_SUCCESS;
+}
+
+void
+bgp_select_init (void)
+{
+  install_element (CONFIG_NODE, &bgp_bestpath_threads_cmd);
+  install_element (CONFIG_NODE, &no_bgp_bestpath_threads_cmd);
+  install_element (CONFIG_NODE, &no_bgp_bestpath_threads_val_cmd);
+  install_element (VIEW_NODE, &show_bgp_bestpath_threads_cmd);
+  install_element (ENABLE_NODE, &show_bgp_bestpath_threads_cmd);
+}
+
+void
+bgp_select_finish (void)
+{
+  bgp_select_stop ();
+}
+
+#else /* HAVE_PTHREAD */
+
+void
+bgp_select_init (void)
+{
+}
+
+void
+bgp_select_finish (void)
+{
+}
+
+int
+bgp_select_shards (void)
+{
+  return 1;
+}
+
+void
+bgp_select_run (bgp_select_func func, void *arg, int shards)
+{
+  int shard;
+
+  for (shard = 0; shard < shards; shard++)
+    func (arg, shard);
+}
+
+int
+bgp_select_config_write (struct vty *vty)
+{
+  return 0;
+}
+
+#endif /* HAVE_PTHREAD */
@@ -0,0 +1,40 @@
+/* BGP best-path selection threads.
+
+This file is part of GNU Zebra.
+
+GNU Zebra is free software; you can redistribute it and/or modify it
+under the terms of the GNU General Public License as published by the
+Free Software Foundation; either version 2, or (at your option) any
+later version.
+
+GNU Zebra is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with GNU Zebra; see the file COPYING.  If not, write to the Free
+Software Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
+02111-1307, USA.  */
+
+#ifndef _QUAGGA_BGP_SELECT_H
+#define _QUAGGA_BGP_SELECT_H
+
+/* Threads sharing best-path selection, the main one included.  */
+#define BGP_SELECT_THREADS_MAX  16
+
+/* Nodes queued for selection together, and handed out to the
+   threads.  */
+#define BGP_SELECT_BATCH_MAX    512
+
+/* Work for one shard of a batch.  Returns the number of nodes it
+   looked at.  */
+typedef unsigned int (*bgp_select_func) (void *, int);
+
+extern void bgp_select_init (void);
+extern void bgp_select_finish (void);
+extern int bgp_select_shards (void);
+extern void bgp_select_run (bgp_select_func, void *, int);
+extern int bgp_select_config_write (struct vty *);
+
+#endif /* _QUAGGA_BGP_SELECT_H */
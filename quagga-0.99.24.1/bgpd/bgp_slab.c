@@ -0,0 +1,128 @@
+/* BGP slab allocator.
+
+This file is part of GNU Zebra.
+
+GNU Zebra is free software; you can redistribute it and/or modify it
+under the terms of the GNU General Public License as published by the
+Free Software Foundation; either version 2, or (at your option) any
+later version.
+
+GNU Zebra is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with GNU Zebra; see the file COPYING.  If not, write to the Free
+Software Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
+02111-1307, USA.  */
+
+#include <zebra.h>
+
+#include "memory.h"
+#include "log.h"
+#include "vty.h"
+
+#include "bgpd/bgp_slab.h"
+
+static void
+bgp_slab_grow (struct bgp_slab *slab)
+{
+  struct bgp_slab_block *block;
+  void *mem;
+  char *obj;
+  u_int32_t i;
+  int ret;
+
+  if (! slab->per_block)
+    {
+      slab->size = (slab->size + 7) & ~(size_t) 7;
+      slab->per_block = (BGP_SLAB_BLOCK_SIZE - BGP_SLAB_HEADER_SIZE)
+	/ slab->size;
+    }
+
+  if (slab->count == slab->max)
+    {
+      slab->max = slab->max ? slab->max * 2 : 16;
+      slab->block = XREALLOC (MTYPE_BGP_SLAB, slab->block,
+			      slab->max * sizeof (struct bgp_slab_block *));
+    }
+
+  ret = posix_memalign (&mem, BGP_SLAB_BLOCK_SIZE, BGP_SLAB_BLOCK_SIZE);
+  if (ret)
+    {
+      zlog_err ("%s: can't allocate a block of %s: %s", __func__,
+		slab->name, safe_strerror (ret));
+      exit (1);
+    }
+
+  block = mem;
+  block->number = slab->count;
+  slab->block[slab->count++] = block;
+
+  /* Hand out the block from its start. */
+  obj = (char *) block + BGP_SLAB_HEADER_SIZE;
+  for (i = slab->per_block; i > 0; i--)
+    {
+      *(void **) (obj + (i - 1) * slab->size) = slab->free;
+      slab->free = obj + (i - 1) * slab->size;
+    }
+}
+
+/* A zeroed object.  */
+void *
+bgp_slab_alloc (struct bgp_slab *slab)
+{
+  void *p;
+
+  if (! slab->free)
+    bgp_slab_grow (slab);
+
+  p = slab->free;
+  slab->free = *(void **) p;
+  memset (p, 0, slab->size);
+  slab->used++;
+  return p;
+}
+
+void
+bgp_slab_free (struct bgp_slab *slab, void *p)
+{
+  *(void **) p = slab->free;
+  slab->free = p;
+  slab->used--;
+}
+
+/* Give the blocks back, if nothing is allocated from them.  */
+void
+bgp_slab_finish (struct bgp_slab *slab)
+{
+  u_int32_t i;
+
+  if (slab->used)
+    return;
+
+  for (i = 0; i < slab->count; i++)
+    free (slab->block[i]);
+  if (slab->block)
+    XFREE (MTYPE_BGP_SLAB, slab->block);
+  slab->block = NULL;
+  slab->count = slab->max = 0;
+  slab->free = NULL;
+}
+
+void
+bgp_slab_show (struct vty *vty, struct bgp_slab *slab)
+{
+  char memstrbuf[MTYPE_MEMSTR_LEN];
+  unsigned long total;
+
+  total = (unsigned long) slab->count * slab->per_block;
+  vty_out (vty, "  %s slab: %lu of %lu objects of %lu bytes used,"
+	   " %u blocks, %s%s",
+	   slab->name, slab->used, total, (unsigned long) slab->size,
+	   slab->count,
+	   mtype_memstr (memstrbuf, sizeof (memstrbuf),
+			 (unsigned long) slab->count * BGP_SLAB_BLOCK_SIZE),
+	   VTY_NEWLINE);
+}
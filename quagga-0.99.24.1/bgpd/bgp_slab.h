@@ -0,0 +1,92 @@
+/* BGP slab allocator.
+
+This file is part of GNU Zebra.
+
+GNU Zebra is free software; you can redistribute it and/or modify it
+under the terms of the GNU General Public License as published by the
+Free Software Foundation; either version 2, or (at your option) any
+later version.
+
+GNU Zebra is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with GNU Zebra; see the file COPYING.  If not, write to the Free
+Software Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
+02111-1307, USA.  */
+
+#ifndef _QUAGGA_BGP_SLAB_H
+#define _QUAGGA_BGP_SLAB_H
+
+/* Objects of one size, carved out of blocks aligned to their size, so
+   the block of an object is found from its address.  There is no
+   allocator header per object.  Each object has a number, its index,
+   which is never 0 and is as good as a pointer to it for as long as it
+   is allocated; structures held by the million refer to each other by
+   index to save space.  Blocks are kept until the slab is finished,
+   and freed objects are handed out again first.  */
+#define BGP_SLAB_BLOCK_SIZE     (1 << 16)
+
+struct bgp_slab_block
+{
+  u_int32_t number;
+};
+
+/* Objects start this far into a block, suitably aligned.  */
+#define BGP_SLAB_HEADER_SIZE    8
+
+struct bgp_slab
+{
+  const char *name;
+  size_t size;
+  u_int32_t per_block;
+
+  /* Blocks, by number. */
+  struct bgp_slab_block **block;
+  u_int32_t count;
+  u_int32_t max;
+
+  /* Free objects, linked through their first word. */
+  void *free;
+
+  /* Objects in use. */
+  unsigned long used;
+};
+
+#define BGP_SLAB_INITIALIZER(NAME,SIZE) \
+  { .name = (NAME), .size = (SIZE) }
+
+extern void *bgp_slab_alloc (struct bgp_slab *);
+extern void bgp_slab_free (struct bgp_slab *, void *);
+extern void bgp_slab_finish (struct bgp_slab *);
+extern void bgp_slab_show (struct vty *, struct bgp_slab *);
+
+/* Index of P, or 0 for NULL.  */
+static inline u_int32_t
+bgp_slab_index (const struct bgp_slab *slab, const void *p)
+{
+  const struct bgp_slab_block *block;
+  size_t offset;
+
+  if (! p)
+    return 0;
+  block = (const struct bgp_slab_block *)
+    ((uintptr_t) p & ~((uintptr_t) BGP_SLAB_BLOCK_SIZE - 1));
+  offset = (const char *) p - (const char *) block - BGP_SLAB_HEADER_SIZE;
+  return block->number * slab->per_block + offset / slab->size + 1;
+}
+
+/* Object with index I, or NULL for 0.  */
+static inline void *
+bgp_slab_ptr (const struct bgp_slab *slab, u_int32_t i)
+{
+  if (! i)
+    return NULL;
+  i--;
+  return (char *) slab->block[i / slab->per_block] + BGP_SLAB_HEADER_SIZE
+    + (i % slab->per_block) * slab->size;
+}
+
+#endif /* _QUAGGA_BGP_SLAB_H */
@@ -67,6 +67,9 @@ bgp_table_finish (struct bgp_table **rt)
     }
 }
 
+struct bgp_slab bgp_node_slab =
+  BGP_SLAB_INITIALIZER ("BGP node", sizeof (struct bgp_node));
+
 /*
  * bgp_node_create
  */
@@ -74,7 +77,7 @@ static struct route_node *
 bgp_node_create (route_table_delegate_t *delegate, struct route_table *table)
 {
   struct bgp_node *node;
-  node = XCALLOC (MTYPE_BGP_NODE, sizeof (struct bgp_node));
+  node = bgp_slab_alloc (&bgp_node_slab);
   return bgp_node_to_rnode (node);
 }
 
@@ -87,7 +90,7 @@ bgp_node_destroy (route_table_delegate_t *delegate,
 {
   struct bgp_node *bgp_node;
   bgp_node = bgp_node_from_rnode (node);
-  XFREE (MTYPE_BGP_NODE, bgp_node);
+  bgp_slab_free (&bgp_node_slab, bgp_node);
 }
 
 /*
@@ -22,6 +22,7 @@ Software Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
 #define _QUAGGA_BGP_TABLE_H
 
 #include "table.h"
+#include "bgp_slab.h"
 
 typedef enum
 {
@@ -57,16 +58,20 @@ struct bgp_node
    */
   ROUTE_NODE_FIELDS;
 
+  /* In the padding after the route_node's lock.  */
+  u_char flags;
+#define BGP_NODE_PROCESS_SCHEDULED	(1 << 0)
+
   struct bgp_adj_out *adj_out;
 
   struct bgp_adj_in *adj_in;
 
   struct bgp_node *prn;
-
-  u_char flags;
-#define BGP_NODE_PROCESS_SCHEDULED	(1 << 0)
 };
 
+/* Nodes of all BGP tables are allocated from here.  */
+extern struct bgp_slab bgp_node_slab;
+
 /*
  * bgp_table_iter_t
  * 
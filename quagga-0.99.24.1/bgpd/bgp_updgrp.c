@@ -0,0 +1,759 @@
+/* BGP update groups.
+
+This file is part of GNU Zebra.
+
+GNU Zebra is free software; you can redistribute it and/or modify it
+under the terms of the GNU General Public License as published by the
+Free Software Foundation; either version 2, or (at your option) any
+later version.
+
+GNU Zebra is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with GNU Zebra; see the file COPYING.  If not, write to the Free
+Software Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
+02111-1307, USA.  */
+
+#include <zebra.h>
+
+#include "prefix.h"
+#include "linklist.h"
+#include "memory.h"
+#include "command.h"
+#include "stream.h"
+#include "thread.h"
+#include "log.h"
+#include "sockunion.h"
+
+#include "bgpd/bgpd.h"
+#include "bgpd/bgp_table.h"
+#include "bgpd/bgp_route.h"
+#include "bgpd/bgp_attr.h"
+#include "bgpd/bgp_advertise.h"
+#include "bgpd/bgp_packet.h"
+#include "bgpd/bgp_fsm.h"
+#include "bgpd/bgp_debug.h"
+#include "bgpd/bgp_vty.h"
+#include "bgpd/bgp_updgrp.h"
+
+/* Per AF flags which only concern what is received from the peer.  */
+#define UPDGRP_AF_FLAGS_IGNORE \
+  (PEER_FLAG_SOFT_RECONFIG | PEER_FLAG_ALLOWAS_IN \
+   | PEER_FLAG_ORF_PREFIX_SM | PEER_FLAG_ORF_PREFIX_RM \
+   | PEER_FLAG_MAX_PREFIX | PEER_FLAG_MAX_PREFIX_WARNING)
+
+static struct thread *updgrp_thread;
+static u_int32_t updgrp_id;
+
+/* Fill in KEY for PEER.  Filter names are borrowed from the peer.  */
+static void
+updgrp_key_make (struct bgp_updgrp_key *key, struct peer *peer,
+		 afi_t afi, safi_t safi)
+{
+  struct bgp_filter *filter = &peer->filter[afi][safi];
+
+  memset (key, 0, sizeof (struct bgp_updgrp_key));
+  key->sort = peer->sort;
+#ifdef BGP_SEND_ASPATH_CHECK
+  key->as = peer->as;
+#endif /* BGP_SEND_ASPATH_CHECK */
+  key->local_as = peer->local_as;
+  key->change_local_as = peer->change_local_as;
+  key->flags = peer->flags & (PEER_FLAG_LOCAL_AS_NO_PREPEND
+			      | PEER_FLAG_LOCAL_AS_REPLACE_AS);
+  key->af_flags = peer->af_flags[afi][safi] & ~UPDGRP_AF_FLAGS_IGNORE;
+  key->af_sflags = peer->af_sflags[afi][safi] & PEER_STATUS_DEFAULT_ORIGINATE;
+  key->cap = peer->cap & (PEER_CAP_AS4_ADV | PEER_CAP_AS4_RCV
+			  | PEER_CAP_EXTENDED_MSG_ADV
+			  | PEER_CAP_EXTENDED_MSG_RCV);
+  key->v_routeadv = peer->v_routeadv;
+  key->shared_network = peer->shared_network;
+  if (peer->su_local)
+    key->su_local = *peer->su_local;
+  key->nexthop = peer->nexthop.v4;
+#ifdef HAVE_IPV6
+  key->nexthop_global = peer->nexthop.v6_global;
+  key->nexthop_local = peer->nexthop.v6_local;
+#endif /* HAVE_IPV6 */
+  key->name[0] = filter->dlist[FILTER_OUT].name;
+  key->name[1] = filter->plist[FILTER_OUT].name;
+  key->name[2] = filter->aslist[FILTER_OUT].name;
+  key->name[3] = filter->map[RMAP_OUT].name;
+  key->name[4] = filter->usmap.name;
+}
+
+static void
+updgrp_key_copy (struct bgp_updgrp_key *dst, struct bgp_updgrp_key *src)
+{
+  int i;
+
+  *dst = *src;
+  for (i = 0; i < BGP_UPDGRP_NAMES; i++)
+    if (src->name[i])
+      dst->name[i] = XSTRDUP (MTYPE_TMP, src->name[i]);
+}
+
+static void
+updgrp_key_free (struct bgp_updgrp_key *key)
+{
+  int i;
+
+  for (i = 0; i < BGP_UPDGRP_NAMES; i++)
+    if (key->name[i])
+      XFREE (MTYPE_TMP, key->name[i]);
+}
+
+/* Return 0 when both keys describe the same policy.  */
+static int
+updgrp_key_cmp (struct bgp_updgrp_key *k1, struct bgp_updgrp_key *k2)
+{
+  int i;
+
+  if (k1->sort != k2->sort
+#ifdef BGP_SEND_ASPATH_CHECK
+      || k1->as != k2->as
+#endif /* BGP_SEND_ASPATH_CHECK */
+      || k1->local_as != k2->local_as
+      || k1->change_local_as != k2->change_local_as
+      || k1->flags != k2->flags
+      || k1->af_flags != k2->af_flags
+      || k1->af_sflags != k2->af_sflags
+      || k1->cap != k2->cap
+      || k1->v_routeadv != k2->v_routeadv
+      || k1->shared_network != k2->shared_network
+      || k1->nexthop.s_addr != k2->nexthop.s_addr)
+    return 1;
+#ifdef HAVE_IPV6
+  if (! IPV6_ADDR_SAME (&k1->nexthop_global, &k2->nexthop_global)
+      || ! IPV6_ADDR_SAME (&k1->nexthop_local, &k2->nexthop_local))
+    return 1;
+#endif /* HAVE_IPV6 */
+  if (k1->su_local.sa.sa_family != k2->su_local.sa.sa_family
+      || (k1->su_local.sa.sa_family
+	  && ! sockunion_same (&k1->su_local, &k2->su_local)))
+    return 1;
+
+  for (i = 0; i < BGP_UPDGRP_NAMES; i++)
+    {
+      if (! k1->name[i] != ! k2->name[i])
+	return 1;
+      if (k1->name[i] && strcmp (k1->name[i], k2->name[i]))
+	return 1;
+    }
+  return 0;
+}
+
+/* Whether PEER may be sent the same UPDATEs as others.  Peers with
+   ORF or route server clients get updates of their own.  */
+static int
+updgrp_peer_eligible (struct peer *peer, afi_t afi, safi_t safi)
+{
+  if (safi != SAFI_UNICAST && safi != SAFI_MULTICAST)
+    return 0;
+  if (peer->status != Established || ! peer->afc_nego[afi][safi])
+    return 0;
+  if (CHECK_FLAG (peer->af_flags[afi][safi], PEER_FLAG_RSERVER_CLIENT))
+    return 0;
+  if (peer->orf_plist[afi][safi]
+      || CHECK_FLAG (peer->af_sflags[afi][safi], PEER_STATUS_ORF_WAIT_REFRESH))
+    return 0;
+  /* The third party next-hop check depends on the address of a
+     multihop EBGP peer.  */
+  if (peer->sort == BGP_PEER_EBGP && peer->ttl > 1)
+    return 0;
+  return 1;
+}
+
+/* A peer joins a group only once it has sent everything it had queued,
+   so that it holds exactly the routes in its adj-RIB-out.  */
+static int
+updgrp_peer_idle (struct peer *peer, afi_t afi, safi_t safi)
+{
+  struct bgp_synchronize *sync = peer->sync[afi][safi];
+
+  return (FIFO_EMPTY (&sync->update)
+	  && FIFO_EMPTY (&sync->withdraw)
+	  && FIFO_EMPTY (&sync->withdraw_low)
+	  && peer->obuf->count < BGP_UPDGRP_OBUF_MAX);
+}
+
+static void
+updgrp_write_on (struct peer *peer)
+{
+  BGP_WRITE_ON (peer->t_write, bgp_write, peer->fd);
+}
+
+static struct update_group *
+updgrp_lookup (struct bgp *bgp, afi_t afi, safi_t safi,
+	       struct bgp_updgrp_key *key)
+{
+  struct listnode *node;
+  struct update_group *group;
+
+  for (ALL_LIST_ELEMENTS_RO (bgp->update_groups, node, group))
+    if (group->afi == afi && group->safi == safi
+	&& ! updgrp_key_cmp (&group->key, key))
+      return group;
+  return NULL;
+}
+
+static void
+updgrp_synctime (struct update_group *group)
+{
+  struct listnode *node;
+  struct peer *peer;
+
+  group->synctime = 0;
+  for (ALL_LIST_ELEMENTS_RO (group->peers, node, peer))
+    if (node == listhead (group->peers) || peer->synctime < group->synctime)
+      group->synctime = peer->synctime;
+}
+
+/* Hand the adj-RIB-out of FROM over to TO.  */
+static void
+updgrp_adj_move (struct peer *from, struct peer *to, afi_t afi, safi_t safi)
+{
+  struct bgp_adj_out *adj;
+
+  while ((adj = from->adj_out[afi][safi]) != NULL)
+    {
+      BGP_PEER_LIST_DEL (from->adj_out[afi][safi], adj);
+      BGP_PEER_LIST_ADD (to->adj_out[afi][safi], adj);
+      adj->peer = peer_lock (to);
+      peer_unlock (from);
+    }
+  to->scount[afi][safi] = from->scount[afi][safi];
+  from->scount[afi][safi] = 0;
+}
+
+/* Give PEER an adj-RIB-out of its own matching the group's, pending
+   advertisements included.  */
+static void
+updgrp_adj_copy (struct peer *owner, struct peer *peer, afi_t afi, safi_t safi)
+{
+  struct bgp_node *rn;
+  struct bgp_adj_out *adj;
+  struct bgp_adj_out *new;
+
+  for (adj = owner->adj_out[afi][safi]; adj; adj = adj->peer_next)
+    {
+      rn = adj->rn;
+
+      if (adj->attr)
+	{
+	  new = XCALLOC (MTYPE_BGP_ADJ_OUT, sizeof (struct bgp_adj_out));
+	  new->peer = peer_lock (peer);
+	  new->attr = bgp_attr_intern (adj->attr);
+	  new->rn = rn;
+	  BGP_ADJ_OUT_ADD (rn, new);
+	  BGP_PEER_LIST_ADD (peer->adj_out[afi][safi], new);
+	  bgp_lock_node (rn);
+	  peer->scount[afi][safi]++;
+	}
+
+      if (adj->adv)
+	{
+	  if (adj->adv->baa)
+	    bgp_adj_out_set (rn, peer, &rn->p, adj->adv->baa->attr,
+			     afi, safi, adj->adv->binfo);
+	  else
+	    bgp_adj_out_unset (rn, peer, &rn->p, afi, safi);
+	}
+    }
+}
+
+/* The group did not send PEER the routes it advertised, nor will PEER
+   on its own.  */
+static void
+updgrp_adj_trim (struct peer *peer, afi_t afi, safi_t safi)
+{
+  struct bgp_node *rn;
+  struct bgp_adj_out *adj;
+  struct bgp_adj_out *next;
+  struct bgp_info *ri;
+
+  for (adj = peer->adj_out[afi][safi]; adj; adj = next)
+    {
+      next = adj->peer_next;
+      rn = adj->rn;
+
+      for (ri = rn->info; ri; ri = ri->next)
+	if (CHECK_FLAG (ri->flags, BGP_INFO_SELECTED))
+	  break;
+      if (! ri || ri->peer != peer)
+	continue;
+
+      if (adj->adv)
+	bgp_adj_out_unset (rn, peer, &rn->p, afi, safi);
+      else
+	{
+	  if (adj->attr)
+	    peer->scount[afi][safi]--;
+	  bgp_adj_out_remove (rn, adj, peer, afi, safi);
+	  bgp_unlock_node (rn);
+	}
+    }
+}
+
+/* Forget what PEER was sent; the group it joins has it already.  */
+static void
+updgrp_adj_drop (struct peer *peer, afi_t afi, safi_t safi)
+{
+  struct bgp_node *rn;
+  struct bgp_adj_out *adj;
+
+  while ((adj = peer->adj_out[afi][safi]) != NULL)
+    {
+      rn = adj->rn;
+      bgp_adj_out_remove (rn, adj, peer, afi, safi);
+      bgp_unlock_node (rn);
+    }
+  peer->scount[afi][safi] = 0;
+}
+
+/* Routes which were kept from FIRST alone because they came from it,
+   or carry its router-id as ORIGINATOR_ID, are due to the rest of its
+   group.  */
+static void
+updgrp_announce_held (struct update_group *group, struct peer *first)
+{
+  struct bgp_node *rn;
+  struct bgp_info *ri;
+  struct attr *attr;
+
+  for (rn = bgp_table_top (group->bgp->rib[group->afi][group->safi]); rn;
+       rn = bgp_route_next (rn))
+    for (ri = rn->info; ri; ri = ri->next)
+      if (CHECK_FLAG (ri->flags, BGP_INFO_SELECTED))
+	{
+	  attr = ri->attr;
+	  if (ri->peer == first
+	      || (attr->extra
+		  && (attr->flag & ATTR_FLAG_BIT (BGP_ATTR_ORIGINATOR_ID))
+		  && IPV4_ADDR_SAME (&first->remote_id,
+				     &attr->extra->originator_id)))
+	    bgp_process_announce_group (group, ri, rn);
+	  break;
+	}
+}
+
+static void
+updgrp_add (struct update_group *group, struct peer *peer)
+{
+  peer->updgrp[group->afi][group->safi] = group;
+  listnode_add (group->peers, peer);
+  group->joins++;
+  updgrp_synctime (group);
+
+  if (BGP_DEBUG (events, EVENTS))
+    zlog_debug ("%s joined update group %u", peer->host, group->id);
+}
+
+/* Start a group from FIRST, which brings its adj-RIB-out along.  */
+static struct update_group *
+updgrp_create (struct peer *first, afi_t afi, safi_t safi,
+	       struct bgp_updgrp_key *key)
+{
+  struct bgp *bgp = first->bgp;
+  struct update_group *group;
+  struct peer *owner;
+  char buf[32];
+
+  group = XCALLOC (MTYPE_BGP_UPDGRP, sizeof (struct update_group));
+  group->bgp = bgp;
+  group->afi = afi;
+  group->safi = safi;
+  group->id = ++updgrp_id;
+  group->uptime = bgp_clock ();
+  updgrp_key_copy (&group->key, key);
+  group->peers = list_new ();
+
+  owner = peer_new (bgp);
+  snprintf (buf, sizeof (buf), "update-group %u", group->id);
+  owner->host = XSTRDUP (MTYPE_BGP_PEER_HOST, buf);
+  owner->updgrp[afi][safi] = group;
+  group->peer = owner;
+  bgp_packet_size_set (owner, first->max_packet_size);
+
+  listnode_add (bgp->update_groups, group);
+
+  updgrp_adj_move (first, owner, afi, safi);
+  updgrp_add (group, first);
+  updgrp_announce_held (group, first);
+
+  return group;
+}
+
+static void
+updgrp_free (struct update_group *group)
+{
+  struct peer *owner = group->peer;
+
+  listnode_delete (group->bgp->update_groups, group);
+
+  owner->updgrp[group->afi][group->safi] = NULL;
+  owner->status = Deleted;
+  stream_free (owner->ibuf);
+  owner->ibuf = NULL;
+  stream_fifo_free (owner->obuf);
+  owner->obuf = NULL;
+  stream_free (owner->work);
+  owner->work = NULL;
+  stream_free (owner->scratch);
+  owner->scratch = NULL;
+  peer_unlock (owner); /* initial reference */
+
+  updgrp_key_free (&group->key);
+  list_delete (group->peers);
+  XFREE (MTYPE_BGP_UPDGRP, group);
+}
+
+/* Take PEER out of its group in AFI/SAFI.  With KEEP it carries on
+   from where the group is, otherwise it is going down.  A group left
+   with a single member is dissolved into that member.  */
+void
+bgp_updgrp_leave (struct peer *peer, afi_t afi, safi_t safi, int keep)
+{
+  struct update_group *group = peer->updgrp[afi][safi];
+  struct peer *owner;
+  struct peer *last;
+  struct bgp_synchronize *sync;
+  struct hash *hash;
+
+  if (! group)
+    return;
+  owner = group->peer;
+
+  listnode_delete (group->peers, peer);
+  peer->updgrp[afi][safi] = NULL;
+  if (group->slow == peer)
+    group->slow = NULL;
+  group->splits++;
+
+  if (BGP_DEBUG (events, EVENTS))
+    zlog_debug ("%s left update group %u", peer->host, group->id);
+
+  if (keep)
+    {
+      updgrp_adj_copy (owner, peer, afi, safi);
+      updgrp_adj_trim (peer, afi, safi);
+      updgrp_write_on (peer);
+    }
+
+  if (listcount (group->peers) > 1)
+    {
+      updgrp_synctime (group);
+      return;
+    }
+
+  /* A group of one is just a peer.  Its queues are empty while it is
+     grouped, so it takes the owner's as they are.  */
+  if (listcount (group->peers) == 1)
+    {
+      last = listgetdata (listhead (group->peers));
+      last->updgrp[afi][safi] = NULL;
+      updgrp_adj_move (owner, last, afi, safi);
+
+      sync = last->sync[afi][safi];
+      last->sync[afi][safi] = owner->sync[afi][safi];
+      owner->sync[afi][safi] = sync;
+      hash = last->hash[afi][safi];
+      last->hash[afi][safi] = owner->hash[afi][safi];
+      owner->hash[afi][safi] = hash;
+
+      updgrp_adj_trim (last, afi, safi);
+
+      if (BGP_DEBUG (events, EVENTS))
+	zlog_debug ("%s left update group %u", last->host, group->id);
+
+      updgrp_write_on (last);
+    }
+  updgrp_free (group);
+}
+
+void
+bgp_updgrp_leave_all (struct peer *peer)
+{
+  afi_t afi;
+  safi_t safi;
+
+  for (afi = AFI_IP; afi < AFI_MAX; afi++)
+    for (safi = SAFI_UNICAST; safi < SAFI_MAX; safi++)
+      bgp_updgrp_leave (peer, afi, safi, 0);
+}
+
+/* Members whose policy no longer matches the group's leave it, unless
+   all of them changed alike.  */
+static void
+updgrp_check_group (struct update_group *group)
+{
+  struct listnode *node, *nnode;
+  struct peer *peer;
+  struct bgp_updgrp_key key;
+  struct bgp_updgrp_key pkey;
+  afi_t afi = group->afi;
+  safi_t safi = group->safi;
+
+  peer = listgetdata (listhead (group->peers));
+  updgrp_key_make (&key, peer, afi, safi);
+  if (updgrp_key_cmp (&group->key, &key))
+    {
+      for (ALL_LIST_ELEMENTS_RO (group->peers, node, peer))
+	{
+	  if (! updgrp_peer_eligible (peer, afi, safi))
+	    break;
+	  updgrp_key_make (&pkey, peer, afi, safi);
+	  if (updgrp_key_cmp (&pkey, &key))
+	    break;
+	}
+      if (! node)
+	{
+	  updgrp_key_free (&group->key);
+	  updgrp_key_copy (&group->key, &key);
+	}
+    }
+
+  for (ALL_LIST_ELEMENTS (group->peers, node, nnode, peer))
+    {
+      if (updgrp_peer_eligible (peer, afi, safi))
+	{
+	  updgrp_key_make (&pkey, peer, afi, safi);
+	  if (! updgrp_key_cmp (&pkey, &group->key))
+	    continue;
+	}
+      if (listcount (group->peers) <= 2)
+	{
+	  bgp_updgrp_leave (peer, afi, safi, 1);
+	  return;
+	}
+      bgp_updgrp_leave (peer, afi, safi, 1);
+    }
+}
+
+void
+bgp_updgrp_check (void)
+{
+  struct listnode *node, *gnode, *gnnode;
+  struct bgp *bgp;
+  struct update_group *group;
+
+  for (ALL_LIST_ELEMENTS_RO (bm->bgp, node, bgp))
+    for (ALL_LIST_ELEMENTS (bgp->update_groups, gnode, gnnode, group))
+      updgrp_check_group (group);
+}
+
+/* A member still unable to keep up a scan later is split out, so that
+   it does not hold back the rest.  */
+static void
+updgrp_check_slow (struct update_group *group)
+{
+  struct listnode *node;
+  struct peer *peer;
+  struct peer *slow = NULL;
+
+  for (ALL_LIST_ELEMENTS_RO (group->peers, node, peer))
+    if (peer->obuf->count >= BGP_UPDGRP_OBUF_MAX)
+      {
+	slow = peer;
+	break;
+      }
+
+  if (slow && slow == group->slow)
+    {
+      zlog_info ("%s is too slow for update group %u, split out",
+		 slow->host, group->id);
+      bgp_updgrp_leave (slow, group->afi, group->safi, 1);
+      return;
+    }
+  group->slow = slow;
+}
+
+/* Put ungrouped peers which have caught up into groups.  */
+static void
+updgrp_scan_afi (struct bgp *bgp, afi_t afi, safi_t safi)
+{
+  struct listnode *node;
+  struct peer *peer;
+  struct update_group *group;
+  struct bgp_updgrp_key key;
+  struct
+  {
+    struct peer *peer;
+    struct bgp_updgrp_key key;
+  } *cand;
+  int count = 0;
+  int i;
+
+  if (! listcount (bgp->peer))
+    return;
+  cand = XCALLOC (MTYPE_TMP, listcount (bgp->peer) * sizeof (*cand));
+
+  for (ALL_LIST_ELEMENTS_RO (bgp->peer, node, peer))
+    {
+      if (peer->updgrp[afi][safi]
+	  || ! updgrp_peer_eligible (peer, afi, safi)
+	  || ! updgrp_peer_idle (peer, afi, safi))
+	continue;
+
+      updgrp_key_make (&key, peer, afi, safi);
+      group = updgrp_lookup (bgp, afi, safi, &key);
+      if (group)
+	{
+	  updgrp_adj_drop (peer, afi, safi);
+	  updgrp_add (group, peer);
+	  continue;
+	}
+
+      for (i = 0; i < count; i++)
+	if (cand[i].peer && ! updgrp_key_cmp (&cand[i].key, &key))
+	  break;
+      if (i < count)
+	{
+	  group = updgrp_create (cand[i].peer, afi, safi, &cand[i].key);
+	  cand[i].peer = NULL;
+	  updgrp_adj_drop (peer, afi, safi);
+	  updgrp_add (group, peer);
+	}
+      else
+	{
+	  cand[count].peer = peer;
+	  cand[count].key = key;
+	  count++;
+	}
+    }
+
+  XFREE (MTYPE_TMP, cand);
+}
+
+static int
+bgp_updgrp_scan (struct thread *t)
+{
+  struct listnode *node, *gnode, *gnnode;
+  struct bgp *bgp;
+  struct update_group *group;
+  afi_t afi;
+  safi_t safi;
+
+  updgrp_thread = thread_add_timer (bm->master, bgp_updgrp_scan, NULL,
+				    BGP_UPDGRP_SCAN_INTERVAL);
+
+  bgp_updgrp_check ();
+
+  for (ALL_LIST_ELEMENTS_RO (bm->bgp, node, bgp))
+    {
+      for (ALL_LIST_ELEMENTS (bgp->update_groups, gnode, gnnode, group))
+	updgrp_check_slow (group);
+
+      for (afi = AFI_IP; afi < AFI_MAX; afi++)
+	for (safi = SAFI_UNICAST; safi <= SAFI_MULTICAST; safi++)
+	  updgrp_scan_afi (bgp, afi, safi);
+    }
+  return 0;
+}
+
+/* A member's MRAI timer fired.  */
+void
+bgp_updgrp_routeadv (struct peer *peer)
+{
+  afi_t afi;
+  safi_t safi;
+
+  for (afi = AFI_IP; afi < AFI_MAX; afi++)
+    for (safi = SAFI_UNICAST; safi < SAFI_MAX; safi++)
+      if (peer->updgrp[afi][safi])
+	updgrp_synctime (peer->updgrp[afi][safi]);
+}
+
+/* Whether building for GROUP has to wait for a member to drain its
+   output queue.  */
+int
+bgp_updgrp_blocked (struct update_group *group)
+{
+  struct listnode *node;
+  struct peer *peer;
+
+  if (! group->blocked)
+    return 0;
+
+  group->blocked = 0;
+  for (ALL_LIST_ELEMENTS_RO (group->peers, node, peer))
+    if (peer->obuf->count >= BGP_UPDGRP_OBUF_MAX)
+      {
+	group->blocked = 1;
+	break;
+      }
+  return group->blocked;
+}
+
+void
+bgp_updgrp_write_on (struct update_group *group)
+{
+  struct listnode *node;
+  struct peer *peer;
+
+  for (ALL_LIST_ELEMENTS_RO (group->peers, node, peer))
+    updgrp_write_on (peer);
+}
+
+DEFUN (show_ip_bgp_update_groups,
+       show_ip_bgp_update_groups_cmd,
+       "show ip bgp update-groups",
+       SHOW_STR
+       IP_STR
+       BGP_STR
+       "Update groups\n")
+{
+  struct bgp *bgp;
+  struct listnode *node, *pnode;
+  struct update_group *group;
+  struct peer *peer;
+  char timebuf[BGP_UPTIME_LEN];
+
+  bgp = bgp_get_default ();
+  if (bgp == NULL)
+    {
+      vty_out (vty, "No BGP process is configured%s", VTY_NEWLINE);
+      return CMD_WARNING;
+    }
+
+  for (ALL_LIST_ELEMENTS_RO (bgp->update_groups, node, group))
+    {
+      vty_out (vty, "Update group %u, %s, up for %s%s", group->id,
+	       afi_safi_print (group->afi, group->safi),
+	       peer_uptime (group->uptime, timebuf, BGP_UPTIME_LEN),
+	       VTY_NEWLINE);
+      vty_out (vty, "  %d members, %lu prefixes advertised%s%s",
+	       listcount (group->peers),
+	       group->peer->scount[group->afi][group->safi],
+	       group->blocked ? ", blocked" : "", VTY_NEWLINE);
+      vty_out (vty, "  Packets built %u, copies sent %u%s",
+	       group->packets, group->copies, VTY_NEWLINE);
+      vty_out (vty, "  Joins %u, leaves %u%s",
+	       group->joins, group->splits, VTY_NEWLINE);
+      for (ALL_LIST_ELEMENTS_RO (group->peers, pnode, peer))
+	vty_out (vty, "    %-16s outq %lu%s", peer->host,
+		 (unsigned long) peer->obuf->count, VTY_NEWLINE);
+      vty_out (vty, "%s", VTY_NEWLINE);
+    }
+  return CMD_SUCCESS;
+}
+
+void
+bgp_updgrp_init (void)
+{
+  updgrp_thread = thread_add_timer (bm->master, bgp_updgrp_scan, NULL,
+				    BGP_UPDGRP_SCAN_INTERVAL);
+
+  install_element (VIEW_NODE, &show_ip_bgp_update_groups_cmd);
+  install_element (RESTRICTED_NODE, &show_ip_bgp_update_groups_cmd);
+  install_element (ENABLE_NODE, &show_ip_bgp_update_groups_cmd);
+}
+
+void
+bgp_updgrp_finish (void)
+{
+  THREAD_OFF (updgrp_thread);
+}
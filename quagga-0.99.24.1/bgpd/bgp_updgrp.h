@@ -0,0 +1,114 @@
+/* BGP update groups.
+
+This file is part of GNU Zebra.
+
+GNU Zebra is free software; you can redistribute it and/or modify it
+under the terms of the GNU General Public License as published by the
+Free Software Foundation; either version 2, or (at your option) any
+later version.
+
+GNU Zebra is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with GNU Zebra; see the file COPYING.  If not, write to the Free
+Software Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
+02111-1307, USA.  */
+
+#ifndef _QUAGGA_BGP_UPDGRP_H
+#define _QUAGGA_BGP_UPDGRP_H
+
+/* Everything which decides what a peer is sent in one address family,
+   and how it is encoded.  Peers with equal keys are sent the same
+   UPDATE messages.  Filters are compared by name.  */
+#define BGP_UPDGRP_NAMES  5
+
+struct bgp_updgrp_key
+{
+  bgp_peer_sort_t sort;
+#ifdef BGP_SEND_ASPATH_CHECK
+  as_t as;
+#endif /* BGP_SEND_ASPATH_CHECK */
+  as_t local_as;
+  as_t change_local_as;
+  u_int32_t flags;
+  u_int32_t af_flags;
+  u_int16_t af_sflags;
+  u_int16_t cap;
+  u_int32_t v_routeadv;
+  int shared_network;
+  union sockunion su_local;
+  struct in_addr nexthop;
+#ifdef HAVE_IPV6
+  struct in6_addr nexthop_global;
+  struct in6_addr nexthop_local;
+#endif /* HAVE_IPV6 */
+  char *name[BGP_UPDGRP_NAMES];
+};
+
+/* Established peers with the same outbound policy in an address
+   family.  Routes are run through the policy and encoded once for the
+   whole group, and every member is handed a reference to the same
+   packet.  */
+struct update_group
+{
+  struct bgp *bgp;
+  afi_t afi;
+  safi_t safi;
+
+  /* Number for display.  */
+  u_int32_t id;
+
+  /* Policy shared by the members.  */
+  struct bgp_updgrp_key key;
+
+  /* Member peers.  The first one stands in for all of them when the
+     outbound policy is applied.  */
+  struct list *peers;
+
+  /* Owner of the group's adj-RIB-out, advertisement queues and
+     attribute hash, much like bgp->peer_self.  It never connects and
+     is not on bgp->peer.  */
+  struct peer *peer;
+
+  /* Oldest MRAI tick of the members.  */
+  time_t synctime;
+
+  /* Set while a member's output queue is full.  */
+  int blocked;
+
+  /* Member which held the group back at the last scan.  */
+  struct peer *slow;
+
+  time_t uptime;
+
+  /* Statistics.  */
+  u_int32_t packets;
+  u_int32_t copies;
+  u_int32_t joins;
+  u_int32_t splits;
+};
+
+/* Packets a member may have queued before the group stops building.  */
+#define BGP_UPDGRP_OBUF_MAX        64
+
+/* Seconds between membership scans.  */
+#define BGP_UPDGRP_SCAN_INTERVAL    1
+
+/* Peer whose adj-RIB-out and advertisement queues carry what is sent
+   to P in AFI/SAFI: the owner of P's update group, or P itself.  */
+#define BGP_ADJ_OWNER(P,A,S) \
+  ((P)->updgrp[(A)][(S)] ? (P)->updgrp[(A)][(S)]->peer : (P))
+
+extern void bgp_updgrp_init (void);
+extern void bgp_updgrp_finish (void);
+extern void bgp_updgrp_leave (struct peer *, afi_t, safi_t, int);
+extern void bgp_updgrp_leave_all (struct peer *);
+extern void bgp_updgrp_check (void);
+extern void bgp_updgrp_routeadv (struct peer *);
+extern int bgp_updgrp_blocked (struct update_group *);
+extern void bgp_updgrp_write_on (struct update_group *);
+
+#endif /* _QUAGGA_BGP_UPDGRP_H */
@@ -49,6 +49,7 @@ Software Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
 #include "bgpd/bgp_table.h"
 #include "bgpd/bgp_vty.h"
 #include "bgpd/bgp_mpath.h"
+#include "bgpd/bgp_updgrp.h"
 
 extern struct in_addr router_id_zebra;
 
@@ -155,6 +156,9 @@ bgp_vty_return (struct vty *vty, int ret)
 {
   const char *str = NULL;
 
+  /* Peers whose outbound policy was changed leave their update group. */
+  bgp_updgrp_check ();
+
   switch (ret)
     {
     case BGP_ERR_INVALID_VALUE:
@@ -1979,6 +1983,30 @@ DEFUN (no_neighbor_capability_dynamic,
   return peer_flag_unset_vty (vty, argv[0], PEER_FLAG_DYNAMIC_CAPABILITY);
 }
 
+/* neighbor capability extended-message. */
+DEFUN (neighbor_capability_extended_message,
+       neighbor_capability_extended_message_cmd,
+       NEIGHBOR_CMD2 "capability extended-message",
+       NEIGHBOR_STR
+       NEIGHBOR_ADDR_STR2
+       "Advertise capability to the peer\n"
+       "Advertise extended message capability to this neighbor\n")
+{
+  return peer_flag_set_vty (vty, argv[0], PEER_FLAG_EXTENDED_MESSAGE);
+}
+
+DEFUN (no_neighbor_capability_extended_message,
+       no_neighbor_capability_extended_message_cmd,
+       NO_NEIGHBOR_CMD2 "capability extended-message",
+       NO_STR
+       NEIGHBOR_STR
+       NEIGHBOR_ADDR_STR2
+       "Advertise capability to the peer\n"
+       "Advertise extended message capability to this neighbor\n")
+{
+  return peer_flag_unset_vty (vty, argv[0], PEER_FLAG_EXTENDED_MESSAGE);
+}
+
 /* neighbor dont-capability-negotiate */
 DEFUN (neighbor_dont_capability_negotiate,
        neighbor_dont_capability_negotiate_cmd,
@@ -6801,22 +6829,29 @@ DEFUN (show_bgp_memory,
   unsigned long count;
   
   /* RIB related usage stats */
-  count = mtype_stats_alloc (MTYPE_BGP_NODE);
+  count = bgp_node_slab.used;
   vty_out (vty, "%ld RIB nodes, using %s of memory%s", count,
            mtype_memstr (memstrbuf, sizeof (memstrbuf),
-                         count * sizeof (struct bgp_node)),
+                         count * bgp_node_slab.size),
            VTY_NEWLINE);
+  bgp_slab_show (vty, &bgp_node_slab);
   
-  count = mtype_stats_alloc (MTYPE_BGP_ROUTE);
+  count = bgp_info_slab.used;
   vty_out (vty, "%ld BGP routes, using %s of memory%s", count,
            mtype_memstr (memstrbuf, sizeof (memstrbuf),
-                         count * sizeof (struct bgp_info)),
+                         count * bgp_info_slab.size),
            VTY_NEWLINE);
+  bgp_slab_show (vty, &bgp_info_slab);
   if ((count = mtype_stats_alloc (MTYPE_BGP_ROUTE_EXTRA)))
     vty_out (vty, "%ld BGP route ancillaries, using %s of memory%s", count,
              mtype_memstr (memstrbuf, sizeof (memstrbuf),
                            count * sizeof (struct bgp_info_extra)),
              VTY_NEWLINE);
+  if ((count = mtype_stats_alloc (MTYPE_BGP_MPATH_INFO)))
+    vty_out (vty, "%ld BGP multipath entries, using %s of memory%s", count,
+             mtype_memstr (memstrbuf, sizeof (memstrbuf),
+                           count * sizeof (struct bgp_info_mpath)),
+             VTY_NEWLINE);
   
   if ((count = mtype_stats_alloc (MTYPE_BGP_STATIC)))
     vty_out (vty, "%ld Static routes, using %s of memory%s", count,
@@ -6956,7 +6991,7 @@ bgp_show_summary (struct vty *vty, struct bgp *bgp, int afi, int safi)
               ents = bgp_table_count (bgp->rib[afi][safi]);
               vty_out (vty, "RIB entries %ld, using %s of memory%s", ents,
                        mtype_memstr (memstrbuf, sizeof (memstrbuf),
-                                     ents * sizeof (struct bgp_node)),
+                                     ents * bgp_node_slab.size),
                        VTY_NEWLINE);
               
               /* Peer related usage */
@@ -7358,6 +7393,10 @@ bgp_show_peer_afi (struct vty *vty, struct peer *p, afi_t afi, safi_t safi)
   if (p->af_group[afi][safi])
     vty_out (vty, "  %s peer-group member%s", p->group->name, VTY_NEWLINE);
 
+  if (p->updgrp[afi][safi])
+    vty_out (vty, "  Update group %u, %d members%s", p->updgrp[afi][safi]->id,
+	     listcount (p->updgrp[afi][safi]->peers), VTY_NEWLINE);
+
   if (CHECK_FLAG (p->af_cap[afi][safi], PEER_CAP_ORF_PREFIX_SM_ADV)
       || CHECK_FLAG (p->af_cap[afi][safi], PEER_CAP_ORF_PREFIX_SM_RCV)
       || CHECK_FLAG (p->af_cap[afi][safi], PEER_CAP_ORF_PREFIX_SM_OLD_RCV)
@@ -7669,6 +7708,18 @@ bgp_show_peer (struct vty *vty, struct peer *p)
 			 CHECK_FLAG (p->cap, PEER_CAP_DYNAMIC_ADV) ? "and " : "");
 	      vty_out (vty, "%s", VTY_NEWLINE);
 	    }
+	  /* Extended message */
+	  if (CHECK_FLAG (p->cap, PEER_CAP_EXTENDED_MSG_RCV)
+	      || CHECK_FLAG (p->cap, PEER_CAP_EXTENDED_MSG_ADV))
+	    {
+	      vty_out (vty, "    Extended message:");
+	      if (CHECK_FLAG (p->cap, PEER_CAP_EXTENDED_MSG_ADV))
+		vty_out (vty, " advertised");
+	      if (CHECK_FLAG (p->cap, PEER_CAP_EXTENDED_MSG_RCV))
+		vty_out (vty, " %sreceived",
+			 CHECK_FLAG (p->cap, PEER_CAP_EXTENDED_MSG_ADV) ? "and " : "");
+	      vty_out (vty, "%s", VTY_NEWLINE);
+	    }
 
 	  /* Route Refresh */
 	  if (CHECK_FLAG (p->cap, PEER_CAP_REFRESH_ADV)
@@ -7798,6 +7849,7 @@ bgp_show_peer (struct vty *vty, struct peer *p)
 	   p->update_out + p->keepalive_out + p->refresh_out + p->dynamic_cap_out,
 	   p->open_in + p->notify_in + p->update_in + p->keepalive_in + p->refresh_in +
 	   p->dynamic_cap_in, VTY_NEWLINE);
+  bgp_attr_cache_show (vty, p);
 
   /* advertisement-interval */
   vty_out (vty, "  Minimum time between advertisement runs is %d seconds%s",
@@ -9566,6 +9618,10 @@ bgp_vty_init (void)
   install_element (BGP_NODE, &neighbor_capability_dynamic_cmd);
   install_element (BGP_NODE, &no_neighbor_capability_dynamic_cmd);
 
+  /* "neighbor capability extended-message" commands.*/
+  install_element (BGP_NODE, &neighbor_capability_extended_message_cmd);
+  install_element (BGP_NODE, &no_neighbor_capability_extended_message_cmd);
+
   /* "neighbor dont-capability-negotiate" commands. */
   install_element (BGP_NODE, &neighbor_dont_capability_negotiate_cmd);
   install_element (BGP_NODE, &no_neighbor_dont_capability_negotiate_cmd);
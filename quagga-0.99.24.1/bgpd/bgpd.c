@@ -58,6 +58,9 @@ Software Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
 #include "bgpd/bgp_network.h"
 #include "bgpd/bgp_vty.h"
 #include "bgpd/bgp_mpath.h"
+#include "bgpd/bgp_updgrp.h"
+#include "bgpd/bgp_io.h"
+#include "bgpd/bgp_select.h"
 #ifdef HAVE_SNMP
 #include "bgpd/bgp_snmp.h"
 #endif /* HAVE_SNMP */
@@ -83,6 +86,7 @@ bgp_option_set (int flag)
     case BGP_OPT_MULTIPLE_INSTANCE:
     case BGP_OPT_CONFIG_CISCO:
     case BGP_OPT_NO_LISTEN:
+    case BGP_OPT_IO_THREAD:
       SET_FLAG (bm->options, flag);
       break;
     default:
@@ -102,6 +106,7 @@ bgp_option_unset (int flag)
       /* Fall through.  */
     case BGP_OPT_NO_FIB:
     case BGP_OPT_CONFIG_CISCO:
+    case BGP_OPT_IO_THREAD:
       UNSET_FLAG (bm->options, flag);
       break;
     default:
@@ -786,7 +791,7 @@ peer_unlock (struct peer *peer)
 }
   
 /* Allocate new peer object, implicitely locked.  */
-static struct peer *
+struct peer *
 peer_new (struct bgp *bgp)
 {
   afi_t afi;
@@ -833,6 +838,7 @@ peer_new (struct bgp *bgp)
   peer->obuf = stream_fifo_new ();
   peer->work = stream_new (BGP_MAX_PACKET_SIZE);
   peer->scratch = stream_new (BGP_MAX_PACKET_SIZE);
+  peer->max_packet_size = BGP_MAX_PACKET_SIZE;
 
   bgp_sync_init (peer);
 
@@ -863,6 +869,8 @@ peer_create (union sockunion *su, struct bgp *bgp, as_t local_as,
     peer->v_routeadv = BGP_DEFAULT_IBGP_ROUTEADV;
   else
     peer->v_routeadv = BGP_DEFAULT_EBGP_ROUTEADV;
+  /* Not in the index of a table dump under way. */
+  peer->table_dump_index = TABLE_DUMP_V2_PEER_INDEX_NONE;
     
   peer = peer_lock (peer); /* bgp peer list reference */
   listnode_add_sort (bgp->peer, peer);
@@ -1958,6 +1966,7 @@ bgp_create (as_t *as, const char *name)
   bgp->peer->cmp = (int (*)(void *, void *)) peer_cmp;
 
   bgp->group = list_new ();
+  bgp->update_groups = list_new ();
   bgp->group->cmp = (int (*)(void *, void *)) peer_group_cmp;
 
   bgp->rsclient = list_new ();
@@ -2182,6 +2191,7 @@ bgp_free (struct bgp *bgp)
   list_delete (bgp->group);
   list_delete (bgp->peer);
   list_delete (bgp->rsclient);
+  list_delete (bgp->update_groups);
 
   if (bgp->name)
     free (bgp->name);
@@ -2353,6 +2363,7 @@ static const struct peer_flag_action peer_flag_action_list[] =
     { PEER_FLAG_STRICT_CAP_MATCH,         0, peer_change_none },
     { PEER_FLAG_DYNAMIC_CAPABILITY,       0, peer_change_reset },
     { PEER_FLAG_DISABLE_CONNECTED_CHECK,  0, peer_change_reset },
+    { PEER_FLAG_EXTENDED_MESSAGE,         0, peer_change_reset },
     { 0, 0, 0 }
   };
 
@@ -2462,7 +2473,8 @@ peer_flag_modify_action (struct peer *peer, u_int32_t flag)
     }
   else if (BGP_IS_VALID_STATE_FOR_NOTIF(peer->status))
     {
-      if (flag == PEER_FLAG_DYNAMIC_CAPABILITY)
+      if (flag == PEER_FLAG_DYNAMIC_CAPABILITY
+	  || flag == PEER_FLAG_EXTENDED_MESSAGE)
 	peer->last_reset = PEER_DOWN_CAPABILITY_CHANGE;
       else if (flag == PEER_FLAG_PASSIVE)
 	peer->last_reset = PEER_DOWN_PASSIVE_CHANGE;
@@ -4932,6 +4944,13 @@ bgp_config_write_peer (struct vty *vty, struct bgp *bgp,
 	vty_out (vty, " neighbor %s capability dynamic%s", addr,
 	     VTY_NEWLINE);
 
+      /* Extended message capability.  */
+      if (CHECK_FLAG (peer->flags, PEER_FLAG_EXTENDED_MESSAGE))
+        if (! peer_group_active (peer) ||
+	    ! CHECK_FLAG (g_peer->flags, PEER_FLAG_EXTENDED_MESSAGE))
+	vty_out (vty, " neighbor %s capability extended-message%s", addr,
+	     VTY_NEWLINE);
+
       /* dont capability negotiation. */
       if (CHECK_FLAG (peer->flags, PEER_FLAG_DONT_CAPABILITY))
         if (! peer_group_active (peer) ||
@@ -5228,6 +5247,16 @@ bgp_config_write (struct vty *vty)
       write++;
     }
 
+  /* BGP I/O thread. */
+  if (bgp_option_check (BGP_OPT_IO_THREAD))
+    {
+      vty_out (vty, "bgp io-thread%s", VTY_NEWLINE);
+      write++;
+    }
+
+  /* BGP best-path selection threads. */
+  write += bgp_select_config_write (vty);
+
   /* BGP configuration. */
   for (ALL_LIST_ELEMENTS (bm->bgp, mnode, mnnode, bgp))
     {
@@ -5432,6 +5461,9 @@ bgp_init (void)
   bgp_route_map_init ();
   bgp_address_init ();
   bgp_scan_init ();
+  bgp_updgrp_init ();
+  bgp_io_init ();
+  bgp_select_init ();
   bgp_mplsvpn_init ();
 
   /* Access list initialize. */
@@ -5483,4 +5515,9 @@ bgp_terminate (void)
       work_queue_free (bm->process_rsclient_queue);
       bm->process_rsclient_queue = NULL;
     }
+  if (bm->process_batch_queue)
+    {
+      work_queue_free (bm->process_batch_queue);
+      bm->process_batch_queue = NULL;
+    }
 }
@@ -41,6 +41,7 @@ struct bgp_master
   /* work queues */
   struct work_queue *process_main_queue;
   struct work_queue *process_rsclient_queue;
+  struct work_queue *process_batch_queue;
   
   /* Listening sockets */
   struct list *listen_sockets;
@@ -60,6 +61,7 @@ struct bgp_master
 #define BGP_OPT_MULTIPLE_INSTANCE        (1 << 1)
 #define BGP_OPT_CONFIG_CISCO             (1 << 2)
 #define BGP_OPT_NO_LISTEN                (1 << 3)
+#define BGP_OPT_IO_THREAD                (1 << 4)
 };
 
 /* BGP instance structure.  */
@@ -86,6 +88,9 @@ struct bgp
   /* BGP route-server-clients. */
   struct list *rsclient;
 
+  /* BGP update groups.  */
+  struct list *update_groups;
+
   /* BGP configuration.  */
   u_int16_t config;
 #define BGP_CONFIG_ROUTER_ID              (1 << 0)
@@ -370,6 +375,8 @@ struct peer
 #define PEER_CAP_AS4_RCV                    (1 << 8) /* as4 received */
 #define PEER_CAP_RESTART_BIT_ADV            (1 << 9) /* sent restart state */
 #define PEER_CAP_RESTART_BIT_RCV            (1 << 10) /* peer restart state */
+#define PEER_CAP_EXTENDED_MSG_ADV           (1 << 11) /* extended message advertised */
+#define PEER_CAP_EXTENDED_MSG_RCV           (1 << 12) /* extended message received */
 
   /* Capability flags (reset in bgp_stop) */
   u_int16_t af_cap[AFI_MAX][SAFI_MAX];
@@ -393,6 +400,7 @@ struct peer
 #define PEER_FLAG_DISABLE_CONNECTED_CHECK   (1 << 6) /* disable-connected-check */
 #define PEER_FLAG_LOCAL_AS_NO_PREPEND       (1 << 7) /* local-as no-prepend */
 #define PEER_FLAG_LOCAL_AS_REPLACE_AS       (1 << 8) /* local-as no-prepend replace-as */
+#define PEER_FLAG_EXTENDED_MESSAGE          (1 << 9) /* extended message capability */
 
   /* NSF mode (graceful restart) */
   u_char nsf[AFI_MAX][SAFI_MAX];
@@ -515,12 +523,31 @@ struct peer
   /* Announcement attribute hash.  */
   struct hash *hash[AFI_MAX][SAFI_MAX];
 
+  /* Update group sent the same UPDATEs as this peer.  */
+  struct update_group *updgrp[AFI_MAX][SAFI_MAX];
+
+  /* Routes learned from the peer and its adj-RIB-in and adj-RIB-out
+     entries, so that clearing the peer need not walk the tables.  */
+  struct bgp_info *routes[AFI_MAX][SAFI_MAX];
+  struct bgp_adj_in *adj_in[AFI_MAX][SAFI_MAX];
+  struct bgp_adj_out *adj_out[AFI_MAX][SAFI_MAX];
+
+  /* Socket I/O on the I/O thread, if the session is there.  */
+  struct bgp_io *io;
+
+  /* Raw attributes received, and what they parsed to.  */
+  struct bgp_attr_cache *attr_cache;
+
   /* Notify data. */
   struct bgp_notify notify;
 
   /* Whole packet size to be read. */
   unsigned long packet_size;
 
+  /* Largest packet of the session, either way.  The packet buffers are
+     sized for it once the session is established. */
+  bgp_size_t max_packet_size;
+
   /* Filter structure. */
   struct bgp_filter filter[AFI_MAX][SAFI_MAX];
 
@@ -606,6 +633,7 @@ struct bgp_nlri
 #define BGP_MARKER_SIZE		                16
 #define BGP_HEADER_SIZE		                19
 #define BGP_MAX_PACKET_SIZE                   4096
+#define BGP_EXTENDED_MESSAGE_MAX_PACKET_SIZE 65535
 
 /* BGP minimum message size.  */
 #define BGP_MSG_OPEN_MIN_SIZE                   (BGP_HEADER_SIZE + 10)
@@ -850,6 +878,7 @@ extern struct peer_group *peer_group_lookup (struct bgp *, const char *);
 extern struct peer_group *peer_group_get (struct bgp *, const char *);
 extern struct peer *peer_lookup_with_open (union sockunion *, as_t, struct in_addr *,
 				    int *);
+extern struct peer *peer_new (struct bgp *);
 extern struct peer *peer_lock (struct peer *);
 extern struct peer *peer_unlock (struct peer *);
 extern bgp_peer_sort_t peer_sort (struct peer *peer);
@@ -85,6 +85,12 @@
  * If the connection to the FPM goes down for some reason, the client
  * (zebra) should send the FPM a complete copy of the forwarding
  * table(s) when it reconnects.
+ *
+ * Zebra may be configured to send that copy as a snapshot, between a
+ * start and an end marker message. Any route that the FPM has not
+ * heard about between the two markers is no longer in zebra's
+ * forwarding table, which lets the FPM reconcile its state with
+ * zebra's without first flushing its own copy.
  */
 
 #define FPM_DEFAULT_PORT 2620
@@ -133,6 +139,18 @@ typedef enum fpm_msg_type_e_ {
    * message.
    */
   FPM_MSG_TYPE_NETLINK = 1,
+
+  /*
+   * Marks the start of a snapshot of the forwarding table(s). There
+   * is no payload.
+   */
+  FPM_MSG_TYPE_SNAPSHOT_START = 2,
+
+  /*
+   * Marks the end of a snapshot. The payload is the number of routes
+   * in the snapshot, as a 32-bit integer in network byte order.
+   */
+  FPM_MSG_TYPE_SNAPSHOT_END = 3,
 } fpm_msg_type_e;
 
 /*
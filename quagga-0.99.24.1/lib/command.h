@@ -103,6 +103,8 @@ enum node_type
   DUMP_NODE,			/* Packet dump node. */
   FORWARDING_NODE,		/* IP forwarding node. */
   PROTOCOL_NODE,                /* protocol filtering node */
+  FPM_NODE,			/* Forwarding Plane Manager node. */
+  LOOKUP_NODE,			/* Zebra lookup service node. */
   VTY_NODE,			/* Vty node. */
 };
 
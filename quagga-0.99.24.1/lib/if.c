@@ -35,10 +35,26 @@
 #include "buffer.h"
 #include "str.h"
 #include "log.h"
+#include "hash.h"
 
 /* Master list of interfaces. */
 struct list *iflist;
 
+/* Indexes of iflist by ifindex and by name.  Interfaces with
+   IFINDEX_INTERNAL are not in the ifindex index. */
+static struct hash *if_index_hash;
+static struct hash *if_name_hash;
+
+/* Set once two interfaces have claimed the same ifindex, after which
+   the loser must be looked for again when the winner gives it up. */
+static int if_index_collision;
+
+/* IPv4 address indexes of the connected lists: every address as a host
+   route, and every connected prefix, each node holding a list of the
+   struct connected that share it. */
+static struct route_table *if_addr_table;
+static struct route_table *if_subnet_table;
+
 /* One for each program.  This structure is needed to store hooks. */
 struct if_master
 {
@@ -111,6 +127,86 @@ if_cmp_func (struct interface *ifp1, struct interface *ifp2)
   return 0;
 }
 
+static unsigned int
+if_index_hash_key (void *arg)
+{
+  return ((struct interface *) arg)->ifindex;
+}
+
+static int
+if_index_hash_cmp (const void *a, const void *b)
+{
+  return ((const struct interface *) a)->ifindex
+         == ((const struct interface *) b)->ifindex;
+}
+
+static unsigned int
+if_name_hash_key (void *arg)
+{
+  return string_hash_make (((struct interface *) arg)->name);
+}
+
+static int
+if_name_hash_cmp (const void *a, const void *b)
+{
+  return strcmp (((const struct interface *) a)->name,
+                 ((const struct interface *) b)->name) == 0;
+}
+
+static void
+if_index_hash_add (struct interface *ifp)
+{
+  struct interface *old;
+
+  if (ifp->ifindex == IFINDEX_INTERNAL)
+    return;
+
+  old = hash_lookup (if_index_hash, ifp);
+  if (old == ifp)
+    return;
+  if (old)
+    {
+      hash_release (if_index_hash, old);
+      if_index_collision = 1;
+    }
+  hash_get (if_index_hash, ifp, hash_alloc_intern);
+}
+
+static void
+if_index_hash_del (struct interface *ifp)
+{
+  struct listnode *node;
+  struct interface *other;
+
+  if (ifp->ifindex == IFINDEX_INTERNAL
+      || hash_lookup (if_index_hash, ifp) != ifp)
+    return;
+
+  hash_release (if_index_hash, ifp);
+
+  /* Hand the index to another interface still claiming it. */
+  if (if_index_collision)
+    for (ALL_LIST_ELEMENTS_RO (iflist, node, other))
+      if (other != ifp && other->ifindex == ifp->ifindex)
+        {
+          hash_get (if_index_hash, other, hash_alloc_intern);
+          break;
+        }
+}
+
+/* Change the ifindex of an interface.  All writes of ifindex must go
+   through here to keep if_lookup_by_index() right. */
+void
+if_set_index (struct interface *ifp, unsigned int ifindex)
+{
+  if (ifp->ifindex == ifindex)
+    return;
+
+  if_index_hash_del (ifp);
+  ifp->ifindex = ifindex;
+  if_index_hash_add (ifp);
+}
+
 /* Create new interface structure. */
 struct interface *
 if_create (const char *name, int namelen)
@@ -125,7 +221,10 @@ if_create (const char *name, int namelen)
   strncpy (ifp->name, name, namelen);
   ifp->name[namelen] = '\0';
   if (if_lookup_by_name(ifp->name) == NULL)
-    listnode_add_sort (iflist, ifp);
+    {
+      listnode_add_sort (iflist, ifp);
+      hash_get (if_name_hash, ifp, hash_alloc_intern);
+    }
   else
     zlog_err("if_create(%s): corruption detected -- interface with this "
 	     "name exists already!", ifp->name);
@@ -153,6 +252,9 @@ if_delete_retain (struct interface *ifp)
 void
 if_delete (struct interface *ifp)
 {
+  if_index_hash_del (ifp);
+  if (hash_lookup (if_name_hash, ifp) == ifp)
+    hash_release (if_name_hash, ifp);
   listnode_delete (iflist, ifp);
 
   if_delete_retain(ifp);
@@ -182,15 +284,13 @@ if_add_hook (int type, int (*func)(struct interface *ifp))
 struct interface *
 if_lookup_by_index (unsigned int index)
 {
-  struct listnode *node;
-  struct interface *ifp;
+  struct interface key;
 
-  for (ALL_LIST_ELEMENTS_RO(iflist, node, ifp))
-    {
-      if (ifp->ifindex == index)
-	return ifp;
-    }
-  return NULL;
+  if (index == IFINDEX_INTERNAL)
+    return NULL;
+
+  key.ifindex = index;
+  return hash_lookup (if_index_hash, &key);
 }
 
 const char *
@@ -215,70 +315,53 @@ ifname2ifindex (const char *name)
 struct interface *
 if_lookup_by_name (const char *name)
 {
-  struct listnode *node;
-  struct interface *ifp;
-  
   if (name)
-    for (ALL_LIST_ELEMENTS_RO (iflist, node, ifp))
-      {
-        if (strcmp(name, ifp->name) == 0)
-          return ifp;
-      }
+    return if_lookup_by_name_len (name, strlen (name));
   return NULL;
 }
 
 struct interface *
 if_lookup_by_name_len(const char *name, size_t namelen)
 {
-  struct listnode *node;
-  struct interface *ifp;
+  struct interface key;
 
   if (namelen > INTERFACE_NAMSIZ)
     return NULL;
 
-  for (ALL_LIST_ELEMENTS_RO (iflist, node, ifp))
-    {
-      if (!memcmp(name, ifp->name, namelen) && (ifp->name[namelen] == '\0'))
-	return ifp;
-    }
-  return NULL;
+  memcpy (key.name, name, namelen);
+  key.name[namelen] = '\0';
+  return hash_lookup (if_name_hash, &key);
 }
 
 /* Lookup interface by IPv4 address. */
 struct interface *
 if_lookup_exact_address (struct in_addr src)
 {
-  struct listnode *node;
-  struct listnode *cnode;
-  struct interface *ifp;
-  struct prefix *p;
+  struct prefix_ipv4 p;
+  struct route_node *rn;
   struct connected *c;
 
-  for (ALL_LIST_ELEMENTS_RO (iflist, node, ifp))
-    {
-      for (ALL_LIST_ELEMENTS_RO (ifp->connected, cnode, c))
-	{
-	  p = c->address;
+  p.family = AF_INET;
+  p.prefix = src;
+  p.prefixlen = IPV4_MAX_BITLEN;
 
-	  if (p && p->family == AF_INET)
-	    {
-	      if (IPV4_ADDR_SAME (&p->u.prefix4, &src))
-		return ifp;
-	    }	      
-	}
-    }
-  return NULL;
+  rn = route_node_lookup (if_addr_table, (struct prefix *) &p);
+  if (! rn)
+    return NULL;
+
+  c = listnode_head ((struct list *) rn->info);
+  route_unlock_node (rn);
+  return c ? c->ifp : NULL;
 }
 
 /* Lookup interface by IPv4 address. */
 struct interface *
 if_lookup_address (struct in_addr src)
 {
-  struct listnode *node;
   struct prefix addr;
   int bestlen = 0;
   struct listnode *cnode;
-  struct interface *ifp;
+  struct route_node *rn, *match_rn;
   struct connected *c;
   struct interface *match;
 
@@ -288,19 +371,25 @@ if_lookup_address (struct in_addr src)
 
   match = NULL;
 
-  for (ALL_LIST_ELEMENTS_RO (iflist, node, ifp))
+  /* Every connected prefix covering src is on the path from the best
+     match to the root; the winner is still picked on the length of
+     the local address, which differs for peer addresses. */
+  match_rn = route_node_match (if_subnet_table, &addr);
+  for (rn = match_rn; rn; rn = rn->parent)
     {
-      for (ALL_LIST_ELEMENTS_RO (ifp->connected, cnode, c))
+      if (! rn->info)
+        continue;
+      for (ALL_LIST_ELEMENTS_RO ((struct list *) rn->info, cnode, c))
 	{
-	  if (c->address && (c->address->family == AF_INET) &&
-	      prefix_match(CONNECTED_PREFIX(c), &addr) &&
-	      (c->address->prefixlen > bestlen))
+	  if (c->address->prefixlen > bestlen)
 	    {
 	      bestlen = c->address->prefixlen;
-	      match = ifp;
+	      match = c->ifp;
 	    }
 	}
     }
+  if (match_rn)
+    route_unlock_node (match_rn);
   return match;
 }
 
@@ -647,10 +736,97 @@ connected_new (void)
   return XCALLOC (MTYPE_CONNECTED, sizeof (struct connected));
 }
 
+/* Add an IPv4 connected address to the address indexes. */
+static struct route_node *
+connected_index_get (struct route_table *table, struct prefix *p,
+                     struct connected *ifc)
+{
+  struct route_node *rn;
+
+  rn = route_node_get (table, p);
+  if (rn->info)
+    route_unlock_node (rn);
+  else
+    rn->info = list_new ();
+  listnode_add ((struct list *) rn->info, ifc);
+  return rn;
+}
+
+static void
+connected_index_release (struct route_node *rn, struct connected *ifc)
+{
+  struct list *list = rn->info;
+
+  listnode_delete (list, ifc);
+  if (list->count == 0)
+    {
+      list_delete (list);
+      rn->info = NULL;
+      route_unlock_node (rn);
+    }
+}
+
+static void
+connected_index_add (struct connected *ifc)
+{
+  struct prefix p;
+
+  if (! ifc->address || ifc->address->family != AF_INET || ! if_addr_table)
+    return;
+
+  prefix_copy (&p, ifc->address);
+  p.prefixlen = IPV4_MAX_BITLEN;
+  ifc->addr_node = connected_index_get (if_addr_table, &p, ifc);
+
+  if (CONNECTED_PREFIX (ifc))
+    {
+      prefix_copy (&p, CONNECTED_PREFIX (ifc));
+      apply_mask (&p);
+      ifc->subnet_node = connected_index_get (if_subnet_table, &p, ifc);
+    }
+}
+
+static void
+connected_index_del (struct connected *ifc)
+{
+  if (ifc->addr_node)
+    connected_index_release (ifc->addr_node, ifc);
+  if (ifc->subnet_node)
+    connected_index_release (ifc->subnet_node, ifc);
+  ifc->addr_node = ifc->subnet_node = NULL;
+}
+
+/* Add a connected address to an interface. */
+void
+connected_add (struct interface *ifp, struct connected *ifc)
+{
+  listnode_add (ifp->connected, ifc);
+  connected_index_add (ifc);
+}
+
+/* Remove a connected address from an interface, without freeing it. */
+void
+connected_delete (struct interface *ifp, struct connected *ifc)
+{
+  listnode_delete (ifp->connected, ifc);
+  connected_index_del (ifc);
+}
+
+/* Update the indexes after the flags or destination of a connected
+   address on an interface list have changed. */
+void
+connected_reindex (struct connected *ifc)
+{
+  connected_index_del (ifc);
+  connected_index_add (ifc);
+}
+
 /* Free connected structure. */
 void
 connected_free (struct connected *connected)
 {
+  connected_index_del (connected);
+
   if (connected->address)
     prefix_free (connected->address);
 
@@ -722,7 +898,7 @@ connected_delete_by_prefix (struct interface *ifp, struct prefix *p)
 
       if (connected_same_prefix (ifc->address, p))
 	{
-	  listnode_delete (ifp->connected, ifc);
+	  connected_delete (ifp, ifc);
 	  return ifc;
 	}
     }
@@ -777,7 +953,7 @@ connected_add_by_prefix (struct interface *ifp, struct prefix *p,
     }
 
   /* Add connected address to the interface. */
-  listnode_add (ifp->connected, ifc);
+  connected_add (ifp, ifc);
   return ifc;
 }
 
@@ -889,6 +1065,10 @@ void
 if_init (void)
 {
   iflist = list_new ();
+  if_index_hash = hash_create (if_index_hash_key, if_index_hash_cmp);
+  if_name_hash = hash_create (if_name_hash_key, if_name_hash_cmp);
+  if_addr_table = route_table_init ();
+  if_subnet_table = route_table_init ();
 #if 0
   ifaddr_ipv4_table = route_table_init ();
 #endif /* ifaddr_ipv4_table */
@@ -917,4 +1097,12 @@ if_terminate (void)
 
   list_delete (iflist);
   iflist = NULL;
+
+  hash_free (if_index_hash);
+  hash_free (if_name_hash);
+  route_table_finish (if_addr_table);
+  route_table_finish (if_subnet_table);
+  if_index_hash = if_name_hash = NULL;
+  if_addr_table = if_subnet_table = NULL;
+  if_index_collision = 0;
 }
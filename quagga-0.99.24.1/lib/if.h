@@ -183,6 +183,10 @@ struct connected
 
   /* Label for Linux 2.2.X and upper. */
   char *label;
+
+  /* Nodes holding this address in the IPv4 address indexes of if.c. */
+  struct route_node *addr_node;
+  struct route_node *subnet_node;
 };
 
 /* Does the destination field contain a peer address? */
@@ -243,6 +247,7 @@ struct connected
 extern int if_cmp_func (struct interface *, struct interface *);
 extern struct interface *if_create (const char *name, int namelen);
 extern struct interface *if_lookup_by_index (unsigned int);
+extern void if_set_index (struct interface *, unsigned int);
 extern struct interface *if_lookup_exact_address (struct in_addr);
 extern struct interface *if_lookup_address (struct in_addr);
 extern struct interface *if_lookup_prefix (struct prefix *prefix);
@@ -296,6 +301,8 @@ extern unsigned int ifname2ifindex(const char *ifname);
 extern struct connected *connected_new (void);
 extern void connected_free (struct connected *);
 extern void connected_add (struct interface *, struct connected *);
+extern void connected_delete (struct interface *, struct connected *);
+extern void connected_reindex (struct connected *);
 extern struct connected  *connected_add_by_prefix (struct interface *,
                                             struct prefix *,
                                             struct prefix *);
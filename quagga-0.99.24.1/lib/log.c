@@ -891,6 +891,9 @@ static const struct zebra_desc_table command_types[] = {
   DESC_ENTRY	(ZEBRA_ROUTER_ID_DELETE),
   DESC_ENTRY	(ZEBRA_ROUTER_ID_UPDATE),
   DESC_ENTRY	(ZEBRA_HELLO),
+  DESC_ENTRY	(ZEBRA_IPV4_NEXTHOP_LOOKUP_MRIB),
+  DESC_ENTRY	(ZEBRA_ROUTE_BULK),
+  DESC_ENTRY	(ZEBRA_ROUTE_RING),
 };
 #undef DESC_ENTRY
 
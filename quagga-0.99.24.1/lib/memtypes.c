@@ -63,6 +63,7 @@ struct memory_list memory_list_lib[] =
   { MTYPE_PRIVS,		"Privilege information"		},
   { MTYPE_ZLOG,			"Logging"			},
   { MTYPE_ZCLIENT,		"Zclient"			},
+  { MTYPE_ZRING,		"Zclient route ring"		},
   { MTYPE_WORK_QUEUE,		"Work queue"			},
   { MTYPE_WORK_QUEUE_ITEM,	"Work queue item"		},
   { MTYPE_WORK_QUEUE_NAME,	"Work queue name string"	},
@@ -75,6 +76,7 @@ struct memory_list memory_list_lib[] =
 struct memory_list memory_list_zebra[] = 
 {
   { MTYPE_RTADV_PREFIX,		"Router Advertisement Prefix"	},
+  { MTYPE_RTADV_PACKET,		"Router Advertisement Packet"	},
   { MTYPE_VRF,			"VRF"				},
   { MTYPE_VRF_NAME,		"VRF name"			},
   { MTYPE_NEXTHOP,		"Nexthop"			},
@@ -84,6 +86,11 @@ struct memory_list memory_list_zebra[] =
   { MTYPE_STATIC_IPV6,		"Static IPv6 route"		},
   { MTYPE_RIB_DEST,		"RIB destination"		},
   { MTYPE_RIB_TABLE_INFO,	"RIB table info"		},
+  { MTYPE_ZSERV_PENDING,	"Zserv pending route update"	},
+  { MTYPE_REDIST_DUMP,		"Redistribution dump"		},
+  { MTYPE_REDIST_VRF,		"Redistribution VRF flags"	},
+  { MTYPE_NHG,			"Nexthop group"			},
+  { MTYPE_ZLOOKUP_SNAP,		"Lookup snapshot"		},
   { -1, NULL },
 };
 
@@ -98,14 +105,14 @@ struct memory_list memory_list_bgp[] =
   { MTYPE_PEER_PASSWORD,	"Peer password string"		},
   { MTYPE_ATTR,			"BGP attribute"			},
   { MTYPE_ATTR_EXTRA,		"BGP extra attributes"		},
+  { MTYPE_BGP_ATTR_CACHE,	"BGP attribute cache"		},
   { MTYPE_AS_PATH,		"BGP aspath"			},
   { MTYPE_AS_SEG,		"BGP aspath seg"		},
   { MTYPE_AS_SEG_DATA,		"BGP aspath segment data"	},
   { MTYPE_AS_STR,		"BGP aspath str"		},
   { 0, NULL },
   { MTYPE_BGP_TABLE,		"BGP table"			},
-  { MTYPE_BGP_NODE,		"BGP node"			},
-  { MTYPE_BGP_ROUTE,		"BGP route"			},
+  { MTYPE_BGP_SLAB,		"BGP slab"			},
   { MTYPE_BGP_ROUTE_EXTRA,	"BGP ancillary route info"	},
   { MTYPE_BGP_CONN,		"BGP connected"			},
   { MTYPE_BGP_STATIC,		"BGP static"			},
@@ -115,10 +122,14 @@ struct memory_list memory_list_bgp[] =
   { MTYPE_BGP_ADJ_IN,		"BGP adj in"			},
   { MTYPE_BGP_ADJ_OUT,		"BGP adj out"			},
   { MTYPE_BGP_MPATH_INFO,	"BGP multipath info"		},
+  { MTYPE_BGP_UPDGRP,		"BGP update group"		},
+  { MTYPE_BGP_IO,		"BGP I/O thread"		},
+  { MTYPE_BGP_DUMP_BUF,	"BGP dump buffer"		},
   { 0, NULL },
   { MTYPE_AS_LIST,		"BGP AS list"			},
   { MTYPE_AS_FILTER,		"BGP AS filter"			},
   { MTYPE_AS_FILTER_STR,	"BGP AS filter str"		},
+  { MTYPE_AS_FILTER_CACHE,	"BGP AS filter cache"		},
   { 0, NULL },
   { MTYPE_COMMUNITY,		"community"			},
   { MTYPE_COMMUNITY_VAL,	"community val"			},
@@ -138,6 +149,7 @@ struct memory_list memory_list_bgp[] =
   { MTYPE_CLUSTER_VAL,		"Cluster list val"		},
   { 0, NULL },
   { MTYPE_BGP_PROCESS_QUEUE,	"BGP Process queue"		},
+  { MTYPE_BGP_PROCESS_BATCH,	"BGP Process batch"		},
   { MTYPE_BGP_CLEAR_NODE_QUEUE, "BGP node clear queue"		},
   { 0, NULL },
   { MTYPE_TRANSIT,		"BGP transit attr"		},
@@ -150,6 +162,7 @@ struct memory_list memory_list_bgp[] =
   { MTYPE_BGP_DAMP_INFO,	"Dampening info"		},
   { MTYPE_BGP_DAMP_ARRAY,	"BGP Dampening array"		},
   { MTYPE_BGP_REGEXP,		"BGP regexp"			},
+  { MTYPE_BGP_ASREGEX,	"BGP AS path regexp"		},
   { MTYPE_BGP_AGGREGATE,	"BGP aggregate"			},
   { MTYPE_BGP_ADDR,		"BGP own address"		},
   { -1, NULL }
@@ -211,6 +224,11 @@ struct memory_list memory_list_ospf[] =
   { MTYPE_OSPF_IF_INFO,       "OSPF if info"			},
   { MTYPE_OSPF_IF_PARAMS,     "OSPF if params"			},
   { MTYPE_OSPF_MESSAGE,		"OSPF message"			},
+  { MTYPE_OSPF_GR_IF,         "OSPF GR interface"		},
+  { MTYPE_OSPF_HLPR_NBR,      "OSPF GR helper nbr"		},
+  { MTYPE_OSPF_OPAQUE_FUNCTAB,"OSPF opaque functab"		},
+  { MTYPE_OPAQUE_INFO_PER_TYPE,"OSPF opaque per-type info"	},
+  { MTYPE_OPAQUE_INFO_PER_ID, "OSPF opaque per-ID info"		},
   { -1, NULL },
 };
 
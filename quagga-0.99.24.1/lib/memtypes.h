@@ -57,6 +57,7 @@ enum
   MTYPE_PRIVS,
   MTYPE_ZLOG,
   MTYPE_ZCLIENT,
+  MTYPE_ZRING,
   MTYPE_WORK_QUEUE,
   MTYPE_WORK_QUEUE_ITEM,
   MTYPE_WORK_QUEUE_NAME,
@@ -64,6 +65,7 @@ enum
   MTYPE_PQUEUE_DATA,
   MTYPE_HOST,
   MTYPE_RTADV_PREFIX,
+  MTYPE_RTADV_PACKET,
   MTYPE_VRF,
   MTYPE_VRF_NAME,
   MTYPE_NEXTHOP,
@@ -73,6 +75,11 @@ enum
   MTYPE_STATIC_IPV6,
   MTYPE_RIB_DEST,
   MTYPE_RIB_TABLE_INFO,
+  MTYPE_ZSERV_PENDING,
+  MTYPE_REDIST_DUMP,
+  MTYPE_REDIST_VRF,
+  MTYPE_NHG,
+  MTYPE_ZLOOKUP_SNAP,
   MTYPE_BGP,
   MTYPE_BGP_LISTENER,
   MTYPE_BGP_PEER,
@@ -82,13 +89,13 @@ enum
   MTYPE_PEER_PASSWORD,
   MTYPE_ATTR,
   MTYPE_ATTR_EXTRA,
+  MTYPE_BGP_ATTR_CACHE,
   MTYPE_AS_PATH,
   MTYPE_AS_SEG,
   MTYPE_AS_SEG_DATA,
   MTYPE_AS_STR,
   MTYPE_BGP_TABLE,
-  MTYPE_BGP_NODE,
-  MTYPE_BGP_ROUTE,
+  MTYPE_BGP_SLAB,
   MTYPE_BGP_ROUTE_EXTRA,
   MTYPE_BGP_CONN,
   MTYPE_BGP_STATIC,
@@ -98,9 +105,13 @@ enum
   MTYPE_BGP_ADJ_IN,
   MTYPE_BGP_ADJ_OUT,
   MTYPE_BGP_MPATH_INFO,
+  MTYPE_BGP_UPDGRP,
+  MTYPE_BGP_IO,
+  MTYPE_BGP_DUMP_BUF,
   MTYPE_AS_LIST,
   MTYPE_AS_FILTER,
   MTYPE_AS_FILTER_STR,
+  MTYPE_AS_FILTER_CACHE,
   MTYPE_COMMUNITY,
   MTYPE_COMMUNITY_VAL,
   MTYPE_COMMUNITY_STR,
@@ -115,6 +126,7 @@ enum
   MTYPE_CLUSTER,
   MTYPE_CLUSTER_VAL,
   MTYPE_BGP_PROCESS_QUEUE,
+  MTYPE_BGP_PROCESS_BATCH,
   MTYPE_BGP_CLEAR_NODE_QUEUE,
   MTYPE_TRANSIT,
   MTYPE_TRANSIT_VAL,
@@ -125,6 +137,7 @@ enum
   MTYPE_BGP_DAMP_INFO,
   MTYPE_BGP_DAMP_ARRAY,
   MTYPE_BGP_REGEXP,
+  MTYPE_BGP_ASREGEX,
   MTYPE_BGP_AGGREGATE,
   MTYPE_BGP_ADDR,
   MTYPE_RIP,
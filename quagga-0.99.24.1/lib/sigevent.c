@@ -363,3 +363,22 @@ signal_init (struct thread_master *m, int sigc,
                       QUAGGA_SIGNAL_TIMER_INTERVAL);
 #endif /* SIGEVENT_SCHEDULE_THREAD */
 }
+
+#ifdef HAVE_PTHREAD
+/* Start a POSIX thread running func (arg) with all signals blocked,
+ * so that they are still handled by the main thread only.  Returns
+ * what pthread_create() does.
+ */
+int
+quagga_pthread_create (pthread_t *thread, void *(*func) (void *), void *arg)
+{
+  sigset_t all, old;
+  int ret;
+
+  sigfillset (&all);
+  pthread_sigmask (SIG_BLOCK, &all, &old);
+  ret = pthread_create (thread, NULL, func, arg);
+  pthread_sigmask (SIG_SETMASK, &old, NULL);
+  return ret;
+}
+#endif /* HAVE_PTHREAD */
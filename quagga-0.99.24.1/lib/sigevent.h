@@ -25,6 +25,9 @@
 #define _QUAGGA_SIGNAL_H
 
 #include <thread.h>
+#ifdef HAVE_PTHREAD
+#include <pthread.h>
+#endif /* HAVE_PTHREAD */
 
 #define QUAGGA_SIGNAL_TIMER_INTERVAL 2L
 
@@ -49,4 +52,9 @@ extern void signal_init (struct thread_master *m, int sigc,
 /* check whether there are signals to handle, process any found */
 extern int quagga_sigevent_process (void);
 
+#ifdef HAVE_PTHREAD
+/* start a thread that leaves signals to the main thread */
+extern int quagga_pthread_create (pthread_t *, void *(*) (void *), void *);
+#endif /* HAVE_PTHREAD */
+
 #endif /* _QUAGGA_SIGNAL_H */
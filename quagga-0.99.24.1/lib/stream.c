@@ -111,15 +111,27 @@ stream_new (size_t size)
     }
   
   s->size = size;
+  s->refcnt = 1;
   return s;
 }
 
-/* Free it now. */
+/* Free it now, or drop one reference to shared data. */
 void
 stream_free (struct stream *s)
 {
   if (!s)
     return;
+
+  if (s->origin)
+    {
+      struct stream *origin = s->origin;
+
+      XFREE (MTYPE_STREAM, s);
+      s = origin;
+    }
+
+  if (--s->refcnt > 0)
+    return;
   
   XFREE (MTYPE_STREAM_DATA, s->data);
   XFREE (MTYPE_STREAM, s);
@@ -154,6 +166,30 @@ stream_dup (struct stream *s)
   return (stream_copy (new, s));
 }
 
+/* Make a read-only copy of a stream which shares its data instead of
+   duplicating it.  Each copy has its own getp, so several readers can
+   consume the same data at their own pace. */
+struct stream *
+stream_share (struct stream *s)
+{
+  struct stream *new;
+
+  STREAM_VERIFY_SANE (s);
+
+  if (s->origin)
+    s = s->origin;
+
+  new = XCALLOC (MTYPE_STREAM, sizeof (struct stream));
+  new->data = s->data;
+  new->size = s->size;
+  new->endp = s->endp;
+  new->getp = s->getp;
+  new->origin = s;
+  s->refcnt++;
+
+  return new;
+}
+
 struct stream *
 stream_dupcat (struct stream *s1, struct stream *s2, size_t offset)
 {
@@ -178,6 +214,7 @@ stream_resize (struct stream *s, size_t newsize)
 {
   u_char *newdata;
   STREAM_VERIFY_SANE (s);
+  assert (s->origin == NULL && s->refcnt == 1);
   
   newdata = XREALLOC (MTYPE_STREAM_DATA, s->data, newsize);
   
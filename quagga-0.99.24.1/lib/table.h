@@ -79,14 +79,15 @@ struct route_table
   struct route_node *parent;			\
   struct route_node *link[2];			\
 						\
-  /* Lock of this radix */			\
-  unsigned int lock;				\
-						\
   /* Each node of route. */			\
   void *info;					\
 						\
   /* Aggregation. */				\
-  void *aggregate;
+  void *aggregate;				\
+						\
+  /* Lock of this radix, last, so that a node	\
+     extending it can use the padding. */	\
+  unsigned int lock;
 
 
 /* Each routing entry. */
@@ -203,6 +203,8 @@ DEFUN(show_work_queues,
                    (unsigned int) (wq->cycles.total / wq->runs) : 0,
                wq->name,
                VTY_NEWLINE);
+      if (wq->spec.show_func)
+        wq->spec.show_func (vty, wq);
     }
     
   return CMD_SUCCESS;
@@ -24,6 +24,8 @@
 #ifndef _QUAGGA_WORK_QUEUE_H
 #define _QUAGGA_WORK_QUEUE_H
 
+struct vty;
+
 /* Hold time for the initial schedule of a queue run, in  millisec */
 #define WORK_QUEUE_DEFAULT_HOLD  50 
 
@@ -79,6 +81,10 @@ struct work_queue
     
     /* completion callback, called when queue is emptied, optional */
     void (*completion_func) (struct work_queue *);
+
+    /* callback to show more about the queue in "show work-queues",
+     * optional */
+    void (*show_func) (struct vty *, struct work_queue *);
     
     /* max number of retries to make for item that errors */
     unsigned int max_retries;	
@@ -32,6 +32,7 @@
 #include "zclient.h"
 #include "memory.h"
 #include "table.h"
+#include "zring.h"
 
 /* Zebra client events. */
 enum event {ZCLIENT_SCHEDULE, ZCLIENT_READ, ZCLIENT_CONNECT};
@@ -43,6 +44,9 @@ extern struct thread_master *master;
 
 char *zclient_serv_path = NULL;
 
+/* Route ring size requested for new zclients, 0 to disable. */
+static u_int32_t zclient_ring_slots = 0;
+
 /* This file local debug flag. */
 int zclient_debug = 0;
 
@@ -55,7 +59,9 @@ zclient_new ()
 
   zclient->ibuf = stream_new (ZEBRA_MAX_PACKET_SIZ);
   zclient->obuf = stream_new (ZEBRA_MAX_PACKET_SIZ);
+  zclient->bulk = stream_new (ZEBRA_MAX_PACKET_SIZ);
   zclient->wb = buffer_new(0);
+  zclient->ring_slots = zclient_ring_slots;
 
   return zclient;
 }
@@ -72,6 +78,8 @@ zclient_free (struct zclient *zclient)
     stream_free(zclient->ibuf);
   if (zclient->obuf)
     stream_free(zclient->obuf);
+  if (zclient->bulk)
+    stream_free(zclient->bulk);
   if (zclient->wb)
     buffer_free(zclient->wb);
 
@@ -121,10 +129,26 @@ zclient_stop (struct zclient *zclient)
   THREAD_OFF(zclient->t_read);
   THREAD_OFF(zclient->t_connect);
   THREAD_OFF(zclient->t_write);
+  THREAD_OFF(zclient->t_bulk);
 
   /* Reset streams. */
   stream_reset(zclient->ibuf);
   stream_reset(zclient->obuf);
+  stream_reset(zclient->bulk);
+  zclient->bulk_count = 0;
+
+  /* Bulk support is negotiated again on the next connection. */
+  zclient->bulk_version = 0;
+
+#ifdef HAVE_ZEBRA_RING
+  /* The ring is only meaningful to the zebra that accepted it. */
+  if (zclient->ring)
+    {
+      zring_free (zclient->ring);
+      zclient->ring = NULL;
+    }
+#endif /* HAVE_ZEBRA_RING */
+  zclient->msg_sent = 0;
 
   /* Empty the write buffer. */
   buffer_reset(zclient->wb);
@@ -234,6 +258,27 @@ zclient_socket_connect (struct zclient *zclient)
   return zclient->sock;
 }
 
+/**
+ * Connect to the socket zebra answers nexthop lookups on, or to its
+ * zserv socket if there is none.
+ * @param zclient a pointer to zclient structure
+ * @return socket fd just to make sure that connection established
+ */
+int
+zclient_lookup_socket_connect (struct zclient *zclient)
+{
+#ifndef HAVE_TCP_ZEBRA
+  char path[sizeof (((struct sockaddr_un *) 0)->sun_path)];
+
+  snprintf (path, sizeof (path), "%s%s", zclient_serv_path_get (),
+            ZEBRA_LOOKUP_SUFFIX);
+  zclient->sock = zclient_socket_un (path);
+  if (zclient->sock >= 0)
+    return zclient->sock;
+#endif /* HAVE_TCP_ZEBRA */
+  return zclient_socket_connect (zclient);
+}
+
 static int
 zclient_failed(struct zclient *zclient)
 {
@@ -268,13 +313,14 @@ zclient_flush_data(struct thread *thread)
   return 0;
 }
 
-int
-zclient_send_message(struct zclient *zclient)
+static int
+zclient_write_stream (struct zclient *zclient, struct stream *s)
 {
   if (zclient->sock < 0)
     return -1;
-  switch (buffer_write(zclient->wb, zclient->sock, STREAM_DATA(zclient->obuf),
-		       stream_get_endp(zclient->obuf)))
+  zclient->msg_sent++;
+  switch (buffer_write(zclient->wb, zclient->sock, STREAM_DATA(s),
+		       stream_get_endp(s)))
     {
     case BUFFER_ERROR:
       zlog_warn("%s: buffer_write failed to zclient fd %d, closing",
@@ -292,6 +338,15 @@ zclient_send_message(struct zclient *zclient)
   return 0;
 }
 
+int
+zclient_send_message(struct zclient *zclient)
+{
+  /* Routes coalesced earlier must reach zebra before this message. */
+  if (zclient_bulk_flush (zclient) < 0)
+    return -1;
+  return zclient_write_stream (zclient, zclient->obuf);
+}
+
 void
 zclient_create_header (struct stream *s, uint16_t command)
 {
@@ -302,6 +357,25 @@ zclient_create_header (struct stream *s, uint16_t command)
   stream_putw (s, command);
 }
 
+/* Same for a message about the given VRF.  The default VRF keeps the
+   plain header older zebras understand. */
+void
+zclient_create_header_vrf (struct stream *s, uint16_t command,
+                           u_int16_t vrf_id)
+{
+  if (! vrf_id)
+    {
+      zclient_create_header (s, command);
+      return;
+    }
+
+  stream_putw (s, ZEBRA_VRF_HEADER_SIZE);
+  stream_putc (s, ZEBRA_HEADER_MARKER);
+  stream_putc (s, ZSERV_VERSION_VRF);
+  stream_putw (s, command);
+  stream_putw (s, vrf_id);
+}
+
 /* Send simple Zebra message. */
 static int
 zebra_message_send (struct zclient *zclient, int command)
@@ -330,6 +404,7 @@ zebra_hello_send (struct zclient *zclient)
 
       zclient_create_header (s, ZEBRA_HELLO);
       stream_putc (s, zclient->redist_default);
+      stream_putc (s, ZAPI_BULK_VERSION);
       stream_putw_at (s, 0, stream_get_endp (s));
       return zclient_send_message(zclient);
     }
@@ -414,6 +489,321 @@ zclient_connect (struct thread *t)
   return zclient_start (zclient);
 }
 
+ /*
+  * ZEBRA_ROUTE_BULK carries any number of IPv4 or IPv6 prefixes that
+  * share the same route type, flags, nexthops, distance and metric.
+  * Once zebra has answered our ZEBRA_HELLO with a non-zero bulk
+  * version, zapi_ipv4_route() and zapi_ipv6_route() coalesce
+  * consecutive routes with identical attributes into one pending
+  * message, which is sent when the attributes or the command change,
+  * when it is full, before any other message, or from an event thread
+  * once the caller returns to the event loop.
+  *
+  *  0 1 2 3 4 5 6 7 8 9 A B C D E F 0 1 2 3 4 5 6 7 8 9 A B C D E F
+  * +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+  * | Bulk version  | Route command (ZEBRA_IPV*_ROUTE_*)| Attr len  :
+  * +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+  * :   | Route Type, ZEBRA Flags, Message Flags, SAFI, nexthops,   :
+  * +-+-+  distance and metric as in the single route message       :
+  * :                                                               |
+  * +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+  * |         Prefix count          |
+  * +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+  * | Prefix length | Destination prefix, PSIZE(length) bytes       :
+  * +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+  *
+  * The last two fields are repeated for each prefix.  The attribute
+  * block is encoded in zclient->obuf first so that it can be compared
+  * byte for byte with the block of the pending message.
+  */
+int
+zclient_bulk_flush (struct zclient *zclient)
+{
+  struct stream *s = zclient->bulk;
+  uint16_t alen;
+  int ret;
+
+  THREAD_OFF (zclient->t_bulk);
+
+  if (! zclient->bulk_count)
+    return 0;
+
+  alen = stream_getw_from (s, ZEBRA_HEADER_SIZE + 3);
+  stream_putw_at (s, ZEBRA_HEADER_SIZE + ZAPI_BULK_HEADER_SIZE + alen,
+                  zclient->bulk_count);
+  stream_putw_at (s, 0, stream_get_endp (s));
+
+  if (zclient_debug)
+    zlog_debug ("zclient sending %s bulk with %u prefixes",
+                zserv_command_string (zclient->bulk_cmd), zclient->bulk_count);
+
+  zclient->bulk_count = 0;
+  ret = zclient_write_stream (zclient, s);
+  stream_reset (s);
+  return ret;
+}
+
+static int
+zclient_bulk_flush_event (struct thread *t)
+{
+  struct zclient *zclient = THREAD_ARG (t);
+
+  zclient->t_bulk = NULL;
+#ifdef HAVE_ZEBRA_RING
+  if (zclient->ring)
+    zring_doorbell (zclient->ring);
+#endif /* HAVE_ZEBRA_RING */
+  return zclient_bulk_flush (zclient);
+}
+
+#ifdef HAVE_ZEBRA_RING
+/*
+ * The shared-memory route ring is an optional alternative to the socket
+ * for route add and delete.  When zebra's ZEBRA_HELLO reply offers it
+ * and ring_slots is set, the client creates a memfd ring and an eventfd
+ * doorbell and passes both to zebra in a ZEBRA_ROUTE_RING message:
+ *
+ * +-+-+-+-+-+-+-+-+
+ * | Ring version  |  plus SCM_RIGHTS {ring memfd, doorbell eventfd}
+ * +-+-+-+-+-+-+-+-+
+ *
+ * Routes are then written as fixed-layout struct zring_route records
+ * that zebra consumes in place.  Each record carries the number of
+ * socket messages sent before it, and zebra does not process a record
+ * before it has read that many messages, so routes that still go over
+ * the socket (ring full, too many nexthops) stay in order.  The doorbell
+ * is rung once per event loop pass rather than per route.
+ */
+static void
+zclient_ring_start (struct zclient *zclient)
+{
+  struct zring *ring;
+  struct stream *s;
+  struct msghdr msg;
+  struct iovec iov;
+  struct cmsghdr *cmsg;
+  char cbuf[CMSG_SPACE (2 * sizeof (int))];
+  int fds[2];
+  ssize_t nbytes;
+
+  /* The descriptors must ride on the first byte of the message. */
+  if (zclient_bulk_flush (zclient) < 0 || ! buffer_empty (zclient->wb))
+    {
+      if (zclient_debug)
+        zlog_debug ("zclient output pending, not using the route ring");
+      return;
+    }
+
+  if ((ring = zring_create (zclient->ring_slots)) == NULL)
+    return;
+
+  s = zclient->obuf;
+  stream_reset (s);
+  zclient_create_header (s, ZEBRA_ROUTE_RING);
+  stream_putc (s, ZRING_VERSION);
+  stream_putw_at (s, 0, stream_get_endp (s));
+
+  memset (&msg, 0, sizeof (msg));
+  iov.iov_base = STREAM_DATA (s);
+  iov.iov_len = stream_get_endp (s);
+  msg.msg_iov = &iov;
+  msg.msg_iovlen = 1;
+  msg.msg_control = cbuf;
+  msg.msg_controllen = sizeof (cbuf);
+
+  fds[0] = ring->fd;
+  fds[1] = ring->doorbell;
+  cmsg = CMSG_FIRSTHDR (&msg);
+  cmsg->cmsg_level = SOL_SOCKET;
+  cmsg->cmsg_type = SCM_RIGHTS;
+  cmsg->cmsg_len = CMSG_LEN (sizeof (fds));
+  memcpy (CMSG_DATA (cmsg), fds, sizeof (fds));
+
+  nbytes = sendmsg (zclient->sock, &msg, 0);
+  if (nbytes <= 0)
+    {
+      zlog_warn ("%s: sendmsg failed on zclient fd %d: %s", __func__,
+                 zclient->sock, safe_strerror (errno));
+      zring_free (ring);
+      return;
+    }
+
+  zclient->msg_sent++;
+  zclient->ring = ring;
+
+  /* Queue whatever the kernel did not take with the descriptors. */
+  if ((size_t) nbytes < iov.iov_len)
+    buffer_write (zclient->wb, zclient->sock, STREAM_DATA (s) + nbytes,
+                  iov.iov_len - nbytes);
+
+  if (zclient_debug)
+    zlog_debug ("zclient route ring started with %u slots", ring->slots);
+}
+
+/* Fill in the common part of the next ring record.  Returns NULL if
+   the route has to go over the socket instead. */
+static struct zring_route *
+zclient_ring_reserve (struct zclient *zclient, u_char cmd, struct prefix *p,
+                      u_char type, u_char flags, u_char message, safi_t safi,
+                      u_char distance, u_int32_t metric)
+{
+  struct zring_route *rec;
+
+  /* Coalesced routes were queued first and must reach zebra first.
+     A failed flush closes the connection and frees the ring. */
+  if (zclient_bulk_flush (zclient) < 0 || ! zclient->ring)
+    return NULL;
+
+  if ((rec = zring_reserve (zclient->ring)) == NULL)
+    {
+      zring_doorbell (zclient->ring);
+      return NULL;
+    }
+
+  rec->seq = zclient->msg_sent;
+  rec->cmd = cmd;
+  rec->safi = safi;
+  rec->type = type;
+  rec->flags = flags;
+  rec->message = message;
+  rec->prefixlen = p->prefixlen;
+  memcpy (&rec->prefix, &p->u.prefix, PSIZE (p->prefixlen));
+  if (CHECK_FLAG (message, ZAPI_MESSAGE_DISTANCE))
+    rec->distance = distance;
+  if (CHECK_FLAG (message, ZAPI_MESSAGE_METRIC))
+    rec->metric = metric;
+  return rec;
+}
+
+static int
+zclient_ring_commit (struct zclient *zclient)
+{
+  zring_commit (zclient->ring);
+  if (! zclient->t_bulk)
+    zclient->t_bulk = thread_add_event (master, zclient_bulk_flush_event,
+                                        zclient, 0);
+  return 0;
+}
+
+static int
+zapi_ipv4_ring (u_char cmd, struct zclient *zclient, struct prefix_ipv4 *p,
+                struct zapi_ipv4 *api)
+{
+  struct zring_route *rec;
+  int i;
+
+  if (CHECK_FLAG (api->message, ZAPI_MESSAGE_NEXTHOP)
+      && api->nexthop_num + api->ifindex_num > ZRING_NEXTHOP_MAX)
+    return 1;
+
+  rec = zclient_ring_reserve (zclient, cmd, (struct prefix *) p, api->type,
+                              api->flags, api->message, api->safi,
+                              api->distance, api->metric);
+  if (rec == NULL)
+    return zclient->sock < 0 ? -1 : 1;
+  if (CHECK_FLAG (api->message, ZAPI_MESSAGE_NEXTHOP))
+    {
+      if (CHECK_FLAG (api->flags, ZEBRA_FLAG_BLACKHOLE))
+        rec->nexthop[rec->nexthop_num++].type = ZEBRA_NEXTHOP_BLACKHOLE;
+      else
+        {
+          for (i = 0; i < api->nexthop_num; i++)
+            {
+              rec->nexthop[rec->nexthop_num].type = ZEBRA_NEXTHOP_IPV4;
+              rec->nexthop[rec->nexthop_num++].gate.ipv4 = *api->nexthop[i];
+            }
+          for (i = 0; i < api->ifindex_num; i++)
+            {
+              rec->nexthop[rec->nexthop_num].type = ZEBRA_NEXTHOP_IFINDEX;
+              rec->nexthop[rec->nexthop_num++].ifindex = api->ifindex[i];
+            }
+        }
+    }
+  return zclient_ring_commit (zclient);
+}
+
+#ifdef HAVE_IPV6
+static int
+zapi_ipv6_ring (u_char cmd, struct zclient *zclient, struct prefix_ipv6 *p,
+                struct zapi_ipv6 *api)
+{
+  struct zring_route *rec;
+  int i;
+
+  if (CHECK_FLAG (api->message, ZAPI_MESSAGE_NEXTHOP)
+      && api->nexthop_num + api->ifindex_num > ZRING_NEXTHOP_MAX)
+    return 1;
+
+  rec = zclient_ring_reserve (zclient, cmd, (struct prefix *) p, api->type,
+                              api->flags, api->message, api->safi,
+                              api->distance, api->metric);
+  if (rec == NULL)
+    return zclient->sock < 0 ? -1 : 1;
+  if (CHECK_FLAG (api->message, ZAPI_MESSAGE_NEXTHOP))
+    {
+      for (i = 0; i < api->nexthop_num; i++)
+        {
+          rec->nexthop[rec->nexthop_num].type = ZEBRA_NEXTHOP_IPV6;
+          rec->nexthop[rec->nexthop_num++].gate.ipv6 = *api->nexthop[i];
+        }
+      for (i = 0; i < api->ifindex_num; i++)
+        {
+          rec->nexthop[rec->nexthop_num].type = ZEBRA_NEXTHOP_IFINDEX;
+          rec->nexthop[rec->nexthop_num++].ifindex = api->ifindex[i];
+        }
+    }
+  return zclient_ring_commit (zclient);
+}
+#endif /* HAVE_IPV6 */
+#endif /* HAVE_ZEBRA_RING */
+
+/* Queue prefix p with the attribute block in zclient->obuf.  Returns 0
+   if the route was queued, 1 if it must be sent as a single route
+   message instead, or -1 on an I/O error. */
+static int
+zclient_bulk_route (struct zclient *zclient, u_char cmd, struct prefix *p)
+{
+  struct stream *s = zclient->bulk;
+  size_t alen = stream_get_endp (zclient->obuf);
+  size_t psize = PSIZE (p->prefixlen);
+
+  if (ZEBRA_HEADER_SIZE + ZAPI_BULK_HEADER_SIZE + alen + 2 + 1 + psize
+      > STREAM_SIZE (s))
+    return 1;
+
+  if (zclient->bulk_count
+      && (zclient->bulk_cmd != cmd
+          || zclient->bulk_count == UINT16_MAX
+          || STREAM_WRITEABLE (s) < 1 + psize
+          || stream_getw_from (s, ZEBRA_HEADER_SIZE + 3) != alen
+          || memcmp (STREAM_DATA (s) + ZEBRA_HEADER_SIZE
+                     + ZAPI_BULK_HEADER_SIZE,
+                     STREAM_DATA (zclient->obuf), alen)))
+    if (zclient_bulk_flush (zclient) < 0)
+      return -1;
+
+  if (! zclient->bulk_count)
+    {
+      stream_reset (s);
+      zclient_create_header (s, ZEBRA_ROUTE_BULK);
+      stream_putc (s, zclient->bulk_version);
+      stream_putw (s, cmd);
+      stream_putw (s, alen);
+      stream_put (s, STREAM_DATA (zclient->obuf), alen);
+      stream_putw (s, 0); /* prefix count placeholder */
+      zclient->bulk_cmd = cmd;
+    }
+
+  stream_putc (s, p->prefixlen);
+  stream_write (s, (u_char *) &p->u.prefix, psize);
+  zclient->bulk_count++;
+
+  if (! zclient->t_bulk)
+    zclient->t_bulk = thread_add_event (master, zclient_bulk_flush_event,
+                                        zclient, 0);
+  return 0;
+}
+
  /* 
   * "xdr_encode"-like interface that allows daemon (client) to send
   * a message to zebra server for a route that needs to be
@@ -458,30 +848,10 @@ zclient_connect (struct thread *t)
   *
   * XXX: No attention paid to alignment.
   */ 
-int
-zapi_ipv4_route (u_char cmd, struct zclient *zclient, struct prefix_ipv4 *p,
-                 struct zapi_ipv4 *api)
+static void
+zapi_ipv4_attr_put (struct stream *s, struct zapi_ipv4 *api)
 {
   int i;
-  int psize;
-  struct stream *s;
-
-  /* Reset stream. */
-  s = zclient->obuf;
-  stream_reset (s);
-  
-  zclient_create_header (s, cmd);
-  
-  /* Put type and nexthop. */
-  stream_putc (s, api->type);
-  stream_putc (s, api->flags);
-  stream_putc (s, api->message);
-  stream_putw (s, api->safi);
-
-  /* Put prefix information. */
-  psize = PSIZE (p->prefixlen);
-  stream_putc (s, p->prefixlen);
-  stream_write (s, (u_char *) & p->prefix, psize);
 
   /* Nexthop, ifindex, distance and metric information. */
   if (CHECK_FLAG (api->message, ZAPI_MESSAGE_NEXTHOP))
@@ -512,38 +882,81 @@ zapi_ipv4_route (u_char cmd, struct zclient *zclient, struct prefix_ipv4 *p,
     stream_putc (s, api->distance);
   if (CHECK_FLAG (api->message, ZAPI_MESSAGE_METRIC))
     stream_putl (s, api->metric);
+}
 
-  /* Put length at the first point of the stream. */
-  stream_putw_at (s, 0, stream_get_endp (s));
-
-  return zclient_send_message(zclient);
+int
+zapi_ipv4_route (u_char cmd, struct zclient *zclient, struct prefix_ipv4 *p,
+                 struct zapi_ipv4 *api)
+{
+  return zapi_ipv4_route_vrf (cmd, zclient, p, api, 0);
 }
 
-#ifdef HAVE_IPV6
+/* The route ring and bulk messages only carry default VRF routes. */
 int
-zapi_ipv6_route (u_char cmd, struct zclient *zclient, struct prefix_ipv6 *p,
-	       struct zapi_ipv6 *api)
+zapi_ipv4_route_vrf (u_char cmd, struct zclient *zclient,
+                     struct prefix_ipv4 *p, struct zapi_ipv4 *api,
+                     u_int16_t vrf_id)
 {
-  int i;
+  int ret;
   int psize;
   struct stream *s;
 
+#ifdef HAVE_ZEBRA_RING
+  if (zclient->ring && ! vrf_id
+      && (cmd == ZEBRA_IPV4_ROUTE_ADD || cmd == ZEBRA_IPV4_ROUTE_DELETE))
+    {
+      ret = zapi_ipv4_ring (cmd, zclient, p, api);
+      if (ret <= 0)
+        return ret;
+    }
+#endif /* HAVE_ZEBRA_RING */
+
   /* Reset stream. */
   s = zclient->obuf;
   stream_reset (s);
 
-  zclient_create_header (s, cmd);
-
+  /* Coalesce into a bulk message if zebra supports it. */
+  if (zclient->bulk_version && ! vrf_id
+      && (cmd == ZEBRA_IPV4_ROUTE_ADD || cmd == ZEBRA_IPV4_ROUTE_DELETE))
+    {
+      stream_putc (s, api->type);
+      stream_putc (s, api->flags);
+      stream_putc (s, api->message);
+      stream_putw (s, api->safi);
+      zapi_ipv4_attr_put (s, api);
+
+      ret = zclient_bulk_route (zclient, cmd, (struct prefix *) p);
+      if (ret <= 0)
+        return ret;
+      stream_reset (s);
+    }
+  
+  zclient_create_header_vrf (s, cmd, vrf_id);
+  
   /* Put type and nexthop. */
   stream_putc (s, api->type);
   stream_putc (s, api->flags);
   stream_putc (s, api->message);
   stream_putw (s, api->safi);
-  
+
   /* Put prefix information. */
   psize = PSIZE (p->prefixlen);
   stream_putc (s, p->prefixlen);
-  stream_write (s, (u_char *)&p->prefix, psize);
+  stream_write (s, (u_char *) & p->prefix, psize);
+
+  zapi_ipv4_attr_put (s, api);
+
+  /* Put length at the first point of the stream. */
+  stream_putw_at (s, 0, stream_get_endp (s));
+
+  return zclient_send_message(zclient);
+}
+
+#ifdef HAVE_IPV6
+static void
+zapi_ipv6_attr_put (struct stream *s, struct zapi_ipv6 *api)
+{
+  int i;
 
   /* Nexthop, ifindex, distance and metric information. */
   if (CHECK_FLAG (api->message, ZAPI_MESSAGE_NEXTHOP))
@@ -566,6 +979,69 @@ zapi_ipv6_route (u_char cmd, struct zclient *zclient, struct prefix_ipv6 *p,
     stream_putc (s, api->distance);
   if (CHECK_FLAG (api->message, ZAPI_MESSAGE_METRIC))
     stream_putl (s, api->metric);
+}
+
+int
+zapi_ipv6_route (u_char cmd, struct zclient *zclient, struct prefix_ipv6 *p,
+                 struct zapi_ipv6 *api)
+{
+  return zapi_ipv6_route_vrf (cmd, zclient, p, api, 0);
+}
+
+/* The route ring and bulk messages only carry default VRF routes. */
+int
+zapi_ipv6_route_vrf (u_char cmd, struct zclient *zclient,
+                     struct prefix_ipv6 *p, struct zapi_ipv6 *api,
+                     u_int16_t vrf_id)
+{
+  int ret;
+  int psize;
+  struct stream *s;
+
+#ifdef HAVE_ZEBRA_RING
+  if (zclient->ring && ! vrf_id
+      && (cmd == ZEBRA_IPV6_ROUTE_ADD || cmd == ZEBRA_IPV6_ROUTE_DELETE))
+    {
+      ret = zapi_ipv6_ring (cmd, zclient, p, api);
+      if (ret <= 0)
+        return ret;
+    }
+#endif /* HAVE_ZEBRA_RING */
+
+  /* Reset stream. */
+  s = zclient->obuf;
+  stream_reset (s);
+
+  /* Coalesce into a bulk message if zebra supports it. */
+  if (zclient->bulk_version && ! vrf_id
+      && (cmd == ZEBRA_IPV6_ROUTE_ADD || cmd == ZEBRA_IPV6_ROUTE_DELETE))
+    {
+      stream_putc (s, api->type);
+      stream_putc (s, api->flags);
+      stream_putc (s, api->message);
+      stream_putw (s, api->safi);
+      zapi_ipv6_attr_put (s, api);
+
+      ret = zclient_bulk_route (zclient, cmd, (struct prefix *) p);
+      if (ret <= 0)
+        return ret;
+      stream_reset (s);
+    }
+
+  zclient_create_header_vrf (s, cmd, vrf_id);
+
+  /* Put type and nexthop. */
+  stream_putc (s, api->type);
+  stream_putc (s, api->flags);
+  stream_putc (s, api->message);
+  stream_putw (s, api->safi);
+  
+  /* Put prefix information. */
+  psize = PSIZE (p->prefixlen);
+  stream_putc (s, p->prefixlen);
+  stream_write (s, (u_char *)&p->prefix, psize);
+
+  zapi_ipv6_attr_put (s, api);
 
   /* Put length at the first point of the stream. */
   stream_putw_at (s, 0, stream_get_endp (s));
@@ -582,13 +1058,20 @@ zapi_ipv6_route (u_char cmd, struct zclient *zclient, struct prefix_ipv6 *p,
  */
 int
 zebra_redistribute_send (int command, struct zclient *zclient, int type)
+{
+  return zebra_redistribute_send_vrf (command, zclient, type, 0);
+}
+
+int
+zebra_redistribute_send_vrf (int command, struct zclient *zclient, int type,
+                             u_int16_t vrf_id)
 {
   struct stream *s;
 
   s = zclient->obuf;
   stream_reset(s);
   
-  zclient_create_header (s, command);
+  zclient_create_header_vrf (s, command, vrf_id);
   stream_putc (s, type);
   
   stream_putw_at (s, 0, stream_get_endp (s));
@@ -724,7 +1207,7 @@ void
 zebra_interface_if_set_value (struct stream *s, struct interface *ifp)
 {
   /* Read interface's index. */
-  ifp->ifindex = stream_getl (s);
+  if_set_index (ifp, stream_getl (s));
   ifp->status = stream_getc (s);
 
   /* Read interface's value. */
@@ -815,6 +1298,7 @@ zebra_interface_address_read (int type, struct stream *s)
 		    ifp->name, buf);
 	       UNSET_FLAG(ifc->flags, ZEBRA_IFA_PEER);
 	     }
+	   connected_reindex (ifc);
 	 }
     }
   else
@@ -834,6 +1318,7 @@ zclient_read (struct thread *thread)
   size_t already;
   uint16_t length, command;
   uint8_t marker, version;
+  int hdrsize;
   struct zclient *zclient;
 
   /* Get socket to zebra. */
@@ -870,17 +1355,20 @@ zclient_read (struct thread *thread)
   version = stream_getc (zclient->ibuf);
   command = stream_getw (zclient->ibuf);
   
-  if (marker != ZEBRA_HEADER_MARKER || version != ZSERV_VERSION)
+  if (marker != ZEBRA_HEADER_MARKER
+      || (version != ZSERV_VERSION && version != ZSERV_VERSION_VRF))
     {
       zlog_err("%s: socket %d version mismatch, marker %d, version %d",
                __func__, zclient->sock, marker, version);
       return zclient_failed(zclient);
     }
   
-  if (length < ZEBRA_HEADER_SIZE) 
+  hdrsize = (version == ZSERV_VERSION_VRF
+             ? ZEBRA_VRF_HEADER_SIZE : ZEBRA_HEADER_SIZE);
+  if (length < hdrsize) 
     {
       zlog_err("%s: socket %d message length %u is less than %d ",
-	       __func__, zclient->sock, length, ZEBRA_HEADER_SIZE);
+	       __func__, zclient->sock, length, hdrsize);
       return zclient_failed(zclient);
     }
 
@@ -916,13 +1404,30 @@ zclient_read (struct thread *thread)
 	}
     }
 
-  length -= ZEBRA_HEADER_SIZE;
+  zclient->vrf_id = 0;
+  if (version == ZSERV_VERSION_VRF)
+    zclient->vrf_id = stream_getw (zclient->ibuf);
+  length -= hdrsize;
 
   if (zclient_debug)
     zlog_debug("zclient 0x%p command 0x%x \n", zclient, command);
 
   switch (command)
     {
+    case ZEBRA_HELLO:
+      /* zebra answers our hello with the bulk version it will accept,
+         followed by the route ring version it supports, if any. */
+      zclient->bulk_version = stream_getc (zclient->ibuf);
+      if (zclient->bulk_version > ZAPI_BULK_VERSION)
+        zclient->bulk_version = ZAPI_BULK_VERSION;
+      if (zclient_debug)
+        zlog_debug ("zclient bulk route version %d", zclient->bulk_version);
+#ifdef HAVE_ZEBRA_RING
+      if (length > 1 && stream_getc (zclient->ibuf) == ZRING_VERSION
+          && zclient->ring_slots && ! zclient->ring)
+        zclient_ring_start (zclient);
+#endif /* HAVE_ZEBRA_RING */
+      break;
     case ZEBRA_ROUTER_ID_UPDATE:
       if (zclient->router_id_update)
 	(*zclient->router_id_update) (command, zclient, length);
@@ -1058,6 +1563,14 @@ const char *const zclient_serv_path_get()
   return zclient_serv_path ? zclient_serv_path : ZEBRA_SERV_PATH;
 }
 
+/* Ask zebra for a shared-memory route ring of this many slots on the
+   next connection of every zclient created afterwards. */
+void
+zclient_ring_slots_set (u_int32_t slots)
+{
+  zclient_ring_slots = slots;
+}
+
 void
 zclient_serv_path_set (char *path)
 {
@@ -34,6 +34,11 @@
 /* Zebra header size. */
 #define ZEBRA_HEADER_SIZE             6
 
+/* zebra answers nexthop lookups on a socket of its own too, named as the
+   zserv socket with this appended. */
+#define ZEBRA_LOOKUP_SUFFIX           ".lookup"
+#define ZEBRA_VRF_HEADER_SIZE         (ZEBRA_HEADER_SIZE + 2)
+
 /* Structure for the zebra client. */
 struct zclient
 {
@@ -63,6 +68,31 @@ struct zclient
   /* Thread to write buffered data to zebra. */
   struct thread *t_write;
 
+  /* ZEBRA_ROUTE_BULK version agreed with zebra, 0 if not supported. */
+  u_char bulk_version;
+
+  /* VRF of the message being read, 0 for the default VRF. */
+  u_int16_t vrf_id;
+
+  /* Pending ZEBRA_ROUTE_BULK message, the route command it carries and
+     the number of prefixes coalesced into it so far. */
+  struct stream *bulk;
+  uint16_t bulk_cmd;
+  uint16_t bulk_count;
+
+  /* Event thread to flush the pending bulk message. */
+  struct thread *t_bulk;
+
+  /* Requested size of the shared-memory route ring, 0 to disable. */
+  u_int32_t ring_slots;
+
+  /* Shared-memory route ring, if zebra accepted one. */
+  struct zring *ring;
+
+  /* Messages written to the socket since connecting, which orders
+     ring records against socket messages. */
+  u_int32_t msg_sent;
+
   /* Redistribute information. */
   u_char redist_default;
   u_char redist[ZEBRA_ROUTE_MAX];
@@ -90,6 +120,15 @@ struct zclient
 #define ZAPI_MESSAGE_DISTANCE 0x04
 #define ZAPI_MESSAGE_METRIC   0x08
 
+/* Highest ZEBRA_ROUTE_BULK encoding understood by this library. */
+#define ZAPI_BULK_VERSION     1
+
+/* Size of the fixed part of a ZEBRA_ROUTE_BULK message after the
+   header: version, route command and attribute length. */
+#define ZAPI_BULK_HEADER_SIZE 5
+
+struct zring;
+
 /* Zserv protocol message header */
 struct zserv_header
 {
@@ -99,6 +138,9 @@ struct zserv_header
                          */
   uint8_t version;
 #define ZSERV_VERSION	2
+/* Version 3 headers are followed by the 16-bit id of the VRF the
+   message refers to.  Version 2 messages are about the default VRF. */
+#define ZSERV_VERSION_VRF	3
   uint16_t command;
 };
 
@@ -133,11 +175,15 @@ extern void zclient_reset (struct zclient *);
 extern void zclient_free (struct zclient *);
 
 extern int  zclient_socket_connect (struct zclient *);
+extern int  zclient_lookup_socket_connect (struct zclient *);
 extern void zclient_serv_path_set  (char *path);
+extern void zclient_ring_slots_set (u_int32_t slots);
 extern const char *const zclient_serv_path_get (void);
 
 /* Send redistribute command to zebra daemon. Do not update zclient state. */
 extern int zebra_redistribute_send (int command, struct zclient *, int type);
+extern int zebra_redistribute_send_vrf (int command, struct zclient *, int type,
+                                        u_int16_t vrf_id);
 
 /* If state has changed, update state and call zebra_redistribute_send. */
 extern void zclient_redistribute (int command, struct zclient *, int type);
@@ -151,6 +197,11 @@ extern int zclient_send_message(struct zclient *);
 
 /* create header for command, length to be filled in by user later */
 extern void zclient_create_header (struct stream *, uint16_t);
+extern void zclient_create_header_vrf (struct stream *, uint16_t, u_int16_t);
+
+/* Send any routes coalesced into a ZEBRA_ROUTE_BULK message.
+   Returns 0 for success or -1 on an I/O error. */
+extern int zclient_bulk_flush (struct zclient *);
 
 extern struct interface *zebra_interface_add_read (struct stream *);
 extern struct interface *zebra_interface_state_read (struct stream *s);
@@ -159,6 +210,8 @@ extern void zebra_interface_if_set_value (struct stream *, struct interface *);
 extern void zebra_router_id_update_read (struct stream *s, struct prefix *rid);
 extern int zapi_ipv4_route (u_char, struct zclient *, struct prefix_ipv4 *, 
                             struct zapi_ipv4 *);
+extern int zapi_ipv4_route_vrf (u_char, struct zclient *, struct prefix_ipv4 *,
+                                struct zapi_ipv4 *, u_int16_t);
 
 #ifdef HAVE_IPV6
 /* IPv6 prefix add and delete function prototype. */
@@ -186,6 +239,9 @@ struct zapi_ipv6
 
 extern int zapi_ipv6_route (u_char cmd, struct zclient *zclient, 
                      struct prefix_ipv6 *p, struct zapi_ipv6 *api);
+extern int zapi_ipv6_route_vrf (u_char cmd, struct zclient *zclient,
+                                struct prefix_ipv6 *p, struct zapi_ipv6 *api,
+                                u_int16_t vrf_id);
 #endif /* HAVE_IPV6 */
 
 #endif /* _ZEBRA_ZCLIENT_H */
@@ -0,0 +1,273 @@
+/* Shared-memory route ring between zebra clients and zebra.
+ *
+ * This file is part of Quagga.
+ *
+ * Quagga is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2, or (at your option) any
+ * later version.
+ *
+ * Quagga is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Quagga; see the file COPYING.  If not, write to the Free
+ * Software Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
+ * 02111-1307, USA.
+ */
+
+#include <zebra.h>
+
+#include "log.h"
+#include "memory.h"
+#include "network.h"
+#include "zring.h"
+
+#ifdef HAVE_ZEBRA_RING
+
+#include <sys/mman.h>
+#include <sys/eventfd.h>
+
+/* Sealing stops a client from shrinking the memfd under zebra. */
+#ifdef F_ADD_SEALS
+#define ZRING_MFD_FLAGS       (MFD_CLOEXEC | MFD_ALLOW_SEALING)
+#define ZRING_SEALS           (F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_SEAL)
+#else
+#define ZRING_MFD_FLAGS       MFD_CLOEXEC
+#endif /* F_ADD_SEALS */
+
+/* The ring is a single-producer single-consumer queue of fixed size
+ * records in a memfd shared between one client and zebra.  The client
+ * fills records and advances head; zebra reads them in place and
+ * advances tail.  Neither side ever blocks on the other: a client that
+ * finds the ring full simply falls back to the zserv socket.
+ */
+
+static size_t
+zring_size (u_int32_t slots)
+{
+  return sizeof (struct zring_header)
+         + (size_t) slots * sizeof (struct zring_route);
+}
+
+static struct zring *
+zring_map (int fd, int doorbell, size_t size)
+{
+  struct zring *ring;
+  void *base;
+
+  base = mmap (NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  if (base == MAP_FAILED)
+    {
+      zlog_warn ("%s: mmap of %lu bytes failed: %s",
+                 __func__, (u_long) size, safe_strerror (errno));
+      return NULL;
+    }
+
+  ring = XCALLOC (MTYPE_ZRING, sizeof (struct zring));
+  ring->hdr = base;
+  ring->rec = (struct zring_route *) (ring->hdr + 1);
+  ring->size = size;
+  ring->fd = fd;
+  ring->doorbell = doorbell;
+  return ring;
+}
+
+/* Create a ring of the given number of slots, rounded up to a power
+   of two.  Returns NULL if shared memory is not available. */
+struct zring *
+zring_create (u_int32_t slots)
+{
+  struct zring *ring;
+  u_int32_t n;
+  size_t size;
+  int fd, doorbell;
+
+  for (n = ZRING_SLOTS_MIN; n < slots && n < ZRING_SLOTS_MAX; n <<= 1)
+    ;
+  size = zring_size (n);
+
+  if ((fd = memfd_create ("zebra-ring", ZRING_MFD_FLAGS)) < 0)
+    {
+      zlog_warn ("%s: memfd_create failed: %s",
+                 __func__, safe_strerror (errno));
+      return NULL;
+    }
+  if (ftruncate (fd, size) < 0)
+    {
+      zlog_warn ("%s: ftruncate to %lu bytes failed: %s",
+                 __func__, (u_long) size, safe_strerror (errno));
+      close (fd);
+      return NULL;
+    }
+#ifdef F_ADD_SEALS
+  if (fcntl (fd, F_ADD_SEALS, ZRING_SEALS) < 0)
+    {
+      zlog_warn ("%s: sealing failed: %s", __func__, safe_strerror (errno));
+      close (fd);
+      return NULL;
+    }
+#endif /* F_ADD_SEALS */
+  if ((doorbell = eventfd (0, EFD_NONBLOCK | EFD_CLOEXEC)) < 0)
+    {
+      zlog_warn ("%s: eventfd failed: %s", __func__, safe_strerror (errno));
+      close (fd);
+      return NULL;
+    }
+
+  if ((ring = zring_map (fd, doorbell, size)) == NULL)
+    {
+      close (doorbell);
+      close (fd);
+      return NULL;
+    }
+
+  ring->hdr->magic = ZRING_MAGIC;
+  ring->hdr->version = ZRING_VERSION;
+  ring->hdr->slots = ring->slots = n;
+  ring->hdr->record_size = sizeof (struct zring_route);
+  ring->hdr->head = 0;
+  ring->hdr->tail = 0;
+  return ring;
+}
+
+/* Next free record, or NULL if the ring is full.  The record is not
+   visible to zebra until zring_commit(). */
+struct zring_route *
+zring_reserve (struct zring *ring)
+{
+  struct zring_route *rec;
+
+  if (ZRING_FULL (ring))
+    return NULL;
+
+  rec = &ring->rec[ring->hdr->head & (ring->slots - 1)];
+  memset (rec, 0, sizeof (struct zring_route));
+  return rec;
+}
+
+/* Publish the record returned by the last zring_reserve(). */
+void
+zring_commit (struct zring *ring)
+{
+  ZRING_BARRIER ();
+  ring->hdr->head++;
+  ring->unsignalled++;
+}
+
+/* Wake zebra up for the records committed since the last call. */
+int
+zring_doorbell (struct zring *ring)
+{
+  u_int64_t one = 1;
+
+  if (! ring->unsignalled)
+    return 0;
+  ring->unsignalled = 0;
+
+  if (write (ring->doorbell, &one, sizeof (one)) < 0
+      && ! ERRNO_IO_RETRY (errno))
+    {
+      zlog_warn ("%s: doorbell write failed: %s",
+                 __func__, safe_strerror (errno));
+      return -1;
+    }
+  return 0;
+}
+
+/* Map a ring created by a client.  The descriptors are owned by the
+   returned ring, or closed if it cannot be used. */
+struct zring *
+zring_attach (int fd, int doorbell)
+{
+  struct zring *ring;
+  struct stat st;
+#ifdef F_ADD_SEALS
+  int seals;
+#endif /* F_ADD_SEALS */
+
+  if (fstat (fd, &st) < 0
+      || (size_t) st.st_size < sizeof (struct zring_header))
+    goto bad;
+#ifdef F_ADD_SEALS
+  seals = fcntl (fd, F_GET_SEALS);
+  if (seals < 0 || (seals & ZRING_SEALS) != ZRING_SEALS)
+    {
+      zlog_warn ("%s: ring memory is not sealed", __func__);
+      goto bad;
+    }
+#endif /* F_ADD_SEALS */
+
+  if ((ring = zring_map (fd, doorbell, st.st_size)) == NULL)
+    goto bad;
+
+  ring->slots = ring->hdr->slots;
+  if (ring->hdr->magic != ZRING_MAGIC
+      || ring->hdr->version != ZRING_VERSION
+      || ring->hdr->record_size != sizeof (struct zring_route)
+      || ring->slots < ZRING_SLOTS_MIN
+      || ring->slots > ZRING_SLOTS_MAX
+      || (ring->slots & (ring->slots - 1))
+      || zring_size (ring->slots) > ring->size)
+    {
+      zlog_warn ("%s: invalid ring header (magic 0x%x, version %u, "
+                 "%u slots of %u bytes)", __func__, ring->hdr->magic,
+                 ring->hdr->version, ring->slots, ring->hdr->record_size);
+      zring_free (ring);
+      return NULL;
+    }
+  return ring;
+
+ bad:
+  close (doorbell);
+  close (fd);
+  return NULL;
+}
+
+/* Oldest unconsumed record, or NULL if the ring is empty.  The record
+   stays valid until zring_release(). */
+struct zring_route *
+zring_peek (struct zring *ring)
+{
+  u_int32_t count = ZRING_COUNT (ring);
+
+  /* A client must never run head more than a ring ahead of tail. */
+  if (count == 0 || count > ring->slots)
+    return NULL;
+
+  ZRING_BARRIER ();
+  return &ring->rec[ring->hdr->tail & (ring->slots - 1)];
+}
+
+/* Hand the record returned by zring_peek() back to the client. */
+void
+zring_release (struct zring *ring)
+{
+  ZRING_BARRIER ();
+  ring->hdr->tail++;
+}
+
+/* Reset the doorbell once it has woken zebra up. */
+int
+zring_doorbell_clear (struct zring *ring)
+{
+  u_int64_t count;
+
+  if (read (ring->doorbell, &count, sizeof (count)) < 0
+      && ! ERRNO_IO_RETRY (errno))
+    return -1;
+  return 0;
+}
+
+void
+zring_free (struct zring *ring)
+{
+  munmap (ring->hdr, ring->size);
+  close (ring->doorbell);
+  close (ring->fd);
+  XFREE (MTYPE_ZRING, ring);
+}
+
+#endif /* HAVE_ZEBRA_RING */
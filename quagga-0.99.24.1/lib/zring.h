@@ -0,0 +1,147 @@
+/* Shared-memory route ring between zebra clients and zebra.
+ *
+ * This file is part of Quagga.
+ *
+ * Quagga is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2, or (at your option) any
+ * later version.
+ *
+ * Quagga is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Quagga; see the file COPYING.  If not, write to the Free
+ * Software Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
+ * 02111-1307, USA.
+ */
+
+#ifndef _ZEBRA_ZRING_H
+#define _ZEBRA_ZRING_H
+
+/* The ring needs anonymous shared memory, an eventfd doorbell and a
+   UNIX domain zserv socket to pass both descriptors to zebra. */
+#if defined(HAVE_MEMFD_CREATE) && defined(HAVE_SYS_MMAN_H) \
+    && defined(HAVE_SYS_EVENTFD_H) && !defined(HAVE_TCP_ZEBRA)
+#define HAVE_ZEBRA_RING
+#endif
+
+#define ZRING_MAGIC           0x5a52494e	/* "ZRIN" */
+#define ZRING_VERSION         1
+
+/* Routes with more nexthops than this are sent over the socket. */
+#define ZRING_NEXTHOP_MAX     8
+
+/* Bounds on the number of slots, which must be a power of two. */
+#define ZRING_SLOTS_MIN       64
+#define ZRING_SLOTS_MAX       (1 << 20)
+
+struct zring_nexthop
+{
+  u_char type;				/* ZEBRA_NEXTHOP_* */
+  u_char pad[3];
+  u_int32_t ifindex;
+  union
+  {
+    struct in_addr ipv4;
+#ifdef HAVE_IPV6
+    struct in6_addr ipv6;
+#endif /* HAVE_IPV6 */
+    u_char pad[16];
+  } gate;
+};
+
+/* One route record.  The fields mirror the ZEBRA_IPV*_ROUTE_* message
+   and are written by the client and read in place by zebra. */
+struct zring_route
+{
+  /* Number of socket messages the client had sent when it wrote this
+     record, so zebra can keep ring and socket messages in order. */
+  u_int32_t seq;
+
+  u_int16_t cmd;			/* ZEBRA_IPV*_ROUTE_{ADD,DELETE} */
+  u_int16_t safi;
+
+  u_char type;
+  u_char flags;
+  u_char message;
+  u_char prefixlen;
+
+  u_char nexthop_num;
+  u_char distance;
+  u_char pad[2];
+
+  u_int32_t metric;
+
+  union
+  {
+    struct in_addr ipv4;
+#ifdef HAVE_IPV6
+    struct in6_addr ipv6;
+#endif /* HAVE_IPV6 */
+    u_char pad[16];
+  } prefix;
+
+  struct zring_nexthop nexthop[ZRING_NEXTHOP_MAX];
+};
+
+/* Shared header at the start of the mapping.  head is only written by
+   the client and tail only by zebra; each sits on its own cache line.
+   Both are free running and reduced modulo slots on use. */
+struct zring_header
+{
+  u_int32_t magic;
+  u_int32_t version;
+  u_int32_t slots;
+  u_int32_t record_size;
+  u_char pad1[48];
+
+  volatile u_int32_t head;
+  u_char pad2[60];
+
+  volatile u_int32_t tail;
+  u_char pad3[60];
+};
+
+/* Local handle on a mapped ring. */
+struct zring
+{
+  struct zring_header *hdr;
+  struct zring_route *rec;
+  size_t size;
+
+  /* Private copy of hdr->slots, so the peer cannot change it. */
+  u_int32_t slots;
+
+  /* Shared memory and doorbell descriptors. */
+  int fd;
+  int doorbell;
+
+  /* Records written but not yet signalled through the doorbell. */
+  u_int32_t unsignalled;
+};
+
+/* Full memory barrier between record contents and ring indices. */
+#define ZRING_BARRIER()       __sync_synchronize ()
+
+#define ZRING_COUNT(R)        ((R)->hdr->head - (R)->hdr->tail)
+#define ZRING_FULL(R)         (ZRING_COUNT (R) == (R)->slots)
+#define ZRING_EMPTY(R)        (ZRING_COUNT (R) == 0)
+
+/* Client side. */
+extern struct zring *zring_create (u_int32_t slots);
+extern struct zring_route *zring_reserve (struct zring *);
+extern void zring_commit (struct zring *);
+extern int zring_doorbell (struct zring *);
+
+/* zebra side. */
+extern struct zring *zring_attach (int fd, int doorbell);
+extern struct zring_route *zring_peek (struct zring *);
+extern void zring_release (struct zring *);
+extern int zring_doorbell_clear (struct zring *);
+
+extern void zring_free (struct zring *);
+
+#endif /* _ZEBRA_ZRING_H */
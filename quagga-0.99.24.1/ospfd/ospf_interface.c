@@ -878,7 +878,6 @@ ospf_vl_new (struct ospf *ospf, struct ospf_vl_data *vl_data)
   vi = if_create (ifname, strnlen(ifname, sizeof(ifname)));
   co = connected_new ();
   co->ifp = vi;
-  listnode_add (vi->connected, co);
 
   p = prefix_ipv4_new ();
   p->family = AF_INET;
@@ -886,6 +885,7 @@ ospf_vl_new (struct ospf *ospf, struct ospf_vl_data *vl_data)
   p->prefixlen = 0;
  
   co->address = (struct prefix *)p;
+  connected_add (vi, co);
   
   voi = ospf_if_new (ospf, vi, co->address);
   if (voi == NULL)
@@ -51,7 +51,7 @@ static int zclient_lookup_connect(struct thread *t)
     return 0;
   }
 
-  if (zclient_socket_connect(zlookup) < 0) {
+  if (zclient_lookup_socket_connect(zlookup) < 0) {
     ++zlookup->fail;
     zlog_warn("%s: failure connecting zclient socket: failures=%d",
 	      __PRETTY_FUNCTION__, zlookup->fail);
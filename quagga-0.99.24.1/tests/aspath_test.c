@@ -28,6 +28,7 @@
 #include "bgpd/bgpd.h"
 #include "bgpd/bgp_aspath.h"
 #include "bgpd/bgp_attr.h"
+#include "bgpd/bgp_regex.h"
 
 #define VT100_RESET "\x1b[0m"
 #define VT100_RED "\x1b[31m"
@@ -883,6 +884,65 @@ struct compare_tests
   { 9, 8, CMP_RES_NO, CMP_RES_NO },
 };
 
+/* AS path regular expressions, matched by bgp_asregex_match against
+   regexec on the string.  */
+static struct regex_tests
+{
+  const char *regstr;
+#define REGEX_DFA 1
+#define REGEX_REGEXEC 0
+  int dfa; /* whether it should be compiled to a DFA */
+} regex_tests [] =
+{
+  { "^$", REGEX_DFA },
+  { ".*", REGEX_DFA },
+  { "^8466_", REGEX_DFA },
+  { "_4$", REGEX_DFA },
+  { "_3_", REGEX_DFA },
+  { "^8466 3", REGEX_DFA },
+  { "_5204_", REGEX_DFA },
+  { "_123_", REGEX_DFA },
+  { "2", REGEX_DFA },
+  { "^1", REGEX_DFA },
+  { "\\{5204\\}", REGEX_DFA },
+  { "[{]", REGEX_DFA },
+  { "[][()]", REGEX_DFA },
+  { "\\(123", REGEX_DFA },
+  { "\\[456", REGEX_DFA },
+  { "_(4196|17322)_", REGEX_DFA },
+  { "^[0-9]+$", REGEX_DFA },
+  { "^[0-9]+_[0-9]+_", REGEX_DFA },
+  { "^([0-9]+ ){1,3}[0-9]+$", REGEX_DFA },
+  { "^([0-9]+ ){4,}", REGEX_DFA },
+  { "^([0-9]+ ){2}[0-9]+$", REGEX_DFA },
+  { "8466 (3 )?52737", REGEX_DFA },
+  { "[^0-9 ]", REGEX_DFA },
+  { "_6553[0-5]_", REGEX_DFA },
+  { "_645[1-9][0-9]$", REGEX_DFA },
+  { "^(8466|8482)_[0-9]*_", REGEX_DFA },
+  { "^(8722|4)( |$)", REGEX_DFA },
+  { "(_8722)+$", REGEX_DFA },
+  { "4$_", REGEX_DFA },
+  { "^_8466", REGEX_DFA },
+  { "3^8466", REGEX_DFA },
+  { "((((1|2)*)*)*3)+", REGEX_DFA },
+  { "^(.*_)?(64512|65535)_", REGEX_DFA },
+  { "a|^$", REGEX_DFA },
+  { "[[:digit:]]+ 4$", REGEX_REGEXEC },
+  { "\\b4\\b", REGEX_REGEXEC },
+  { "(8466) \\1", REGEX_REGEXEC },
+  { NULL, 0 },
+};
+
+/* AS paths to match the expressions against, besides test_segments */
+static const char *regex_paths[] =
+{
+  "4200000000 65001",
+  "1 {2,3} (4 5) [6,7] 8",
+  "64512 {65535}",
+  NULL,
+};
+
 /* make an aspath from a data stream */
 static struct aspath *
 make_aspath (const u_char *data, size_t len, int use32bit)
@@ -1249,6 +1309,73 @@ cmp_test ()
     }
 }
 
+static int
+regex_match_check (struct bgp_asregex *re, regex_t *reg, struct aspath *as)
+{
+  int match = bgp_asregex_match (re, as);
+
+  if (match != (bgp_regexec (reg, as) == 0))
+    {
+      printf ("path \"%s\": %s, but regexec says otherwise\n",
+              aspath_print (as), match ? "matches" : "doesn't match");
+      return 1;
+    }
+  return 0;
+}
+
+/* bgp_asregex_match against regexec */
+static void
+regex_test (struct regex_tests *t)
+{
+  struct bgp_asregex *re;
+  regex_t *reg;
+  struct aspath *as;
+  int i;
+  int initfail = failed;
+
+  printf ("regex %s\n", t->regstr);
+
+  re = bgp_asregex_compile (t->regstr);
+  reg = bgp_regcomp (t->regstr);
+  if (! re || ! reg)
+    {
+      printf ("can't compile\n" FAILED "\n\n");
+      failed++;
+      if (re)
+        bgp_asregex_free (re);
+      if (reg)
+        bgp_regex_free (reg);
+      return;
+    }
+
+  if (bgp_asregex_compiled (re) != t->dfa)
+    {
+      printf ("%s compiled to a DFA\n", t->dfa ? "not" : "wrongly");
+      failed++;
+    }
+
+  for (i = 0; test_segments[i].name; i++)
+    {
+      as = make_aspath (test_segments[i].asdata, test_segments[i].len, 0);
+      if (! as)
+        continue;
+      failed += regex_match_check (re, reg, as);
+      aspath_unintern (&as);
+    }
+
+  for (i = 0; regex_paths[i]; i++)
+    {
+      as = aspath_str2aspath (regex_paths[i]);
+      failed += regex_match_check (re, reg, as);
+      aspath_free (as);
+    }
+
+  printf ("%s\n\n", (failed > initfail) ? FAILED : OK);
+
+  bgp_asregex_free (re);
+  bgp_regex_free (reg);
+}
+
 static int
 handle_attr_test (struct aspath_tests *t)
 {
@@ -1296,17 +1423,17 @@ handle_attr_test (struct aspath_tests *t)
       printf ("aspath is NULL, but should be: %s\n", t->shouldbe);
       failed++;
     }
-  if (t->shouldbe && attr.aspath && strcmp (attr.aspath->str, t->shouldbe))
+  if (t->shouldbe && attr.aspath && strcmp (aspath_print (attr.aspath), t->shouldbe))
     {
       printf ("attr str and 'shouldbe' mismatched!\n"
               "attr str:  %s\n"
               "shouldbe:  %s\n",
-              attr.aspath->str, t->shouldbe);
+              aspath_print (attr.aspath), t->shouldbe);
       failed++;
     }
   if (!t->shouldbe && attr.aspath)
     {
-      printf ("aspath should be NULL, but is: %s\n", attr.aspath->str);
+      printf ("aspath should be NULL, but is: %s\n", aspath_print (attr.aspath));
       failed++;
     }
 
@@ -1379,6 +1506,11 @@ main (void)
       attr_test (&aspath_tests[i++]);
     }
   
+  i = 0;
+  
+  while (regex_tests[i].regstr)
+    regex_test (&regex_tests[i++]);
+  
   printf ("failures: %d\n", failed);
   printf ("aspath count: %ld\n", aspath_count());
   
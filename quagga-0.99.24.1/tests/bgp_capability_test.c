@@ -412,6 +412,16 @@ static struct test_segment misc_segments[] =
     { CAPABILITY_CODE_DYNAMIC, 0x0 },
     2, SHOULD_PARSE,
   },
+  { "ExtMsg",
+    "Extended message capability",
+    { CAPABILITY_CODE_EXTENDED_MSG, 0x0 },
+    2, SHOULD_PARSE,
+  },
+  { "ExtMsg-long",
+    "Extended message capability, with data",
+    { CAPABILITY_CODE_EXTENDED_MSG, 0x2, 0x0, 0x0 },
+    4, SHOULD_PARSE,
+  },
   { NULL, NULL, {0}, 0, 0}
 };
 
@@ -106,6 +106,8 @@ bgp_create_fake (as_t *as, const char *name)
   bgp->rsclient = list_new ();
   //bgp->rsclient->cmp = (int (*)(void*, void*)) peer_cmp;
 
+  bgp->update_groups = list_new ();
+
   for (afi = AFI_IP; afi < AFI_MAX; afi++)
     for (safi = SAFI_UNICAST; safi < SAFI_MAX; safi++)
       {
@@ -203,19 +205,27 @@ struct peer test_mp_list_peer[] = {
 };
 int test_mp_list_peer_count = sizeof (test_mp_list_peer)/ sizeof (struct peer);
 struct attr test_mp_list_attr[4];
-struct bgp_info test_mp_list_info[] = {
-  { .peer = &test_mp_list_peer[0], .attr = &test_mp_list_attr[0] },
-  { .peer = &test_mp_list_peer[1], .attr = &test_mp_list_attr[1] },
-  { .peer = &test_mp_list_peer[2], .attr = &test_mp_list_attr[1] },
-  { .peer = &test_mp_list_peer[3], .attr = &test_mp_list_attr[2] },
-  { .peer = &test_mp_list_peer[4], .attr = &test_mp_list_attr[3] },
-};
+/* Paths come from their slab, made by setup_bgp_mp_list: the path of
+   each peer, with these attributes.  */
+int test_mp_list_info_attr[] = { 0, 1, 1, 2, 3 };
+struct bgp_info *test_mp_list_info[5];
 int test_mp_list_info_count =
-  sizeof (test_mp_list_info)/sizeof (struct bgp_info);
+  sizeof (test_mp_list_info)/sizeof (struct bgp_info *);
 
 static int
 setup_bgp_mp_list (testcase_t *t)
 {
+  int i;
+
+  for (i = 0; i < test_mp_list_info_count; i++)
+    if (! test_mp_list_info[i])
+      {
+        test_mp_list_info[i] = bgp_slab_alloc (&bgp_info_slab);
+        test_mp_list_info[i]->peer = &test_mp_list_peer[i];
+        test_mp_list_info[i]->attr =
+          &test_mp_list_attr[test_mp_list_info_attr[i]];
+      }
+
   test_mp_list_attr[0].nexthop.s_addr = 0x01010101;
   test_mp_list_attr[1].nexthop.s_addr = 0x02020202;
   test_mp_list_attr[2].nexthop.s_addr = 0x03030303;
@@ -246,17 +256,17 @@ run_bgp_mp_list (testcase_t *t)
   bgp_mp_list_init (&mp_list);
   EXPECT_TRUE (listcount(&mp_list) == 0, test_result);
 
-  bgp_mp_list_add (&mp_list, &test_mp_list_info[1]);
-  bgp_mp_list_add (&mp_list, &test_mp_list_info[4]);
-  bgp_mp_list_add (&mp_list, &test_mp_list_info[2]);
-  bgp_mp_list_add (&mp_list, &test_mp_list_info[3]);
-  bgp_mp_list_add (&mp_list, &test_mp_list_info[0]);
+  bgp_mp_list_add (&mp_list, test_mp_list_info[1]);
+  bgp_mp_list_add (&mp_list, test_mp_list_info[4]);
+  bgp_mp_list_add (&mp_list, test_mp_list_info[2]);
+  bgp_mp_list_add (&mp_list, test_mp_list_info[3]);
+  bgp_mp_list_add (&mp_list, test_mp_list_info[0]);
 
   for (i = 0, mp_node = listhead(&mp_list); i < test_mp_list_info_count;
        i++, mp_node = listnextnode(mp_node))
     {
       info = listgetdata(mp_node);
-      EXPECT_TRUE (info == &test_mp_list_info[i], test_result);
+      EXPECT_TRUE (info == test_mp_list_info[i], test_result);
     }
 
   bgp_mp_list_clear (&mp_list);
@@ -287,16 +297,21 @@ testcase_t test_bgp_mp_list = {
  * Testcase for bgp_info_mpath_update
  */
 
-struct bgp_node test_rn;
+struct bgp_node *test_rn;
 
 static int
 setup_bgp_info_mpath_update (testcase_t *t)
 {
+  struct bgp_table *table;
+  struct prefix p;
   int i;
-  str2prefix ("42.1.1.0/24", &test_rn.p);
+
+  table = bgp_table_init (AFI_IP, SAFI_UNICAST);
+  str2prefix ("42.1.1.0/24", &p);
+  test_rn = bgp_node_get (table, &p);
   setup_bgp_mp_list (t);
   for (i = 0; i < test_mp_list_info_count; i++)
-    bgp_info_add (&test_rn, &test_mp_list_info[i]);
+    bgp_info_add (test_rn, test_mp_list_info[i]);
   return 0;
 }
 
@@ -308,33 +323,33 @@ run_bgp_info_mpath_update (testcase_t *t)
   struct bgp_maxpaths_cfg mp_cfg = { 3, 3 };
   int test_result = TEST_PASSED;
   bgp_mp_list_init (&mp_list);
-  bgp_mp_list_add (&mp_list, &test_mp_list_info[4]);
-  bgp_mp_list_add (&mp_list, &test_mp_list_info[3]);
-  bgp_mp_list_add (&mp_list, &test_mp_list_info[0]);
-  bgp_mp_list_add (&mp_list, &test_mp_list_info[1]);
-  new_best = &test_mp_list_info[3];
+  bgp_mp_list_add (&mp_list, test_mp_list_info[4]);
+  bgp_mp_list_add (&mp_list, test_mp_list_info[3]);
+  bgp_mp_list_add (&mp_list, test_mp_list_info[0]);
+  bgp_mp_list_add (&mp_list, test_mp_list_info[1]);
+  new_best = test_mp_list_info[3];
   old_best = NULL;
-  bgp_info_mpath_update (&test_rn, new_best, old_best, &mp_list, &mp_cfg);
+  bgp_info_mpath_update (test_rn, new_best, old_best, &mp_list, &mp_cfg);
   bgp_mp_list_clear (&mp_list);
   EXPECT_TRUE (bgp_info_mpath_count (new_best) == 2, test_result);
   mpath = bgp_info_mpath_first (new_best);
-  EXPECT_TRUE (mpath == &test_mp_list_info[0], test_result);
+  EXPECT_TRUE (mpath == test_mp_list_info[0], test_result);
   EXPECT_TRUE (CHECK_FLAG (mpath->flags, BGP_INFO_MULTIPATH), test_result);
   mpath = bgp_info_mpath_next (mpath);
-  EXPECT_TRUE (mpath == &test_mp_list_info[1], test_result);
+  EXPECT_TRUE (mpath == test_mp_list_info[1], test_result);
   EXPECT_TRUE (CHECK_FLAG (mpath->flags, BGP_INFO_MULTIPATH), test_result);
 
-  bgp_mp_list_add (&mp_list, &test_mp_list_info[0]);
-  bgp_mp_list_add (&mp_list, &test_mp_list_info[1]);
-  new_best = &test_mp_list_info[0];
-  old_best = &test_mp_list_info[3];
-  bgp_info_mpath_update (&test_rn, new_best, old_best, &mp_list, &mp_cfg);
+  bgp_mp_list_add (&mp_list, test_mp_list_info[0]);
+  bgp_mp_list_add (&mp_list, test_mp_list_info[1]);
+  new_best = test_mp_list_info[0];
+  old_best = test_mp_list_info[3];
+  bgp_info_mpath_update (test_rn, new_best, old_best, &mp_list, &mp_cfg);
   bgp_mp_list_clear (&mp_list);
   EXPECT_TRUE (bgp_info_mpath_count (new_best) == 1, test_result);
   mpath = bgp_info_mpath_first (new_best);
-  EXPECT_TRUE (mpath == &test_mp_list_info[1], test_result);
+  EXPECT_TRUE (mpath == test_mp_list_info[1], test_result);
   EXPECT_TRUE (CHECK_FLAG (mpath->flags, BGP_INFO_MULTIPATH), test_result);
-  EXPECT_TRUE (!CHECK_FLAG (test_mp_list_info[0].flags, BGP_INFO_MULTIPATH),
+  EXPECT_TRUE (!CHECK_FLAG (test_mp_list_info[0]->flags, BGP_INFO_MULTIPATH),
                test_result);
 
   return test_result;
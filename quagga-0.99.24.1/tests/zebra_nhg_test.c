@@ -0,0 +1,492 @@
+/*
+ * Nexthop group tests: routes with the same nexthops share a group and
+ * its kernel nexthop object, which lasts as long as a route is
+ * installed with it.  Run against the kernel, in a network namespace
+ * of its own; skipped where one cannot be had.
+ *
+ * This file is part of Quagga.
+ *
+ * Quagga is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2, or (at your option) any
+ * later version.
+ *
+ * Quagga is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Quagga; see the file COPYING.  If not, write to the Free
+ * Software Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
+ * 02111-1307, USA.
+ */
+
+#include <zebra.h>
+#include <sched.h>
+
+#include "thread.h"
+#include "vty.h"
+#include "command.h"
+#include "memory.h"
+#include "prefix.h"
+#include "table.h"
+#include "privs.h"
+#include "filter.h"
+#include "plist.h"
+#include "workqueue.h"
+
+#include "zebra/rib.h"
+#include "zebra/zserv.h"
+#include "zebra/debug.h"
+#include "zebra/rt.h"
+#include "zebra/interface.h"
+#include "zebra/router-id.h"
+#include "zebra/zebra_nhg.h"
+
+#define VT100_RESET "\x1b[0m"
+#define VT100_RED "\x1b[31m"
+#define VT100_GREEN "\x1b[32m"
+#define VT100_YELLOW "\x1b[33m"
+#define OK VT100_GREEN "OK" VT100_RESET
+#define FAILED VT100_RED "failed" VT100_RESET
+#define SKIPPED VT100_YELLOW "skipped" VT100_RESET
+
+#define TEST_PASSED 0
+#define TEST_FAILED -1
+#define TEST_SKIPPED -2
+
+/* Exit status automake and friends take to mean "not run". */
+#define EXIT_SKIPPED 77
+
+#define EXPECT_TRUE(expr, res)                                          \
+  if (!(expr))                                                          \
+    {                                                                   \
+      printf ("Test failure in %s line %u: %s\n",                       \
+              __FUNCTION__, __LINE__, #expr);                           \
+      (res) = TEST_FAILED;                                              \
+    }
+
+/* need these to link in libzebrad */
+struct zebra_t zebrad =
+{
+  .rtm_table_default = 0,
+};
+pid_t pid;
+struct thread_master *master;
+int retain_mode = 0;
+int keep_kernel_mode = 0;
+int reconcile_time = 0;
+u_int32_t nl_rcvbufsize = 0;
+struct zebra_privs_t zserv_privs =
+{
+  .user = NULL,
+  .group = NULL,
+  .vty_group = NULL,
+};
+
+static int tty = 0;
+static struct vty *vty;
+
+#define TEST_ROUTES 3
+#define TEST_GATE "10.9.0.2"
+
+/* Work the RIB queue empty. */
+static void
+rib_settle (void)
+{
+  struct thread thread;
+
+  while (zebrad.ribq->items->count)
+    if (thread_fetch (zebrad.master, &thread))
+      thread_call (&thread);
+}
+
+static void
+route_prefix (struct prefix_ipv4 *p, int i)
+{
+  char buf[INET_ADDRSTRLEN + 3];
+
+  snprintf (buf, sizeof (buf), "10.10.%d.0/24", i);
+  str2prefix_ipv4 (buf, p);
+}
+
+static void
+routes_add (int from, int to)
+{
+  struct prefix_ipv4 p;
+  struct in_addr gate;
+  int i;
+
+  inet_aton (TEST_GATE, &gate);
+  for (i = from; i < to; i++)
+    {
+      route_prefix (&p, i);
+      rib_add_ipv4 (ZEBRA_ROUTE_BGP, 0, &p, &gate, NULL, 0, 0, 0, 0, 20,
+                    SAFI_UNICAST);
+    }
+  rib_settle ();
+}
+
+static void
+routes_delete (int from, int to)
+{
+  struct prefix_ipv4 p;
+  struct in_addr gate;
+  int i;
+
+  inet_aton (TEST_GATE, &gate);
+  for (i = from; i < to; i++)
+    {
+      route_prefix (&p, i);
+      rib_delete_ipv4 (ZEBRA_ROUTE_BGP, 0, &p, &gate, 0, 0, 0, SAFI_UNICAST);
+    }
+  rib_settle ();
+}
+
+/* The selected entry of a prefix, if any. */
+static struct rib *
+route_rib (afi_t afi, struct prefix *p)
+{
+  struct route_table *table;
+  struct route_node *rn;
+  struct rib *rib;
+
+  table = vrf_table (afi, SAFI_UNICAST, 0);
+  rn = route_node_lookup (table, p);
+  if (! rn)
+    return NULL;
+  route_unlock_node (rn);
+  RNODE_FOREACH_RIB (rn, rib)
+    if (CHECK_FLAG (rib->flags, ZEBRA_FLAG_SELECTED)
+        && ! CHECK_FLAG (rib->status, RIB_ENTRY_REMOVED))
+      return rib;
+  return NULL;
+}
+
+static struct rib *
+route_rib_ipv4 (int i)
+{
+  struct prefix_ipv4 p;
+
+  route_prefix (&p, i);
+  return route_rib (AFI_IP, (struct prefix *) &p);
+}
+
+/* Whether a line of the output of command contains match. */
+static int
+kernel_shows (const char *command, const char *match)
+{
+  char line[512];
+  FILE *fp;
+  int found = 0;
+
+  if ((fp = popen (command, "r")) == NULL)
+    return 0;
+  while (fgets (line, sizeof (line), fp))
+    if (strstr (line, match))
+      found = 1;
+  pclose (fp);
+  return found;
+}
+
+/* Whether the kernel has route i, installed with object id, or with
+   no object if id is 0. */
+static int
+kernel_route (int i, u_int32_t id)
+{
+  char command[64];
+  char match[32];
+
+  snprintf (command, sizeof (command), "ip -4 route show 10.10.%d.0/24", i);
+  if (! id)
+    return kernel_shows (command, "via " TEST_GATE)
+           && ! kernel_shows (command, "nhid");
+  snprintf (match, sizeof (match), "nhid %u ", id);
+  return kernel_shows (command, match);
+}
+
+static int
+kernel_object (u_int32_t id)
+{
+  char command[64];
+  char match[32];
+
+  snprintf (command, sizeof (command), "ip nexthop show id %u 2>/dev/null",
+            id);
+  snprintf (match, sizeof (match), "id %u ", id);
+  return kernel_shows (command, match);
+}
+
+static int
+config (const char *line)
+{
+  vector vline;
+  int ret;
+
+  vty->node = CONFIG_NODE;
+  vline = cmd_make_strvec (line);
+  ret = cmd_execute_command (vline, vty, NULL, 0);
+  cmd_free_strvec (vline);
+  return ret;
+}
+
+/*=========================================================
+ * Testcase for routes sharing a group
+ */
+static int
+test_share (void)
+{
+  struct rib *rib[TEST_ROUTES];
+  int i, res = TEST_PASSED;
+
+  routes_add (0, TEST_ROUTES);
+  for (i = 0; i < TEST_ROUTES; i++)
+    {
+      rib[i] = route_rib_ipv4 (i);
+      if (! rib[i])
+        {
+          printf ("Route %d not selected\n", i);
+          routes_delete (0, TEST_ROUTES);
+          return TEST_FAILED;
+        }
+      EXPECT_TRUE (rib[i]->nhg == rib[0]->nhg, res);
+    }
+
+  EXPECT_TRUE (rib[0]->nhg && rib[0]->nhg->refcnt >= TEST_ROUTES, res);
+  EXPECT_TRUE (rib[0]->nhg && rib[0]->nhg->family == AF_INET, res);
+  EXPECT_TRUE (rib[0]->nhg && rib[0]->nhg->kernel_id, res);
+  if (res == TEST_PASSED)
+    for (i = 0; i < TEST_ROUTES; i++)
+      {
+        EXPECT_TRUE (rib[i]->kernel_nhid == rib[0]->nhg->kernel_id, res);
+        EXPECT_TRUE (kernel_route (i, rib[0]->nhg->kernel_id), res);
+      }
+
+  routes_delete (0, TEST_ROUTES);
+  return res;
+}
+
+/*=========================================================
+ * Testcase for the object going with the last route of the group
+ */
+static int
+test_release (void)
+{
+  struct rib *rib;
+  u_int32_t id;
+  int res = TEST_PASSED;
+
+  routes_add (0, TEST_ROUTES);
+  rib = route_rib_ipv4 (0);
+  if (! rib || ! rib->nhg || ! rib->nhg->kernel_id)
+    {
+      routes_delete (0, TEST_ROUTES);
+      return TEST_FAILED;
+    }
+  id = rib->nhg->kernel_id;
+
+  routes_delete (0, TEST_ROUTES - 1);
+  EXPECT_TRUE (kernel_object (id), res);
+  EXPECT_TRUE (kernel_route (TEST_ROUTES - 1, id), res);
+  EXPECT_TRUE (! kernel_route (0, id), res);
+
+  routes_delete (TEST_ROUTES - 1, TEST_ROUTES);
+  EXPECT_TRUE (! kernel_object (id), res);
+  EXPECT_TRUE (! kernel_route (TEST_ROUTES - 1, id), res);
+  return res;
+}
+
+/*=========================================================
+ * Testcase for routes leaving their group for a protocol route-map,
+ * which must not take them out of the kernel with its object
+ */
+static int
+test_route_map (void)
+{
+  struct rib *rib;
+  u_int32_t id;
+  int i, res = TEST_PASSED;
+
+  routes_add (0, TEST_ROUTES);
+  rib = route_rib_ipv4 (0);
+  if (! rib || ! rib->nhg || ! rib->nhg->kernel_id)
+    {
+      routes_delete (0, TEST_ROUTES);
+      return TEST_FAILED;
+    }
+  id = rib->nhg->kernel_id;
+
+  EXPECT_TRUE (config ("route-map NHGTEST permit 10") == CMD_SUCCESS, res);
+  EXPECT_TRUE (config ("ip protocol bgp route-map NHGTEST") == CMD_SUCCESS,
+               res);
+  rib_update ();
+  rib_settle ();
+  for (i = 0; i < TEST_ROUTES; i++)
+    {
+      rib = route_rib_ipv4 (i);
+      EXPECT_TRUE (rib && ! rib->nhg && ! rib->kernel_nhid, res);
+      EXPECT_TRUE (kernel_route (i, 0), res);
+    }
+  EXPECT_TRUE (! kernel_object (id), res);
+
+  EXPECT_TRUE (config ("no ip protocol bgp") == CMD_SUCCESS, res);
+  rib_update ();
+  rib_settle ();
+  for (i = 0; i < TEST_ROUTES; i++)
+    {
+      rib = route_rib_ipv4 (i);
+      EXPECT_TRUE (rib && rib->nhg, res);
+      EXPECT_TRUE (kernel_route (i, 0), res);
+    }
+
+  routes_delete (0, TEST_ROUTES);
+  config ("no route-map NHGTEST");
+  return res;
+}
+
+/*=========================================================
+ * Testcase for groups of the same nexthops in both families
+ */
+static int
+test_family (void)
+{
+  struct prefix_ipv4 p4;
+  struct prefix_ipv6 p6;
+  struct interface *ifp;
+  struct rib *rib4, *rib6;
+  int res = TEST_PASSED;
+
+  ifp = if_lookup_by_name ("v0");
+  if (! ifp)
+    return TEST_FAILED;
+
+  str2prefix_ipv4 ("10.11.0.0/24", &p4);
+  str2prefix_ipv6 ("2001:db8:11::/64", &p6);
+  rib_add_ipv4 (ZEBRA_ROUTE_BGP, 0, &p4, NULL, NULL, ifp->ifindex, 0, 0,
+                0, 20, SAFI_UNICAST);
+  rib_add_ipv6 (ZEBRA_ROUTE_BGP, 0, &p6, NULL, ifp->ifindex, 0, 0,
+                0, 20, SAFI_UNICAST);
+  rib_settle ();
+
+  rib4 = route_rib (AFI_IP, (struct prefix *) &p4);
+  rib6 = route_rib (AFI_IP6, (struct prefix *) &p6);
+  EXPECT_TRUE (rib4 && rib4->nhg && rib4->nhg->family == AF_INET, res);
+  EXPECT_TRUE (rib6 && rib6->nhg && rib6->nhg->family == AF_INET6, res);
+  EXPECT_TRUE (rib4 && rib6 && rib4->nhg != rib6->nhg, res);
+
+  rib_delete_ipv4 (ZEBRA_ROUTE_BGP, 0, &p4, NULL, ifp->ifindex, 0, 0,
+                   SAFI_UNICAST);
+  rib_delete_ipv6 (ZEBRA_ROUTE_BGP, 0, &p6, NULL, ifp->ifindex, 0, 0,
+                   SAFI_UNICAST);
+  rib_settle ();
+  return res;
+}
+
+/*=========================================================
+ * Test Driver Functions
+ */
+static struct
+{
+  const char *desc;
+  int (*run) (void);
+} all_tests[] =
+{
+  { "nexthop group sharing", test_share },
+  { "nexthop group release", test_release },
+  { "nexthop group protocol route-map", test_route_map },
+  { "nexthop group family", test_family },
+};
+
+/* A namespace of our own with an interface to route through, and the
+   kernel to have nexthop objects. */
+static int
+global_test_setup (void)
+{
+  if (unshare (CLONE_NEWNET) < 0)
+    return -1;
+  if (system ("ip link set lo up"
+              " && ip link add v0 type veth peer name v1"
+              " && ip link set v0 up && ip link set v1 up"
+              " && ip addr add 10.9.0.1/24 dev v0"
+              " && ip -6 addr add 2001:db8:9::1/64 dev v0 nodad") != 0)
+    return -1;
+  if (system ("ip nexthop show >/dev/null 2>&1") != 0)
+    return -1;
+  return 0;
+}
+
+static void
+global_test_init (void)
+{
+  zebrad.master = master = thread_master_create ();
+  zprivs_init (&zserv_privs);
+  cmd_init (1);
+  vty_init (zebrad.master);
+  memory_init ();
+  zebra_init ();
+  rib_init ();
+  zebra_if_init ();
+  zebra_debug_init ();
+  router_id_init ();
+  zebra_vty_init ();
+  access_list_init ();
+  prefix_list_init ();
+  kernel_init ();
+  interface_list ();
+  route_read ();
+  rib_settle ();
+
+  vty = vty_new ();
+  vty->type = VTY_TERM;
+
+  if (fileno (stdout) >= 0)
+    tty = isatty (fileno (stdout));
+}
+
+static void
+display_result (const char *desc, int result)
+{
+  if (result == TEST_SKIPPED)
+    printf ("%s: %s\n", desc, tty ? SKIPPED : "skipped");
+  else if (tty)
+    printf ("%s: %s\n", desc, result == TEST_PASSED ? OK : FAILED);
+  else
+    printf ("%s: %s\n", desc, result == TEST_PASSED ? "OK" : "FAILED");
+}
+
+int
+main (void)
+{
+  int pass_count = 0, fail_count = 0;
+  unsigned int i;
+  time_t cur_time;
+
+  time (&cur_time);
+  printf ("Zebra Nexthop Group Tests Run at %s", ctime (&cur_time));
+  if (global_test_setup () != 0)
+    {
+      /* Nothing to test them on: none of the tests was run, so none
+       * of them may count as passed. */
+      printf ("No network namespace with nexthop objects, skipping\n");
+      for (i = 0; i < array_size (all_tests); i++)
+        display_result (all_tests[i].desc, TEST_SKIPPED);
+      printf ("Total pass/fail/skip: 0/0/%u\n",
+              (unsigned int) array_size (all_tests));
+      return EXIT_SKIPPED;
+    }
+  global_test_init ();
+
+  for (i = 0; i < array_size (all_tests); i++)
+    {
+      int result = all_tests[i].run ();
+
+      if (result == TEST_PASSED)
+        pass_count++;
+      else
+        fail_count++;
+      display_result (all_tests[i].desc, result);
+    }
+  printf ("Total pass/fail: %d/%d\n", pass_count, fail_count);
+  return fail_count;
+}
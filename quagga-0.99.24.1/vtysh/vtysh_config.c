@@ -248,6 +248,11 @@ vtysh_config_parse_line (const char *line)
 	config = config_get (AAA_NODE, line);
       else if (strncmp (line, "ip protocol", strlen ("ip protocol")) == 0)
 	config = config_get (PROTOCOL_NODE, line);
+      else if (strncmp (line, "fpm", strlen ("fpm")) == 0)
+	config = config_get (FPM_NODE, line);
+      else if (strncmp (line, "zebra lookup-service",
+			strlen ("zebra lookup-service")) == 0)
+	config = config_get (LOOKUP_NODE, line);
       else
 	{
 	  if (strncmp (line, "log", strlen ("log")) == 0
@@ -292,7 +297,7 @@ vtysh_config_parse (char *line)
    || (I) == AS_LIST_NODE || (I) == COMMUNITY_LIST_NODE || \
    (I) == ACCESS_IPV6_NODE || (I) == PREFIX_IPV6_NODE \
    || (I) == SERVICE_NODE || (I) == FORWARDING_NODE || (I) == DEBUG_NODE \
-   || (I) == AAA_NODE)
+   || (I) == AAA_NODE || (I) == FPM_NODE || (I) == LOOKUP_NODE)
 
 /* Display configuration to file pointer. */
 void
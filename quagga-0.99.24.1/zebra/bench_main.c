@@ -0,0 +1,850 @@
+/* Zebra RIB benchmark.
+ *
+ * This file is part of Quagga.
+ *
+ * Quagga is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2, or (at your option) any
+ * later version.
+ *
+ * Quagga is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Quagga; see the file COPYING.  If not, write to the Free
+ * Software Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
+ * 02111-1307, USA.
+ */
+
+/* benchzebra runs the zserv server, the RIB and redistribution over the
+ * null kernel interface, as testzebra does, and drives them from
+ * zclient clients in the same process.  Injecting clients announce
+ * routes as bgpd would; listening clients ask for BGP routes to be
+ * redistributed to them, as ospfd would.  The benchmark goes through
+ * phases - announcing the routes, churning them and withdrawing them -
+ * and runs each until zebra is idle again: every message read, the
+ * meta-queue empty and every redistributed update read by the
+ * listeners.
+ *
+ * For each phase it reports the route operations per second, the time
+ * route nodes spent on the meta-queue and the redistribution messages
+ * the listeners received, and, once the routes are in, the memory they
+ * take.  The cost of redistribution fan-out is the difference between
+ * runs with different numbers of listeners.
+ */
+
+#include <zebra.h>
+
+#include <lib/version.h>
+#include "getopt.h"
+#include "command.h"
+#include "thread.h"
+#include "filter.h"
+#include "memory.h"
+#include "prefix.h"
+#include "plist.h"
+#include "log.h"
+#include "privs.h"
+#include "sigevent.h"
+#include "buffer.h"
+#include "hash.h"
+#include "jhash.h"
+#include "linklist.h"
+#include "table.h"
+#include "workqueue.h"
+#include "zclient.h"
+#include "zring.h"
+
+#include "zebra/rib.h"
+#include "zebra/zserv.h"
+#include "zebra/debug.h"
+#include "zebra/router-id.h"
+#include "zebra/interface.h"
+#include "zebra/connected.h"
+#include "zebra/zebra_nhg.h"
+
+/* Zebra instance */
+struct zebra_t zebrad =
+{
+  .rtm_table_default = 0,
+};
+
+/* process id. */
+pid_t pid;
+
+/* zebra_rib's workqueue hold time and queue hook. Private export for
+   use by test code only */
+extern int rib_process_hold_time;
+extern void (*rib_queue_hook) (struct route_node *, int queued);
+
+/* The master thread the in-process zclients run on. */
+struct thread_master *master;
+
+zebra_capabilities_t _caps_p [] =
+{
+  ZCAP_NET_ADMIN,
+  ZCAP_SYS_ADMIN,
+  ZCAP_NET_RAW,
+};
+
+struct zebra_privs_t zserv_privs =
+{
+  .caps_p = _caps_p,
+  .cap_num_p = array_size(_caps_p),
+  .cap_num_i = 0
+};
+
+/* Command line options. */
+struct option longopts[] =
+{
+  { "routes",      required_argument, NULL, 'n'},
+  { "ecmp",        required_argument, NULL, 'w'},
+  { "depth",       required_argument, NULL, 'd'},
+  { "churn",       required_argument, NULL, 'c'},
+  { "rounds",      required_argument, NULL, 'R'},
+  { "clients",     required_argument, NULL, 'k'},
+  { "listeners",   required_argument, NULL, 'l'},
+  { "ring",        required_argument, NULL, 'g'},
+  { "rib_hold",    required_argument, NULL, 'r'},
+  { "output",      required_argument, NULL, 'o'},
+  { "socket",      required_argument, NULL, 's'},
+  { "help",        no_argument,       NULL, 'h'},
+  { 0 }
+};
+
+/* Help information display. */
+static void
+usage (char *progname, int status)
+{
+  if (status != 0)
+    fprintf (stderr, "Try `%s --help' for more information.\n", progname);
+  else
+    {
+      printf ("Usage : %s [OPTION...]\n\n"\
+	      "Benchmark of the zebra RIB, driven by in-process zserv "\
+	      "clients.\n\n"\
+	      "-n, --routes       Number of routes to inject (10000)\n"\
+	      "-w, --ecmp         Nexthops per route (1)\n"\
+	      "-d, --depth        Recursion depth of the nexthops, 0 or 1 (0)\n"\
+	      "-c, --churn        Churn pattern: none, flap or nexthop (flap)\n"\
+	      "-R, --rounds       Rounds of churn (3)\n"\
+	      "-k, --clients      Number of injecting clients (1)\n"\
+	      "-l, --listeners    Number of redistribution listeners (1)\n"\
+	      "-g, --ring         Inject through route rings of this many "\
+	      "slots (0)\n"\
+	      "-r, --rib_hold     Set rib-queue hold time (10)\n"\
+	      "-o, --output       Output format: json or text (json)\n"\
+	      "-s, --socket       Set zserv socket path\n"\
+	      "-h, --help         Display this help and exit\n"\
+	      "\n"\
+	      "Report bugs to %s\n", progname, ZEBRA_BUG_ADDRESS);
+    }
+
+  exit (status);
+}
+
+/* Limits of the synthetic routes: /24s from 16.0.0.0 on, and gateways
+   picked from a pool of 250 addresses. */
+#define BENCH_ROUTES_MAX      4000000
+#define BENCH_GATE_POOL       250
+#define BENCH_ECMP_MAX        64
+
+enum bench_churn
+{
+  BENCH_CHURN_NONE,
+  BENCH_CHURN_FLAP,
+  BENCH_CHURN_NEXTHOP,
+};
+
+static const char *bench_churn_name[] = { "none", "flap", "nexthop" };
+
+/* Configuration. */
+static unsigned long bench_routes = 10000;
+static int bench_ecmp = 1;
+static int bench_depth = 0;
+static enum bench_churn bench_churn = BENCH_CHURN_FLAP;
+static int bench_rounds = 3;
+static int bench_clients = 1;
+static int bench_listeners = 1;
+static u_int32_t bench_ring = 0;
+static int bench_json = 1;
+
+/* The clients. */
+static struct zclient **bench_inject;
+static struct zclient **bench_listen;
+static struct zclient *bench_igp;
+
+/* Where the time of a thread went. */
+enum bench_busy
+{
+  BENCH_BUSY_RIB,
+  BENCH_BUSY_ZSERV,
+  BENCH_BUSY_INJECT,
+  BENCH_BUSY_LISTEN,
+  BENCH_BUSY_OTHER,
+  BENCH_BUSY_MAX,
+};
+
+static const char *bench_busy_name[] =
+  { "rib", "zserv", "inject", "listen", "other" };
+
+/* Results of a phase. */
+struct bench_phase
+{
+  char name[32];
+  unsigned long ops;
+  double seconds;
+  double busy[BENCH_BUSY_MAX];
+
+  /* Meta-queue latencies in microseconds. */
+  unsigned long *lat;
+  unsigned long lat_num;
+  unsigned long lat_size;
+
+  unsigned long redist_msgs;
+};
+
+static struct bench_phase *bench_phase;
+
+/* Route nodes on the meta-queue, with the time they were queued. */
+struct bench_queued
+{
+  struct route_node *rn;
+  struct timeval tv;
+};
+
+static struct hash *bench_queued_hash;
+
+static unsigned int
+bench_queued_key (void *p)
+{
+  struct route_node *rn = ((struct bench_queued *) p)->rn;
+
+  return jhash (&rn, sizeof (rn), 0);
+}
+
+static int
+bench_queued_cmp (const void *p1, const void *p2)
+{
+  return ((const struct bench_queued *) p1)->rn
+         == ((const struct bench_queued *) p2)->rn;
+}
+
+static void *
+bench_queued_alloc (void *p)
+{
+  struct bench_queued *q;
+
+  q = XCALLOC (MTYPE_TMP, sizeof (struct bench_queued));
+  q->rn = ((struct bench_queued *) p)->rn;
+  quagga_gettime (QUAGGA_CLK_MONOTONIC, &q->tv);
+  return q;
+}
+
+static unsigned long
+bench_usec_since (const struct timeval *start)
+{
+  struct timeval now;
+
+  quagga_gettime (QUAGGA_CLK_MONOTONIC, &now);
+  return (now.tv_sec - start->tv_sec) * 1000000UL
+         + now.tv_usec - start->tv_usec;
+}
+
+/* A node queued in several sub-queues counts from the first, and is
+   done with once it is processed. */
+static void
+bench_queue_hook (struct route_node *rn, int queued)
+{
+  struct bench_queued key, *q;
+  struct bench_phase *ph = bench_phase;
+
+  key.rn = rn;
+  if (queued)
+    {
+      hash_get (bench_queued_hash, &key, bench_queued_alloc);
+      return;
+    }
+
+  if ((q = hash_release (bench_queued_hash, &key)) == NULL)
+    return;
+  if (ph)
+    {
+      if (ph->lat_num == ph->lat_size)
+        {
+          ph->lat_size = ph->lat_size ? ph->lat_size * 2 : 1024;
+          ph->lat = XREALLOC (MTYPE_TMP, ph->lat,
+                              ph->lat_size * sizeof (unsigned long));
+        }
+      ph->lat[ph->lat_num++] = bench_usec_since (&q->tv);
+    }
+  XFREE (MTYPE_TMP, q);
+}
+
+/* A listener got a redistributed route. */
+static int
+bench_redist_read (int command, struct zclient *zclient, uint16_t length)
+{
+  if (bench_phase)
+    bench_phase->redist_msgs++;
+  return 0;
+}
+
+/* Whether there is data waiting on sock. */
+static int
+bench_unread (int sock)
+{
+  int n = 0;
+
+  if (sock < 0)
+    return 0;
+  if (ioctl (sock, FIONREAD, &n) < 0)
+    return 0;
+  return n > 0;
+}
+
+static int
+bench_zclient_idle (struct zclient *zclient)
+{
+  return zclient->sock >= 0
+         && buffer_empty (zclient->wb)
+         && ! zclient->t_bulk
+         && ! bench_unread (zclient->sock);
+}
+
+/* Whether all clients are connected and everything they sent has been
+   processed by zebra, and everything zebra sent them read. */
+static int
+bench_idle (void)
+{
+  struct listnode *node;
+  struct zserv *client;
+  int i, expect;
+
+  expect = bench_clients + bench_listeners + (bench_igp ? 1 : 0);
+  if (listcount (zebrad.client_list) != (unsigned int) expect)
+    return 0;
+
+  for (i = 0; i < bench_clients; i++)
+    if (! bench_zclient_idle (bench_inject[i]))
+      return 0;
+  for (i = 0; i < bench_listeners; i++)
+    if (! bench_zclient_idle (bench_listen[i]))
+      return 0;
+  if (bench_igp && ! bench_zclient_idle (bench_igp))
+    return 0;
+
+  for (ALL_LIST_ELEMENTS_RO (zebrad.client_list, node, client))
+    {
+      if (bench_unread (client->sock)
+          || ! buffer_empty (client->wb)
+          || listcount (client->pending_fifo)
+          || listcount (client->redist_dump))
+        return 0;
+#ifdef HAVE_ZEBRA_RING
+      if (client->ring && zring_peek (client->ring))
+        return 0;
+#endif /* HAVE_ZEBRA_RING */
+    }
+
+  return zebrad.ribq->items->count == 0;
+}
+
+static enum bench_busy
+bench_busy_class (void *arg)
+{
+  struct listnode *node;
+  struct zserv *client;
+  int i;
+
+  if (arg == zebrad.ribq)
+    return BENCH_BUSY_RIB;
+  for (ALL_LIST_ELEMENTS_RO (zebrad.client_list, node, client))
+    if (arg == client)
+      return BENCH_BUSY_ZSERV;
+  for (i = 0; i < bench_clients; i++)
+    if (arg == bench_inject[i])
+      return BENCH_BUSY_INJECT;
+  if (arg == bench_igp)
+    return BENCH_BUSY_INJECT;
+  for (i = 0; i < bench_listeners; i++)
+    if (arg == bench_listen[i])
+      return BENCH_BUSY_LISTEN;
+  return BENCH_BUSY_OTHER;
+}
+
+/* Run the threads until zebra is idle. */
+static void
+bench_run (struct bench_phase *ph)
+{
+  struct thread thread;
+  struct timeval start;
+  enum bench_busy busy;
+
+  while (! bench_idle ())
+    {
+      if (! thread_fetch (zebrad.master, &thread))
+        break;
+      busy = bench_busy_class (thread.arg);
+      quagga_gettime (QUAGGA_CLK_MONOTONIC, &start);
+      thread_call (&thread);
+      if (ph)
+        ph->busy[busy] += bench_usec_since (&start) / 1e6;
+    }
+}
+
+/* The subnet of bench0, and the one of the gateways the IGP client
+   announces /32 routes for. */
+#define BENCH_CONNECTED       0x0aff0000
+#define BENCH_RECURSIVE       0xac100000
+
+/* Gateway j of round r. */
+static struct in_addr
+bench_gate (u_int32_t base, int round, int j)
+{
+  struct in_addr gate;
+
+  gate.s_addr = htonl (base + 2 + (round + j) % BENCH_GATE_POOL);
+  return gate;
+}
+
+static void
+bench_prefix (unsigned long i, struct prefix_ipv4 *p)
+{
+  memset (p, 0, sizeof (*p));
+  p->family = AF_INET;
+  p->prefixlen = 24;
+  p->prefix.s_addr = htonl (0x10000000 + (i << 8));
+}
+
+static void
+bench_announce (struct zclient *zclient, u_char cmd, int type,
+                struct prefix_ipv4 *p, u_char flags, u_int32_t base,
+                int round, int ecmp)
+{
+  struct zapi_ipv4 api;
+  struct in_addr gate[BENCH_ECMP_MAX];
+  struct in_addr *gatep[BENCH_ECMP_MAX];
+  int j;
+
+  memset (&api, 0, sizeof (api));
+  api.type = type;
+  api.flags = flags;
+  api.safi = SAFI_UNICAST;
+  if (cmd == ZEBRA_IPV4_ROUTE_ADD)
+    {
+      for (j = 0; j < ecmp; j++)
+        {
+          gate[j] = bench_gate (base, round, j);
+          gatep[j] = &gate[j];
+        }
+      SET_FLAG (api.message, ZAPI_MESSAGE_NEXTHOP);
+      api.nexthop_num = ecmp;
+      api.nexthop = gatep;
+    }
+  zapi_ipv4_route (cmd, zclient, p, &api);
+}
+
+/* Announce or withdraw all the routes, as of the given round. */
+static void
+bench_inject_all (u_char cmd, int round)
+{
+  struct prefix_ipv4 p;
+  unsigned long i;
+  u_char flags = bench_depth ? ZEBRA_FLAG_INTERNAL : 0;
+  u_int32_t base = bench_depth ? BENCH_RECURSIVE : BENCH_CONNECTED;
+
+  for (i = 0; i < bench_routes; i++)
+    {
+      bench_prefix (i, &p);
+      bench_announce (bench_inject[i % bench_clients], cmd, ZEBRA_ROUTE_BGP,
+                      &p, flags, base, round, bench_ecmp);
+    }
+}
+
+/* The /32 routes of all the gateways, through the connected subnet. */
+static unsigned long
+bench_igp_announce (void)
+{
+  struct prefix_ipv4 p;
+  int j, num;
+
+  num = MIN (BENCH_GATE_POOL, bench_ecmp + bench_rounds);
+  for (j = 0; j < num; j++)
+    {
+      memset (&p, 0, sizeof (p));
+      p.family = AF_INET;
+      p.prefixlen = IPV4_MAX_BITLEN;
+      p.prefix = bench_gate (BENCH_RECURSIVE, 0, j);
+      bench_announce (bench_igp, ZEBRA_IPV4_ROUTE_ADD, ZEBRA_ROUTE_OSPF,
+                      &p, 0, BENCH_CONNECTED, j, 1);
+    }
+  return num;
+}
+
+/* Bytes held by the RIB. */
+static unsigned long
+bench_rib_bytes (void)
+{
+  return mtype_stats_alloc (MTYPE_RIB) * sizeof (struct rib)
+         + mtype_stats_alloc (MTYPE_NEXTHOP) * sizeof (struct nexthop)
+         + mtype_stats_alloc (MTYPE_ROUTE_NODE) * sizeof (struct route_node)
+         + mtype_stats_alloc (MTYPE_RIB_DEST) * sizeof (rib_dest_t)
+         + mtype_stats_alloc (MTYPE_NHG) * sizeof (struct nexthop_group);
+}
+
+static int
+bench_lat_cmp (const void *a, const void *b)
+{
+  unsigned long x = *(const unsigned long *) a;
+  unsigned long y = *(const unsigned long *) b;
+
+  return x < y ? -1 : x > y;
+}
+
+static unsigned long
+bench_percentile (const struct bench_phase *ph, int pct)
+{
+  unsigned long i;
+
+  if (! ph->lat_num)
+    return 0;
+  i = ph->lat_num * pct / 100;
+  return ph->lat[MIN (i, ph->lat_num - 1)];
+}
+
+static void
+bench_report (struct bench_phase *ph)
+{
+  double rate = ph->seconds > 0 ? ph->ops / ph->seconds : 0;
+  int i;
+
+  qsort (ph->lat, ph->lat_num, sizeof (unsigned long), bench_lat_cmp);
+
+  if (bench_json)
+    {
+      printf ("{\"phase\":\"%s\",\"ops\":%lu,\"seconds\":%.6f,"
+              "\"routes_per_sec\":%.0f,"
+              "\"mq_latency_usec\":{\"samples\":%lu,\"p50\":%lu,"
+              "\"p90\":%lu,\"p99\":%lu,\"max\":%lu},"
+              "\"redist_msgs\":%lu,\"redist_per_op\":%.3f,\"busy_sec\":{",
+              ph->name, ph->ops, ph->seconds, rate, ph->lat_num,
+              bench_percentile (ph, 50), bench_percentile (ph, 90),
+              bench_percentile (ph, 99), bench_percentile (ph, 100),
+              ph->redist_msgs,
+              ph->ops ? (double) ph->redist_msgs / ph->ops : 0);
+      for (i = 0; i < BENCH_BUSY_MAX; i++)
+        printf ("%s\"%s\":%.6f", i ? "," : "", bench_busy_name[i],
+                ph->busy[i]);
+      printf ("}}\n");
+    }
+  else
+    {
+      printf ("%-12s %9lu ops %10.6f s %10.0f routes/s  "
+              "mq p50 %lu p90 %lu p99 %lu max %lu usec  redist %lu",
+              ph->name, ph->ops, ph->seconds, rate,
+              bench_percentile (ph, 50), bench_percentile (ph, 90),
+              bench_percentile (ph, 99), bench_percentile (ph, 100),
+              ph->redist_msgs);
+      for (i = 0; i < BENCH_BUSY_MAX; i++)
+        printf ("  %s %.3f", bench_busy_name[i], ph->busy[i]);
+      printf ("\n");
+    }
+  fflush (stdout);
+}
+
+/* Run a phase: inject its routes, and time it until zebra is idle. */
+static void
+bench_phase_run (const char *name, int round, u_char cmd)
+{
+  struct bench_phase ph;
+  struct timeval start;
+
+  memset (&ph, 0, sizeof (ph));
+  if (round >= 0)
+    snprintf (ph.name, sizeof (ph.name), "%s-%d", name, round);
+  else
+    snprintf (ph.name, sizeof (ph.name), "%s", name);
+  bench_phase = &ph;
+
+  quagga_gettime (QUAGGA_CLK_MONOTONIC, &start);
+  if (bench_igp && ! strcmp (name, "igp"))
+    ph.ops = bench_igp_announce ();
+  else
+    {
+      bench_inject_all (cmd, round < 0 ? 0 : round);
+      ph.ops = bench_routes;
+    }
+  ph.busy[BENCH_BUSY_INJECT] += bench_usec_since (&start) / 1e6;
+  bench_run (&ph);
+  ph.seconds = bench_usec_since (&start) / 1e6;
+
+  bench_phase = NULL;
+  bench_report (&ph);
+  if (ph.lat)
+    XFREE (MTYPE_TMP, ph.lat);
+}
+
+static struct zclient *
+bench_client (int type, int listen)
+{
+  struct zclient *zclient;
+
+  zclient = zclient_new ();
+  zclient_init (zclient, type);
+  if (listen)
+    {
+      zclient->redist[ZEBRA_ROUTE_BGP] = 1;
+      zclient->ipv4_route_add = bench_redist_read;
+      zclient->ipv4_route_delete = bench_redist_read;
+    }
+  return zclient;
+}
+
+/* The interface the routes go out of. */
+static void
+bench_interface (void)
+{
+  struct interface *ifp;
+  struct in_addr addr;
+
+  ifp = if_get_by_name ("bench0");
+  if_set_index (ifp, 1);
+  ifp->mtu = 1500;
+  ifp->flags = IFF_UP | IFF_RUNNING | IFF_BROADCAST | IFF_MULTICAST;
+  if_add_update (ifp);
+
+  addr.s_addr = htonl (BENCH_CONNECTED + 1);
+  connected_add_ipv4 (ifp, 0, &addr, 16, NULL, NULL);
+}
+
+static void
+bench_print_config (void)
+{
+  if (bench_json)
+    printf ("{\"benchmark\":\"zebra-rib\",\"version\":\"%s\","
+            "\"routes\":%lu,\"ecmp\":%d,\"depth\":%d,\"churn\":\"%s\","
+            "\"rounds\":%d,\"clients\":%d,\"listeners\":%d,\"ring\":%u,"
+            "\"rib_hold\":%d}\n",
+            QUAGGA_VERSION, bench_routes, bench_ecmp, bench_depth,
+            bench_churn_name[bench_churn], bench_rounds, bench_clients,
+            bench_listeners, bench_ring, rib_process_hold_time);
+  else
+    printf ("zebra-rib %s: %lu routes, ecmp %d, depth %d, churn %s x %d, "
+            "%d clients, %d listeners, ring %u, rib hold %d\n",
+            QUAGGA_VERSION, bench_routes, bench_ecmp, bench_depth,
+            bench_churn_name[bench_churn], bench_rounds, bench_clients,
+            bench_listeners, bench_ring, rib_process_hold_time);
+}
+
+static void
+bench_print_memory (unsigned long before, unsigned long after)
+{
+  unsigned long bytes = after > before ? after - before : 0;
+
+  if (bench_json)
+    printf ("{\"memory\":{\"rib_bytes\":%lu,\"bytes_per_route\":%.1f,"
+            "\"ribs\":%lu,\"nexthops\":%lu,\"route_nodes\":%lu,"
+            "\"nexthop_groups\":%lu}}\n",
+            bytes, (double) bytes / bench_routes,
+            mtype_stats_alloc (MTYPE_RIB), mtype_stats_alloc (MTYPE_NEXTHOP),
+            mtype_stats_alloc (MTYPE_ROUTE_NODE),
+            mtype_stats_alloc (MTYPE_NHG));
+  else
+    printf ("memory       %lu bytes, %.1f bytes/route, %lu ribs, "
+            "%lu nexthops, %lu route nodes, %lu nexthop groups\n",
+            bytes, (double) bytes / bench_routes,
+            mtype_stats_alloc (MTYPE_RIB), mtype_stats_alloc (MTYPE_NEXTHOP),
+            mtype_stats_alloc (MTYPE_ROUTE_NODE),
+            mtype_stats_alloc (MTYPE_NHG));
+  fflush (stdout);
+}
+
+static unsigned long
+bench_number (char *progname, const char *arg, unsigned long min,
+              unsigned long max)
+{
+  char *endptr;
+  unsigned long val;
+
+  errno = 0;
+  val = strtoul (arg, &endptr, 10);
+  if (*arg == '\0' || *endptr != '\0' || errno || val < min || val > max)
+    {
+      fprintf (stderr, "%s: %s is not a number from %lu to %lu\n",
+               progname, arg, min, max);
+      usage (progname, 1);
+    }
+  return val;
+}
+
+/* Main startup routine. */
+int
+main (int argc, char **argv)
+{
+  char *p;
+  char *progname;
+  char *zserv_path = NULL;
+  char path[64];
+  unsigned long before;
+  int i, round;
+
+  /* Set umask before anything for security */
+  umask (0027);
+
+  /* preserve my name */
+  progname = ((p = strrchr (argv[0], '/')) ? ++p : argv[0]);
+
+  zlog_default = openzlog (progname, ZLOG_ZEBRA,
+			   LOG_CONS|LOG_NDELAY|LOG_PID, LOG_DAEMON);
+  zlog_set_level (NULL, ZLOG_DEST_SYSLOG, ZLOG_DISABLED);
+  zlog_set_level (NULL, ZLOG_DEST_STDOUT, ZLOG_DISABLED);
+  zlog_set_level (NULL, ZLOG_DEST_MONITOR, ZLOG_DISABLED);
+
+  while (1)
+    {
+      int opt;
+
+      opt = getopt_long (argc, argv, "n:w:d:c:R:k:l:g:r:o:s:h", longopts, 0);
+
+      if (opt == EOF)
+	break;
+
+      switch (opt)
+	{
+	case 0:
+	  break;
+	case 'n':
+	  bench_routes = bench_number (progname, optarg, 1,
+	                               BENCH_ROUTES_MAX);
+	  break;
+	case 'w':
+	  bench_ecmp = bench_number (progname, optarg, 1, BENCH_ECMP_MAX);
+	  break;
+	case 'd':
+	  /* Zebra resolves nexthops through one level of routes. */
+	  bench_depth = bench_number (progname, optarg, 0, 1);
+	  break;
+	case 'c':
+	  if (! strcmp (optarg, "none"))
+	    bench_churn = BENCH_CHURN_NONE;
+	  else if (! strcmp (optarg, "flap"))
+	    bench_churn = BENCH_CHURN_FLAP;
+	  else if (! strcmp (optarg, "nexthop"))
+	    bench_churn = BENCH_CHURN_NEXTHOP;
+	  else
+	    usage (progname, 1);
+	  break;
+	case 'R':
+	  bench_rounds = bench_number (progname, optarg, 0,
+	                               BENCH_GATE_POOL - BENCH_ECMP_MAX);
+	  break;
+	case 'k':
+	  bench_clients = bench_number (progname, optarg, 1, 64);
+	  break;
+	case 'l':
+	  bench_listeners = bench_number (progname, optarg, 0, 64);
+	  break;
+	case 'g':
+	  bench_ring = bench_number (progname, optarg, 0, 1 << 20);
+	  break;
+	case 'r':
+	  rib_process_hold_time = bench_number (progname, optarg, 0, 10000);
+	  break;
+	case 'o':
+	  if (! strcmp (optarg, "json"))
+	    bench_json = 1;
+	  else if (! strcmp (optarg, "text"))
+	    bench_json = 0;
+	  else
+	    usage (progname, 1);
+	  break;
+	case 's':
+	  zserv_path = optarg;
+	  break;
+	case 'h':
+	  usage (progname, 0);
+	  break;
+	default:
+	  usage (progname, 1);
+	  break;
+	}
+    }
+
+  if (zserv_path == NULL)
+    {
+      snprintf (path, sizeof (path), "/tmp/benchzebra.%d.api", (int) getpid ());
+      zserv_path = path;
+    }
+
+  /* Make master thread emulator. */
+  zebrad.master = master = thread_master_create ();
+
+  /* Vty related initialize. */
+  signal_init (zebrad.master, 0, NULL);
+  cmd_init (1);
+  vty_init (zebrad.master);
+  memory_init ();
+
+  /* Zebra related initialize. */
+  zebra_init ();
+  rib_init ();
+  zebra_if_init ();
+  zebra_debug_init ();
+  router_id_init ();
+  zebra_vty_init ();
+  access_list_init ();
+  prefix_list_init ();
+  zebra_route_map_init ();
+
+  kernel_init ();
+  bench_interface ();
+  zebra_zserv_socket_init (zserv_path);
+
+  bench_queued_hash = hash_create (bench_queued_key, bench_queued_cmp);
+  rib_queue_hook = bench_queue_hook;
+
+  /* Connect the clients. */
+  zclient_serv_path_set (zserv_path);
+  zclient_ring_slots_set (bench_ring);
+  bench_inject = XCALLOC (MTYPE_TMP, bench_clients * sizeof (struct zclient *));
+  for (i = 0; i < bench_clients; i++)
+    bench_inject[i] = bench_client (ZEBRA_ROUTE_BGP, 0);
+  bench_listen = XCALLOC (MTYPE_TMP,
+                          MAX (bench_listeners, 1) * sizeof (struct zclient *));
+  for (i = 0; i < bench_listeners; i++)
+    bench_listen[i] = bench_client (ZEBRA_ROUTE_RIP, 1);
+  if (bench_depth)
+    bench_igp = bench_client (ZEBRA_ROUTE_OSPF, 0);
+  bench_run (NULL);
+
+  bench_print_config ();
+
+  if (bench_igp)
+    bench_phase_run ("igp", -1, ZEBRA_IPV4_ROUTE_ADD);
+
+  before = bench_rib_bytes ();
+  bench_phase_run ("add", -1, ZEBRA_IPV4_ROUTE_ADD);
+  bench_print_memory (before, bench_rib_bytes ());
+
+  for (round = 1; round <= bench_rounds; round++)
+    switch (bench_churn)
+      {
+      case BENCH_CHURN_FLAP:
+        bench_phase_run ("withdraw", round, ZEBRA_IPV4_ROUTE_DELETE);
+        bench_phase_run ("readd", round, ZEBRA_IPV4_ROUTE_ADD);
+        break;
+      case BENCH_CHURN_NEXTHOP:
+        bench_phase_run ("nexthop", round, ZEBRA_IPV4_ROUTE_ADD);
+        break;
+      default:
+        break;
+      }
+
+  bench_phase_run ("delete", -1, ZEBRA_IPV4_ROUTE_DELETE);
+
+  unlink (zserv_path);
+  return 0;
+}
@@ -67,7 +67,7 @@ connected_withdraw (struct connected *ifc)
 
   if (!CHECK_FLAG (ifc->conf, ZEBRA_IFC_CONFIGURED))
     {
-      listnode_delete (ifc->ifp->connected, ifc);
+      connected_delete (ifc->ifp, ifc);
       connected_free (ifc);
     }
 }
@@ -78,7 +78,7 @@ connected_announce (struct interface *ifp, struct connected *ifc)
   if (!ifc)
     return;
   
-  listnode_add (ifp->connected, ifc);
+  connected_add (ifp, ifc);
 
   /* Update interface address information to protocol daemon. */
   if (ifc->address->family == AF_INET)
@@ -192,10 +192,10 @@ connected_up_ipv4 (struct interface *ifp, struct connected *ifc)
     return;
 
   rib_add_ipv4 (ZEBRA_ROUTE_CONNECT, 0, &p, NULL, NULL, ifp->ifindex,
-	RT_TABLE_MAIN, ifp->metric, 0, SAFI_UNICAST);
+	RT_TABLE_MAIN, 0, ifp->metric, 0, SAFI_UNICAST);
 
   rib_add_ipv4 (ZEBRA_ROUTE_CONNECT, 0, &p, NULL, NULL, ifp->ifindex,
-	RT_TABLE_MAIN, ifp->metric, 0, SAFI_MULTICAST);
+	RT_TABLE_MAIN, 0, ifp->metric, 0, SAFI_MULTICAST);
 
   rib_update ();
 }
@@ -304,9 +304,11 @@ connected_down_ipv4 (struct interface *ifp, struct connected *ifc)
     return;
 
   /* Same logic as for connected_up_ipv4(): push the changes into the head. */
-  rib_delete_ipv4 (ZEBRA_ROUTE_CONNECT, 0, &p, NULL, ifp->ifindex, 0, SAFI_UNICAST);
+  rib_delete_ipv4 (ZEBRA_ROUTE_CONNECT, 0, &p, NULL, ifp->ifindex, 0, 0,
+		   SAFI_UNICAST);
 
-  rib_delete_ipv4 (ZEBRA_ROUTE_CONNECT, 0, &p, NULL, ifp->ifindex, 0, SAFI_MULTICAST);
+  rib_delete_ipv4 (ZEBRA_ROUTE_CONNECT, 0, &p, NULL, ifp->ifindex, 0, 0,
+		   SAFI_MULTICAST);
 
   rib_update ();
 }
@@ -354,7 +356,7 @@ connected_up_ipv6 (struct interface *ifp, struct connected *ifc)
 #endif
 
   rib_add_ipv6 (ZEBRA_ROUTE_CONNECT, 0, &p, NULL, ifp->ifindex, RT_TABLE_MAIN,
-                ifp->metric, 0, SAFI_UNICAST);
+                0, ifp->metric, 0, SAFI_UNICAST);
 
   rib_update ();
 }
@@ -436,7 +438,8 @@ connected_down_ipv6 (struct interface *ifp, struct connected *ifc)
   if (IN6_IS_ADDR_UNSPECIFIED (&p.prefix))
     return;
 
-  rib_delete_ipv6 (ZEBRA_ROUTE_CONNECT, 0, &p, NULL, ifp->ifindex, 0, SAFI_UNICAST);
+  rib_delete_ipv6 (ZEBRA_ROUTE_CONNECT, 0, &p, NULL, ifp->ifindex, 0, 0,
+		   SAFI_UNICAST);
 
   rib_update ();
 }
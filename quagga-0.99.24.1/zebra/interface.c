@@ -68,7 +68,6 @@ if_zebra_new_hook (struct interface *ifp)
     rtadv->AdvSendAdvertisements = 0;
     rtadv->MaxRtrAdvInterval = RTADV_MAX_RTR_ADV_INTERVAL;
     rtadv->MinRtrAdvInterval = RTADV_MIN_RTR_ADV_INTERVAL;
-    rtadv->AdvIntervalTimer = 0;
     rtadv->AdvManagedFlag = 0;
     rtadv->AdvOtherConfigFlag = 0;
     rtadv->AdvHomeAgentFlag = 0;
@@ -107,6 +106,10 @@ if_zebra_delete_hook (struct interface *ifp)
       if (zebra_if->ipv4_subnets)
 	route_table_finish (zebra_if->ipv4_subnets);
 
+#ifdef RTADV
+      rtadv_if_delete (ifp);
+#endif /* RTADV */
+
       XFREE (MTYPE_TMP, zebra_if);
     }
 
@@ -476,7 +479,7 @@ if_delete_update (struct interface *ifp)
 		  /* Remove from interface address list (unconditionally). */
 		  if (!CHECK_FLAG (ifc->conf, ZEBRA_IFC_CONFIGURED))
 		    {
-		      listnode_delete (ifp->connected, ifc);
+		      connected_delete (ifp, ifc);
 		      connected_free (ifc);
                     }
                   else
@@ -502,7 +505,7 @@ if_delete_update (struct interface *ifp)
 		last = node;
 	      else
 		{
-		  listnode_delete (ifp->connected, ifc);
+		  connected_delete (ifp, ifc);
 		  connected_free (ifc);
 		}
 	    }
@@ -520,7 +523,7 @@ if_delete_update (struct interface *ifp)
      while processing the deletion.  Each client daemon is responsible
      for setting ifindex to IFINDEX_INTERNAL after processing the
      interface deletion message. */
-  ifp->ifindex = IFINDEX_INTERNAL;
+  if_set_index (ifp, IFINDEX_INTERNAL);
 }
 
 /* Interface is up. */
@@ -692,6 +695,12 @@ nd_dump_vty (struct vty *vty, struct interface *ifp)
       if (rtadv->AdvIntervalOption)
       	vty_out (vty, "  ND router advertisements with Adv. Interval option.%s",
 		 VTY_NEWLINE);
+      vty_out (vty, "  ND router advertisements sent: %u, failed: %u, "
+	       "built: %u%s", rtadv->AdvSent, rtadv->AdvSendFailed,
+	       rtadv->AdvBuilt, VTY_NEWLINE);
+      vty_out (vty, "  ND router solicitations received: %u, "
+	       "advertisements received: %u%s", rtadv->SolicitRcvd,
+	       rtadv->AdvRcvd, VTY_NEWLINE);
     }
 }
 #endif /* RTADV */
@@ -1252,7 +1261,7 @@ ip_address_install (struct vty *vty, struct interface *ifp,
 	ifc->label = XSTRDUP (MTYPE_CONNECTED_LABEL, label);
 
       /* Add to linked list. */
-      listnode_add (ifp->connected, ifc);
+      connected_add (ifp, ifc);
     }
 
   /* This address is configured from zebra. */
@@ -1323,7 +1332,7 @@ ip_address_uninstall (struct vty *vty, struct interface *ifp,
   if (! CHECK_FLAG (ifc->conf, ZEBRA_IFC_QUEUED)
       || ! CHECK_FLAG (ifp->status, ZEBRA_INTERFACE_ACTIVE))
     {
-      listnode_delete (ifp->connected, ifc);
+      connected_delete (ifp, ifc);
       connected_free (ifc);
       return CMD_WARNING;
     }
@@ -1431,7 +1440,7 @@ ipv6_address_install (struct vty *vty, struct interface *ifp,
 	ifc->label = XSTRDUP (MTYPE_CONNECTED_LABEL, label);
 
       /* Add to linked list. */
-      listnode_add (ifp->connected, ifc);
+      connected_add (ifp, ifc);
     }
 
   /* This address is configured from zebra. */
@@ -1502,7 +1511,7 @@ ipv6_address_uninstall (struct vty *vty, struct interface *ifp,
   if (! CHECK_FLAG (ifc->conf, ZEBRA_IFC_QUEUED)
       || ! CHECK_FLAG (ifp->status, ZEBRA_INTERFACE_ACTIVE))
     {
-      listnode_delete (ifp->connected, ifc);
+      connected_delete (ifp, ifc);
       connected_free (ifc);
       return CMD_WARNING;
     }
@@ -67,12 +67,19 @@ struct rtadvconf
      MUST be no less than 30 ms [RFC6275 7.5].
      MUST be no greater than .75 * MaxRtrAdvInterval.
 
-     Default: 0.33 * MaxRtrAdvInterval */
-  int MinRtrAdvInterval; /* This field is currently unused. */
+     Default: 0.33 * MaxRtrAdvInterval
+
+     Unsolicited advertisements are put on the timer wheel a random
+     time between this and MaxRtrAdvInterval apart. */
+  int MinRtrAdvInterval;
 #define RTADV_MIN_RTR_ADV_INTERVAL (0.33 * RTADV_MAX_RTR_ADV_INTERVAL)
 
-  /* Unsolicited Router Advertisements' interval timer. */
-  int AdvIntervalTimer;
+  /* When the next unsolicited Router Advertisement is due, in
+     milliseconds of the monotonic clock, and the next and previous
+     interfaces in its slot of the timer wheel. */
+  unsigned long long AdvNextSend;
+  struct interface *AdvWheelNext;
+  struct interface **AdvWheelPrev;
 
   /* The TRUE/FALSE value to be placed in the "Managed address
      configuration" flag field in the Router Advertisement.  See
@@ -176,6 +183,20 @@ struct rtadvconf
      Default: 0 (medium) */
   int DefaultPreference;
 #define RTADV_PREF_MEDIUM 0x0 /* Per RFC4191. */
+
+  /* The Router Advertisement as last built, NULL once anything it is
+     built from has changed, and the link-layer address it carries. */
+  u_char *AdvPacket;
+  int AdvPacketLen;
+  u_char AdvPacketHwAddr[INTERFACE_HWADDR_MAX];
+  int AdvPacketHwAddrLen;
+
+  /* Statistics. */
+  u_int32_t AdvSent;
+  u_int32_t AdvSendFailed;
+  u_int32_t AdvBuilt;
+  u_int32_t SolicitRcvd;
+  u_int32_t AdvRcvd;
 };
 
 #endif /* RTADV */
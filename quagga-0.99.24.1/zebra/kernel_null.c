@@ -29,16 +29,28 @@
 #include "zebra/redistribute.h"
 #include "zebra/connected.h"
 
-int kernel_add_ipv4 (struct prefix *a, struct rib *b) { return 0; }
-#ifdef HAVE_SYS_WEAK_ALIAS_PRAGMA
-#pragma weak kernel_delete_ipv4 = kernel_add_ipv4
-#else
+/* Take the route as the kernel would, so that routes can resolve
+   through it. */
+static int
+kernel_null_install (struct rib *rib)
+{
+  struct nexthop *nexthop, *tnexthop;
+  int recursing;
+
+  for (ALL_NEXTHOPS_RO(rib->nexthop, nexthop, tnexthop, recursing))
+    if (CHECK_FLAG (nexthop->flags, NEXTHOP_FLAG_ACTIVE))
+      SET_FLAG (nexthop->flags, NEXTHOP_FLAG_FIB);
+  return 0;
+}
+
+int kernel_add_ipv4 (struct prefix *a, struct rib *b)
+{ return kernel_null_install (b); }
 int kernel_delete_ipv4 (struct prefix *a, struct rib *b) { return 0; }
-#endif
 
-int kernel_add_ipv6 (struct prefix *a, struct rib *b) { return 0; }
+int kernel_add_ipv6 (struct prefix *a, struct rib *b)
+{ return kernel_null_install (b); }
 #ifdef HAVE_SYS_WEAK_ALIAS_PRAGMA
-#pragma weak kernel_delete_ipv6 = kernel_add_ipv6
+#pragma weak kernel_delete_ipv6 = kernel_delete_ipv4
 #else
 int kernel_delete_ipv6 (struct prefix *a, struct rib *b) { return 0; }
 #endif
@@ -46,6 +58,14 @@ int kernel_delete_ipv6 (struct prefix *a, struct rib *b) { return 0; }
 int kernel_add_route (struct prefix_ipv4 *a, struct in_addr *b, int c, int d)
 { return 0; }
 
+int kernel_nhg_update (struct prefix *a, struct rib *b) { return -1; }
+void kernel_nhg_delete (struct nexthop_group *a) { return; }
+
+#ifdef HAVE_NETLINK
+void kernel_netlink_show (struct vty *a) { return; }
+void kernel_netlink_clear (void) { return; }
+#endif /* HAVE_NETLINK */
+
 int kernel_address_add_ipv4 (struct interface *a, struct connected *b)
 {
   zlog_debug ("%s", __func__);
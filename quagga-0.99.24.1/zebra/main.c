@@ -40,6 +40,7 @@
 #include "zebra/irdp.h"
 #include "zebra/rtadv.h"
 #include "zebra/zebra_fpm.h"
+#include "zebra/zebra_lookup.h"
 
 /* Zebra instance */
 struct zebra_t zebrad =
@@ -59,6 +60,9 @@ int retain_mode = 0;
 /* Don't delete kernel route. */
 int keep_kernel_mode = 0;
 
+/* Seconds to reconcile old zebra routes in the kernel, 0 to sweep. */
+int reconcile_time = 0;
+
 #ifdef HAVE_NETLINK
 /* Receive buffer size for netlink socket */
 u_int32_t nl_rcvbufsize = 0;
@@ -70,6 +74,7 @@ struct option longopts[] =
   { "batch",       no_argument,       NULL, 'b'},
   { "daemon",      no_argument,       NULL, 'd'},
   { "keep_kernel", no_argument,       NULL, 'k'},
+  { "reconcile",   required_argument, NULL, 'R'},
   { "config_file", required_argument, NULL, 'f'},
   { "pid_file",    required_argument, NULL, 'i'},
   { "socket",      required_argument, NULL, 'z'},
@@ -133,6 +138,9 @@ usage (char *progname, int status)
 	      "-z, --socket       Set path of zebra socket\n"\
 	      "-k, --keep_kernel  Don't delete old routes which installed by "\
 				  "zebra.\n"\
+	      "-R, --reconcile    Keep old routes installed by zebra for the "\
+				  "given seconds,\n"\
+	      "                   replacing only those that changed\n"\
 	      "-C, --dryrun       Check configuration for validity and exit\n"\
 	      "-A, --vty_addr     Set vty's bind address\n"\
 	      "-P, --vty_port     Set vty's port number\n"\
@@ -233,9 +241,9 @@ main (int argc, char **argv)
       int opt;
   
 #ifdef HAVE_NETLINK  
-      opt = getopt_long (argc, argv, "bdkf:i:z:hA:P:ru:g:vs:C", longopts, 0);
+      opt = getopt_long (argc, argv, "bdkR:f:i:z:hA:P:ru:g:vs:C", longopts, 0);
 #else
-      opt = getopt_long (argc, argv, "bdkf:i:z:hA:P:ru:g:vC", longopts, 0);
+      opt = getopt_long (argc, argv, "bdkR:f:i:z:hA:P:ru:g:vC", longopts, 0);
 #endif /* HAVE_NETLINK */
 
       if (opt == EOF)
@@ -253,6 +261,14 @@ main (int argc, char **argv)
 	case 'k':
 	  keep_kernel_mode = 1;
 	  break;
+	case 'R':
+	  reconcile_time = atoi (optarg);
+	  if (reconcile_time <= 0)
+	    {
+	      fprintf (stderr, "Invalid reconcile time: %s\n", optarg);
+	      usage (progname, 1);
+	    }
+	  break;
 	case 'C':
 	  dryrun = 1;
 	  break;
@@ -353,6 +369,8 @@ main (int argc, char **argv)
   zfpm_init (zebrad.master, 0, 0);
 #endif
 
+  zlookup_init (zebrad.master, zserv_path);
+
   /* Process the configuration file. Among other configuration
   *  directives we can meet those installing static routes. Such
   *  requests will not be executed immediately, but queued in
@@ -367,7 +385,10 @@ main (int argc, char **argv)
     return(0);
   
   /* Clean up rib. */
-  rib_weed_tables ();
+  if (reconcile_time && ! keep_kernel_mode)
+    rib_reconcile_start (reconcile_time);
+  else
+    rib_weed_tables ();
 
   /* Exit when zebra is working in batch mode. */
   if (batch_mode)
@@ -391,7 +412,7 @@ main (int argc, char **argv)
   *  will be equal to the current getpid(). To know about such routes,
   * we have to have route_read() called before.
   */
-  if (! keep_kernel_mode)
+  if (! keep_kernel_mode && ! reconcile_time)
     rib_sweep_route ();
 
   /* Needed for BSD routing socket. */
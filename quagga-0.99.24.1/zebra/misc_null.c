@@ -28,6 +28,7 @@
 #include "zebra/zebra_fpm.h"
 
 void ifstat_update_proc (void) { return; }
+void rtadv_if_delete (struct interface *ifp) { return; }
 #ifdef HAVE_SYS_WEAK_ALIAS_PRAGMA
 #pragma weak rtadv_config_write = ifstat_update_proc
 #pragma weak irdp_config_write = ifstat_update_proc
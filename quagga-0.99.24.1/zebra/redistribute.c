@@ -30,6 +30,9 @@
 #include "zclient.h"
 #include "linklist.h"
 #include "log.h"
+#include "memory.h"
+#include "thread.h"
+#include "buffer.h"
 
 #include "zebra/rib.h"
 #include "zebra/zserv.h"
@@ -137,35 +140,204 @@ zebra_redistribute_default (struct zserv *client)
 #endif /* HAVE_IPV6 */
 }
 
-/* Redistribute routes. */
+/* The routes of a type a client has just asked for are sent as a
+ * background dump rather than all at once, so a full table does not
+ * hold zebra up.  The dump walks the unicast tables with a pausable
+ * iterator, yields once its time slice is used up and stops whenever
+ * the client's output is backed up, to carry on when it has drained.
+ * Changes to routes the dump has not reached yet are still sent as they
+ * happen; the dump then sends the route's current state again, which
+ * clients take as a replacement.
+ */
+struct zebra_redist_dump
+{
+  int type;
+  u_int32_t vrf_id;
+  afi_t afi;
+  route_table_iter_t iter;
+};
+
+static int zebra_redistribute_dump (struct thread *);
+
+static int
+zebra_redistribute_blocked (struct zserv *client)
+{
+  return listhead (client->pending_fifo) || ! buffer_empty (client->wb);
+}
+
 static void
-zebra_redistribute (struct zserv *client, int type)
+zebra_redistribute_schedule (struct zserv *client)
 {
-  struct rib *newrib;
-  struct route_table *table;
-  struct route_node *rn;
+  if (! client->t_redist && listhead (client->redist_dump)
+      && ! zebra_redistribute_blocked (client))
+    client->t_redist = thread_add_event (zebrad.master,
+                                         zebra_redistribute_dump, client, 0);
+}
 
-  table = vrf_table (AFI_IP, SAFI_UNICAST, 0);
-  if (table)
-    for (rn = route_top (table); rn; rn = route_next (rn))
-      RNODE_FOREACH_RIB (rn, newrib)
-	if (CHECK_FLAG (newrib->flags, ZEBRA_FLAG_SELECTED) 
-	    && newrib->type == type 
-	    && newrib->distance != DISTANCE_INFINITY
-	    && zebra_check_addr (&rn->p))
-	  zsend_route_multipath (ZEBRA_IPV4_ROUTE_ADD, client, &rn->p, newrib);
-  
+static void
+zebra_redistribute_dump_free (struct zserv *client,
+                              struct zebra_redist_dump *dump)
+{
+  route_table_iter_cleanup (&dump->iter);
+  listnode_delete (client->redist_dump, dump);
+  XFREE (MTYPE_REDIST_DUMP, dump);
+}
+
+/* Start sending the routes of type in VRF vrf_id to client. */
+static void
+zebra_redistribute (struct zserv *client, int type, u_int32_t vrf_id)
+{
+  struct zebra_redist_dump *dump;
+
+  dump = XCALLOC (MTYPE_REDIST_DUMP, sizeof (struct zebra_redist_dump));
+  dump->type = type;
+  dump->vrf_id = vrf_id;
+  dump->afi = AFI_IP;
+  route_table_iter_init (&dump->iter,
+                         vrf_table (AFI_IP, SAFI_UNICAST, vrf_id));
+  listnode_add (client->redist_dump, dump);
+
+  zebra_redistribute_schedule (client);
+}
+
+/* Stop an unfinished dump of type in VRF vrf_id to client. */
+static void
+zebra_redistribute_cancel (struct zserv *client, int type, u_int32_t vrf_id)
+{
+  struct listnode *node, *nnode;
+  struct zebra_redist_dump *dump;
+
+  for (ALL_LIST_ELEMENTS (client->redist_dump, node, nnode, dump))
+    if (dump->type == type && dump->vrf_id == vrf_id)
+      zebra_redistribute_dump_free (client, dump);
+}
+
+/* Move a dump on to the next table, returning 0 when there is none. */
+static int
+zebra_redistribute_dump_next_table (struct zebra_redist_dump *dump)
+{
+  struct route_table *table = NULL;
+
+  route_table_iter_cleanup (&dump->iter);
 #ifdef HAVE_IPV6
-  table = vrf_table (AFI_IP6, SAFI_UNICAST, 0);
-  if (table)
-    for (rn = route_top (table); rn; rn = route_next (rn))
-      RNODE_FOREACH_RIB (rn, newrib)
-	if (CHECK_FLAG (newrib->flags, ZEBRA_FLAG_SELECTED)
-	    && newrib->type == type 
-	    && newrib->distance != DISTANCE_INFINITY
-	    && zebra_check_addr (&rn->p))
-	  zsend_route_multipath (ZEBRA_IPV6_ROUTE_ADD, client, &rn->p, newrib);
+  if (dump->afi == AFI_IP)
+    {
+      dump->afi = AFI_IP6;
+      table = vrf_table (AFI_IP6, SAFI_UNICAST, dump->vrf_id);
+    }
 #endif /* HAVE_IPV6 */
+  if (! table)
+    return 0;
+
+  route_table_iter_init (&dump->iter, table);
+  return 1;
+}
+
+static int
+zebra_redistribute_dump (struct thread *thread)
+{
+  struct zserv *client = THREAD_ARG (thread);
+  struct zebra_redist_dump *dump;
+  struct route_node *rn;
+  struct rib *newrib;
+
+  /* Sending may schedule the next run already, see
+     zebra_redistribute_resume(). */
+  client->t_redist = NULL;
+
+  while (listhead (client->redist_dump))
+    {
+      dump = listgetdata (listhead (client->redist_dump));
+
+      while (1)
+        {
+          if (zebra_redistribute_blocked (client))
+            {
+              /* Carried on by zebra_redistribute_resume(). */
+              route_table_iter_pause (&dump->iter);
+              return 0;
+            }
+          if (thread_should_yield (thread))
+            {
+              route_table_iter_pause (&dump->iter);
+              if (! client->t_redist)
+                client->t_redist = thread_add_event (zebrad.master,
+                                                     zebra_redistribute_dump,
+                                                     client, 0);
+              return 0;
+            }
+
+          if (dump->iter.table)
+            rn = route_table_iter_next (&dump->iter);
+          else
+            rn = NULL;
+          if (! rn)
+            {
+              if (zebra_redistribute_dump_next_table (dump))
+                continue;
+              break;
+            }
+
+          RNODE_FOREACH_RIB (rn, newrib)
+            if (CHECK_FLAG (newrib->flags, ZEBRA_FLAG_SELECTED)
+                && newrib->type == dump->type
+                && newrib->distance != DISTANCE_INFINITY
+                && zebra_check_addr (&rn->p))
+              zsend_route_multipath (dump->afi == AFI_IP
+                                     ? ZEBRA_IPV4_ROUTE_ADD
+                                     : ZEBRA_IPV6_ROUTE_ADD,
+                                     client, &rn->p, newrib);
+        }
+
+      zebra_redistribute_dump_free (client, dump);
+    }
+  return 0;
+}
+
+/* The client's output has drained, carry on with any dump. */
+void
+zebra_redistribute_resume (struct zserv *client)
+{
+  zebra_redistribute_schedule (client);
+}
+
+/* Drop the client's unfinished dumps and its subscriptions in VRFs
+   other than the default. */
+void
+zebra_redistribute_stop (struct zserv *client)
+{
+  unsigned int i;
+
+  THREAD_OFF (client->t_redist);
+  while (listhead (client->redist_dump))
+    zebra_redistribute_dump_free (client,
+                                  listgetdata (listhead (client->redist_dump)));
+
+  for (i = 0; i < vector_active (client->redist_vrf); i++)
+    if (vector_slot (client->redist_vrf, i))
+      {
+        XFREE (MTYPE_REDIST_VRF, vector_slot (client->redist_vrf, i));
+        vector_unset (client->redist_vrf, i);
+      }
+}
+
+/* The route types client redistributes in VRF vrf_id, or NULL if it
+   has never asked for any there and create is not set. */
+static u_char *
+zebra_redist_types (struct zserv *client, u_int32_t vrf_id, int create)
+{
+  u_char *redist;
+
+  if (vrf_id == 0)
+    return client->redist;
+
+  redist = vector_lookup (client->redist_vrf, vrf_id);
+  if (! redist && create)
+    {
+      redist = XCALLOC (MTYPE_REDIST_VRF, ZEBRA_ROUTE_MAX);
+      vector_set_index (client->redist_vrf, vrf_id, redist);
+    }
+  return redist;
 }
 
 void
@@ -173,12 +345,16 @@ redistribute_add (struct prefix *p, struct rib *rib)
 {
   struct listnode *node, *nnode;
   struct zserv *client;
+  u_char *redist;
 
   for (ALL_LIST_ELEMENTS (zebrad.client_list, node, nnode, client))
     {
+      if ((redist = zebra_redist_types (client, rib->vrf_id, 0)) == NULL)
+        continue;
+
       if (is_default (p))
         {
-          if (client->redist_default || client->redist[rib->type])
+          if ((client->redist_default && ! rib->vrf_id) || redist[rib->type])
             {
               if (p->family == AF_INET)
                 zsend_route_multipath (ZEBRA_IPV4_ROUTE_ADD, client, p, rib);
@@ -188,7 +364,7 @@ redistribute_add (struct prefix *p, struct rib *rib)
 #endif /* HAVE_IPV6 */	  
 	    }
         }
-      else if (client->redist[rib->type])
+      else if (redist[rib->type])
         {
           if (p->family == AF_INET)
             zsend_route_multipath (ZEBRA_IPV4_ROUTE_ADD, client, p, rib);
@@ -205,6 +381,7 @@ redistribute_delete (struct prefix *p, struct rib *rib)
 {
   struct listnode *node, *nnode;
   struct zserv *client;
+  u_char *redist;
 
   /* Add DISTANCE_INFINITY check. */
   if (rib->distance == DISTANCE_INFINITY)
@@ -212,9 +389,12 @@ redistribute_delete (struct prefix *p, struct rib *rib)
 
   for (ALL_LIST_ELEMENTS (zebrad.client_list, node, nnode, client))
     {
+      if ((redist = zebra_redist_types (client, rib->vrf_id, 0)) == NULL)
+        continue;
+
       if (is_default (p))
 	{
-	  if (client->redist_default || client->redist[rib->type])
+	  if ((client->redist_default && ! rib->vrf_id) || redist[rib->type])
 	    {
 	      if (p->family == AF_INET)
 		zsend_route_multipath (ZEBRA_IPV4_ROUTE_DELETE, client, p,
@@ -226,7 +406,7 @@ redistribute_delete (struct prefix *p, struct rib *rib)
 #endif /* HAVE_IPV6 */
 	    }
 	}
-      else if (client->redist[rib->type])
+      else if (redist[rib->type])
 	{
 	  if (p->family == AF_INET)
 	    zsend_route_multipath (ZEBRA_IPV4_ROUTE_DELETE, client, p, rib);
@@ -242,16 +422,18 @@ void
 zebra_redistribute_add (int command, struct zserv *client, int length)
 {
   int type;
+  u_char *redist;
 
   type = stream_getc (client->ibuf);
 
   if (type == 0 || type >= ZEBRA_ROUTE_MAX)
     return;
 
-  if (! client->redist[type])
+  redist = zebra_redist_types (client, client->vrf_id, 1);
+  if (! redist[type])
     {
-      client->redist[type] = 1;
-      zebra_redistribute (client, type);
+      redist[type] = 1;
+      zebra_redistribute (client, type, client->vrf_id);
     }
 }
 
@@ -259,13 +441,18 @@ void
 zebra_redistribute_delete (int command, struct zserv *client, int length)
 {
   int type;
+  u_char *redist;
 
   type = stream_getc (client->ibuf);
 
   if (type == 0 || type >= ZEBRA_ROUTE_MAX)
     return;
 
-  client->redist[type] = 0;
+  if ((redist = zebra_redist_types (client, client->vrf_id, 0)) == NULL)
+    return;
+
+  redist[type] = 0;
+  zebra_redistribute_cancel (client, type, client->vrf_id);
 }
 
 void
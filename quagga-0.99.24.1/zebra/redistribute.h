@@ -32,6 +32,9 @@ extern void zebra_redistribute_delete (int, struct zserv *, int);
 extern void zebra_redistribute_default_add (int, struct zserv *, int);
 extern void zebra_redistribute_default_delete (int, struct zserv *, int);
 
+extern void zebra_redistribute_resume (struct zserv *);
+extern void zebra_redistribute_stop (struct zserv *);
+
 extern void redistribute_add (struct prefix *, struct rib *);
 extern void redistribute_delete (struct prefix *, struct rib *);
 
@@ -46,6 +46,17 @@ struct rib
   
   /* Nexthop structure */
   struct nexthop *nexthop;
+
+  /* Shared group of the same nexthops, which caches their resolution,
+     or NULL until the nexthops are first resolved. */
+  struct nexthop_group *nhg;
+
+  /* Kernel nexthop object the route is installed with, 0 if it is
+     installed with its nexthops inline, and the group of the object,
+     which is kept while the route is installed with it even if the
+     route has moved to another group or to none. */
+  u_int32_t kernel_nhid;
+  struct nexthop_group *kernel_nhg;
   
   /* Refrence count. */
   unsigned long refcnt;
@@ -59,6 +70,9 @@ struct rib
   /* Which routing table */
   int table;			
 
+  /* VRF the route belongs to. */
+  u_int32_t vrf_id;
+
   /* Metric */
   u_int32_t metric;
 
@@ -74,6 +88,8 @@ struct rib
   /* RIB internal status */
   u_char status;
 #define RIB_ENTRY_REMOVED	(1 << 0)
+#define RIB_ENTRY_PROVISIONAL	(1 << 1)
+#define RIB_ENTRY_STALE		(1 << 2)
 
   /* Nexthop information. */
   u_char nexthop_num;
@@ -89,12 +105,58 @@ struct rib
  * sub-queue 4: any other origin (if any)
  */
 #define MQ_SIZE 5
+
+/* When the route nodes of a sub-queue were queued, oldest first, in
+ * milliseconds of the monotonic clock.
+ */
+struct meta_queue_times
+{
+  u_int32_t *ms;
+  u_int32_t head;
+  u_int32_t num;
+  u_int32_t size;
+};
+
 struct meta_queue
 {
   struct list *subq[MQ_SIZE];
   u_int32_t size; /* sum of lengths of all subqueues */
+  struct meta_queue_times times[MQ_SIZE];
+
+  /* Sub-queue whose turn it is, and how many more route nodes it may
+   * take before the next one's turn.
+   */
+  u_char turn;
+  u_int32_t credit;
 };
 
+/* Scheduling of the sub-queues: each gets weight route nodes in turn,
+ * except that a sub-queue whose oldest node has waited longer than its
+ * latency target is served first.
+ */
+struct meta_queue_class
+{
+  const char *name;
+  u_int32_t weight;
+  u_int32_t target; /* milliseconds */
+
+  /* Statistics over all VRFs. */
+  u_int32_t queued;
+  unsigned long processed;
+  unsigned long promoted;
+  unsigned long late;
+  unsigned long long wait_total; /* milliseconds */
+  u_int32_t wait_max;
+};
+
+#define MQ_WEIGHT_MAX           1000
+#define MQ_TARGET_MAX           600000
+
+extern struct meta_queue_class mq_class[MQ_SIZE];
+extern const struct meta_queue_class mq_class_default[MQ_SIZE];
+
+extern u_int32_t rib_generation;
+
 /*
  * Structure that represents a single destination (prefix).
  */
@@ -117,6 +179,12 @@ typedef struct rib_dest_t_
    */
   u_int32_t flags;
 
+  /*
+   * Time (in msecs) at which the dest was put on the FPM processing
+   * queue, for statistics.
+   */
+  u_int32_t fpm_q_time;
+
   /*
    * Linkage to put dest on the FPM processing queue.
    */
@@ -334,8 +402,23 @@ struct vrf
 
   /* Static route configuration.  */
   struct route_table *stable[AFI_MAX][SAFI_MAX];
+
+  /* Route nodes of this VRF waiting for rib_process(), and whether the
+     VRF is on zebrad.mq_vrfs to have them processed. */
+  struct meta_queue *mq;
+  u_char mq_scheduled;
+
+  /* Statistics. */
+  unsigned long rib_cnt[AFI_MAX];
+  unsigned long processed;
 };
 
+/* Non-default VRFs install their routes into the kernel table of the
+   same number, so the ids of the Linux default, main and local tables
+   (253 to 255) are not usable. */
+#define VRF_ID_MAX            65535
+#define VRF_ID_RESERVED(id)   ((id) >= 253 && (id) <= 255)
+
 /*
  * rib_table_info_t
  *
@@ -399,6 +482,7 @@ extern struct nexthop *nexthop_ipv4_ifindex_add (struct rib *,
                                                  struct in_addr *,
                                                  unsigned int);
 extern int nexthop_has_fib_child(struct nexthop *);
+extern void nexthops_free (struct nexthop *);
 extern void rib_lookup_and_dump (struct prefix_ipv4 *);
 extern void rib_lookup_and_pushup (struct prefix_ipv4 *);
 #define rib_dump(prefix ,rib) _rib_dump(__func__, prefix, rib)
@@ -416,6 +500,8 @@ extern struct nexthop *nexthop_ipv6_add (struct rib *, struct in6_addr *);
 #endif /* HAVE_IPV6 */
 
 extern struct vrf *vrf_lookup (u_int32_t);
+extern struct vrf *vrf_get (u_int32_t);
+extern int vrf_id_get_next (u_int32_t, u_int32_t *);
 extern struct route_table *vrf_table (afi_t afi, safi_t safi, u_int32_t id);
 extern struct route_table *vrf_static_table (afi_t afi, safi_t safi, u_int32_t id);
 
@@ -424,14 +510,14 @@ extern struct route_table *vrf_static_table (afi_t afi, safi_t safi, u_int32_t i
  * also implicitly withdraw equal prefix of same type. */
 extern int rib_add_ipv4 (int type, int flags, struct prefix_ipv4 *p, 
 			 struct in_addr *gate, struct in_addr *src,
-			 unsigned int ifindex, u_int32_t vrf_id,
-			 u_int32_t, u_char, safi_t);
+			 unsigned int ifindex, u_int32_t kernel_table,
+			 u_int32_t vrf_id, u_int32_t, u_char, safi_t);
 
 extern int rib_add_ipv4_multipath (struct prefix_ipv4 *, struct rib *, safi_t);
 
 extern int rib_delete_ipv4 (int type, int flags, struct prefix_ipv4 *p,
 		            struct in_addr *gate, unsigned int ifindex, 
-		            u_int32_t, safi_t safi);
+		            u_int32_t kernel_table, u_int32_t vrf_id, safi_t safi);
 
 extern struct rib *rib_match_ipv4_safi (struct in_addr addr, safi_t safi,
 					int skip_bgp, struct route_node **rn_out);
@@ -443,6 +529,9 @@ extern struct rib *rib_lookup_ipv4 (struct prefix_ipv4 *);
 extern void rib_update (void);
 extern void rib_weed_tables (void);
 extern void rib_sweep_route (void);
+extern void rib_reconcile_start (int);
+extern unsigned long rib_mark_kernel_stale (afi_t);
+extern unsigned long rib_sweep_kernel_stale (afi_t, int);
 extern void rib_close (void);
 extern void rib_init (void);
 extern unsigned long rib_score_proto (u_char proto);
@@ -458,12 +547,13 @@ static_delete_ipv4_safi (safi_t safi, struct prefix *p, struct in_addr *gate,
 #ifdef HAVE_IPV6
 extern int
 rib_add_ipv6 (int type, int flags, struct prefix_ipv6 *p,
-	      struct in6_addr *gate, unsigned int ifindex, u_int32_t vrf_id,
-	      u_int32_t metric, u_char distance, safi_t safi);
+	      struct in6_addr *gate, unsigned int ifindex, u_int32_t kernel_table,
+	      u_int32_t vrf_id, u_int32_t metric, u_char distance, safi_t safi);
 
 extern int
 rib_delete_ipv6 (int type, int flags, struct prefix_ipv6 *p,
-		 struct in6_addr *gate, unsigned int ifindex, u_int32_t vrf_id, safi_t safi);
+		 struct in6_addr *gate, unsigned int ifindex, u_int32_t kernel_table,
+		 u_int32_t vrf_id, safi_t safi);
 
 extern struct rib *rib_lookup_ipv6 (struct in6_addr *);
 
@@ -26,6 +26,7 @@
 #include "prefix.h"
 #include "if.h"
 #include "zebra/rib.h"
+#include "zebra/zebra_nhg.h"
 
 extern int kernel_add_ipv4 (struct prefix *, struct rib *);
 extern int kernel_delete_ipv4 (struct prefix *, struct rib *);
@@ -33,6 +34,19 @@ extern int kernel_add_route (struct prefix_ipv4 *, struct in_addr *, int, int);
 extern int kernel_address_add_ipv4 (struct interface *, struct connected *);
 extern int kernel_address_delete_ipv4 (struct interface *, struct connected *);
 
+/* Kernels with nexthop objects install the routes of a nexthop group
+   with a shared object.  kernel_nhg_update() brings the object of the
+   group rib is installed with up to date with rib's nexthops, and
+   fails if rib would have to be installed again. */
+extern int kernel_nhg_update (struct prefix *, struct rib *);
+extern void kernel_nhg_delete (struct nexthop_group *);
+
+#ifdef HAVE_NETLINK
+/* Statistics of the netlink listen sockets and nexthop objects. */
+extern void kernel_netlink_show (struct vty *);
+extern void kernel_netlink_clear (void);
+#endif /* HAVE_NETLINK */
+
 #ifdef HAVE_IPV6
 extern int kernel_add_ipv6 (struct prefix *, struct rib *);
 extern int kernel_delete_ipv6 (struct prefix *, struct rib *);
@@ -36,6 +36,8 @@
 #include "rib.h"
 #include "thread.h"
 #include "privs.h"
+#include "vty.h"
+#include "command.h"
 
 #include "zebra/zserv.h"
 #include "zebra/rt.h"
@@ -45,6 +47,29 @@
 
 #include "rt_netlink.h"
 
+#ifdef RTM_NEWNEXTHOP
+#include <linux/nexthop.h>
+
+/* Attributes of a nexthop object message. */
+#define NL_NHA(nhm) \
+  ((struct rtattr *) (((char *) (nhm)) + NLMSG_ALIGN (sizeof (struct nhmsg))))
+
+static unsigned long netlink_nhg_flush (unsigned int);
+#endif /* RTM_NEWNEXTHOP */
+
+/* Datagrams read from a listen socket per recvmmsg(), and the size of
+   each receive buffer.  Route and address notifications are at most a
+   page, but link messages with many attributes can be much larger. */
+#define NL_RECV_BATCH         32
+#define NL_RECV_BUF_SIZE      32768
+
+/* Batches read per kernel_read(), so a flood of notifications does not
+   starve the rest of zebra. */
+#define NL_RECV_BATCH_MAX     64
+
+/* Batch size histogram buckets: 1, 2-3, 4-7, ... NL_RECV_BATCH. */
+#define NL_BATCH_BUCKETS      6
+
 /* Socket interface to kernel */
 struct nlsock
 {
@@ -52,9 +77,45 @@ struct nlsock
   int seq;
   struct sockaddr_nl snl;
   const char *name;
-} netlink      = { -1, 0, {0}, "netlink-listen"},     /* kernel messages */
+
+  /* Listen sockets only: the family to dump again after an overrun,
+     AF_UNSPEC for links and addresses, and whether one is pending. */
+  int family;
+  int resync;
+
+  /* Listen socket statistics. */
+  unsigned long reads;
+  unsigned long dgrams;
+  unsigned long msgs;
+  unsigned long overruns;
+  unsigned long resyncs;
+  unsigned long batch[NL_BATCH_BUCKETS];
+
+  /* errno of the last error reply. */
+  int error;
+} netlink      = { -1, 0, {0}, "netlink-listen", AF_UNSPEC}, /* links, addrs */
+  netlink_route4 = { -1, 0, {0}, "netlink-route4", AF_INET}, /* IPv4 routes */
+#ifdef HAVE_IPV6
+  netlink_route6 = { -1, 0, {0}, "netlink-route6", AF_INET6}, /* IPv6 routes */
+#endif /* HAVE_IPV6 */
   netlink_cmd  = { -1, 0, {0}, "netlink-cmd"};        /* command channel */
 
+/* Receive buffers shared by the listen sockets, which are read one at
+   a time to completion. */
+static char nl_rcvbuf[NL_RECV_BATCH][NL_RECV_BUF_SIZE];
+static struct sockaddr_nl nl_rcvaddr[NL_RECV_BATCH];
+static struct iovec nl_rcviov[NL_RECV_BATCH];
+#ifdef HAVE_RECVMMSG
+static struct mmsghdr nl_rcvmsg[NL_RECV_BATCH];
+#define NL_RCV_HDR(I)         (&nl_rcvmsg[(I)].msg_hdr)
+#define NL_RCV_LEN(I)         (nl_rcvmsg[(I)].msg_len)
+#else
+static struct msghdr nl_rcvmsg[NL_RECV_BATCH];
+static unsigned int nl_rcvlen[NL_RECV_BATCH];
+#define NL_RCV_HDR(I)         (&nl_rcvmsg[(I)])
+#define NL_RCV_LEN(I)         (nl_rcvlen[(I)])
+#endif /* HAVE_RECVMMSG */
+
 static const struct message nlmsg_str[] = {
   {RTM_NEWROUTE, "RTM_NEWROUTE"},
   {RTM_DELROUTE, "RTM_DELROUTE"},
@@ -65,6 +126,11 @@ static const struct message nlmsg_str[] = {
   {RTM_NEWADDR,  "RTM_NEWADDR"},
   {RTM_DELADDR,  "RTM_DELADDR"},
   {RTM_GETADDR,  "RTM_GETADDR"},
+#ifdef RTM_NEWNEXTHOP
+  {RTM_NEWNEXTHOP, "RTM_NEWNEXTHOP"},
+  {RTM_DELNEXTHOP, "RTM_DELNEXTHOP"},
+  {RTM_GETNEXTHOP, "RTM_GETNEXTHOP"},
+#endif /* RTM_NEWNEXTHOP */
   {0, NULL}
 };
 
@@ -98,7 +164,7 @@ set_ifindex(struct interface *ifp, unsigned int ifi_index)
 	  if_delete_update(oifp);
         }
     }
-  ifp->ifindex = ifi_index;
+  if_set_index (ifp, ifi_index);
 }
 
 #ifndef SO_RCVBUFFORCE
@@ -269,6 +335,149 @@ netlink_request (int family, int type, struct nlsock *nl)
   return 0;
 }
 
+/* Pass the messages in one datagram of 'status' bytes to 'filter'.
+   Sets *done if the datagram ends the exchange, in which case the
+   return value is the caller's to return. */
+static int
+netlink_parse_buf (int (*filter) (struct sockaddr_nl *, struct nlmsghdr *),
+                   struct nlsock *nl, struct sockaddr_nl *snl,
+                   char *buf, int status, int msg_flags, int *done)
+{
+  int ret = 0;
+  int error;
+  struct nlmsghdr *h;
+
+  *done = 0;
+
+  for (h = (struct nlmsghdr *) buf; NLMSG_OK (h, (unsigned int) status);
+       h = NLMSG_NEXT (h, status))
+    {
+      /* Finish of reading. */
+      if (h->nlmsg_type == NLMSG_DONE)
+        {
+          *done = 1;
+          return ret;
+        }
+
+      /* Error handling. */
+      if (h->nlmsg_type == NLMSG_ERROR)
+        {
+          struct nlmsgerr *err = (struct nlmsgerr *) NLMSG_DATA (h);
+          int errnum = err->error;
+          int msg_type = err->msg.nlmsg_type;
+
+          /* If the error field is zero, then this is an ACK */
+          if (err->error == 0)
+            {
+              if (IS_ZEBRA_DEBUG_KERNEL)
+                {
+                  zlog_debug ("%s: %s ACK: type=%s(%u), seq=%u, pid=%u",
+                             __FUNCTION__, nl->name,
+                             lookup (nlmsg_str, err->msg.nlmsg_type),
+                             err->msg.nlmsg_type, err->msg.nlmsg_seq,
+                             err->msg.nlmsg_pid);
+                }
+
+              /* return if not a multipart message, otherwise continue */
+              if (!(h->nlmsg_flags & NLM_F_MULTI))
+                {
+                  *done = 1;
+                  return 0;
+                }
+              continue;
+            }
+
+          *done = 1;
+          if (h->nlmsg_len < NLMSG_LENGTH (sizeof (struct nlmsgerr)))
+            {
+              zlog (NULL, LOG_ERR, "%s error: message truncated",
+                    nl->name);
+              return -1;
+            }
+          nl->error = -errnum;
+
+#ifdef RTM_NEWNEXTHOP
+          /* Errors the nexthop object code expects and deals with: a
+             kernel without them, an id taken, an object already gone. */
+          if (nl == &netlink_cmd
+              && ((msg_type == RTM_GETNEXTHOP)
+                  || (msg_type == RTM_NEWNEXTHOP && -errnum == EEXIST)
+                  || (msg_type == RTM_DELNEXTHOP && -errnum == ENOENT)))
+            {
+              if (IS_ZEBRA_DEBUG_KERNEL)
+                zlog_debug ("%s: error: %s type=%s(%u), seq=%u, pid=%u",
+                            nl->name, safe_strerror (-errnum),
+                            lookup (nlmsg_str, msg_type),
+                            msg_type, err->msg.nlmsg_seq, err->msg.nlmsg_pid);
+              return -1;
+            }
+#endif /* RTM_NEWNEXTHOP */
+
+          /* Deal with errors that occur because of races in link handling */
+          if (nl == &netlink_cmd
+              && ((msg_type == RTM_DELROUTE &&
+                   (-errnum == ENODEV || -errnum == ESRCH))
+                  || (msg_type == RTM_NEWROUTE && -errnum == EEXIST)))
+            {
+              if (IS_ZEBRA_DEBUG_KERNEL)
+                zlog_debug ("%s: error: %s type=%s(%u), seq=%u, pid=%u",
+                            nl->name, safe_strerror (-errnum),
+                            lookup (nlmsg_str, msg_type),
+                            msg_type, err->msg.nlmsg_seq, err->msg.nlmsg_pid);
+              return 0;
+            }
+
+          zlog_err ("%s error: %s, type=%s(%u), seq=%u, pid=%u",
+                    nl->name, safe_strerror (-errnum),
+                    lookup (nlmsg_str, msg_type),
+                    msg_type, err->msg.nlmsg_seq, err->msg.nlmsg_pid);
+          return -1;
+        }
+
+      /* OK we got netlink message. */
+      if (IS_ZEBRA_DEBUG_KERNEL)
+        zlog_debug ("netlink_parse_info: %s type %s(%u), seq=%u, pid=%u",
+                   nl->name,
+                   lookup (nlmsg_str, h->nlmsg_type), h->nlmsg_type,
+                   h->nlmsg_seq, h->nlmsg_pid);
+
+      /* skip unsolicited messages originating from command socket
+       * linux sets the originators port-id for {NEW|DEL}ADDR messages,
+       * so this has to be checked here. */
+      if (nl != &netlink_cmd && h->nlmsg_pid == netlink_cmd.snl.nl_pid
+          && (h->nlmsg_type != RTM_NEWADDR && h->nlmsg_type != RTM_DELADDR))
+        {
+          if (IS_ZEBRA_DEBUG_KERNEL)
+            zlog_debug ("netlink_parse_info: %s packet comes from %s",
+                        netlink_cmd.name, nl->name);
+          continue;
+        }
+
+      nl->msgs++;
+      error = (*filter) (snl, h);
+      if (error < 0)
+        {
+          zlog (NULL, LOG_ERR, "%s filter function error", nl->name);
+          ret = error;
+        }
+    }
+
+  /* After error care. */
+  if (msg_flags & MSG_TRUNC)
+    {
+      zlog (NULL, LOG_ERR, "%s error: message truncated", nl->name);
+      return ret;
+    }
+  if (status)
+    {
+      zlog (NULL, LOG_ERR, "%s error: data remnant size %d", nl->name,
+            status);
+      *done = 1;
+      return -1;
+    }
+  return ret;
+}
+
 /* Receive message from netlink interface and pass those information
    to the given function. */
 static int
@@ -278,6 +487,7 @@ netlink_parse_info (int (*filter) (struct sockaddr_nl *, struct nlmsghdr *),
   int status;
   int ret = 0;
   int error;
+  int done;
 
   while (1)
     {
@@ -293,7 +503,6 @@ netlink_parse_info (int (*filter) (struct sockaddr_nl *, struct nlmsghdr *),
         .msg_iov = &iov,
         .msg_iovlen = 1
       };
-      struct nlmsghdr *h;
 
       status = recvmsg (nl->sock, &msg, 0);
       if (status < 0)
@@ -319,108 +528,13 @@ netlink_parse_info (int (*filter) (struct sockaddr_nl *, struct nlmsghdr *),
                 nl->name, msg.msg_namelen);
           return -1;
         }
-      
-      for (h = (struct nlmsghdr *) buf; NLMSG_OK (h, (unsigned int) status);
-           h = NLMSG_NEXT (h, status))
-        {
-          /* Finish of reading. */
-          if (h->nlmsg_type == NLMSG_DONE)
-            return ret;
-
-          /* Error handling. */
-          if (h->nlmsg_type == NLMSG_ERROR)
-            {
-              struct nlmsgerr *err = (struct nlmsgerr *) NLMSG_DATA (h);
-	      int errnum = err->error;
-	      int msg_type = err->msg.nlmsg_type;
-
-              /* If the error field is zero, then this is an ACK */
-              if (err->error == 0)
-                {
-                  if (IS_ZEBRA_DEBUG_KERNEL)
-                    {
-                      zlog_debug ("%s: %s ACK: type=%s(%u), seq=%u, pid=%u",
-                                 __FUNCTION__, nl->name,
-                                 lookup (nlmsg_str, err->msg.nlmsg_type),
-                                 err->msg.nlmsg_type, err->msg.nlmsg_seq,
-                                 err->msg.nlmsg_pid);
-                    }
-
-                  /* return if not a multipart message, otherwise continue */
-                  if (!(h->nlmsg_flags & NLM_F_MULTI))
-                    {
-                      return 0;
-                    }
-                  continue;
-                }
-
-              if (h->nlmsg_len < NLMSG_LENGTH (sizeof (struct nlmsgerr)))
-                {
-                  zlog (NULL, LOG_ERR, "%s error: message truncated",
-                        nl->name);
-                  return -1;
-                }
-
-              /* Deal with errors that occur because of races in link handling */
-	      if (nl == &netlink_cmd
-		  && ((msg_type == RTM_DELROUTE &&
-		       (-errnum == ENODEV || -errnum == ESRCH))
-		      || (msg_type == RTM_NEWROUTE && -errnum == EEXIST)))
-		{
-		  if (IS_ZEBRA_DEBUG_KERNEL)
-		    zlog_debug ("%s: error: %s type=%s(%u), seq=%u, pid=%u",
-				nl->name, safe_strerror (-errnum),
-				lookup (nlmsg_str, msg_type),
-				msg_type, err->msg.nlmsg_seq, err->msg.nlmsg_pid);
-		  return 0;
-		}
-
-	      zlog_err ("%s error: %s, type=%s(%u), seq=%u, pid=%u",
-			nl->name, safe_strerror (-errnum),
-			lookup (nlmsg_str, msg_type),
-			msg_type, err->msg.nlmsg_seq, err->msg.nlmsg_pid);
-              return -1;
-            }
-
-          /* OK we got netlink message. */
-          if (IS_ZEBRA_DEBUG_KERNEL)
-            zlog_debug ("netlink_parse_info: %s type %s(%u), seq=%u, pid=%u",
-                       nl->name,
-                       lookup (nlmsg_str, h->nlmsg_type), h->nlmsg_type,
-                       h->nlmsg_seq, h->nlmsg_pid);
-
-          /* skip unsolicited messages originating from command socket
-           * linux sets the originators port-id for {NEW|DEL}ADDR messages,
-           * so this has to be checked here. */
-          if (nl != &netlink_cmd && h->nlmsg_pid == netlink_cmd.snl.nl_pid
-              && (h->nlmsg_type != RTM_NEWADDR && h->nlmsg_type != RTM_DELADDR))
-            {
-              if (IS_ZEBRA_DEBUG_KERNEL)
-                zlog_debug ("netlink_parse_info: %s packet comes from %s",
-                            netlink_cmd.name, nl->name);
-              continue;
-            }
-
-          error = (*filter) (&snl, h);
-          if (error < 0)
-            {
-              zlog (NULL, LOG_ERR, "%s filter function error", nl->name);
-              ret = error;
-            }
-        }
 
-      /* After error care. */
-      if (msg.msg_flags & MSG_TRUNC)
-        {
-          zlog (NULL, LOG_ERR, "%s error: message truncated", nl->name);
-          continue;
-        }
-      if (status)
-        {
-          zlog (NULL, LOG_ERR, "%s error: data remnant size %d", nl->name,
-                status);
-          return -1;
-        }
+      error = netlink_parse_buf (filter, nl, &snl, buf, status,
+                                 msg.msg_flags, &done);
+      if (done)
+        return error < 0 ? error : ret;
+      if (error < 0)
+        ret = error;
     }
   return ret;
 }
@@ -743,7 +857,7 @@ netlink_routing_table (struct sockaddr_nl *snl, struct nlmsghdr *h)
 
       if (!tb[RTA_MULTIPATH])
           rib_add_ipv4 (ZEBRA_ROUTE_KERNEL, flags, &p, gate, src, index,
-                        table, metric, 0, SAFI_UNICAST);
+                        table, 0, metric, 0, SAFI_UNICAST);
       else
         {
           /* This is a multipath route */
@@ -809,7 +923,7 @@ netlink_routing_table (struct sockaddr_nl *snl, struct nlmsghdr *h)
       p.prefixlen = rtm->rtm_dst_len;
 
       rib_add_ipv6 (ZEBRA_ROUTE_KERNEL, flags, &p, gate, index, table,
-		    metric, 0, SAFI_UNICAST);
+		    0, metric, 0, SAFI_UNICAST);
     }
 #endif /* HAVE_IPV6 */
 
@@ -945,7 +1059,7 @@ netlink_route_change (struct sockaddr_nl *snl, struct nlmsghdr *h)
         {
           if (!tb[RTA_MULTIPATH])
             rib_add_ipv4 (ZEBRA_ROUTE_KERNEL, 0, &p, gate, src, index, table,
-                          metric, 0, SAFI_UNICAST);
+                          0, metric, 0, SAFI_UNICAST);
           else
             {
               /* This is a multipath route */
@@ -1003,7 +1117,8 @@ netlink_route_change (struct sockaddr_nl *snl, struct nlmsghdr *h)
             }
         }
       else
-        rib_delete_ipv4 (ZEBRA_ROUTE_KERNEL, 0, &p, gate, index, table, SAFI_UNICAST);
+        rib_delete_ipv4 (ZEBRA_ROUTE_KERNEL, 0, &p, gate, index, table, 0,
+                         SAFI_UNICAST);
     }
 
 #ifdef HAVE_IPV6
@@ -1029,9 +1144,11 @@ netlink_route_change (struct sockaddr_nl *snl, struct nlmsghdr *h)
         }
 
       if (h->nlmsg_type == RTM_NEWROUTE)
-        rib_add_ipv6 (ZEBRA_ROUTE_KERNEL, 0, &p, gate, index, table, metric, 0, SAFI_UNICAST);
+        rib_add_ipv6 (ZEBRA_ROUTE_KERNEL, 0, &p, gate, index, table, 0,
+                      metric, 0, SAFI_UNICAST);
       else
-        rib_delete_ipv6 (ZEBRA_ROUTE_KERNEL, 0, &p, gate, index, table, SAFI_UNICAST);
+        rib_delete_ipv6 (ZEBRA_ROUTE_KERNEL, 0, &p, gate, index, table, 0,
+                         SAFI_UNICAST);
     }
 #endif /* HAVE_IPV6 */
 
@@ -1108,6 +1225,16 @@ netlink_link_change (struct sockaddr_nl *snl, struct nlmsghdr *h)
 
           netlink_interface_update_hw_addr (tb, ifp);
 
+#ifdef RTM_NEWNEXTHOP
+          /* Whether zebra takes the interface for down or not, once
+             it is, routes through it may have gone with their nexthop
+             objects and have to be installed again. */
+          if ((ifi->ifi_flags & (IFF_UP | IFF_RUNNING))
+              != (IFF_UP | IFF_RUNNING)
+              && netlink_nhg_flush (ifp->ifindex))
+            rib_update ();
+#endif /* RTM_NEWNEXTHOP */
+
           if (if_is_operative (ifp))
             {
               ifp->flags = ifi->ifi_flags & 0x0000fffff;
@@ -1137,6 +1264,9 @@ netlink_link_change (struct sockaddr_nl *snl, struct nlmsghdr *h)
           return 0;
         }
 
+#ifdef RTM_NEWNEXTHOP
+      netlink_nhg_flush (ifp->ifindex);
+#endif /* RTM_NEWNEXTHOP */
       if_delete_update (ifp);
     }
 
@@ -1314,9 +1444,11 @@ netlink_talk_filter (struct sockaddr_nl *snl, struct nlmsghdr *h)
   return 0;
 }
 
-/* sendmsg() to netlink socket then recvmsg(). */
+/* sendmsg() to netlink socket then recvmsg(), passing what the kernel
+   answers with other than an acknowledgement to filter. */
 static int
-netlink_talk (struct nlmsghdr *n, struct nlsock *nl)
+netlink_talk_parse (struct nlmsghdr *n, struct nlsock *nl,
+                    int (*filter) (struct sockaddr_nl *, struct nlmsghdr *))
 {
   int status;
   struct sockaddr_nl snl;
@@ -1365,7 +1497,13 @@ netlink_talk (struct nlmsghdr *n, struct nlsock *nl)
    * Get reply from netlink socket. 
    * The reply should either be an acknowlegement or an error.
    */
-  return netlink_parse_info (netlink_talk_filter, nl);
+  return netlink_parse_info (filter, nl);
+}
+
+static int
+netlink_talk (struct nlmsghdr *n, struct nlsock *nl)
+{
+  return netlink_talk_parse (n, nl, netlink_talk_filter);
 }
 
 /* Routing table change via netlink interface. */
@@ -1650,6 +1788,462 @@ _netlink_route_debug(
     }
 }
 
+#ifdef RTM_NEWNEXTHOP
+/* Kernel nexthop objects.  Routes with a nexthop group are installed
+ * referring to a kernel object of the group by its id, whose members
+ * are objects of the group's nexthops as resolved.  When they resolve
+ * differently, replacing the group object moves all its routes at once
+ * instead of each being installed again.  Kernels without nexthop
+ * objects get the nexthops of every route inline.
+ */
+
+/* Most members of a group object zebra programs. */
+#define NL_NHG_HOPS           64
+
+static struct
+{
+  /* Whether the kernel has nexthop objects, probed at startup. */
+  int supported;
+
+  /* Id to try for the next object. */
+  u_int32_t next_id;
+
+  /* Statistics. */
+  unsigned long created;
+  unsigned long replaced;
+  unsigned long followed;
+  unsigned long flushed;
+  unsigned long failed;
+} nl_nhg = { 0, 1 };
+
+/* Add, replace or delete the nexthop object id: a single nexthop if
+   hop is given, else a group of the num objects in members. */
+static int
+netlink_nexthop (int cmd, int flags, u_int32_t id, struct nhg_kernel_hop *hop,
+                 struct nhg_kernel_hop *members, int num)
+{
+  struct nexthop_grp grp[NL_NHG_HOPS];
+  int bytelen;
+  int i;
+
+  struct
+  {
+    struct nlmsghdr n;
+    struct nhmsg nhm;
+    char buf[NL_PKT_BUF_SIZE];
+  } req;
+
+  memset (&req, 0, sizeof req - NL_PKT_BUF_SIZE);
+
+  req.n.nlmsg_len = NLMSG_LENGTH (sizeof (struct nhmsg));
+  req.n.nlmsg_flags = NLM_F_REQUEST | flags;
+  req.n.nlmsg_type = cmd;
+  req.nhm.nh_family = AF_UNSPEC;
+  if (cmd == RTM_NEWNEXTHOP)
+    req.nhm.nh_protocol = RTPROT_ZEBRA;
+
+  addattr32 ((struct nlmsghdr *) &req, sizeof req, NHA_ID, id);
+
+  if (cmd == RTM_NEWNEXTHOP && hop)
+    {
+      req.nhm.nh_family = hop->family;
+      if (CHECK_FLAG (hop->flags, NHG_KERNEL_ONLINK))
+        req.nhm.nh_flags |= RTNH_F_ONLINK;
+      if (CHECK_FLAG (hop->flags, NHG_KERNEL_GATE))
+        {
+          bytelen = (hop->family == AF_INET ? 4 : 16);
+          addattr_l ((struct nlmsghdr *) &req, sizeof req, NHA_GATEWAY,
+                     &hop->gate, bytelen);
+        }
+      addattr32 ((struct nlmsghdr *) &req, sizeof req, NHA_OIF, hop->ifindex);
+    }
+  else if (cmd == RTM_NEWNEXTHOP)
+    {
+      memset (grp, 0, sizeof (grp));
+      for (i = 0; i < num; i++)
+        grp[i].id = members[i].id;
+      addattr_l ((struct nlmsghdr *) &req, sizeof req, NHA_GROUP, grp,
+                 num * sizeof (struct nexthop_grp));
+    }
+
+  return netlink_talk (&req.n, &netlink_cmd);
+}
+
+/* Create a nexthop object under an id not taken yet.  Returns the id,
+   0 if the kernel refused the object. */
+static u_int32_t
+netlink_nexthop_create (struct nhg_kernel_hop *hop,
+                        struct nhg_kernel_hop *members, int num)
+{
+  u_int32_t id;
+  int tries;
+
+  for (tries = 0; tries < 16; tries++)
+    {
+      id = nl_nhg.next_id++;
+      if (nl_nhg.next_id == 0)
+        nl_nhg.next_id = 1;
+
+      if (netlink_nexthop (RTM_NEWNEXTHOP, NLM_F_CREATE | NLM_F_EXCL, id,
+                           hop, members, num) == 0)
+        {
+          nl_nhg.created++;
+          return id;
+        }
+      if (netlink_cmd.error != EEXIST)
+        break;
+    }
+  return 0;
+}
+
+static void
+netlink_nexthop_delete (u_int32_t id)
+{
+  netlink_nexthop (RTM_DELNEXTHOP, 0, id, NULL, NULL, 0);
+}
+
+/* The nexthops rib is installed with, as members of an object of a
+   family route.  Returns their number, 0 if there are none or if one
+   is of a kind an object does not carry the way the route would.  An
+   object needs the interface, which for a gateway alone is the one
+   zebra resolved it to. */
+static int
+netlink_nhg_hops (struct rib *rib, int family, struct nhg_kernel_hop *hops)
+{
+  struct nexthop *nexthop, *tnexthop;
+  struct nhg_kernel_hop *hop;
+  int recursing;
+  int num = 0;
+
+  for (ALL_NEXTHOPS_RO(rib->nexthop, nexthop, tnexthop, recursing))
+    {
+      if (CHECK_FLAG (nexthop->flags, NEXTHOP_FLAG_RECURSIVE)
+          || ! CHECK_FLAG (nexthop->flags, NEXTHOP_FLAG_ACTIVE))
+        continue;
+      if (MULTIPATH_NUM != 0 && num >= MULTIPATH_NUM)
+        break;
+
+      /* The preferred source is an attribute of the route. */
+      if (num == NL_NHG_HOPS || ! nexthop->ifindex
+          || (family == AF_INET && nexthop->src.ipv4.s_addr))
+        return 0;
+
+      hop = &hops[num++];
+      memset (hop, 0, sizeof (*hop));
+      hop->family = family;
+      hop->ifindex = nexthop->ifindex;
+      if (CHECK_FLAG (nexthop->flags, NEXTHOP_FLAG_ONLINK))
+        SET_FLAG (hop->flags, NHG_KERNEL_ONLINK);
+
+      switch (nexthop->type)
+        {
+        case NEXTHOP_TYPE_IPV4_IFINDEX:
+        case NEXTHOP_TYPE_IPV4:
+          hop->family = AF_INET;
+          hop->gate.ipv4 = nexthop->gate.ipv4;
+          SET_FLAG (hop->flags, NHG_KERNEL_GATE);
+          break;
+#ifdef HAVE_IPV6
+        case NEXTHOP_TYPE_IPV6_IFINDEX:
+        case NEXTHOP_TYPE_IPV6_IFNAME:
+        case NEXTHOP_TYPE_IPV6:
+          hop->family = AF_INET6;
+          hop->gate.ipv6 = nexthop->gate.ipv6;
+          SET_FLAG (hop->flags, NHG_KERNEL_GATE);
+          break;
+#endif /* HAVE_IPV6 */
+        case NEXTHOP_TYPE_IFINDEX:
+        case NEXTHOP_TYPE_IFNAME:
+          break;
+        default:
+          return 0;
+        }
+    }
+  return num;
+}
+
+static int
+netlink_nhg_hop_same (const struct nhg_kernel_hop *a,
+                      const struct nhg_kernel_hop *b)
+{
+  return a->family == b->family && a->flags == b->flags
+         && a->ifindex == b->ifindex
+         && ! memcmp (&a->gate, &b->gate, sizeof (a->gate));
+}
+
+/* Program the object of nhg with the nexthops of rib, one of its
+   routes, keeping the objects of the members that stay. */
+static int
+netlink_nhg_sync (struct nexthop_group *nhg, struct rib *rib, int family)
+{
+  struct nhg_kernel_hop hops[NL_NHG_HOPS];
+  u_char kept[NL_NHG_HOPS];
+  int num, i, j, same;
+  u_int32_t id;
+
+  num = netlink_nhg_hops (rib, family, hops);
+  if (! num)
+    return -1;
+
+  memset (kept, 0, sizeof (kept));
+  same = (num == nhg->kernel_num);
+  for (i = 0; i < num; i++)
+    {
+      for (j = 0; j < nhg->kernel_num; j++)
+        if (! kept[j] && netlink_nhg_hop_same (&hops[i], &nhg->kernel_hop[j]))
+          break;
+      if (j < nhg->kernel_num)
+        {
+          hops[i].id = nhg->kernel_hop[j].id;
+          kept[j] = 1;
+        }
+      else
+        same = 0;
+    }
+  if (nhg->kernel_id && same)
+    return 0;
+
+  for (i = 0; i < num; i++)
+    if (! hops[i].id && ! (hops[i].id = netlink_nexthop_create (&hops[i],
+                                                                NULL, 0)))
+      goto fail;
+
+  if (nhg->kernel_id)
+    {
+      if (netlink_nexthop (RTM_NEWNEXTHOP, NLM_F_REPLACE, nhg->kernel_id,
+                           NULL, hops, num) < 0)
+        goto fail;
+      nl_nhg.replaced++;
+    }
+  else if ((id = netlink_nexthop_create (NULL, hops, num)))
+    nhg->kernel_id = id;
+  else
+    goto fail;
+
+  for (j = 0; j < nhg->kernel_num; j++)
+    if (! kept[j])
+      netlink_nexthop_delete (nhg->kernel_hop[j].id);
+
+  if (num != nhg->kernel_num)
+    nhg->kernel_hop = XREALLOC (MTYPE_NHG, nhg->kernel_hop,
+                                num * sizeof (struct nhg_kernel_hop));
+  memcpy (nhg->kernel_hop, hops, num * sizeof (struct nhg_kernel_hop));
+  nhg->kernel_num = num;
+  return 0;
+
+ fail:
+  nl_nhg.failed++;
+  for (i = 0; i < num; i++)
+    {
+      for (j = 0; j < nhg->kernel_num; j++)
+        if (hops[i].id == nhg->kernel_hop[j].id)
+          break;
+      if (hops[i].id && j == nhg->kernel_num)
+        netlink_nexthop_delete (hops[i].id);
+    }
+  return -1;
+}
+
+/* Set the FIB flag of the nexthops of rib, installed with the object
+   of its group. */
+static void
+netlink_nhg_fib (struct rib *rib)
+{
+  struct nexthop *nexthop, *tnexthop;
+  int recursing;
+  int num = 0;
+
+  for (ALL_NEXTHOPS_RO(rib->nexthop, nexthop, tnexthop, recursing))
+    {
+      UNSET_FLAG (nexthop->flags, NEXTHOP_FLAG_FIB);
+      if (CHECK_FLAG (nexthop->flags, NEXTHOP_FLAG_RECURSIVE)
+          || ! CHECK_FLAG (nexthop->flags, NEXTHOP_FLAG_ACTIVE))
+        continue;
+      if (MULTIPATH_NUM != 0 && num++ >= MULTIPATH_NUM)
+        continue;
+      SET_FLAG (nexthop->flags, NEXTHOP_FLAG_FIB);
+    }
+}
+
+/* Make the object of rib's group ready for rib to be installed with. */
+static int
+netlink_nhg_route (struct rib *rib, int family)
+{
+  if (! nl_nhg.supported || ! rib->nhg)
+    return -1;
+  if (netlink_nhg_sync (rib->nhg, rib, family) < 0)
+    return -1;
+  netlink_nhg_fib (rib);
+  return 0;
+}
+
+int
+kernel_nhg_update (struct prefix *p, struct rib *rib)
+{
+  u_int32_t id = rib->kernel_nhid;
+
+  if (! id || ! rib->nhg || rib->nhg->kernel_id != id)
+    return -1;
+  if (netlink_nhg_route (rib, PREFIX_FAMILY (p)) < 0
+      || rib->nhg->kernel_id != id)
+    return -1;
+
+  nl_nhg.followed++;
+  return 0;
+}
+
+void
+kernel_nhg_delete (struct nexthop_group *nhg)
+{
+  int i;
+
+  /* The group first, so that it does not go with its last member. */
+  netlink_nexthop_delete (nhg->kernel_id);
+  for (i = 0; i < nhg->kernel_num; i++)
+    netlink_nexthop_delete (nhg->kernel_hop[i].id);
+
+  if (nhg->kernel_hop)
+    XFREE (MTYPE_NHG, nhg->kernel_hop);
+  nhg->kernel_num = 0;
+  nhg->kernel_id = 0;
+}
+
+/* The kernel drops the nexthop objects of an interface going down, and
+   group objects left without members along with their routes.  Forget
+   them too; the routes of a group lost are installed again as they
+   are updated. */
+static void
+netlink_nhg_flush_group (struct nexthop_group *nhg, void *arg)
+{
+  unsigned int ifindex = *(unsigned int *) arg;
+  struct nhg_kernel_hop *hop;
+  int i, num;
+
+  if (! nhg->kernel_id)
+    return;
+
+  for (i = num = 0; i < nhg->kernel_num; i++)
+    {
+      hop = &nhg->kernel_hop[i];
+      if (hop->ifindex == ifindex)
+        netlink_nexthop_delete (hop->id);
+      else
+        nhg->kernel_hop[num++] = *hop;
+    }
+  if (num == nhg->kernel_num)
+    return;
+
+  nl_nhg.flushed++;
+  nhg->kernel_num = num;
+  if (! num)
+    {
+      XFREE (MTYPE_NHG, nhg->kernel_hop);
+      nhg->kernel_id = 0;
+    }
+}
+
+/* Returns the number of groups that lost members. */
+static unsigned long
+netlink_nhg_flush (unsigned int ifindex)
+{
+  unsigned long flushed = nl_nhg.flushed;
+
+  if (nl_nhg.supported)
+    nhg_iterate (netlink_nhg_flush_group, &ifindex);
+  return nl_nhg.flushed - flushed;
+}
+
+/* Objects left behind by an earlier zebra, groups first. */
+static struct
+{
+  u_int32_t *id;
+  int num;
+  int groups;
+} nl_nhg_stale;
+
+static int
+netlink_nexthop_stale (struct sockaddr_nl *snl, struct nlmsghdr *h)
+{
+  struct nhmsg *nhm;
+  struct rtattr *tb[NHA_MAX + 1];
+  u_int32_t id;
+  int len;
+
+  if (h->nlmsg_type != RTM_NEWNEXTHOP)
+    return 0;
+  nhm = NLMSG_DATA (h);
+  len = h->nlmsg_len - NLMSG_LENGTH (sizeof (struct nhmsg));
+  if (len < 0)
+    return -1;
+  if (nhm->nh_protocol != RTPROT_ZEBRA)
+    return 0;
+
+  memset (tb, 0, sizeof tb);
+  netlink_parse_rtattr (tb, NHA_MAX, NL_NHA (nhm), len);
+  if (! tb[NHA_ID])
+    return 0;
+  id = *(u_int32_t *) RTA_DATA (tb[NHA_ID]);
+
+  nl_nhg_stale.id = XREALLOC (MTYPE_TMP, nl_nhg_stale.id,
+                              (nl_nhg_stale.num + 1) * sizeof (u_int32_t));
+  if (tb[NHA_GROUP])
+    {
+      nl_nhg_stale.id[nl_nhg_stale.num] = nl_nhg_stale.id[nl_nhg_stale.groups];
+      nl_nhg_stale.id[nl_nhg_stale.groups++] = id;
+    }
+  else
+    nl_nhg_stale.id[nl_nhg_stale.num] = id;
+  nl_nhg_stale.num++;
+  return 0;
+}
+
+/* Find out whether the kernel has nexthop objects, and delete those of
+   an earlier zebra, which takes the routes using them along. */
+static void
+netlink_nexthop_init (void)
+{
+  int i;
+
+  struct
+  {
+    struct nlmsghdr n;
+    struct nhmsg nhm;
+  } req;
+
+  memset (&req, 0, sizeof req);
+  req.n.nlmsg_len = NLMSG_LENGTH (sizeof (struct nhmsg));
+  req.n.nlmsg_type = RTM_GETNEXTHOP;
+  req.n.nlmsg_flags = NLM_F_REQUEST | NLM_F_DUMP;
+
+  if (netlink_talk_parse (&req.n, &netlink_cmd, netlink_nexthop_stale) < 0)
+    {
+      zlog_info ("netlink: no kernel nexthop objects (%s), "
+                 "installing nexthops with each route",
+                 safe_strerror (netlink_cmd.error));
+      nl_nhg.supported = 0;
+    }
+  else
+    nl_nhg.supported = 1;
+
+  for (i = 0; i < nl_nhg_stale.num; i++)
+    netlink_nexthop_delete (nl_nhg_stale.id[i]);
+  if (nl_nhg_stale.id)
+    XFREE (MTYPE_TMP, nl_nhg_stale.id);
+  nl_nhg_stale.num = nl_nhg_stale.groups = 0;
+}
+#else
+int
+kernel_nhg_update (struct prefix *p, struct rib *rib)
+{
+  return -1;
+}
+
+void
+kernel_nhg_delete (struct nexthop_group *nhg)
+{
+}
+#endif /* RTM_NEWNEXTHOP */
+
 /* Routing table change via netlink interface. */
 static int
 netlink_route_multipath (int cmd, struct prefix *p, struct rib *rib,
@@ -1661,7 +2255,9 @@ netlink_route_multipath (int cmd, struct prefix *p, struct rib *rib,
   int recursing;
   int nexthop_num;
   int discard;
+  int ret;
   const char *routedesc;
+  struct nexthop_group *kernel_nhg;
 
   struct
   {
@@ -1708,6 +2304,45 @@ netlink_route_multipath (int cmd, struct prefix *p, struct rib *rib,
   /* Metric. */
   addattr32 (&req.n, sizeof req, RTA_PRIORITY, rib->metric);
 
+  /* Tables past 255, which VRFs may use, only fit in RTA_TABLE. */
+  if (rib->table > 255)
+    {
+      req.r.rtm_table = RT_TABLE_UNSPEC;
+      /* Through &req, so the compiler sees the whole buffer. */
+      addattr32 ((struct nlmsghdr *) &req, sizeof req, RTA_TABLE,
+                 rib->table);
+    }
+
+  /* The group of the object the route was installed with is let go
+   * once the kernel is done with the route, as the object may go with
+   * it.
+   */
+  kernel_nhg = rib->kernel_nhg;
+  rib->kernel_nhg = NULL;
+
+#ifdef RTM_NEWNEXTHOP
+  /* The kernel finds a route installed with a nexthop object without
+   * being given its nexthops.
+   */
+  if (cmd == RTM_DELROUTE && rib->kernel_nhid)
+    {
+      rib->kernel_nhid = 0;
+      goto skip;
+    }
+  if (cmd == RTM_NEWROUTE && ! discard && netlink_nhg_route (rib, family) == 0)
+    {
+      if (IS_ZEBRA_DEBUG_KERNEL)
+        zlog_debug ("netlink_route_multipath(): nexthop object %u",
+                    rib->nhg->kernel_id);
+      addattr32 ((struct nlmsghdr *) &req, sizeof req, RTA_NH_ID,
+                 rib->nhg->kernel_id);
+      rib->kernel_nhid = rib->nhg->kernel_id;
+      rib->kernel_nhg = nhg_lock (rib->nhg);
+      goto skip;
+    }
+  rib->kernel_nhid = 0;
+#endif /* RTM_NEWNEXTHOP */
+
   if (discard)
     {
       if (cmd == RTM_NEWROUTE)
@@ -1818,6 +2453,8 @@ netlink_route_multipath (int cmd, struct prefix *p, struct rib *rib,
     {
       if (IS_ZEBRA_DEBUG_KERNEL)
         zlog_debug ("netlink_route_multipath(): No useful nexthop.");
+      if (kernel_nhg)
+        nhg_release (kernel_nhg);
       return 0;
     }
 
@@ -1828,7 +2465,16 @@ skip:
   snl.nl_family = AF_NETLINK;
 
   /* Talk to netlink socket. */
-  return netlink_talk (&req.n, &netlink_cmd);
+  ret = netlink_talk (&req.n, &netlink_cmd);
+  if (ret < 0 && cmd == RTM_NEWROUTE && rib->kernel_nhg)
+    {
+      nhg_release (rib->kernel_nhg);
+      rib->kernel_nhg = NULL;
+      rib->kernel_nhid = 0;
+    }
+  if (kernel_nhg)
+    nhg_release (kernel_nhg);
+  return ret;
 }
 
 int
@@ -1922,16 +2568,303 @@ kernel_address_delete_ipv4 (struct interface *ifp, struct connected *ifc)
 
 extern struct thread_master *master;
 
+/* Interfaces not yet seen again in a link resync. */
+static struct list *nl_resync_links;
+
+static int
+netlink_link_resync (struct sockaddr_nl *snl, struct nlmsghdr *h)
+{
+  struct ifinfomsg *ifi = NLMSG_DATA (h);
+  struct interface *ifp;
+
+  if (h->nlmsg_type == RTM_NEWLINK
+      && (ifp = if_lookup_by_index (ifi->ifi_index)) != NULL)
+    listnode_delete (nl_resync_links, ifp);
+
+  return netlink_link_change (snl, h);
+}
+
+/* Dump links and addresses again after an overrun of the socket
+   carrying them.  Links that are gone are deleted; addresses are only
+   added, as the dump cannot tell which deletions were lost. */
+static int
+netlink_resync_links (void)
+{
+  struct listnode *node, *nnode;
+  struct interface *ifp;
+  int ret;
+
+  nl_resync_links = list_new ();
+  for (ALL_LIST_ELEMENTS_RO (iflist, node, ifp))
+    if (CHECK_FLAG (ifp->status, ZEBRA_INTERFACE_ACTIVE))
+      listnode_add (nl_resync_links, ifp);
+
+  ret = netlink_request (AF_PACKET, RTM_GETLINK, &netlink_cmd);
+  if (ret == 0)
+    ret = netlink_parse_info (netlink_link_resync, &netlink_cmd);
+  if (ret == 0)
+    for (ALL_LIST_ELEMENTS (nl_resync_links, node, nnode, ifp))
+      if (CHECK_FLAG (ifp->status, ZEBRA_INTERFACE_ACTIVE))
+        {
+          zlog_info ("%s: interface %s went away during overrun",
+                     __func__, ifp->name);
+          if_delete_update (ifp);
+        }
+  list_delete (nl_resync_links);
+  nl_resync_links = NULL;
+  if (ret < 0)
+    return ret;
+
+  ret = netlink_request (AF_INET, RTM_GETADDR, &netlink_cmd);
+  if (ret == 0)
+    ret = netlink_parse_info (netlink_interface_addr, &netlink_cmd);
+#ifdef HAVE_IPV6
+  if (ret == 0)
+    ret = netlink_request (AF_INET6, RTM_GETADDR, &netlink_cmd);
+  if (ret == 0)
+    ret = netlink_parse_info (netlink_interface_addr, &netlink_cmd);
+#endif /* HAVE_IPV6 */
+  return ret;
+}
+
+/* Dump the routes of one family again after an overrun of the socket
+   carrying them, removing kernel routes the dump no longer has. */
+static int
+netlink_resync_routes (int family)
+{
+  afi_t afi = (family == AF_INET ? AFI_IP : AFI_IP6);
+  unsigned long stale, swept;
+  int ret;
+
+  stale = rib_mark_kernel_stale (afi);
+  ret = netlink_request (family, RTM_GETROUTE, &netlink_cmd);
+  if (ret == 0)
+    ret = netlink_parse_info (netlink_route_change, &netlink_cmd);
+  swept = rib_sweep_kernel_stale (afi, ret == 0);
+
+  if (IS_ZEBRA_DEBUG_KERNEL)
+    zlog_debug ("%s: %s, %lu kernel routes checked, %lu removed",
+                __func__, family == AF_INET ? "ipv4" : "ipv6", stale, swept);
+  return ret;
+}
+
+static void
+netlink_resync (struct nlsock *nl)
+{
+  int ret;
+
+  nl->resync = 0;
+  nl->resyncs++;
+
+  zlog_warn ("%s overrun, reading %s from the kernel again", nl->name,
+             nl->family == AF_UNSPEC ? "links and addresses"
+             : nl->family == AF_INET ? "ipv4 routes" : "ipv6 routes");
+
+  if (nl->family == AF_UNSPEC)
+    ret = netlink_resync_links ();
+  else
+    ret = netlink_resync_routes (nl->family);
+
+  if (ret < 0)
+    zlog_err ("%s resync failed", nl->name);
+}
+
+/* Read up to NL_RECV_BATCH datagrams from a listen socket. */
+static int
+netlink_recv_batch (struct nlsock *nl)
+{
+  int i;
+
+  for (i = 0; i < NL_RECV_BATCH; i++)
+    {
+      struct msghdr *msg = NL_RCV_HDR (i);
+
+      nl_rcviov[i].iov_base = nl_rcvbuf[i];
+      nl_rcviov[i].iov_len = NL_RECV_BUF_SIZE;
+      memset (msg, 0, sizeof (struct msghdr));
+      msg->msg_name = &nl_rcvaddr[i];
+      msg->msg_namelen = sizeof (struct sockaddr_nl);
+      msg->msg_iov = &nl_rcviov[i];
+      msg->msg_iovlen = 1;
+    }
+
+#ifdef HAVE_RECVMMSG
+  return recvmmsg (nl->sock, nl_rcvmsg, NL_RECV_BATCH, MSG_DONTWAIT, NULL);
+#else
+  for (i = 0; i < NL_RECV_BATCH; i++)
+    {
+      int len = recvmsg (nl->sock, NL_RCV_HDR (i), MSG_DONTWAIT);
+
+      if (len < 0)
+        return i ? i : -1;
+      NL_RCV_LEN (i) = len;
+    }
+  return i;
+#endif /* HAVE_RECVMMSG */
+}
+
+/* Drain a listen socket in batches.  An overrun means notifications
+   were lost, so the family the socket carries is read again once the
+   socket is empty. */
+static void
+netlink_read (struct nlsock *nl)
+{
+  int i, n, b, done;
+  int batches;
+  int drained = 0;
+
+  for (batches = 0; batches < NL_RECV_BATCH_MAX; batches++)
+    {
+      n = netlink_recv_batch (nl);
+      if (n < 0)
+        {
+          if (errno == EINTR)
+            continue;
+          if (errno == EWOULDBLOCK || errno == EAGAIN)
+            {
+              drained = 1;
+              break;
+            }
+          if (errno == ENOBUFS)
+            {
+              nl->overruns++;
+              nl->resync = 1;
+              continue;
+            }
+          zlog (NULL, LOG_ERR, "%s recvmmsg error: %s",
+                nl->name, safe_strerror (errno));
+          break;
+        }
+
+      nl->reads++;
+      nl->dgrams += n;
+      for (b = 0; b < NL_BATCH_BUCKETS - 1 && (2 << b) <= n; b++)
+        ;
+      nl->batch[b]++;
+
+      for (i = 0; i < n; i++)
+        {
+          struct msghdr *msg = NL_RCV_HDR (i);
+
+          if (msg->msg_namelen != sizeof (struct sockaddr_nl))
+            {
+              zlog (NULL, LOG_ERR, "%s sender address length error: "
+                    "length %d", nl->name, msg->msg_namelen);
+              continue;
+            }
+          if (msg->msg_flags & MSG_TRUNC)
+            {
+              zlog (NULL, LOG_ERR, "%s error: message truncated", nl->name);
+              nl->overruns++;
+              nl->resync = 1;
+              continue;
+            }
+
+          netlink_parse_buf (netlink_information_fetch, nl, &nl_rcvaddr[i],
+                             nl_rcvbuf[i], NL_RCV_LEN (i), msg->msg_flags,
+                             &done);
+        }
+
+      /* A short batch means the socket is empty for now. */
+      if (n < NL_RECV_BATCH)
+        {
+          drained = 1;
+          break;
+        }
+    }
+
+  if (nl->resync && drained)
+    netlink_resync (nl);
+}
+
 /* Kernel route reflection. */
 static int
 kernel_read (struct thread *thread)
 {
-  netlink_parse_info (netlink_information_fetch, &netlink);
-  thread_add_read (zebrad.master, kernel_read, NULL, netlink.sock);
+  struct nlsock *nl = THREAD_ARG (thread);
 
+  /* Keep links and addresses ahead of the routes that use them. */
+  if (nl != &netlink && netlink.sock >= 0)
+    netlink_read (&netlink);
+  netlink_read (nl);
+
+  thread_add_read (zebrad.master, kernel_read, nl, nl->sock);
   return 0;
 }
 
+void
+kernel_netlink_show (struct vty *vty)
+{
+  struct nlsock *socks[] = { &netlink, &netlink_route4,
+#ifdef HAVE_IPV6
+                             &netlink_route6,
+#endif /* HAVE_IPV6 */
+                           };
+  struct nlsock *nl;
+  unsigned int i;
+  int b;
+
+  vty_out (vty, "%-16s %10s %10s %10s %9s %8s %5s%s", "Socket", "Reads",
+           "Datagrams", "Messages", "Overruns", "Resyncs", "Avg", VTY_NEWLINE);
+  for (i = 0; i < array_size (socks); i++)
+    {
+      nl = socks[i];
+      vty_out (vty, "%-16s %10lu %10lu %10lu %9lu %8lu %5.1f%s", nl->name,
+               nl->reads, nl->dgrams, nl->msgs, nl->overruns, nl->resyncs,
+               nl->reads ? (double) nl->dgrams / nl->reads : 0.0,
+               VTY_NEWLINE);
+    }
+
+  vty_out (vty, "%sDatagrams per read (batch of up to %d):%s",
+           VTY_NEWLINE, NL_RECV_BATCH, VTY_NEWLINE);
+  vty_out (vty, "%-16s", "");
+  for (b = 0; b < NL_BATCH_BUCKETS; b++)
+    vty_out (vty, " %4d-%-4d", 1 << b,
+             b == NL_BATCH_BUCKETS - 1 ? NL_RECV_BATCH : (2 << b) - 1);
+  vty_out (vty, "%s", VTY_NEWLINE);
+  for (i = 0; i < array_size (socks); i++)
+    {
+      nl = socks[i];
+      vty_out (vty, "%-16s", nl->name);
+      for (b = 0; b < NL_BATCH_BUCKETS; b++)
+        vty_out (vty, " %9lu", nl->batch[b]);
+      vty_out (vty, "%s", VTY_NEWLINE);
+    }
+
+#ifdef RTM_NEWNEXTHOP
+  if (nl_nhg.supported)
+    vty_out (vty, "%sNexthop objects: %lu created, %lu groups replaced, "
+             "%lu route updates saved, %lu groups lost with interfaces, "
+             "%lu failures%s", VTY_NEWLINE, nl_nhg.created, nl_nhg.replaced,
+             nl_nhg.followed, nl_nhg.flushed, nl_nhg.failed, VTY_NEWLINE);
+  else
+#endif /* RTM_NEWNEXTHOP */
+    vty_out (vty, "%sNexthop objects: not supported by the kernel%s",
+             VTY_NEWLINE, VTY_NEWLINE);
+}
+
+void
+kernel_netlink_clear (void)
+{
+  struct nlsock *socks[] = { &netlink, &netlink_route4,
+#ifdef HAVE_IPV6
+                             &netlink_route6,
+#endif /* HAVE_IPV6 */
+                           };
+  unsigned int i;
+
+  for (i = 0; i < array_size (socks); i++)
+    {
+      socks[i]->reads = socks[i]->dgrams = socks[i]->msgs = 0;
+      socks[i]->overruns = socks[i]->resyncs = 0;
+      memset (socks[i]->batch, 0, sizeof (socks[i]->batch));
+    }
+#ifdef RTM_NEWNEXTHOP
+  nl_nhg.created = nl_nhg.replaced = nl_nhg.followed = 0;
+  nl_nhg.flushed = nl_nhg.failed = 0;
+#endif /* RTM_NEWNEXTHOP */
+}
+
 /* Filter out messages from self that occur on listener socket,
    caused by our actions on the command socket
  */
@@ -1963,37 +2896,51 @@ static void netlink_install_filter (int sock, __u32 pid)
     zlog_warn ("Can't install socket filter: %s\n", safe_strerror(errno));
 }
 
-/* Exported interface function.  This function simply calls
-   netlink_socket (). */
-void
-kernel_init (void)
+/* Set up a listen socket and register it with the thread master. */
+static void
+netlink_listen (struct nlsock *nl, unsigned long groups)
 {
-  unsigned long groups;
-
-  groups = RTMGRP_LINK | RTMGRP_IPV4_ROUTE | RTMGRP_IPV4_IFADDR;
-#ifdef HAVE_IPV6
-  groups |= RTMGRP_IPV6_ROUTE | RTMGRP_IPV6_IFADDR;
-#endif /* HAVE_IPV6 */
-  netlink_socket (&netlink, groups);
-  netlink_socket (&netlink_cmd, 0);
-
-  /* Register kernel socket. */
-  if (netlink.sock > 0)
+  netlink_socket (nl, groups);
+  if (nl->sock > 0)
     {
       /* Only want non-blocking on the netlink event socket */
-      if (fcntl (netlink.sock, F_SETFL, O_NONBLOCK) < 0)
-	zlog (NULL, LOG_ERR, "Can't set %s socket flags: %s", netlink.name,
+      if (fcntl (nl->sock, F_SETFL, O_NONBLOCK) < 0)
+	zlog (NULL, LOG_ERR, "Can't set %s socket flags: %s", nl->name,
 		safe_strerror (errno));
 
       /* Set receive buffer size if it's set from command line */
       if (nl_rcvbufsize)
-	netlink_recvbuf (&netlink, nl_rcvbufsize);
+	netlink_recvbuf (nl, nl_rcvbufsize);
 
-      netlink_install_filter (netlink.sock, netlink_cmd.snl.nl_pid);
-      thread_add_read (zebrad.master, kernel_read, NULL, netlink.sock);
+      netlink_install_filter (nl->sock, netlink_cmd.snl.nl_pid);
+      thread_add_read (zebrad.master, kernel_read, nl, nl->sock);
     }
 }
 
+/* Exported interface function.  This function simply calls
+   netlink_socket ().  Each route family gets a listen socket of its
+   own, so an overrun only needs that family read again. */
+void
+kernel_init (void)
+{
+  unsigned long groups;
+
+  netlink_socket (&netlink_cmd, 0);
+#ifdef RTM_NEWNEXTHOP
+  netlink_nexthop_init ();
+#endif /* RTM_NEWNEXTHOP */
+
+  groups = RTMGRP_LINK | RTMGRP_IPV4_IFADDR;
+#ifdef HAVE_IPV6
+  groups |= RTMGRP_IPV6_IFADDR;
+#endif /* HAVE_IPV6 */
+  netlink_listen (&netlink, groups);
+  netlink_listen (&netlink_route4, RTMGRP_IPV4_ROUTE);
+#ifdef HAVE_IPV6
+  netlink_listen (&netlink_route6, RTMGRP_IPV6_ROUTE);
+#endif /* HAVE_IPV6 */
+}
+
 /*
  * nl_msg_type_to_str
  */
@@ -475,3 +475,15 @@ kernel_delete_ipv6 (struct prefix *p, struct rib *rib)
   return route;
 }
 #endif /* HAVE_IPV6 */
+
+/* Routing sockets have no nexthop objects. */
+int
+kernel_nhg_update (struct prefix *p, struct rib *rib)
+{
+  return -1;
+}
+
+void
+kernel_nhg_delete (struct nexthop_group *nhg)
+{
+}
@@ -59,24 +59,72 @@ extern struct zebra_privs_t zserv_privs;
 
 extern struct zebra_t zebrad;
 
-enum rtadv_event {RTADV_START, RTADV_STOP, RTADV_TIMER, 
-		  RTADV_TIMER_MSEC, RTADV_READ};
+enum rtadv_event {RTADV_START, RTADV_STOP, RTADV_READ};
 
 static void rtadv_event (enum rtadv_event, int);
 
 static int if_join_all_router (int, struct interface *);
 static int if_leave_all_router (int, struct interface *);
 
+/* Unsolicited advertisements are scheduled on a timer wheel of
+   RTADV_WHEEL_SLOTS slots of RTADV_WHEEL_TICK milliseconds, so that
+   only the interfaces that are due are looked at.  An interface due
+   later than a turn of the wheel stays in its slot for as many turns. */
+#define RTADV_WHEEL_TICK   10
+#define RTADV_WHEEL_SLOTS  1024
+#define RTADV_WHEEL_MASK   (RTADV_WHEEL_SLOTS - 1)
+
+/* Advertisements due together are sent with one system call, up to
+   this many at a time. */
+#define RTADV_BATCH        64
+
+/* Most time to wait before the first advertisement of an interface,
+   and before answering a solicitation (MAX_RA_DELAY_TIME [RFC4861
+   10]), in milliseconds. */
+#define RTADV_START_DELAY  1000
+#define RTADV_SOLICIT_DELAY 500
+
+struct rtadv_batch
+{
+  int count;
+  struct interface *ifp[RTADV_BATCH];
+#ifdef HAVE_SENDMMSG
+  struct mmsghdr msg[RTADV_BATCH];
+#define RTADV_BATCH_MSG(B, I)  (&(B)->msg[(I)].msg_hdr)
+#else
+  struct msghdr msg[RTADV_BATCH];
+#define RTADV_BATCH_MSG(B, I)  (&(B)->msg[(I)])
+#endif /* HAVE_SENDMMSG */
+  struct iovec iov[RTADV_BATCH];
+
+  /* Control data of each message.  This is dynamic because CMSG_SPACE
+     is not guaranteed not to call a function.  Note that the size will
+     be different on different architectures due to differing
+     alignment rules. */
+  u_char *adata;
+  size_t adata_size;
+
+  struct sockaddr_in6 addr;
+};
+
 /* Structure which hold status of router advertisement. */
 struct rtadv
 {
   int sock;
 
   int adv_if_count;
-  int adv_msec_if_count;
 
   struct thread *ra_read;
   struct thread *ra_timer;
+
+  /* The timer wheel, the next tick of it to process, and the tick
+     ra_timer is set for. */
+  struct interface *wheel[RTADV_WHEEL_SLOTS];
+  int wheel_count;
+  unsigned long long wheel_tick;
+  unsigned long long timer_tick;
+
+  struct rtadv_batch batch;
 };
 
 struct rtadv *rtadv = NULL;
@@ -142,56 +190,48 @@ rtadv_recv_packet (int sock, u_char *buf, int buflen,
 
 #define RTADV_MSG_SIZE 4096
 
-/* Send router advertisement packet. */
-static void
-rtadv_send_packet (int sock, struct interface *ifp)
+/* Link-layer address of the interface and its length. */
+static int
+rtadv_lladdr (struct interface *ifp, u_char **addr)
 {
-  struct msghdr msg;
-  struct iovec iov;
-  struct cmsghdr  *cmsgptr;
-  struct in6_pktinfo *pkt;
-  struct sockaddr_in6 addr;
 #ifdef HAVE_STRUCT_SOCKADDR_DL
-  struct sockaddr_dl *sdl;
+  *addr = (u_char *) LLADDR (&ifp->sdl);
+  return ifp->sdl.sdl_alen;
+#else
+  *addr = ifp->hw_addr;
+  return ifp->hw_addr_len;
 #endif /* HAVE_STRUCT_SOCKADDR_DL */
-  static void *adata = NULL;
+}
+
+/* Whether the advertisement last built for the interface still is what
+   it should send. */
+static int
+rtadv_packet_valid (struct interface *ifp)
+{
+  struct zebra_if *zif = ifp->info;
+  u_char *lladdr;
+  int lladdr_len;
+
+  if (! zif->rtadv.AdvPacket)
+    return 0;
+  lladdr_len = MIN (rtadv_lladdr (ifp, &lladdr), INTERFACE_HWADDR_MAX);
+  return (lladdr_len == zif->rtadv.AdvPacketHwAddrLen
+          && ! memcmp (lladdr, zif->rtadv.AdvPacketHwAddr, lladdr_len));
+}
+
+/* Build the router advertisement of the interface. */
+static void
+rtadv_build_packet (struct interface *ifp)
+{
   unsigned char buf[RTADV_MSG_SIZE];
   struct nd_router_advert *rtadv;
-  int ret;
   int len = 0;
   struct zebra_if *zif;
   struct rtadv_prefix *rprefix;
-  u_char all_nodes_addr[] = {0xff,0x02,0,0,0,0,0,0,0,0,0,0,0,0,0,1};
   struct listnode *node;
   u_int16_t pkt_RouterLifetime;
-
-  /*
-   * Allocate control message bufffer.  This is dynamic because
-   * CMSG_SPACE is not guaranteed not to call a function.  Note that
-   * the size will be different on different architectures due to
-   * differing alignment rules.
-   */
-  if (adata == NULL)
-    {
-      /* XXX Free on shutdown. */
-      adata = malloc(CMSG_SPACE(sizeof(struct in6_pktinfo)));
-	   
-      if (adata == NULL)
-	zlog_err("rtadv_send_packet: can't malloc control data\n");
-    }
-
-  /* Logging of packet. */
-  if (IS_ZEBRA_DEBUG_PACKET)
-    zlog_debug ("Router advertisement send to %s", ifp->name);
-
-  /* Fill in sockaddr_in6. */
-  memset (&addr, 0, sizeof (struct sockaddr_in6));
-  addr.sin6_family = AF_INET6;
-#ifdef SIN6_LEN
-  addr.sin6_len = sizeof (struct sockaddr_in6);
-#endif /* SIN6_LEN */
-  addr.sin6_port = htons (IPPROTO_ICMPV6);
-  IPV6_ADDR_COPY (&addr.sin6_addr, all_nodes_addr);
+  u_char *lladdr;
+  int lladdr_len;
 
   /* Fetch interface information. */
   zif = ifp->info;
@@ -313,40 +353,22 @@ rtadv_send_packet (int sock, struct interface *ifp)
     }
 
   /* Hardware address. */
-#ifdef HAVE_STRUCT_SOCKADDR_DL
-  sdl = &ifp->sdl;
-  if (sdl != NULL && sdl->sdl_alen != 0)
+  lladdr_len = rtadv_lladdr (ifp, &lladdr);
+  if (lladdr_len != 0)
     {
       buf[len++] = ND_OPT_SOURCE_LINKADDR;
 
       /* Option length should be rounded up to next octet if
          the link address does not end on an octet boundary. */
-      buf[len++] = (sdl->sdl_alen + 9) >> 3;
+      buf[len++] = (lladdr_len + 9) >> 3;
 
-      memcpy (buf + len, LLADDR (sdl), sdl->sdl_alen);
-      len += sdl->sdl_alen;
+      memcpy (buf + len, lladdr, lladdr_len);
+      len += lladdr_len;
 
       /* Pad option to end on an octet boundary. */
-      memset (buf + len, 0, -(sdl->sdl_alen + 2) & 0x7);
-      len += -(sdl->sdl_alen + 2) & 0x7;
+      memset (buf + len, 0, -(lladdr_len + 2) & 0x7);
+      len += -(lladdr_len + 2) & 0x7;
     }
-#else
-  if (ifp->hw_addr_len != 0)
-    {
-      buf[len++] = ND_OPT_SOURCE_LINKADDR;
-
-      /* Option length should be rounded up to next octet if
-         the link address does not end on an octet boundary. */
-      buf[len++] = (ifp->hw_addr_len + 9) >> 3;
-
-      memcpy (buf + len, ifp->hw_addr, ifp->hw_addr_len);
-      len += ifp->hw_addr_len;
-
-      /* Pad option to end on an octet boundary. */
-      memset (buf + len, 0, -(ifp->hw_addr_len + 2) & 0x7);
-      len += -(ifp->hw_addr_len + 2) & 0x7;
-    }
-#endif /* HAVE_STRUCT_SOCKADDR_DL */
 
   /* MTU */
   if (zif->rtadv.AdvLinkMTU)
@@ -359,17 +381,98 @@ rtadv_send_packet (int sock, struct interface *ifp)
       len += sizeof (struct nd_opt_mtu);
     }
 
-  msg.msg_name = (void *) &addr;
-  msg.msg_namelen = sizeof (struct sockaddr_in6);
-  msg.msg_iov = &iov;
-  msg.msg_iovlen = 1;
-  msg.msg_control = (void *) adata;
-  msg.msg_controllen = CMSG_SPACE(sizeof(struct in6_pktinfo));
-  msg.msg_flags = 0;
-  iov.iov_base = buf;
-  iov.iov_len = len;
+  if (zif->rtadv.AdvPacket)
+    XFREE (MTYPE_RTADV_PACKET, zif->rtadv.AdvPacket);
+  zif->rtadv.AdvPacket = XMALLOC (MTYPE_RTADV_PACKET, len);
+  memcpy (zif->rtadv.AdvPacket, buf, len);
+  zif->rtadv.AdvPacketLen = len;
+
+  zif->rtadv.AdvPacketHwAddrLen = MIN (lladdr_len, INTERFACE_HWADDR_MAX);
+  memcpy (zif->rtadv.AdvPacketHwAddr, lladdr,
+          zif->rtadv.AdvPacketHwAddrLen);
+  zif->rtadv.AdvBuilt++;
+}
+
+/* Forget the advertisement built for the interface, as something it is
+   built from has changed. */
+static void
+rtadv_if_changed (struct interface *ifp)
+{
+  struct zebra_if *zif = ifp->info;
+
+  if (zif->rtadv.AdvPacket)
+    XFREE (MTYPE_RTADV_PACKET, zif->rtadv.AdvPacket);
+  zif->rtadv.AdvPacket = NULL;
+}
 
-  cmsgptr = ZCMSG_FIRSTHDR(&msg);
+/* Send the advertisements of the batch. */
+static void
+rtadv_batch_flush (void)
+{
+  struct rtadv_batch *batch = &rtadv->batch;
+  struct zebra_if *zif;
+  int i = 0;
+  int ret;
+
+  while (i < batch->count)
+    {
+#ifdef HAVE_SENDMMSG
+      ret = sendmmsg (rtadv->sock, &batch->msg[i], batch->count - i, 0);
+#else
+      ret = sendmsg (rtadv->sock, &batch->msg[i], 0) < 0 ? -1 : 1;
+#endif /* HAVE_SENDMMSG */
+
+      /* Those sent, up to the first that could not be. */
+      for (; ret > 0; ret--, i++)
+	{
+	  zif = batch->ifp[i]->info;
+	  zif->rtadv.AdvSent++;
+	}
+      if (ret < 0)
+	{
+	  zif = batch->ifp[i]->info;
+	  zif->rtadv.AdvSendFailed++;
+	  zlog_err ("rtadv_batch_flush: sendmsg on %s: %d (%s)",
+		    batch->ifp[i]->name, errno, safe_strerror (errno));
+	  i++;
+	}
+    }
+  batch->count = 0;
+}
+
+/* Queue router advertisement packet of the interface for sending. */
+static void
+rtadv_send_packet (struct interface *ifp)
+{
+  struct rtadv_batch *batch = &rtadv->batch;
+  struct zebra_if *zif = ifp->info;
+  struct msghdr *msg;
+  struct cmsghdr *cmsgptr;
+  struct in6_pktinfo *pkt;
+  int i;
+
+  /* Logging of packet. */
+  if (IS_ZEBRA_DEBUG_PACKET)
+    zlog_debug ("Router advertisement send to %s", ifp->name);
+
+  if (! rtadv_packet_valid (ifp))
+    rtadv_build_packet (ifp);
+
+  i = batch->count++;
+  batch->ifp[i] = ifp;
+  batch->iov[i].iov_base = zif->rtadv.AdvPacket;
+  batch->iov[i].iov_len = zif->rtadv.AdvPacketLen;
+
+  msg = RTADV_BATCH_MSG (batch, i);
+  msg->msg_name = (void *) &batch->addr;
+  msg->msg_namelen = sizeof (struct sockaddr_in6);
+  msg->msg_iov = &batch->iov[i];
+  msg->msg_iovlen = 1;
+  msg->msg_control = (void *) (batch->adata + i * batch->adata_size);
+  msg->msg_controllen = batch->adata_size;
+  msg->msg_flags = 0;
+
+  cmsgptr = ZCMSG_FIRSTHDR(msg);
   cmsgptr->cmsg_len = CMSG_LEN(sizeof(struct in6_pktinfo));
   cmsgptr->cmsg_level = IPPROTO_IPV6;
   cmsgptr->cmsg_type = IPV6_PKTINFO;
@@ -378,68 +481,216 @@ rtadv_send_packet (int sock, struct interface *ifp)
   memset (&pkt->ipi6_addr, 0, sizeof (struct in6_addr));
   pkt->ipi6_ifindex = ifp->ifindex;
 
-  ret = sendmsg (sock, &msg, 0);
-  if (ret < 0)
+  if (batch->count == RTADV_BATCH)
+    rtadv_batch_flush ();
+}
+
+static void
+rtadv_batch_init (struct rtadv_batch *batch)
+{
+  u_char all_nodes_addr[] = {0xff,0x02,0,0,0,0,0,0,0,0,0,0,0,0,0,1};
+
+  batch->adata_size = CMSG_SPACE(sizeof(struct in6_pktinfo));
+  batch->adata = XCALLOC (MTYPE_TMP, RTADV_BATCH * batch->adata_size);
+
+  /* Fill in sockaddr_in6. */
+  memset (&batch->addr, 0, sizeof (struct sockaddr_in6));
+  batch->addr.sin6_family = AF_INET6;
+#ifdef SIN6_LEN
+  batch->addr.sin6_len = sizeof (struct sockaddr_in6);
+#endif /* SIN6_LEN */
+  batch->addr.sin6_port = htons (IPPROTO_ICMPV6);
+  IPV6_ADDR_COPY (&batch->addr.sin6_addr, all_nodes_addr);
+}
+
+static unsigned long long
+rtadv_now (void)
+{
+  struct timeval tv;
+
+  quagga_gettime (QUAGGA_CLK_MONOTONIC, &tv);
+  return tv.tv_sec * 1000ULL + tv.tv_usec / 1000;
+}
+
+/* Time to the next unsolicited advertisement, chosen uniformly between
+   MinRtrAdvInterval and MaxRtrAdvInterval so that routers and their
+   interfaces do not fall into step [RFC4861 6.2.4]. */
+static u_int32_t
+rtadv_interval (struct zebra_if *zif)
+{
+  u_int32_t min = zif->rtadv.MinRtrAdvInterval;
+  u_int32_t max = zif->rtadv.MaxRtrAdvInterval;
+
+  if (min >= max)
+    return max;
+  return min + random () % (max - min + 1);
+}
+
+static int rtadv_timer (struct thread *);
+
+/* Set the timer for the first slot of the wheel with interfaces. */
+static void
+rtadv_wheel_arm (void)
+{
+  unsigned long long tick;
+  unsigned long long now;
+
+  if (rtadv->ra_timer)
     {
-      zlog_err ("rtadv_send_packet: sendmsg %d (%s)\n",
-		errno, safe_strerror(errno));
+      thread_cancel (rtadv->ra_timer);
+      rtadv->ra_timer = NULL;
     }
+  if (! rtadv->wheel_count)
+    return;
+
+  for (tick = rtadv->wheel_tick; ! rtadv->wheel[tick & RTADV_WHEEL_MASK];
+       tick++)
+    ;
+  rtadv->timer_tick = tick;
+
+  now = rtadv_now ();
+  rtadv->ra_timer =
+    thread_add_timer_msec (zebrad.master, rtadv_timer, NULL,
+                           tick * RTADV_WHEEL_TICK > now
+                           ? tick * RTADV_WHEEL_TICK - now : 0);
+}
+
+static void
+rtadv_wheel_remove (struct interface *ifp)
+{
+  struct zebra_if *zif = ifp->info;
+  struct zebra_if *next;
+
+  if (! zif->rtadv.AdvWheelPrev)
+    return;
+
+  *zif->rtadv.AdvWheelPrev = zif->rtadv.AdvWheelNext;
+  if (zif->rtadv.AdvWheelNext)
+    {
+      next = zif->rtadv.AdvWheelNext->info;
+      next->rtadv.AdvWheelPrev = zif->rtadv.AdvWheelPrev;
+    }
+  zif->rtadv.AdvWheelNext = NULL;
+  zif->rtadv.AdvWheelPrev = NULL;
+  rtadv->wheel_count--;
+}
+
+/* Put the interface on the wheel to advertise in delay milliseconds.
+   Returns the tick of its slot. */
+static unsigned long long
+rtadv_wheel_insert (struct interface *ifp, u_int32_t delay)
+{
+  struct zebra_if *zif = ifp->info;
+  struct zebra_if *next;
+  struct interface **slot;
+  unsigned long long now, tick;
+
+  rtadv_wheel_remove (ifp);
+
+  now = rtadv_now ();
+  if (! rtadv->wheel_count)
+    rtadv->wheel_tick = now / RTADV_WHEEL_TICK;
+
+  zif->rtadv.AdvNextSend = now + delay;
+  tick = MAX (zif->rtadv.AdvNextSend / RTADV_WHEEL_TICK, rtadv->wheel_tick);
+
+  slot = &rtadv->wheel[tick & RTADV_WHEEL_MASK];
+  zif->rtadv.AdvWheelNext = *slot;
+  zif->rtadv.AdvWheelPrev = slot;
+  if (*slot)
+    {
+      next = (*slot)->info;
+      next->rtadv.AdvWheelPrev = &zif->rtadv.AdvWheelNext;
+    }
+  *slot = ifp;
+  rtadv->wheel_count++;
+  return tick;
+}
+
+/* Have the interface advertise in delay milliseconds. */
+static void
+rtadv_wheel_add (struct interface *ifp, u_int32_t delay)
+{
+  unsigned long long tick;
+
+  tick = rtadv_wheel_insert (ifp, delay);
+  if (! rtadv->ra_timer || tick < rtadv->timer_tick)
+    rtadv_wheel_arm ();
 }
 
 static int
 rtadv_timer (struct thread *thread)
 {
-  struct listnode *node, *nnode;
-  struct interface *ifp;
+  struct interface *ifp, *next;
   struct zebra_if *zif;
-  int period;
+  unsigned long long now_tick, tick;
 
   rtadv->ra_timer = NULL;
-  if (rtadv->adv_msec_if_count == 0)
-    {
-      period = 1000; /* 1 s */
-      rtadv_event (RTADV_TIMER, 1 /* 1 s */);
-    } 
-  else
-    {
-      period = 10; /* 10 ms */
-      rtadv_event (RTADV_TIMER_MSEC, 10 /* 10 ms */);
-    }
+  now_tick = rtadv_now () / RTADV_WHEEL_TICK;
 
-  for (ALL_LIST_ELEMENTS (iflist, node, nnode, ifp))
-    {
-      if (if_is_loopback (ifp) || ! if_is_operative (ifp))
-	continue;
+  /* Each slot is looked at once, however late the timer is. */
+  if (rtadv->wheel_tick + RTADV_WHEEL_SLOTS <= now_tick)
+    rtadv->wheel_tick = now_tick + 1 - RTADV_WHEEL_SLOTS;
 
-      zif = ifp->info;
+  for (tick = rtadv->wheel_tick; tick <= now_tick; tick++)
+    for (ifp = rtadv->wheel[tick & RTADV_WHEEL_MASK]; ifp; ifp = next)
+      {
+	zif = ifp->info;
+	next = zif->rtadv.AdvWheelNext;
+	if (zif->rtadv.AdvNextSend / RTADV_WHEEL_TICK > now_tick)
+	  continue;
+
+	rtadv_wheel_insert (ifp, rtadv_interval (zif));
+	if (! if_is_loopback (ifp) && if_is_operative (ifp))
+	  rtadv_send_packet (ifp);
+      }
+  rtadv->wheel_tick = now_tick + 1;
 
-      if (zif->rtadv.AdvSendAdvertisements)
-	{ 
-	  zif->rtadv.AdvIntervalTimer -= period;
-	  if (zif->rtadv.AdvIntervalTimer <= 0)
-	    {
-	      /* FIXME: using MaxRtrAdvInterval each time isn't what section
-	         6.2.4 of RFC4861 tells to do. */
-	      zif->rtadv.AdvIntervalTimer = zif->rtadv.MaxRtrAdvInterval;
-	      rtadv_send_packet (rtadv->sock, ifp);
-	    }
-	}
-    }
+  rtadv_batch_flush ();
+  rtadv_wheel_arm ();
   return 0;
 }
 
 static void
 rtadv_process_solicit (struct interface *ifp)
 {
-  zlog_info ("Router solicitation received on %s", ifp->name);
+  struct zebra_if *zif = ifp->info;
+  u_int32_t delay;
+
+  if (IS_ZEBRA_DEBUG_PACKET)
+    zlog_debug ("Router solicitation received on %s", ifp->name);
+  zif->rtadv.SolicitRcvd++;
+
+  /* Answer with a multicast advertisement after a random delay, so
+     that solicitations in the meantime are answered by it too
+     [RFC4861 6.2.6]. */
+  delay = random () % RTADV_SOLICIT_DELAY;
+  if (zif->rtadv.AdvNextSend > rtadv_now () + delay)
+    rtadv_wheel_add (ifp, delay);
+}
+
+static void
+rtadv_process_advert (struct interface *ifp)
+{
+  struct zebra_if *zif = ifp->info;
 
-  rtadv_send_packet (rtadv->sock, ifp);
+  if (IS_ZEBRA_DEBUG_PACKET)
+    zlog_debug ("Router advertisement received on %s", ifp->name);
+  zif->rtadv.AdvRcvd++;
 }
 
+/* Have the interface advertise soon, as it starts to or its interval
+   has changed.  Interfaces started together do not all advertise at
+   once. */
 static void
-rtadv_process_advert (void)
+rtadv_if_start (struct interface *ifp)
 {
-  zlog_info ("Router advertisement received");
+  struct zebra_if *zif = ifp->info;
+
+  if (! zif->rtadv.AdvSendAdvertisements)
+    return;
+  rtadv_wheel_add (ifp, random () % MIN (RTADV_START_DELAY,
+                                         zif->rtadv.MaxRtrAdvInterval));
 }
 
 static void
@@ -494,7 +745,7 @@ rtadv_process_packet (u_char *buf, unsigned int len, unsigned int ifindex, int h
   if (icmph->icmp6_type == ND_ROUTER_SOLICIT)
     rtadv_process_solicit (ifp);
   else if (icmph->icmp6_type == ND_ROUTER_ADVERT)
-    rtadv_process_advert ();
+    rtadv_process_advert (ifp);
 
   return;
 }
@@ -674,7 +925,7 @@ DEFUN (ipv6_nd_suppress_ra,
   if (zif->rtadv.AdvSendAdvertisements)
     {
       zif->rtadv.AdvSendAdvertisements = 0;
-      zif->rtadv.AdvIntervalTimer = 0;
+      rtadv_wheel_remove (ifp);
       rtadv->adv_if_count--;
 
       if_leave_all_router (rtadv->sock, ifp);
@@ -709,13 +960,13 @@ DEFUN (no_ipv6_nd_suppress_ra,
   if (! zif->rtadv.AdvSendAdvertisements)
     {
       zif->rtadv.AdvSendAdvertisements = 1;
-      zif->rtadv.AdvIntervalTimer = 0;
       rtadv->adv_if_count++;
 
       if_join_all_router (rtadv->sock, ifp);
 
       if (rtadv->adv_if_count == 1)
 	rtadv_event (RTADV_START, rtadv->sock);
+      rtadv_if_start (ifp);
     }
 
   return CMD_SUCCESS;
@@ -740,15 +991,10 @@ DEFUN (ipv6_nd_ra_interval_msec,
     return CMD_WARNING;
   }
 
-  if (zif->rtadv.MaxRtrAdvInterval % 1000)
-    rtadv->adv_msec_if_count--;
-
-  if (interval % 1000)
-    rtadv->adv_msec_if_count++;
-  
   zif->rtadv.MaxRtrAdvInterval = interval;
   zif->rtadv.MinRtrAdvInterval = 0.33 * interval;
-  zif->rtadv.AdvIntervalTimer = 0;
+  rtadv_if_changed (ifp);
+  rtadv_if_start (ifp);
 
   return CMD_SUCCESS;
 }
@@ -772,15 +1018,13 @@ DEFUN (ipv6_nd_ra_interval,
     return CMD_WARNING;
   }
 
-  if (zif->rtadv.MaxRtrAdvInterval % 1000)
-    rtadv->adv_msec_if_count--;
-	
   /* convert to milliseconds */
   interval = interval * 1000; 
 	
   zif->rtadv.MaxRtrAdvInterval = interval;
   zif->rtadv.MinRtrAdvInterval = 0.33 * interval;
-  zif->rtadv.AdvIntervalTimer = 0;
+  rtadv_if_changed (ifp);
+  rtadv_if_start (ifp);
 
   return CMD_SUCCESS;
 }
@@ -799,12 +1043,11 @@ DEFUN (no_ipv6_nd_ra_interval,
   ifp = (struct interface *) vty->index;
   zif = ifp->info;
 
-  if (zif->rtadv.MaxRtrAdvInterval % 1000)
-    rtadv->adv_msec_if_count--;
-  
   zif->rtadv.MaxRtrAdvInterval = RTADV_MAX_RTR_ADV_INTERVAL;
   zif->rtadv.MinRtrAdvInterval = RTADV_MIN_RTR_ADV_INTERVAL;
-  zif->rtadv.AdvIntervalTimer = zif->rtadv.MaxRtrAdvInterval;
+  rtadv_if_changed (ifp);
+  if (zif->rtadv.AdvSendAdvertisements)
+    rtadv_wheel_add (ifp, rtadv_interval (zif));
 
   return CMD_SUCCESS;
 }
@@ -854,7 +1097,7 @@ DEFUN (ipv6_nd_ra_lifetime,
     }
 
   zif->rtadv.AdvDefaultLifetime = lifetime;
-
+  rtadv_if_changed (ifp);
   return CMD_SUCCESS;
 }
 
@@ -873,7 +1116,7 @@ DEFUN (no_ipv6_nd_ra_lifetime,
   zif = ifp->info;
 
   zif->rtadv.AdvDefaultLifetime = -1;
-
+  rtadv_if_changed (ifp);
   return CMD_SUCCESS;
 }
 
@@ -897,6 +1140,7 @@ DEFUN (ipv6_nd_reachable_time,
   struct interface *ifp = (struct interface *) vty->index;
   struct zebra_if *zif = ifp->info;
   VTY_GET_INTEGER_RANGE ("reachable time", zif->rtadv.AdvReachableTime, argv[0], 1, RTADV_MAX_REACHABLE_TIME);
+  rtadv_if_changed (ifp);
   return CMD_SUCCESS;
 }
 
@@ -915,7 +1159,7 @@ DEFUN (no_ipv6_nd_reachable_time,
   zif = ifp->info;
 
   zif->rtadv.AdvReachableTime = 0;
-
+  rtadv_if_changed (ifp);
   return CMD_SUCCESS;
 }
 
@@ -939,6 +1183,7 @@ DEFUN (ipv6_nd_homeagent_preference,
   struct interface *ifp = (struct interface *) vty->index;
   struct zebra_if *zif = ifp->info;
   VTY_GET_INTEGER_RANGE ("home agent preference", zif->rtadv.HomeAgentPreference, argv[0], 0, 65535);
+  rtadv_if_changed (ifp);
   return CMD_SUCCESS;
 }
 
@@ -957,7 +1202,7 @@ DEFUN (no_ipv6_nd_homeagent_preference,
   zif = ifp->info;
 
   zif->rtadv.HomeAgentPreference = 0;
-
+  rtadv_if_changed (ifp);
   return CMD_SUCCESS;
 }
 
@@ -981,6 +1226,7 @@ DEFUN (ipv6_nd_homeagent_lifetime,
   struct interface *ifp = (struct interface *) vty->index;
   struct zebra_if *zif = ifp->info;
   VTY_GET_INTEGER_RANGE ("home agent lifetime", zif->rtadv.HomeAgentLifetime, argv[0], 0, RTADV_MAX_HALIFETIME);
+  rtadv_if_changed (ifp);
   return CMD_SUCCESS;
 }
 
@@ -999,7 +1245,7 @@ DEFUN (no_ipv6_nd_homeagent_lifetime,
   zif = ifp->info;
 
   zif->rtadv.HomeAgentLifetime = -1;
-
+  rtadv_if_changed (ifp);
   return CMD_SUCCESS;
 }
 
@@ -1026,7 +1272,7 @@ DEFUN (ipv6_nd_managed_config_flag,
   zif = ifp->info;
 
   zif->rtadv.AdvManagedFlag = 1;
-
+  rtadv_if_changed (ifp);
   return CMD_SUCCESS;
 }
 
@@ -1045,7 +1291,7 @@ DEFUN (no_ipv6_nd_managed_config_flag,
   zif = ifp->info;
 
   zif->rtadv.AdvManagedFlag = 0;
-
+  rtadv_if_changed (ifp);
   return CMD_SUCCESS;
 }
 
@@ -1063,7 +1309,7 @@ DEFUN (ipv6_nd_homeagent_config_flag,
   zif = ifp->info;
 
   zif->rtadv.AdvHomeAgentFlag = 1;
-
+  rtadv_if_changed (ifp);
   return CMD_SUCCESS;
 }
 
@@ -1082,7 +1328,7 @@ DEFUN (no_ipv6_nd_homeagent_config_flag,
   zif = ifp->info;
 
   zif->rtadv.AdvHomeAgentFlag = 0;
-
+  rtadv_if_changed (ifp);
   return CMD_SUCCESS;
 }
 
@@ -1100,7 +1346,7 @@ DEFUN (ipv6_nd_adv_interval_config_option,
   zif = ifp->info;
 
   zif->rtadv.AdvIntervalOption = 1;
-
+  rtadv_if_changed (ifp);
   return CMD_SUCCESS;
 }
 
@@ -1119,7 +1365,7 @@ DEFUN (no_ipv6_nd_adv_interval_config_option,
   zif = ifp->info;
 
   zif->rtadv.AdvIntervalOption = 0;
-
+  rtadv_if_changed (ifp);
   return CMD_SUCCESS;
 }
 
@@ -1137,7 +1383,7 @@ DEFUN (ipv6_nd_other_config_flag,
   zif = ifp->info;
 
   zif->rtadv.AdvOtherConfigFlag = 1;
-
+  rtadv_if_changed (ifp);
   return CMD_SUCCESS;
 }
 
@@ -1156,7 +1402,7 @@ DEFUN (no_ipv6_nd_other_config_flag,
   zif = ifp->info;
 
   zif->rtadv.AdvOtherConfigFlag = 0;
-
+  rtadv_if_changed (ifp);
   return CMD_SUCCESS;
 }
 
@@ -1237,7 +1483,7 @@ DEFUN (ipv6_nd_prefix,
     }
 
   rtadv_prefix_set (zebra_if, &rp);
-
+  rtadv_if_changed (ifp);
   return CMD_SUCCESS;
 }
 
@@ -1428,6 +1674,7 @@ DEFUN (no_ipv6_nd_prefix,
       vty_out (vty, "Non-exist IPv6 prefix%s", VTY_NEWLINE);
       return CMD_WARNING;
     }
+  rtadv_if_changed (ifp);
 
   return CMD_SUCCESS;
 }
@@ -1454,6 +1701,7 @@ DEFUN (ipv6_nd_router_preference,
       if (strncmp (argv[0], rtadv_pref_strs[i], 1) == 0)
 	{
 	  zif->rtadv.DefaultPreference = i;
+	  rtadv_if_changed (ifp);
 	  return CMD_SUCCESS;
 	}
       i++;
@@ -1477,7 +1725,7 @@ DEFUN (no_ipv6_nd_router_preference,
   zif = ifp->info;
 
   zif->rtadv.DefaultPreference = RTADV_PREF_MEDIUM; /* Default per RFC4191. */
-
+  rtadv_if_changed (ifp);
   return CMD_SUCCESS;
 }
 
@@ -1503,6 +1751,7 @@ DEFUN (ipv6_nd_mtu,
   struct interface *ifp = (struct interface *) vty->index;
   struct zebra_if *zif = ifp->info;
   VTY_GET_INTEGER_RANGE ("MTU", zif->rtadv.AdvLinkMTU, argv[0], 1, 65535);
+  rtadv_if_changed (ifp);
   return CMD_SUCCESS;
 }
 
@@ -1517,6 +1766,7 @@ DEFUN (no_ipv6_nd_mtu,
   struct interface *ifp = (struct interface *) vty->index;
   struct zebra_if *zif = ifp->info;
   zif->rtadv.AdvLinkMTU = 0;
+  rtadv_if_changed (ifp);
   return CMD_SUCCESS;
 }
 
@@ -1635,9 +1885,6 @@ rtadv_event (enum rtadv_event event, int val)
     case RTADV_START:
       if (! rtadv->ra_read)
 	rtadv->ra_read = thread_add_read (zebrad.master, rtadv_read, NULL, val);
-      if (! rtadv->ra_timer)
-	rtadv->ra_timer = thread_add_event (zebrad.master, rtadv_timer,
-	                                    NULL, 0);
       break;
     case RTADV_STOP:
       if (rtadv->ra_timer)
@@ -1651,16 +1898,6 @@ rtadv_event (enum rtadv_event event, int val)
 	  rtadv->ra_read = NULL;
 	}
       break;
-    case RTADV_TIMER:
-      if (! rtadv->ra_timer)
-	rtadv->ra_timer = thread_add_timer (zebrad.master, rtadv_timer, NULL,
-	                                    val);
-      break;
-    case RTADV_TIMER_MSEC:
-      if (! rtadv->ra_timer)
-	rtadv->ra_timer = thread_add_timer_msec (zebrad.master, rtadv_timer, 
-					    NULL, val);
-      break;
     case RTADV_READ:
       if (! rtadv->ra_read)
 	rtadv->ra_read = thread_add_read (zebrad.master, rtadv_read, NULL, val);
@@ -1671,6 +1908,21 @@ rtadv_event (enum rtadv_event event, int val)
   return;
 }
 
+/* Called when the interface is deleted. */
+void
+rtadv_if_delete (struct interface *ifp)
+{
+  struct zebra_if *zif = ifp->info;
+
+  if (rtadv && zif->rtadv.AdvSendAdvertisements)
+    {
+      rtadv_wheel_remove (ifp);
+      if (--rtadv->adv_if_count == 0)
+	rtadv_event (RTADV_STOP, 0);
+    }
+  rtadv_if_changed (ifp);
+}
+
 void
 rtadv_init (void)
 {
@@ -1682,6 +1934,7 @@ rtadv_init (void)
 
   rtadv = rtadv_new ();
   rtadv->sock = sock;
+  rtadv_batch_init (&rtadv->batch);
 
   install_element (INTERFACE_NODE, &ipv6_nd_suppress_ra_cmd);
   install_element (INTERFACE_NODE, &no_ipv6_nd_suppress_ra_cmd);
@@ -44,10 +44,44 @@
 /*
  * Sizes of outgoing and incoming stream buffers for writing/reading
  * FPM messages.
+ *
+ * The outgoing buffer is sized by the configured flush size, which is
+ * the number of bytes of messages we try to coalesce into a single
+ * write to the socket.
  */
 #define ZFPM_OBUF_SIZE (2 * FPM_MAX_MSG_LEN)
 #define ZFPM_IBUF_SIZE (FPM_MAX_MSG_LEN)
 
+#define ZFPM_FLUSH_SIZE_MIN      ZFPM_OBUF_SIZE
+#define ZFPM_FLUSH_SIZE_MAX      (1024 * 1024)
+#define ZFPM_FLUSH_SIZE_DEFAULT  (64 * 1024)
+
+/*
+ * Maximum number of milliseconds that route updates may be held back
+ * so that they can be coalesced with later ones. The default is to
+ * send them right away.
+ */
+#define ZFPM_FLUSH_DELAY_MAX     1000
+#define ZFPM_FLUSH_DELAY_DEFAULT 0
+
+/*
+ * Rough size of an encoded route update, used to decide if enough
+ * updates are queued to fill a flush without waiting any longer.
+ */
+#define ZFPM_ROUTE_MSG_SIZE_EST  64
+
+/*
+ * Number of buckets in the queue age histogram. Bucket 'i' counts
+ * updates that spent less than 2^i milliseconds on the queue, and the
+ * last bucket counts everything else.
+ */
+#define ZFPM_Q_AGE_BUCKETS       12
+
+/*
+ * Number of seconds for which we keep per-second throughput figures.
+ */
+#define ZFPM_RATE_SECS           ZFPM_STATS_IVL_SECS
+
 /*
  * The maximum number of times the FPM socket write callback can call
  * 'write' before it yields.
@@ -105,6 +139,20 @@ typedef struct zfpm_stats_t_ {
   unsigned long t_conn_up_aborts;
   unsigned long t_conn_up_finishes;
 
+  unsigned long bytes_written;
+  unsigned long flush_delays;
+
+  unsigned long snapshot_starts;
+  unsigned long snapshot_routes;
+  unsigned long snapshot_dequeues;
+  unsigned long snapshot_aborts;
+  unsigned long snapshot_finishes;
+
+  /*
+   * Histogram of the time updates spent on the queue.
+   */
+  unsigned long q_age_hist[ZFPM_Q_AGE_BUCKETS];
+
 } zfpm_stats_t;
 
 /*
@@ -138,6 +186,44 @@ typedef enum {
 
 } zfpm_state_t;
 
+/*
+ * States of a table snapshot sent to the FPM after the connection
+ * comes up, if snapshot resync is configured.
+ */
+typedef enum {
+
+  /*
+   * No snapshot is in progress.
+   */
+  ZFPM_SNAPSHOT_NONE,
+
+  /*
+   * The start marker has to be sent.
+   */
+  ZFPM_SNAPSHOT_START,
+
+  /*
+   * Walking the tables and sending every route in turn.
+   */
+  ZFPM_SNAPSHOT_WALK,
+
+  /*
+   * All routes have been sent, the end marker has to follow.
+   */
+  ZFPM_SNAPSHOT_END
+
+} zfpm_snapshot_state_t;
+
+/*
+ * Throughput over one second.
+ */
+typedef struct zfpm_rate_t_
+{
+  time_t sec;
+  unsigned long routes;
+  unsigned long bytes;
+} zfpm_rate_t;
+
 /*
  * Globals.
  */
@@ -159,9 +245,22 @@ typedef struct zfpm_glob_t_
   int fpm_port;
 
   /*
-   * List of rib_dest_t structures to be processed
+   * List of rib_dest_t structures to be processed, and its length.
    */
   TAILQ_HEAD (zfpm_dest_q, rib_dest_t_) dest_q;
+  unsigned long dest_q_len;
+
+  /*
+   * Configuration for coalescing updates into fewer, larger writes.
+   */
+  u_int32_t flush_size;
+  u_int32_t flush_delay;
+
+  /*
+   * TRUE if the table is to be sent as a snapshot between start and
+   * end markers when the connection comes up.
+   */
+  int snapshot_resync;
 
   /*
    * Stream socket to the FPM.
@@ -201,6 +300,26 @@ typedef struct zfpm_glob_t_
     zfpm_rnodes_iter_t iter;
   } t_conn_up_state;
 
+  /*
+   * Timer that releases updates held back for coalescing.
+   */
+  struct thread *t_flush;
+
+  /*
+   * State of the table snapshot, which is built by the write
+   * callback as room becomes available in the outbound buffer.
+   */
+  struct {
+    zfpm_snapshot_state_t state;
+    zfpm_rnodes_iter_t iter;
+    u_int32_t routes;
+  } snapshot;
+
+  /*
+   * Per-second throughput over the last few seconds, indexed by time.
+   */
+  zfpm_rate_t rate[ZFPM_RATE_SECS];
+
   unsigned long connect_calls;
   time_t last_connect_call_time;
 
@@ -238,6 +357,7 @@ static zfpm_glob_t *zfpm_g = &zfpm_glob_space;
 
 static int zfpm_read_cb (struct thread *thread);
 static int zfpm_write_cb (struct thread *thread);
+static int zfpm_flush_timer_cb (struct thread *thread);
 
 static void zfpm_set_state (zfpm_state_t state, const char *reason);
 static void zfpm_start_connect_timer (const char *reason);
@@ -313,6 +433,44 @@ zfpm_get_elapsed_time (time_t reference)
   return now - reference;
 }
 
+/*
+ * zfpm_get_msecs
+ *
+ * Returns a cheap, coarse millisecond timestamp for measuring how long
+ * updates wait on the queue. Wraps around, so only use differences.
+ */
+static inline u_int32_t
+zfpm_get_msecs (void)
+{
+  struct timeval tv;
+
+  tv = recent_relative_time ();
+  return tv.tv_sec * 1000 + tv.tv_usec / 1000;
+}
+
+/*
+ * zfpm_rate_get
+ *
+ * Returns the throughput counters for the current second.
+ */
+static zfpm_rate_t *
+zfpm_rate_get (void)
+{
+  zfpm_rate_t *rate;
+  time_t now;
+
+  now = recent_relative_time ().tv_sec;
+  rate = &zfpm_g->rate[now % ZFPM_RATE_SECS];
+  if (rate->sec != now)
+    {
+      rate->sec = now;
+      rate->routes = 0;
+      rate->bytes = 0;
+    }
+
+  return rate;
+}
+
 /*
  * zfpm_is_table_for_fpm
  *
@@ -584,6 +742,20 @@ zfpm_connection_up (const char *detail)
   zfpm_write_on ();
   zfpm_set_state (ZFPM_STATE_ESTABLISHED, detail);
 
+  /*
+   * In snapshot mode the write callback streams the tables to the FPM
+   * directly, instead of queueing every destination.
+   */
+  if (zfpm_g->snapshot_resync)
+    {
+      zfpm_debug ("Starting table snapshot");
+      zfpm_rnodes_iter_init (&zfpm_g->snapshot.iter);
+      zfpm_g->snapshot.state = ZFPM_SNAPSHOT_START;
+      zfpm_g->snapshot.routes = 0;
+      zfpm_g->stats.snapshot_starts++;
+      return;
+    }
+
   /*
    * Start thread to push existing routes to the FPM.
    */
@@ -661,6 +833,7 @@ zfpm_conn_down_thread_cb (struct thread *thread)
 	  if (CHECK_FLAG (dest->flags, RIB_DEST_UPDATE_FPM))
 	    {
 	      TAILQ_REMOVE (&zfpm_g->dest_q, dest, fpm_q_entries);
+	      zfpm_g->dest_q_len--;
 	    }
 
 	  UNSET_FLAG (dest->flags, RIB_DEST_UPDATE_FPM);
@@ -715,10 +888,23 @@ zfpm_connection_down (const char *detail)
 
   zfpm_read_off ();
   zfpm_write_off ();
+  THREAD_TIMER_OFF (zfpm_g->t_flush);
 
   stream_reset (zfpm_g->ibuf);
   stream_reset (zfpm_g->obuf);
 
+  /*
+   * Abandon a snapshot in progress, the next connection starts afresh.
+   */
+  if (zfpm_g->snapshot.state == ZFPM_SNAPSHOT_START
+      || zfpm_g->snapshot.state == ZFPM_SNAPSHOT_WALK)
+    zfpm_rnodes_iter_cleanup (&zfpm_g->snapshot.iter);
+  if (zfpm_g->snapshot.state != ZFPM_SNAPSHOT_NONE)
+    {
+      zfpm_g->snapshot.state = ZFPM_SNAPSHOT_NONE;
+      zfpm_g->stats.snapshot_aborts++;
+    }
+
   if (zfpm_g->sock >= 0) {
     close (zfpm_g->sock);
     zfpm_g->sock = -1;
@@ -849,6 +1035,12 @@ zfpm_writes_pending (void)
   if (!TAILQ_EMPTY (&zfpm_g->dest_q))
     return 1;
 
+  /*
+   * Check if a snapshot of the tables is still being sent.
+   */
+  if (zfpm_g->snapshot.state != ZFPM_SNAPSHOT_NONE)
+    return 1;
+
   return 0;
 }
 
@@ -901,28 +1093,193 @@ zfpm_route_for_update (rib_dest_t *dest)
   return NULL;
 }
 
+/*
+ * zfpm_write_route
+ *
+ * Append a route add (or delete, if rib is NULL) message for the given
+ * dest to the stream, which must have room for FPM_MAX_MSG_LEN bytes.
+ *
+ * Returns TRUE if a message was written.
+ */
+static int
+zfpm_write_route (struct stream *s, rib_dest_t *dest, struct rib *rib)
+{
+  unsigned char *buf, *data, *buf_end;
+  size_t msg_len;
+  size_t data_len;
+  fpm_msg_hdr_t *hdr;
+
+  buf = STREAM_DATA (s) + stream_get_endp (s);
+  buf_end = buf + STREAM_WRITEABLE (s);
+
+  hdr = (fpm_msg_hdr_t *) buf;
+  hdr->version = FPM_PROTO_VERSION;
+  hdr->msg_type = FPM_MSG_TYPE_NETLINK;
+
+  data = fpm_msg_data (hdr);
+
+  data_len = zfpm_encode_route (dest, rib, (char *) data, buf_end - data);
+
+  assert (data_len);
+  if (!data_len)
+    return 0;
+
+  msg_len = fpm_data_len_to_msg_len (data_len);
+  hdr->msg_len = htons (msg_len);
+  stream_forward_endp (s, msg_len);
+
+  zfpm_rate_get ()->routes++;
+  return 1;
+}
+
+/*
+ * zfpm_write_marker
+ *
+ * Append a snapshot marker message to the stream. The end marker
+ * carries the number of routes in the snapshot.
+ */
+static void
+zfpm_write_marker (struct stream *s, fpm_msg_type_e msg_type)
+{
+  size_t msg_len;
+
+  msg_len = FPM_MSG_HDR_LEN;
+  if (msg_type == FPM_MSG_TYPE_SNAPSHOT_END)
+    msg_len = fpm_data_len_to_msg_len (sizeof (u_int32_t));
+
+  stream_putc (s, FPM_PROTO_VERSION);
+  stream_putc (s, msg_type);
+  stream_putw (s, msg_len);
+
+  if (msg_type == FPM_MSG_TYPE_SNAPSHOT_END)
+    stream_putl (s, zfpm_g->snapshot.routes);
+}
+
+/*
+ * zfpm_build_snapshot
+ *
+ * Write as much of the table snapshot as fits into the outbound
+ * buffer. The walk is paused in between, so routes that change while
+ * the snapshot is in progress are sent via the queue as usual.
+ */
+static void
+zfpm_build_snapshot (struct stream *s)
+{
+  struct route_node *rnode;
+  rib_dest_t *dest;
+  struct rib *rib;
+
+  if (zfpm_g->snapshot.state == ZFPM_SNAPSHOT_START)
+    {
+      zfpm_write_marker (s, FPM_MSG_TYPE_SNAPSHOT_START);
+      zfpm_g->snapshot.state = ZFPM_SNAPSHOT_WALK;
+    }
+
+  if (zfpm_g->snapshot.state == ZFPM_SNAPSHOT_WALK)
+    {
+      while (STREAM_WRITEABLE (s) >= FPM_MAX_MSG_LEN)
+	{
+	  rnode = zfpm_rnodes_iter_next (&zfpm_g->snapshot.iter);
+	  if (!rnode)
+	    {
+	      zfpm_rnodes_iter_cleanup (&zfpm_g->snapshot.iter);
+	      zfpm_g->snapshot.state = ZFPM_SNAPSHOT_END;
+	      break;
+	    }
+
+	  dest = rib_dest_from_rnode (rnode);
+	  rib = zfpm_route_for_update (dest);
+	  if (!rib)
+	    continue;
+
+	  if (!zfpm_write_route (s, dest, rib))
+	    continue;
+
+	  SET_FLAG (dest->flags, RIB_DEST_SENT_TO_FPM);
+	  zfpm_g->snapshot.routes++;
+	  zfpm_g->stats.snapshot_routes++;
+
+	  /*
+	   * The FPM now has the current state of this dest, no need to
+	   * send it again from the queue.
+	   */
+	  if (CHECK_FLAG (dest->flags, RIB_DEST_UPDATE_FPM))
+	    {
+	      UNSET_FLAG (dest->flags, RIB_DEST_UPDATE_FPM);
+	      TAILQ_REMOVE (&zfpm_g->dest_q, dest, fpm_q_entries);
+	      zfpm_g->dest_q_len--;
+	      zfpm_g->stats.snapshot_dequeues++;
+	    }
+	}
+
+      if (zfpm_g->snapshot.state == ZFPM_SNAPSHOT_WALK)
+	{
+	  zfpm_rnodes_iter_pause (&zfpm_g->snapshot.iter);
+	  return;
+	}
+    }
+
+  if (zfpm_g->snapshot.state == ZFPM_SNAPSHOT_END
+      && STREAM_WRITEABLE (s) >= FPM_MAX_MSG_LEN)
+    {
+      zfpm_write_marker (s, FPM_MSG_TYPE_SNAPSHOT_END);
+      zfpm_debug ("Sent table snapshot of %u routes",
+		  zfpm_g->snapshot.routes);
+      zfpm_g->snapshot.state = ZFPM_SNAPSHOT_NONE;
+      zfpm_g->stats.snapshot_finishes++;
+    }
+}
+
+/*
+ * zfpm_q_age_bucket
+ *
+ * Returns the queue age histogram bucket for the given wait time.
+ */
+static inline int
+zfpm_q_age_bucket (u_int32_t msecs)
+{
+  int i;
+
+  for (i = 0; i < ZFPM_Q_AGE_BUCKETS - 1; i++)
+    if (msecs < (1U << i))
+      break;
+
+  return i;
+}
+
 /*
  * zfpm_build_updates
  *
  * Process the outgoing queue and write messages to the outbound
- * buffer.
+ * buffer, until it holds about flush_size bytes.
  */
 static void
 zfpm_build_updates (void)
 {
   struct stream *s;
   rib_dest_t *dest;
-  unsigned char *buf, *data, *buf_end;
-  size_t msg_len;
-  size_t data_len;
-  fpm_msg_hdr_t *hdr;
   struct rib *rib;
   int is_add, write_msg;
+  u_int32_t now;
 
   s = zfpm_g->obuf;
 
   assert (stream_empty (s));
 
+  /*
+   * Pick up a change in the configured flush size.
+   */
+  if (STREAM_SIZE (s) != zfpm_g->flush_size)
+    {
+      stream_free (s);
+      s = zfpm_g->obuf = stream_new (zfpm_g->flush_size);
+    }
+
+  if (zfpm_g->snapshot.state != ZFPM_SNAPSHOT_NONE)
+    zfpm_build_snapshot (s);
+
+  now = zfpm_get_msecs ();
+
   do {
 
     /*
@@ -931,20 +1288,13 @@ zfpm_build_updates (void)
     if (STREAM_WRITEABLE (s) < FPM_MAX_MSG_LEN)
       break;
 
-    buf = STREAM_DATA (s) + stream_get_endp (s);
-    buf_end = buf + STREAM_WRITEABLE (s);
-
     dest = TAILQ_FIRST (&zfpm_g->dest_q);
     if (!dest)
       break;
 
     assert (CHECK_FLAG (dest->flags, RIB_DEST_UPDATE_FPM));
 
-    hdr = (fpm_msg_hdr_t *) buf;
-    hdr->version = FPM_PROTO_VERSION;
-    hdr->msg_type = FPM_MSG_TYPE_NETLINK;
-
-    data = fpm_msg_data (hdr);
+    zfpm_g->stats.q_age_hist[zfpm_q_age_bucket (now - dest->fpm_q_time)]++;
 
     rib = zfpm_route_for_update (dest);
     is_add = rib ? 1 : 0;
@@ -961,28 +1311,20 @@ zfpm_build_updates (void)
 	zfpm_g->stats.nop_deletes_skipped++;
       }
 
-    if (write_msg) {
-      data_len = zfpm_encode_route (dest, rib, (char *) data, buf_end - data);
-
-      assert (data_len);
-      if (data_len)
-	{
-	  msg_len = fpm_data_len_to_msg_len (data_len);
-	  hdr->msg_len = htons (msg_len);
-	  stream_forward_endp (s, msg_len);
-
-	  if (is_add)
-	    zfpm_g->stats.route_adds++;
-	  else
-	    zfpm_g->stats.route_dels++;
-	}
-    }
+    if (write_msg && zfpm_write_route (s, dest, rib))
+      {
+	if (is_add)
+	  zfpm_g->stats.route_adds++;
+	else
+	  zfpm_g->stats.route_dels++;
+      }
 
     /*
      * Remove the dest from the queue, and reset the flag.
      */
     UNSET_FLAG (dest->flags, RIB_DEST_UPDATE_FPM);
     TAILQ_REMOVE (&zfpm_g->dest_q, dest, fpm_q_entries);
+    zfpm_g->dest_q_len--;
 
     if (is_add)
       {
@@ -1061,6 +1403,9 @@ zfpm_write_cb (struct thread *thread)
 	  return 0;
 	}
 
+      zfpm_g->stats.bytes_written += bytes_written;
+      zfpm_rate_get ()->bytes += bytes_written;
+
       if (bytes_written != bytes_to_write)
 	{
 
@@ -1291,6 +1636,24 @@ zfpm_conn_is_up (void)
   return 1;
 }
 
+/*
+ * zfpm_flush_timer_cb
+ *
+ * Send the updates that were held back for coalescing.
+ */
+static int
+zfpm_flush_timer_cb (struct thread *t)
+{
+  assert (zfpm_g->t_flush);
+  zfpm_g->t_flush = NULL;
+
+  if (!zfpm_conn_is_up () || zfpm_g->t_write)
+    return 0;
+
+  zfpm_write_on ();
+  return 0;
+}
+
 /*
  * zfpm_trigger_update
  *
@@ -1335,7 +1698,9 @@ zfpm_trigger_update (struct route_node *rn, const char *reason)
     }
 
   SET_FLAG (dest->flags, RIB_DEST_UPDATE_FPM);
+  dest->fpm_q_time = zfpm_get_msecs ();
   TAILQ_INSERT_TAIL (&zfpm_g->dest_q, dest, fpm_q_entries);
+  zfpm_g->dest_q_len++;
   zfpm_g->stats.updates_triggered++;
 
   /*
@@ -1344,6 +1709,23 @@ zfpm_trigger_update (struct route_node *rn, const char *reason)
   if (zfpm_g->t_write)
     return;
 
+  /*
+   * Hold the update back for a while if a flush delay is configured,
+   * unless enough updates are queued to fill a flush already.
+   */
+  if (zfpm_g->flush_delay
+      && zfpm_g->dest_q_len * ZFPM_ROUTE_MSG_SIZE_EST < zfpm_g->flush_size)
+    {
+      if (!zfpm_g->t_flush)
+	{
+	  zfpm_g->stats.flush_delays++;
+	  THREAD_TIMER_MSEC_ON (zfpm_g->master, zfpm_g->t_flush,
+				zfpm_flush_timer_cb, 0, zfpm_g->flush_delay);
+	}
+      return;
+    }
+
+  THREAD_TIMER_OFF (zfpm_g->t_flush);
   zfpm_write_on ();
 }
 
@@ -1419,7 +1801,8 @@ static void
 zfpm_show_stats (struct vty *vty)
 {
   zfpm_stats_t total_stats;
-  time_t elapsed;
+  time_t elapsed, now;
+  int i;
 
   vty_out (vty, "%s%-40s %10s     Last %2d secs%s%s", VTY_NEWLINE, "Counter",
 	   "Total", ZFPM_STATS_IVL_SECS, VTY_NEWLINE, VTY_NEWLINE);
@@ -1454,6 +1837,51 @@ zfpm_show_stats (struct vty *vty)
   ZFPM_SHOW_STAT (t_conn_up_yields);
   ZFPM_SHOW_STAT (t_conn_up_aborts);
   ZFPM_SHOW_STAT (t_conn_up_finishes);
+  ZFPM_SHOW_STAT (bytes_written);
+  ZFPM_SHOW_STAT (flush_delays);
+  ZFPM_SHOW_STAT (snapshot_starts);
+  ZFPM_SHOW_STAT (snapshot_routes);
+  ZFPM_SHOW_STAT (snapshot_dequeues);
+  ZFPM_SHOW_STAT (snapshot_aborts);
+  ZFPM_SHOW_STAT (snapshot_finishes);
+
+  vty_out (vty, "%s%-40s %10lu%s", VTY_NEWLINE, "Queued updates",
+	   zfpm_g->dest_q_len, VTY_NEWLINE);
+
+  vty_out (vty, "%s%-40s %10s     Last %2d secs%s%s", VTY_NEWLINE,
+	   "Time on queue", "Total", ZFPM_STATS_IVL_SECS, VTY_NEWLINE,
+	   VTY_NEWLINE);
+
+  for (i = 0; i < ZFPM_Q_AGE_BUCKETS; i++)
+    {
+      char label[32];
+
+      if (i < ZFPM_Q_AGE_BUCKETS - 1)
+	snprintf (label, sizeof (label), "< %u msecs", 1U << i);
+      else
+	snprintf (label, sizeof (label), ">= %u msecs", 1U << (i - 1));
+
+      vty_out (vty, "%-40s %10lu %16lu%s", label, total_stats.q_age_hist[i],
+	       zfpm_g->last_ivl_stats.q_age_hist[i], VTY_NEWLINE);
+    }
+
+  vty_out (vty, "%s%-40s %10s %16s%s%s", VTY_NEWLINE, "Throughput",
+	   "Routes", "Bytes", VTY_NEWLINE, VTY_NEWLINE);
+
+  now = recent_relative_time ().tv_sec;
+  for (i = 1; i <= ZFPM_RATE_SECS && i <= now; i++)
+    {
+      zfpm_rate_t *rate;
+      char label[32];
+
+      rate = &zfpm_g->rate[(now - i) % ZFPM_RATE_SECS];
+      snprintf (label, sizeof (label), "%d secs ago", i);
+      if (rate->sec != now - i)
+	vty_out (vty, "%-40s %10d %16d%s", label, 0, 0, VTY_NEWLINE);
+      else
+	vty_out (vty, "%-40s %10lu %16lu%s", label, rate->routes, rate->bytes,
+		 VTY_NEWLINE);
+    }
 
   if (!zfpm_g->last_stats_clear_time)
     return;
@@ -1518,6 +1946,131 @@ DEFUN (clear_zebra_fpm_stats,
   return CMD_SUCCESS;
 }
 
+DEFUN (fpm_flush_size,
+       fpm_flush_size_cmd,
+       "fpm flush-size <8192-1048576>",
+       "Forwarding Path Manager configuration\n"
+       "Number of bytes of updates to coalesce into one write\n"
+       "Bytes\n")
+{
+  u_int32_t size;
+
+  VTY_GET_INTEGER_RANGE ("flush size", size, argv[0], ZFPM_FLUSH_SIZE_MIN,
+			 ZFPM_FLUSH_SIZE_MAX);
+  zfpm_g->flush_size = size;
+  return CMD_SUCCESS;
+}
+
+DEFUN (no_fpm_flush_size,
+       no_fpm_flush_size_cmd,
+       "no fpm flush-size",
+       NO_STR
+       "Forwarding Path Manager configuration\n"
+       "Number of bytes of updates to coalesce into one write\n")
+{
+  zfpm_g->flush_size = ZFPM_FLUSH_SIZE_DEFAULT;
+  return CMD_SUCCESS;
+}
+
+ALIAS (no_fpm_flush_size,
+       no_fpm_flush_size_val_cmd,
+       "no fpm flush-size <8192-1048576>",
+       NO_STR
+       "Forwarding Path Manager configuration\n"
+       "Number of bytes of updates to coalesce into one write\n"
+       "Bytes\n")
+
+DEFUN (fpm_flush_delay,
+       fpm_flush_delay_cmd,
+       "fpm flush-delay <0-1000>",
+       "Forwarding Path Manager configuration\n"
+       "Time for which updates may be held back to coalesce them\n"
+       "Milliseconds\n")
+{
+  u_int32_t delay;
+
+  VTY_GET_INTEGER_RANGE ("flush delay", delay, argv[0], 0,
+			 ZFPM_FLUSH_DELAY_MAX);
+  zfpm_g->flush_delay = delay;
+  return CMD_SUCCESS;
+}
+
+DEFUN (no_fpm_flush_delay,
+       no_fpm_flush_delay_cmd,
+       "no fpm flush-delay",
+       NO_STR
+       "Forwarding Path Manager configuration\n"
+       "Time for which updates may be held back to coalesce them\n")
+{
+  zfpm_g->flush_delay = ZFPM_FLUSH_DELAY_DEFAULT;
+  return CMD_SUCCESS;
+}
+
+ALIAS (no_fpm_flush_delay,
+       no_fpm_flush_delay_val_cmd,
+       "no fpm flush-delay <0-1000>",
+       NO_STR
+       "Forwarding Path Manager configuration\n"
+       "Time for which updates may be held back to coalesce them\n"
+       "Milliseconds\n")
+
+DEFUN (fpm_snapshot_resync,
+       fpm_snapshot_resync_cmd,
+       "fpm snapshot-resync",
+       "Forwarding Path Manager configuration\n"
+       "Send the tables between snapshot markers when the connection comes up\n")
+{
+  zfpm_g->snapshot_resync = 1;
+  return CMD_SUCCESS;
+}
+
+DEFUN (no_fpm_snapshot_resync,
+       no_fpm_snapshot_resync_cmd,
+       "no fpm snapshot-resync",
+       NO_STR
+       "Forwarding Path Manager configuration\n"
+       "Send the tables between snapshot markers when the connection comes up\n")
+{
+  zfpm_g->snapshot_resync = 0;
+  return CMD_SUCCESS;
+}
+
+/*
+ * zfpm_config_write
+ */
+static int
+zfpm_config_write (struct vty *vty)
+{
+  int write = 0;
+
+  if (zfpm_g->flush_size != ZFPM_FLUSH_SIZE_DEFAULT)
+    {
+      vty_out (vty, "fpm flush-size %u%s", zfpm_g->flush_size, VTY_NEWLINE);
+      write++;
+    }
+
+  if (zfpm_g->flush_delay != ZFPM_FLUSH_DELAY_DEFAULT)
+    {
+      vty_out (vty, "fpm flush-delay %u%s", zfpm_g->flush_delay, VTY_NEWLINE);
+      write++;
+    }
+
+  if (zfpm_g->snapshot_resync)
+    {
+      vty_out (vty, "fpm snapshot-resync%s", VTY_NEWLINE);
+      write++;
+    }
+
+  return write;
+}
+
+static struct cmd_node zfpm_node =
+{
+  FPM_NODE,
+  "",				/* This node has no interface. */
+  1
+};
+
 /**
  * zfpm_init
  *
@@ -1544,6 +2097,8 @@ zfpm_init (struct thread_master *master, int enable, uint16_t port)
   TAILQ_INIT(&zfpm_g->dest_q);
   zfpm_g->sock = -1;
   zfpm_g->state = ZFPM_STATE_IDLE;
+  zfpm_g->flush_size = ZFPM_FLUSH_SIZE_DEFAULT;
+  zfpm_g->flush_delay = ZFPM_FLUSH_DELAY_DEFAULT;
 
   /*
    * Netlink must currently be available for the Zebra-FPM interface
@@ -1562,6 +2117,16 @@ zfpm_init (struct thread_master *master, int enable, uint16_t port)
   install_element (ENABLE_NODE, &show_zebra_fpm_stats_cmd);
   install_element (ENABLE_NODE, &clear_zebra_fpm_stats_cmd);
 
+  install_node (&zfpm_node, zfpm_config_write);
+  install_element (CONFIG_NODE, &fpm_flush_size_cmd);
+  install_element (CONFIG_NODE, &no_fpm_flush_size_cmd);
+  install_element (CONFIG_NODE, &no_fpm_flush_size_val_cmd);
+  install_element (CONFIG_NODE, &fpm_flush_delay_cmd);
+  install_element (CONFIG_NODE, &no_fpm_flush_delay_cmd);
+  install_element (CONFIG_NODE, &no_fpm_flush_delay_val_cmd);
+  install_element (CONFIG_NODE, &fpm_snapshot_resync_cmd);
+  install_element (CONFIG_NODE, &no_fpm_snapshot_resync_cmd);
+
   if (!enable) {
     return 1;
   }
@@ -1571,7 +2136,7 @@ zfpm_init (struct thread_master *master, int enable, uint16_t port)
 
   zfpm_g->fpm_port = port;
 
-  zfpm_g->obuf = stream_new (ZFPM_OBUF_SIZE);
+  zfpm_g->obuf = stream_new (zfpm_g->flush_size);
   zfpm_g->ibuf = stream_new (ZFPM_IBUF_SIZE);
 
   zfpm_start_stats_timer ();
@@ -0,0 +1,1043 @@
+/* Nexthop lookup service on FIB snapshots.
+ *
+ * This file is part of Quagga.
+ *
+ * Quagga is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2, or (at your option) any
+ * later version.
+ *
+ * Quagga is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Quagga; see the file COPYING.  If not, write to the Free
+ * Software Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
+ * 02111-1307, USA.
+ */
+
+/* The IPv4 nexthop lookups of zserv - ZEBRA_IPV4_NEXTHOP_LOOKUP,
+ * ZEBRA_IPV4_NEXTHOP_LOOKUP_MRIB and ZEBRA_IPV4_IMPORT_LOOKUP - are also
+ * answered on a socket of their own, next to the zserv socket, by a
+ * thread of their own.  The thread never touches the RIB.  It answers
+ * from a snapshot of the selected IPv4 routes of the default VRF, which
+ * the main thread builds again when routes have changed, at most once
+ * per interval, and publishes by swapping a pointer.  The thread holds
+ * on to the snapshot it is using through a hazard pointer, so the main
+ * thread only frees a snapshot once it has been replaced and the
+ * thread is not using it.  Allocation, freeing and logging all stay on
+ * the main thread.
+ */
+
+#include <zebra.h>
+
+#include "prefix.h"
+#include "table.h"
+#include "memory.h"
+#include "stream.h"
+#include "thread.h"
+#include "command.h"
+#include "log.h"
+#include "zclient.h"
+#include "network.h"
+#include "sigevent.h"
+
+#include "zebra/rib.h"
+#include "zebra/zserv.h"
+#include "zebra/zebra_lookup.h"
+
+#ifdef HAVE_ZEBRA_LOOKUP
+
+#include <pthread.h>
+#include <poll.h>
+#include <sys/un.h>
+
+/* A nexthop of a route in a snapshot. */
+struct zlookup_nexthop
+{
+  struct in_addr gate;
+  unsigned int ifindex;
+  u_char type;
+  u_char flags;
+#define ZLOOKUP_NH_FIB        (1 << 0)  /* in the FIB */
+#define ZLOOKUP_NH_FIB_CHILD  (1 << 1)  /* resolved through the FIB */
+};
+
+/* The selected route of a prefix in a snapshot. */
+struct zlookup_route
+{
+  u_int32_t prefix;             /* host byte order */
+  u_int32_t metric;
+  u_int32_t nexthop;            /* first in zlookup_table.nexthop */
+  u_char nexthop_num;
+  u_char prefixlen;
+  u_char type;
+  u_char distance;
+  u_char usable;                /* connected, or a nexthop in the FIB */
+};
+
+/* The routes of a table, by prefix length and, for each length, by
+   prefix, with those of length l from start[l] to start[l + 1]. */
+struct zlookup_table
+{
+  struct zlookup_route *route;
+  struct zlookup_nexthop *nexthop;
+  u_int32_t start[IPV4_MAX_BITLEN + 2];
+  u_int32_t nexthop_num;
+};
+
+struct zlookup_snap
+{
+  struct zlookup_table unicast;
+  struct zlookup_table multicast;
+  enum multicast_mode mcast_mode;
+
+  /* rib_generation it was built at, and when. */
+  u_int32_t generation;
+  struct timeval built;
+
+  /* On the list of replaced snapshots. */
+  struct zlookup_snap *next;
+};
+
+/* Most clients a thread serves at once. */
+#define ZLOOKUP_CONN_MAX      32
+
+/* Room to keep in a client's output buffer for an answer. */
+#define ZLOOKUP_ANSWER_MAX    (ZEBRA_HEADER_SIZE + 10 + 255 * 9)
+
+struct zlookup_conn
+{
+  int fd;
+
+  /* Partial message read, and answers not yet written. */
+  u_char ibuf[ZEBRA_MAX_PACKET_SIZ];
+  size_t ilen;
+  struct stream *obuf;
+};
+
+static struct zlookup
+{
+  struct thread_master *master;
+  char path[sizeof (((struct sockaddr_un *) 0)->sun_path)];
+
+  /* Configuration: whether the service runs, and the least time in
+     milliseconds between snapshots. */
+  int enabled;
+  u_int32_t interval;
+#define ZLOOKUP_INTERVAL_DEFAULT      500
+
+  /* Snapshot published to the thread, the one it is using, and those
+     replaced but not yet freed. */
+  struct zlookup_snap *current;
+  struct zlookup_snap *hazard;
+  struct zlookup_snap *retired;
+
+  struct thread *t_build;
+
+  /* The thread, its listening socket, the pipe that stops it, and its
+     clients. */
+  pthread_t thread;
+  int running;
+  int sock;
+  int stop[2];
+  struct zlookup_conn conn[ZLOOKUP_CONN_MAX];
+
+  /* Statistics kept by the main thread. */
+  unsigned long builds;
+  unsigned long build_usec;
+  unsigned long build_usec_max;
+
+  /* Statistics kept by the thread. */
+  unsigned long accepted;
+  unsigned long lookups;
+  unsigned long mrib_lookups;
+  unsigned long import_lookups;
+  unsigned long errors;
+} zlookup =
+{
+  .interval = ZLOOKUP_INTERVAL_DEFAULT,
+  .sock = -1,
+  .stop = { -1, -1 },
+};
+
+#define ZLOOKUP_STAT_INC(field) \
+  __atomic_fetch_add (&zlookup.field, 1, __ATOMIC_RELAXED)
+#define ZLOOKUP_STAT_GET(field) \
+  __atomic_load_n (&zlookup.field, __ATOMIC_RELAXED)
+
+/* Selected route of rn, if any. */
+static struct rib *
+zlookup_selected (struct route_node *rn)
+{
+  struct rib *rib;
+
+  RNODE_FOREACH_RIB (rn, rib)
+    {
+      if (CHECK_FLAG (rib->status, RIB_ENTRY_REMOVED))
+        continue;
+      if (CHECK_FLAG (rib->flags, ZEBRA_FLAG_SELECTED))
+        return rib;
+    }
+  return NULL;
+}
+
+/* The nexthops the lookups answer with are those at the top of the
+   chain in, or resolved through, the FIB. */
+static u_char
+zlookup_nexthop_flags (struct nexthop *nexthop)
+{
+  u_char flags = 0;
+
+  if (CHECK_FLAG (nexthop->flags, NEXTHOP_FLAG_FIB))
+    flags |= ZLOOKUP_NH_FIB;
+  if (nexthop_has_fib_child (nexthop))
+    flags |= ZLOOKUP_NH_FIB_CHILD;
+  return flags;
+}
+
+static void
+zlookup_table_build (struct zlookup_table *t, safi_t safi)
+{
+  struct route_table *table;
+  struct route_node *rn;
+  struct rib *rib;
+  struct nexthop *nexthop, *tnexthop;
+  struct zlookup_route *route;
+  struct zlookup_nexthop *nh;
+  u_int32_t cursor[IPV4_MAX_BITLEN + 1];
+  u_int32_t route_num = 0;
+  int recursing, i;
+
+  memset (t, 0, sizeof (*t));
+  if ((table = vrf_table (AFI_IP, safi, 0)) == NULL)
+    return;
+
+  /* Count the routes of each length, and their nexthops. */
+  memset (cursor, 0, sizeof (cursor));
+  for (rn = route_top (table); rn; rn = route_next (rn))
+    if ((rib = zlookup_selected (rn)) != NULL)
+      {
+        cursor[rn->p.prefixlen]++;
+        route_num++;
+        for (nexthop = rib->nexthop; nexthop; nexthop = nexthop->next)
+          if (zlookup_nexthop_flags (nexthop))
+            t->nexthop_num++;
+      }
+  for (i = 0; i <= IPV4_MAX_BITLEN; i++)
+    {
+      t->start[i + 1] = t->start[i] + cursor[i];
+      cursor[i] = t->start[i];
+    }
+  if (! route_num)
+    return;
+
+  t->route = XCALLOC (MTYPE_ZLOOKUP_SNAP,
+                      route_num * sizeof (struct zlookup_route));
+  if (t->nexthop_num)
+    t->nexthop = XCALLOC (MTYPE_ZLOOKUP_SNAP,
+                          t->nexthop_num * sizeof (struct zlookup_nexthop));
+
+  /* The table is walked in prefix order, so the routes of each length
+     come out sorted. */
+  nh = t->nexthop;
+  for (rn = route_top (table); rn; rn = route_next (rn))
+    {
+      if ((rib = zlookup_selected (rn)) == NULL)
+        continue;
+
+      route = &t->route[cursor[rn->p.prefixlen]++];
+      route->prefix = ntohl (rn->p.u.prefix4.s_addr);
+      route->prefixlen = rn->p.prefixlen;
+      route->type = rib->type;
+      route->distance = rib->distance;
+      route->metric = rib->metric;
+      route->nexthop = nh - t->nexthop;
+
+      route->usable = (rib->type == ZEBRA_ROUTE_CONNECT);
+      for (ALL_NEXTHOPS_RO(rib->nexthop, nexthop, tnexthop, recursing))
+        if (CHECK_FLAG (nexthop->flags, NEXTHOP_FLAG_FIB))
+          route->usable = 1;
+
+      for (nexthop = rib->nexthop; nexthop; nexthop = nexthop->next)
+        if ((nh->flags = zlookup_nexthop_flags (nexthop)) != 0)
+          {
+            nh->type = nexthop->type;
+            nh->gate = nexthop->gate.ipv4;
+            nh->ifindex = nexthop->ifindex;
+            nh++;
+            route->nexthop_num++;
+          }
+    }
+}
+
+static void
+zlookup_table_free (struct zlookup_table *t)
+{
+  if (t->route)
+    XFREE (MTYPE_ZLOOKUP_SNAP, t->route);
+  if (t->nexthop)
+    XFREE (MTYPE_ZLOOKUP_SNAP, t->nexthop);
+}
+
+static void
+zlookup_snap_free (struct zlookup_snap *snap)
+{
+  zlookup_table_free (&snap->unicast);
+  zlookup_table_free (&snap->multicast);
+  XFREE (MTYPE_ZLOOKUP_SNAP, snap);
+}
+
+/* Free the replaced snapshots the thread no longer uses. */
+static void
+zlookup_reclaim (void)
+{
+  struct zlookup_snap *snap, **prev, *hazard;
+
+  hazard = __atomic_load_n (&zlookup.hazard, __ATOMIC_SEQ_CST);
+  for (prev = &zlookup.retired; (snap = *prev) != NULL; )
+    if (snap == hazard)
+      prev = &snap->next;
+    else
+      {
+        *prev = snap->next;
+        zlookup_snap_free (snap);
+      }
+}
+
+/* Build a snapshot of the RIB as it is and hand it to the thread. */
+static void
+zlookup_publish (void)
+{
+  struct zlookup_snap *snap, *old;
+  struct timeval start;
+  unsigned long usec;
+
+  quagga_gettime (QUAGGA_CLK_MONOTONIC, &start);
+
+  snap = XCALLOC (MTYPE_ZLOOKUP_SNAP, sizeof (struct zlookup_snap));
+  zlookup_table_build (&snap->unicast, SAFI_UNICAST);
+  zlookup_table_build (&snap->multicast, SAFI_MULTICAST);
+  snap->mcast_mode = multicast_mode_ipv4_get ();
+  snap->generation = rib_generation;
+
+  quagga_gettime (QUAGGA_CLK_MONOTONIC, &snap->built);
+  usec = (snap->built.tv_sec - start.tv_sec) * 1000000
+         + snap->built.tv_usec - start.tv_usec;
+  zlookup.builds++;
+  zlookup.build_usec += usec;
+  if (usec > zlookup.build_usec_max)
+    zlookup.build_usec_max = usec;
+
+  old = zlookup.current;
+  __atomic_store_n (&zlookup.current, snap, __ATOMIC_SEQ_CST);
+  if (old)
+    {
+      old->next = zlookup.retired;
+      zlookup.retired = old;
+    }
+  zlookup_reclaim ();
+}
+
+static int
+zlookup_timer (struct thread *t)
+{
+  zlookup.t_build = NULL;
+
+  if (zlookup.current->generation != rib_generation
+      || zlookup.current->mcast_mode != multicast_mode_ipv4_get ())
+    zlookup_publish ();
+  else if (zlookup.retired)
+    zlookup_reclaim ();
+
+  zlookup.t_build = thread_add_timer_msec (zlookup.master, zlookup_timer,
+                                           NULL, zlookup.interval);
+  return 0;
+}
+
+/* The snapshot to answer from, marked as in use. */
+static struct zlookup_snap *
+zlookup_snap_acquire (void)
+{
+  struct zlookup_snap *snap;
+
+  do
+    {
+      snap = __atomic_load_n (&zlookup.current, __ATOMIC_SEQ_CST);
+      __atomic_store_n (&zlookup.hazard, snap, __ATOMIC_SEQ_CST);
+    }
+  while (snap != __atomic_load_n (&zlookup.current, __ATOMIC_SEQ_CST));
+  return snap;
+}
+
+static void
+zlookup_snap_release (void)
+{
+  __atomic_store_n (&zlookup.hazard, NULL, __ATOMIC_RELEASE);
+}
+
+static const struct zlookup_route *
+zlookup_route_find (const struct zlookup_table *t, u_int32_t prefix,
+                    int prefixlen)
+{
+  u_int32_t lo = t->start[prefixlen];
+  u_int32_t hi = t->start[prefixlen + 1];
+  u_int32_t mid;
+
+  while (lo < hi)
+    {
+      mid = lo + (hi - lo) / 2;
+      if (t->route[mid].prefix == prefix)
+        return &t->route[mid];
+      if (t->route[mid].prefix < prefix)
+        lo = mid + 1;
+      else
+        hi = mid;
+    }
+  return NULL;
+}
+
+/* Longest match of addr, as rib_match_ipv4_safi() finds it. */
+static const struct zlookup_route *
+zlookup_match (const struct zlookup_table *t, struct in_addr addr,
+               int skip_bgp)
+{
+  const struct zlookup_route *route;
+  u_int32_t a = ntohl (addr.s_addr);
+  int len;
+
+  if (! t->route)
+    return NULL;
+
+  for (len = IPV4_MAX_BITLEN; len >= 0; len--)
+    {
+      route = zlookup_route_find (t, len ? a & (0xffffffff << (32 - len)) : 0,
+                                  len);
+      if (! route || (skip_bgp && route->type == ZEBRA_ROUTE_BGP))
+        continue;
+      return route->usable ? route : NULL;
+    }
+  return NULL;
+}
+
+/* Match of addr for RPF, as rib_match_ipv4_multicast() finds it, and
+   the table it is from. */
+static const struct zlookup_route *
+zlookup_match_multicast (const struct zlookup_snap *snap, struct in_addr addr,
+                         const struct zlookup_table **table)
+{
+  const struct zlookup_route *mroute = NULL, *uroute = NULL;
+
+  switch (snap->mcast_mode)
+    {
+    case MCAST_MRIB_ONLY:
+      *table = &snap->multicast;
+      return zlookup_match (&snap->multicast, addr, 0);
+    case MCAST_URIB_ONLY:
+      *table = &snap->unicast;
+      return zlookup_match (&snap->unicast, addr, 0);
+    case MCAST_NO_CONFIG:
+    case MCAST_MIX_MRIB_FIRST:
+      if ((mroute = zlookup_match (&snap->multicast, addr, 0)) == NULL)
+        uroute = zlookup_match (&snap->unicast, addr, 0);
+      break;
+    case MCAST_MIX_DISTANCE:
+      mroute = zlookup_match (&snap->multicast, addr, 0);
+      uroute = zlookup_match (&snap->unicast, addr, 0);
+      if (mroute && uroute && ! (uroute->distance < mroute->distance))
+        uroute = NULL;
+      break;
+    case MCAST_MIX_PFXLEN:
+      mroute = zlookup_match (&snap->multicast, addr, 0);
+      uroute = zlookup_match (&snap->unicast, addr, 0);
+      if (mroute && uroute && ! (uroute->prefixlen > mroute->prefixlen))
+        uroute = NULL;
+      break;
+    }
+
+  if (uroute)
+    {
+      *table = &snap->unicast;
+      return uroute;
+    }
+  *table = &snap->multicast;
+  return mroute;
+}
+
+static void
+zlookup_put_nexthops (struct stream *s, const struct zlookup_table *t,
+                      const struct zlookup_route *route, u_char flags)
+{
+  const struct zlookup_nexthop *nh;
+  struct in_addr gate;
+  unsigned long nump;
+  u_char num = 0;
+  int i;
+
+  nump = stream_get_endp (s);
+  stream_putc (s, 0);
+  for (i = 0; i < route->nexthop_num; i++)
+    {
+      nh = &t->nexthop[route->nexthop + i];
+      if (! (nh->flags & flags))
+        continue;
+
+      stream_putc (s, nh->type);
+      gate = nh->gate;
+      switch (nh->type)
+        {
+        case ZEBRA_NEXTHOP_IPV4:
+          stream_put_in_addr (s, &gate);
+          break;
+        case ZEBRA_NEXTHOP_IPV4_IFINDEX:
+          stream_put_in_addr (s, &gate);
+          stream_putl (s, nh->ifindex);
+          break;
+        case ZEBRA_NEXTHOP_IFINDEX:
+        case ZEBRA_NEXTHOP_IFNAME:
+          stream_putl (s, nh->ifindex);
+          break;
+        default:
+          break;
+        }
+      num++;
+    }
+  stream_putc_at (s, nump, num);
+}
+
+/* Answer a lookup into s, as zserv would.  Returns -1 if the message is
+   not a lookup the service answers. */
+static int
+zlookup_answer (struct stream *s, struct zlookup_snap *snap, u_int16_t cmd,
+                const u_char *body, u_int16_t len)
+{
+  const struct zlookup_table *table = &snap->unicast;
+  const struct zlookup_route *route;
+  unsigned long start = stream_get_endp (s);
+  struct in_addr addr;
+  u_char prefixlen;
+
+  switch (cmd)
+    {
+    case ZEBRA_IPV4_NEXTHOP_LOOKUP:
+      if (len < 4)
+        return -1;
+      memcpy (&addr, body, 4);
+      route = zlookup_match (table, addr, 1);
+
+      zclient_create_header (s, cmd);
+      stream_put_in_addr (s, &addr);
+      stream_putl (s, route ? route->metric : 0);
+      if (route)
+        zlookup_put_nexthops (s, table, route, ZLOOKUP_NH_FIB);
+      else
+        stream_putc (s, 0);
+      ZLOOKUP_STAT_INC (lookups);
+      break;
+
+    case ZEBRA_IPV4_NEXTHOP_LOOKUP_MRIB:
+      if (len < 4)
+        return -1;
+      memcpy (&addr, body, 4);
+      route = zlookup_match_multicast (snap, addr, &table);
+
+      zclient_create_header (s, cmd);
+      stream_put_in_addr (s, &addr);
+      stream_putc (s, route ? route->distance : 0);
+      stream_putl (s, route ? route->metric : 0);
+      if (route)
+        zlookup_put_nexthops (s, table, route, ZLOOKUP_NH_FIB);
+      else
+        stream_putc (s, 0);
+      ZLOOKUP_STAT_INC (mrib_lookups);
+      break;
+
+    case ZEBRA_IPV4_IMPORT_LOOKUP:
+      if (len < 5 || (prefixlen = body[0]) > IPV4_MAX_BITLEN)
+        return -1;
+      memcpy (&addr, body + 1, 4);
+      route = table->route
+              ? zlookup_route_find (table, prefixlen
+                                    ? ntohl (addr.s_addr)
+                                      & (0xffffffff << (32 - prefixlen))
+                                    : 0, prefixlen)
+              : NULL;
+      if (route && (route->type == ZEBRA_ROUTE_BGP || ! route->usable))
+        route = NULL;
+
+      zclient_create_header (s, cmd);
+      stream_put_in_addr (s, &addr);
+      stream_putl (s, route ? route->metric : 0);
+      if (route)
+        zlookup_put_nexthops (s, table, route,
+                              ZLOOKUP_NH_FIB | ZLOOKUP_NH_FIB_CHILD);
+      else
+        stream_putc (s, 0);
+      ZLOOKUP_STAT_INC (import_lookups);
+      break;
+
+    default:
+      return -1;
+    }
+
+  stream_putw_at (s, start, stream_get_endp (s) - start);
+  return 0;
+}
+
+static void
+zlookup_conn_close (struct zlookup_conn *conn)
+{
+  close (conn->fd);
+  conn->fd = -1;
+  conn->ilen = 0;
+  stream_reset (conn->obuf);
+}
+
+/* Write out what can be of the answers. */
+static int
+zlookup_conn_flush (struct zlookup_conn *conn)
+{
+  struct stream *s = conn->obuf;
+  ssize_t nbytes;
+
+  while (STREAM_READABLE (s))
+    {
+      nbytes = write (conn->fd, STREAM_PNT (s), STREAM_READABLE (s));
+      if (nbytes < 0)
+        return ERRNO_IO_RETRY (errno) ? 0 : -1;
+      stream_forward_getp (s, nbytes);
+    }
+  stream_reset (s);
+  return 0;
+}
+
+/* Answer the complete messages read from a client, as long as there is
+   room for the answers.  Returns how many bytes were answered. */
+static int
+zlookup_conn_process (struct zlookup_conn *conn)
+{
+  struct zlookup_snap *snap;
+  size_t done = 0;
+  u_int16_t len, cmd;
+  int ret = 0;
+
+  snap = zlookup_snap_acquire ();
+  while (conn->ilen - done >= ZEBRA_HEADER_SIZE
+         && STREAM_WRITEABLE (conn->obuf) >= ZLOOKUP_ANSWER_MAX)
+    {
+      const u_char *msg = conn->ibuf + done;
+
+      len = (msg[0] << 8) | msg[1];
+      cmd = (msg[4] << 8) | msg[5];
+      if (len < ZEBRA_HEADER_SIZE || msg[2] != ZEBRA_HEADER_MARKER
+          || msg[3] != ZSERV_VERSION)
+        {
+          ret = -1;
+          break;
+        }
+      if (conn->ilen - done < len)
+        break;
+
+      if (zlookup_answer (conn->obuf, snap, cmd, msg + ZEBRA_HEADER_SIZE,
+                          len - ZEBRA_HEADER_SIZE) < 0)
+        {
+          ret = -1;
+          break;
+        }
+      done += len;
+    }
+  zlookup_snap_release ();
+
+  if (done)
+    {
+      memmove (conn->ibuf, conn->ibuf + done, conn->ilen - done);
+      conn->ilen -= done;
+    }
+  if (ret < 0)
+    {
+      ZLOOKUP_STAT_INC (errors);
+      return -1;
+    }
+  return done;
+}
+
+/* Answer and write out what can be without blocking. */
+static int
+zlookup_conn_serve (struct zlookup_conn *conn)
+{
+  int ret;
+
+  do
+    if ((ret = zlookup_conn_process (conn)) < 0
+        || zlookup_conn_flush (conn) < 0)
+      return -1;
+  while (ret > 0 && ! STREAM_READABLE (conn->obuf));
+  return 0;
+}
+
+static int
+zlookup_conn_read (struct zlookup_conn *conn)
+{
+  ssize_t nbytes;
+
+  nbytes = read (conn->fd, conn->ibuf + conn->ilen,
+                 sizeof (conn->ibuf) - conn->ilen);
+  if (nbytes == 0)
+    return -1;
+  if (nbytes < 0)
+    return ERRNO_IO_RETRY (errno) ? 0 : -1;
+  conn->ilen += nbytes;
+  return 0;
+}
+
+static void
+zlookup_accept (void)
+{
+  struct zlookup_conn *conn = NULL;
+  int fd, i;
+
+  if ((fd = accept (zlookup.sock, NULL, NULL)) < 0)
+    return;
+
+  for (i = 0; i < ZLOOKUP_CONN_MAX; i++)
+    if (zlookup.conn[i].fd < 0)
+      {
+        conn = &zlookup.conn[i];
+        break;
+      }
+  if (! conn || set_nonblocking (fd) < 0)
+    {
+      close (fd);
+      ZLOOKUP_STAT_INC (errors);
+      return;
+    }
+  conn->fd = fd;
+  ZLOOKUP_STAT_INC (accepted);
+}
+
+/* The lookup thread. */
+static void *
+zlookup_thread (void *arg)
+{
+  struct pollfd pfd[ZLOOKUP_CONN_MAX + 2];
+  struct zlookup_conn *conn[ZLOOKUP_CONN_MAX + 2];
+  int i, n;
+
+  while (1)
+    {
+      n = 0;
+      pfd[n].fd = zlookup.stop[0];
+      pfd[n++].events = POLLIN;
+      pfd[n].fd = zlookup.sock;
+      pfd[n++].events = POLLIN;
+      for (i = 0; i < ZLOOKUP_CONN_MAX; i++)
+        if (zlookup.conn[i].fd >= 0)
+          {
+            conn[n] = &zlookup.conn[i];
+            pfd[n].fd = conn[n]->fd;
+
+            /* A client not reading its answers is not read from. */
+            pfd[n].events = STREAM_READABLE (conn[n]->obuf)
+                            ? POLLOUT : POLLIN;
+            n++;
+          }
+
+      if (poll (pfd, n, -1) < 0)
+        {
+          if (ERRNO_IO_RETRY (errno))
+            continue;
+          break;
+        }
+      if (pfd[0].revents)
+        break;
+      if (pfd[1].revents & POLLIN)
+        zlookup_accept ();
+
+      for (i = 2; i < n; i++)
+        {
+          if (! pfd[i].revents)
+            continue;
+          if (((pfd[i].revents & POLLOUT)
+               ? zlookup_conn_flush (conn[i]) : zlookup_conn_read (conn[i])) < 0
+              || zlookup_conn_serve (conn[i]) < 0)
+            zlookup_conn_close (conn[i]);
+        }
+    }
+  return NULL;
+}
+
+static int
+zlookup_socket (void)
+{
+  struct sockaddr_un addr;
+  mode_t old_mask;
+  int sock, len;
+
+  unlink (zlookup.path);
+  if ((sock = socket (AF_UNIX, SOCK_STREAM, 0)) < 0)
+    {
+      zlog_warn ("Can't create lookup socket: %s", safe_strerror (errno));
+      return -1;
+    }
+
+  memset (&addr, 0, sizeof (addr));
+  addr.sun_family = AF_UNIX;
+  strncpy (addr.sun_path, zlookup.path, sizeof (addr.sun_path) - 1);
+#ifdef HAVE_STRUCT_SOCKADDR_UN_SUN_LEN
+  len = addr.sun_len = SUN_LEN (&addr);
+#else
+  len = sizeof (addr.sun_family) + strlen (addr.sun_path);
+#endif /* HAVE_STRUCT_SOCKADDR_UN_SUN_LEN */
+
+  old_mask = umask (0077);
+  if (bind (sock, (struct sockaddr *) &addr, len) < 0
+      || listen (sock, 5) < 0 || set_nonblocking (sock) < 0)
+    {
+      zlog_warn ("Can't listen to lookup socket %s: %s", zlookup.path,
+                 safe_strerror (errno));
+      umask (old_mask);
+      close (sock);
+      return -1;
+    }
+  umask (old_mask);
+  return sock;
+}
+
+/* The thread is started from the main loop, as threads do not outlive
+   the fork of daemon() and the configuration is read before it. */
+static int
+zlookup_thread_start (struct thread *t)
+{
+  int ret;
+
+  zlookup.t_build = NULL;
+
+  ret = quagga_pthread_create (&zlookup.thread, zlookup_thread, NULL);
+  if (ret)
+    {
+      zlog_warn ("Can't start lookup thread: %s", safe_strerror (ret));
+      return -1;
+    }
+  zlookup.running = 1;
+
+  zlookup.t_build = thread_add_timer_msec (zlookup.master, zlookup_timer,
+                                           NULL, zlookup.interval);
+  return 0;
+}
+
+static int
+zlookup_start (void)
+{
+  int i;
+
+  if ((zlookup.sock = zlookup_socket ()) < 0)
+    return -1;
+  if (pipe (zlookup.stop) < 0)
+    {
+      zlog_warn ("Can't create lookup thread pipe: %s", safe_strerror (errno));
+      close (zlookup.sock);
+      zlookup.sock = -1;
+      return -1;
+    }
+
+  for (i = 0; i < ZLOOKUP_CONN_MAX; i++)
+    {
+      zlookup.conn[i].fd = -1;
+      zlookup.conn[i].obuf = stream_new (2 * ZLOOKUP_ANSWER_MAX);
+    }
+  zlookup_publish ();
+
+  zlookup.t_build = thread_add_event (zlookup.master, zlookup_thread_start,
+                                      NULL, 0);
+  zlog_info ("Lookup service listening on %s", zlookup.path);
+  return 0;
+}
+
+static void
+zlookup_stop (void)
+{
+  int i;
+
+  if (zlookup.running)
+    {
+      if (write (zlookup.stop[1], "", 1) == 1)
+        pthread_join (zlookup.thread, NULL);
+      zlookup.running = 0;
+    }
+  if (zlookup.stop[1] >= 0)
+    {
+      close (zlookup.stop[0]);
+      close (zlookup.stop[1]);
+      zlookup.stop[0] = zlookup.stop[1] = -1;
+    }
+  if (zlookup.sock >= 0)
+    {
+      close (zlookup.sock);
+      unlink (zlookup.path);
+      zlookup.sock = -1;
+    }
+  for (i = 0; i < ZLOOKUP_CONN_MAX; i++)
+    {
+      if (zlookup.conn[i].fd >= 0)
+        close (zlookup.conn[i].fd);
+      zlookup.conn[i].fd = -1;
+      if (zlookup.conn[i].obuf)
+        stream_free (zlookup.conn[i].obuf);
+      zlookup.conn[i].obuf = NULL;
+    }
+
+  THREAD_OFF (zlookup.t_build);
+  zlookup.hazard = NULL;
+  if (zlookup.current)
+    zlookup_snap_free (zlookup.current);
+  zlookup.current = NULL;
+  zlookup_reclaim ();
+}
+
+DEFUN (zebra_lookup_service,
+       zebra_lookup_service_cmd,
+       "zebra lookup-service",
+       "Zebra configuration\n"
+       "Answer nexthop lookups from a thread of their own\n")
+{
+  u_int32_t interval = ZLOOKUP_INTERVAL_DEFAULT;
+
+  if (argc)
+    VTY_GET_INTEGER_RANGE ("interval", interval, argv[0], 10, 60000);
+
+  zlookup.interval = interval;
+  if (zlookup.enabled)
+    return CMD_SUCCESS;
+
+  if (zlookup_start () < 0)
+    {
+      zlookup_stop ();
+      vty_out (vty, "%% Can't start the lookup service%s", VTY_NEWLINE);
+      return CMD_WARNING;
+    }
+  zlookup.enabled = 1;
+  return CMD_SUCCESS;
+}
+
+ALIAS (zebra_lookup_service,
+       zebra_lookup_service_interval_cmd,
+       "zebra lookup-service interval <10-60000>",
+       "Zebra configuration\n"
+       "Answer nexthop lookups from a thread of their own\n"
+       "Least time between snapshots of the routes\n"
+       "Milliseconds\n")
+
+DEFUN (no_zebra_lookup_service,
+       no_zebra_lookup_service_cmd,
+       "no zebra lookup-service",
+       NO_STR
+       "Zebra configuration\n"
+       "Answer nexthop lookups from a thread of their own\n")
+{
+  if (zlookup.enabled)
+    zlookup_stop ();
+  zlookup.enabled = 0;
+  zlookup.interval = ZLOOKUP_INTERVAL_DEFAULT;
+  return CMD_SUCCESS;
+}
+
+ALIAS (no_zebra_lookup_service,
+       no_zebra_lookup_service_interval_cmd,
+       "no zebra lookup-service interval <10-60000>",
+       NO_STR
+       "Zebra configuration\n"
+       "Answer nexthop lookups from a thread of their own\n"
+       "Least time between snapshots of the routes\n"
+       "Milliseconds\n")
+
+DEFUN (show_zebra_lookup_service,
+       show_zebra_lookup_service_cmd,
+       "show zebra lookup-service",
+       SHOW_STR
+       "Zebra information\n"
+       "Nexthop lookup service\n")
+{
+  struct zlookup_snap *snap = zlookup.current;
+  struct timeval now;
+  int i, clients = 0;
+
+  if (! zlookup.enabled)
+    {
+      vty_out (vty, "Lookup service is not running%s", VTY_NEWLINE);
+      return CMD_SUCCESS;
+    }
+
+  for (i = 0; i < ZLOOKUP_CONN_MAX; i++)
+    if (zlookup.conn[i].fd >= 0)
+      clients++;
+  quagga_gettime (QUAGGA_CLK_MONOTONIC, &now);
+
+  vty_out (vty, "Lookup service on %s, snapshots at most every %u ms%s",
+           zlookup.path, zlookup.interval, VTY_NEWLINE);
+  vty_out (vty, "Snapshot of RIB generation %u, %ld ms old: "
+           "%u unicast and %u multicast routes%s",
+           snap->generation,
+           (now.tv_sec - snap->built.tv_sec) * 1000
+           + (now.tv_usec - snap->built.tv_usec) / 1000,
+           snap->unicast.start[IPV4_MAX_BITLEN + 1],
+           snap->multicast.start[IPV4_MAX_BITLEN + 1], VTY_NEWLINE);
+  vty_out (vty, "Snapshots built: %lu, average %lu us, longest %lu us%s",
+           zlookup.builds, zlookup.builds
+           ? zlookup.build_usec / zlookup.builds : 0,
+           zlookup.build_usec_max, VTY_NEWLINE);
+  vty_out (vty, "Clients: %d connected, %lu accepted, %lu errors%s",
+           clients, ZLOOKUP_STAT_GET (accepted), ZLOOKUP_STAT_GET (errors),
+           VTY_NEWLINE);
+  vty_out (vty, "Lookups: %lu nexthop, %lu MRIB nexthop, %lu import%s",
+           ZLOOKUP_STAT_GET (lookups), ZLOOKUP_STAT_GET (mrib_lookups),
+           ZLOOKUP_STAT_GET (import_lookups), VTY_NEWLINE);
+  return CMD_SUCCESS;
+}
+
+static int
+zlookup_config_write (struct vty *vty)
+{
+  if (! zlookup.enabled)
+    return 0;
+
+  if (zlookup.interval != ZLOOKUP_INTERVAL_DEFAULT)
+    vty_out (vty, "zebra lookup-service interval %u%s", zlookup.interval,
+             VTY_NEWLINE);
+  else
+    vty_out (vty, "zebra lookup-service%s", VTY_NEWLINE);
+  return 1;
+}
+
+static struct cmd_node zlookup_node =
+{
+  LOOKUP_NODE,
+  "",
+  1
+};
+
+void
+zlookup_init (struct thread_master *master, const char *serv_path)
+{
+  zlookup.master = master;
+  snprintf (zlookup.path, sizeof (zlookup.path), "%s%s",
+            serv_path ? serv_path : ZEBRA_SERV_PATH, ZEBRA_LOOKUP_SUFFIX);
+
+  install_node (&zlookup_node, zlookup_config_write);
+  install_element (CONFIG_NODE, &zebra_lookup_service_cmd);
+  install_element (CONFIG_NODE, &zebra_lookup_service_interval_cmd);
+  install_element (CONFIG_NODE, &no_zebra_lookup_service_cmd);
+  install_element (CONFIG_NODE, &no_zebra_lookup_service_interval_cmd);
+  install_element (VIEW_NODE, &show_zebra_lookup_service_cmd);
+  install_element (ENABLE_NODE, &show_zebra_lookup_service_cmd);
+}
+
+#else /* HAVE_ZEBRA_LOOKUP */
+
+void
+zlookup_init (struct thread_master *master, const char *serv_path)
+{
+}
+
+#endif /* HAVE_ZEBRA_LOOKUP */
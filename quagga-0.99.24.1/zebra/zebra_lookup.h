@@ -0,0 +1,32 @@
+/* Nexthop lookup service on FIB snapshots.
+ *
+ * This file is part of Quagga.
+ *
+ * Quagga is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2, or (at your option) any
+ * later version.
+ *
+ * Quagga is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Quagga; see the file COPYING.  If not, write to the Free
+ * Software Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
+ * 02111-1307, USA.
+ */
+
+#ifndef _ZEBRA_LOOKUP_H
+#define _ZEBRA_LOOKUP_H
+
+/* The service answers on a UNIX domain socket of its own, from a thread
+   of its own. */
+#if defined(HAVE_PTHREAD) && !defined(HAVE_TCP_ZEBRA)
+#define HAVE_ZEBRA_LOOKUP
+#endif
+
+extern void zlookup_init (struct thread_master *, const char *serv_path);
+
+#endif /* _ZEBRA_LOOKUP_H */
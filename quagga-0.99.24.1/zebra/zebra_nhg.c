@@ -0,0 +1,342 @@
+/* Nexthop groups shared by RIB entries.
+ *
+ * This file is part of Quagga.
+ *
+ * Quagga is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2, or (at your option) any
+ * later version.
+ *
+ * Quagga is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Quagga; see the file COPYING.  If not, write to the Free
+ * Software Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
+ * 02111-1307, USA.
+ */
+
+#include <zebra.h>
+
+#include "prefix.h"
+#include "table.h"
+#include "memory.h"
+#include "hash.h"
+#include "jhash.h"
+#include "if.h"
+#include "vty.h"
+
+#include "zebra/rib.h"
+#include "zebra/rt.h"
+#include "zebra/zebra_nhg.h"
+
+/* All groups, keyed by their nexthops. */
+static struct hash *nhg_hash;
+
+u_int32_t nhg_generation = 1;
+
+/* The ifindex of these nexthops is given with the route; for the
+   others it is found by resolution. */
+static int
+nexthop_ifindex_configured (const struct nexthop *nexthop)
+{
+  switch (nexthop->type)
+    {
+    case NEXTHOP_TYPE_IFINDEX:
+    case NEXTHOP_TYPE_IPV4_IFINDEX:
+    case NEXTHOP_TYPE_IPV6_IFINDEX:
+      return 1;
+    default:
+      return 0;
+    }
+}
+
+static int
+nexthop_same_config (const struct nexthop *a, const struct nexthop *b)
+{
+  if (a->type != b->type
+      || CHECK_FLAG (a->flags, NEXTHOP_FLAG_ONLINK)
+         != CHECK_FLAG (b->flags, NEXTHOP_FLAG_ONLINK)
+      || memcmp (&a->gate, &b->gate, sizeof (a->gate))
+      || memcmp (&a->src, &b->src, sizeof (a->src)))
+    return 0;
+  if (nexthop_ifindex_configured (a) && a->ifindex != b->ifindex)
+    return 0;
+  if (a->ifname || b->ifname)
+    return a->ifname && b->ifname && ! strcmp (a->ifname, b->ifname);
+  return 1;
+}
+
+static unsigned int
+nhg_key_compute (const struct nexthop *head, u_char family, u_char internal)
+{
+  const struct nexthop *nexthop;
+  u_int32_t key = jhash_2words (family, internal, 0);
+
+  for (nexthop = head; nexthop; nexthop = nexthop->next)
+    {
+      key = jhash_2words (nexthop->type, nexthop_ifindex_configured (nexthop)
+                          ? nexthop->ifindex : 0, key);
+      key = jhash (&nexthop->gate, sizeof (nexthop->gate), key);
+      key = jhash (&nexthop->src, sizeof (nexthop->src), key);
+      if (nexthop->ifname)
+        key = jhash_1word (string_hash_make (nexthop->ifname), key);
+    }
+  return key;
+}
+
+static unsigned int
+nhg_hash_key (void *p)
+{
+  return ((struct nexthop_group *) p)->key;
+}
+
+static int
+nhg_same (const struct nexthop *a, const struct nexthop *b)
+{
+  for (; a && b; a = a->next, b = b->next)
+    if (! nexthop_same_config (a, b))
+      return 0;
+  return a == NULL && b == NULL;
+}
+
+static int
+nhg_hash_cmp (const void *p1, const void *p2)
+{
+  const struct nexthop_group *a = p1;
+  const struct nexthop_group *b = p2;
+
+  return a->family == b->family
+         && a->internal == b->internal
+         && a->nexthop_num == b->nexthop_num
+         && nhg_same (a->nexthop, b->nexthop);
+}
+
+/* Copy what identifies the nexthops, leaving them unresolved. */
+static struct nexthop *
+nhg_nexthops_copy (const struct nexthop *head)
+{
+  const struct nexthop *nexthop;
+  struct nexthop *copy, *first = NULL, *last = NULL;
+
+  for (nexthop = head; nexthop; nexthop = nexthop->next)
+    {
+      copy = XCALLOC (MTYPE_NEXTHOP, sizeof (struct nexthop));
+      copy->type = nexthop->type;
+      copy->flags = nexthop->flags & NEXTHOP_FLAG_ONLINK;
+      copy->gate = nexthop->gate;
+      copy->src = nexthop->src;
+      if (nexthop_ifindex_configured (nexthop))
+        copy->ifindex = nexthop->ifindex;
+      if (nexthop->ifname)
+        copy->ifname = XSTRDUP (0, nexthop->ifname);
+
+      copy->prev = last;
+      if (last)
+        last->next = copy;
+      else
+        first = copy;
+      last = copy;
+    }
+  return first;
+}
+
+static void *
+nhg_hash_alloc (void *p)
+{
+  struct nexthop_group *key = p;
+  struct nexthop_group *nhg;
+
+  nhg = XCALLOC (MTYPE_NHG, sizeof (struct nexthop_group));
+  nhg->nexthop = nhg_nexthops_copy (key->nexthop);
+  nhg->nexthop_num = key->nexthop_num;
+  nhg->family = key->family;
+  nhg->internal = key->internal;
+  nhg->key = key->key;
+  return nhg;
+}
+
+/* Whether nhg is the group of rib's nexthops, for a route of family,
+   which may have changed since it was looked up. */
+int
+nhg_match (const struct nexthop_group *nhg, const struct rib *rib,
+           u_char family)
+{
+  return nhg->family == family
+         && nhg->internal == !! CHECK_FLAG (rib->flags, ZEBRA_FLAG_INTERNAL)
+         && nhg->nexthop_num == rib->nexthop_num
+         && nhg_same (nhg->nexthop, rib->nexthop);
+}
+
+/* Group of rib's nexthops, for a route of family, created if need be,
+   with a reference taken for rib.  Routes of either family may have
+   the same nexthops, an interface alone for instance, but not the same
+   kernel object. */
+struct nexthop_group *
+nhg_get (struct rib *rib, u_char family)
+{
+  struct nexthop_group key, *nhg;
+
+  memset (&key, 0, sizeof (key));
+  key.nexthop = rib->nexthop;
+  key.nexthop_num = rib->nexthop_num;
+  key.family = family;
+  key.internal = !! CHECK_FLAG (rib->flags, ZEBRA_FLAG_INTERNAL);
+  key.key = nhg_key_compute (key.nexthop, key.family, key.internal);
+
+  nhg = hash_get (nhg_hash, &key, nhg_hash_alloc);
+  nhg->refcnt++;
+  return nhg;
+}
+
+/* Another reference to nhg, for a route installed with its kernel
+   object, which has to stay as long as the route does. */
+struct nexthop_group *
+nhg_lock (struct nexthop_group *nhg)
+{
+  nhg->refcnt++;
+  return nhg;
+}
+
+void
+nhg_release (struct nexthop_group *nhg)
+{
+  if (--nhg->refcnt)
+    return;
+
+  hash_release (nhg_hash, nhg);
+  if (nhg->kernel_id)
+    kernel_nhg_delete (nhg);
+  nexthops_free (nhg->nexthop);
+  XFREE (MTYPE_NHG, nhg);
+}
+
+/* A route nexthops may resolve through has changed, so every group has
+   to be resolved again. */
+void
+nhg_invalidate (void)
+{
+  if (++nhg_generation == 0)
+    nhg_generation = 1;
+}
+
+struct nhg_iterate_arg
+{
+  void (*func) (struct nexthop_group *, void *);
+  void *arg;
+};
+
+static void
+nhg_iterate_backet (struct hash_backet *backet, void *arg)
+{
+  struct nhg_iterate_arg *iter = arg;
+
+  (*iter->func) (backet->data, iter->arg);
+}
+
+void
+nhg_iterate (void (*func) (struct nexthop_group *, void *), void *arg)
+{
+  struct nhg_iterate_arg iter = { func, arg };
+
+  hash_iterate (nhg_hash, nhg_iterate_backet, &iter);
+}
+
+struct nhg_show_arg
+{
+  struct vty *vty;
+  unsigned long resolve_cnt;
+  unsigned long hit_cnt;
+};
+
+static void
+nhg_show_nexthop (struct vty *vty, const struct nexthop *nexthop,
+                  const char *indent)
+{
+#ifdef HAVE_IPV6
+  char buf[INET6_ADDRSTRLEN];
+#endif /* HAVE_IPV6 */
+
+  vty_out (vty, "%s%c ", indent,
+           CHECK_FLAG (nexthop->flags, NEXTHOP_FLAG_ACTIVE) ? '*' : ' ');
+  switch (nexthop->type)
+    {
+    case NEXTHOP_TYPE_IPV4:
+    case NEXTHOP_TYPE_IPV4_IFINDEX:
+    case NEXTHOP_TYPE_IPV4_IFNAME:
+      vty_out (vty, "via %s", inet_ntoa (nexthop->gate.ipv4));
+      break;
+#ifdef HAVE_IPV6
+    case NEXTHOP_TYPE_IPV6:
+    case NEXTHOP_TYPE_IPV6_IFINDEX:
+    case NEXTHOP_TYPE_IPV6_IFNAME:
+      vty_out (vty, "via %s",
+               inet_ntop (AF_INET6, &nexthop->gate.ipv6, buf, sizeof (buf)));
+      break;
+#endif /* HAVE_IPV6 */
+    case NEXTHOP_TYPE_BLACKHOLE:
+      vty_out (vty, "blackhole");
+      break;
+    default:
+      vty_out (vty, "directly connected");
+      break;
+    }
+  if (nexthop->ifname)
+    vty_out (vty, ", %s", nexthop->ifname);
+  else if (nexthop->ifindex)
+    vty_out (vty, ", %s", ifindex2ifname (nexthop->ifindex));
+  if (CHECK_FLAG (nexthop->flags, NEXTHOP_FLAG_RECURSIVE))
+    vty_out (vty, " (recursive)");
+  vty_out (vty, "%s", VTY_NEWLINE);
+}
+
+static void
+nhg_show_iterator (struct hash_backet *backet, void *arg)
+{
+  struct nhg_show_arg *show = arg;
+  struct vty *vty = show->vty;
+  struct nexthop_group *nhg = backet->data;
+  struct nexthop *nexthop, *resolved;
+
+  vty_out (vty, "Group %08x, %s: %lu references%s, %u/%u active%s, "
+           "resolved %u times, reused %lu times%s",
+           nhg->key, nhg->family == AF_INET ? "IPv4" : "IPv6",
+           nhg->refcnt, nhg->internal ? " (internal)" : "",
+           nhg->active_num, nhg->nexthop_num,
+           NHG_RESOLVED (nhg) ? "" : " (stale)",
+           nhg->resolve_cnt, nhg->hit_cnt, VTY_NEWLINE);
+  if (nhg->kernel_id)
+    vty_out (vty, "  Kernel nexthop id %u, %u members%s",
+             nhg->kernel_id, nhg->kernel_num, VTY_NEWLINE);
+  for (nexthop = nhg->nexthop; nexthop; nexthop = nexthop->next)
+    {
+      nhg_show_nexthop (vty, nexthop, "  ");
+      for (resolved = nexthop->resolved; resolved; resolved = resolved->next)
+        nhg_show_nexthop (vty, resolved, "    ");
+    }
+
+  show->resolve_cnt += nhg->resolve_cnt;
+  show->hit_cnt += nhg->hit_cnt;
+}
+
+void
+nhg_show (struct vty *vty)
+{
+  struct nhg_show_arg show;
+
+  memset (&show, 0, sizeof (show));
+  show.vty = vty;
+  hash_iterate (nhg_hash, nhg_show_iterator, &show);
+
+  vty_out (vty, "%lu groups, generation %u, %lu resolutions, "
+           "%lu reused%s", nhg_hash->count, nhg_generation,
+           show.resolve_cnt, show.hit_cnt, VTY_NEWLINE);
+}
+
+void
+nhg_init (void)
+{
+  nhg_hash = hash_create (nhg_hash_key, nhg_hash_cmp);
+}
@@ -0,0 +1,91 @@
+/* Nexthop groups shared by RIB entries.
+ *
+ * This file is part of Quagga.
+ *
+ * Quagga is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2, or (at your option) any
+ * later version.
+ *
+ * Quagga is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Quagga; see the file COPYING.  If not, write to the Free
+ * Software Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
+ * 02111-1307, USA.
+ */
+
+#ifndef _ZEBRA_NHG_H
+#define _ZEBRA_NHG_H
+
+#include "vty.h"
+
+/* The nexthops of a RIB entry, interned so that all entries with the
+   same nexthops share one group.  The group's own copy of the nexthops
+   is resolved once for all of them, and only again once a route that
+   nexthops resolve through has changed. */
+struct nexthop_group
+{
+  /* The nexthops.  Their type, gateway, source, interface name and
+     configured ifindex identify the group and never change; their
+     flags, resolved ifindex and resolved nexthops are the cached
+     resolution. */
+  struct nexthop *nexthop;
+  u_char nexthop_num;
+
+  /* Address family of the routes, which the kernel object is of. */
+  u_char family;
+
+  /* ZEBRA_FLAG_INTERNAL of the entries, which lets nexthops resolve
+     recursively. */
+  u_char internal;
+
+  unsigned int key;
+  unsigned long refcnt;
+
+  /* nhg_generation the resolution is valid for, 0 if none yet. */
+  u_int32_t generation;
+  u_char active_num;
+
+  /* Statistics. */
+  u_int32_t resolve_cnt;
+  unsigned long hit_cnt;
+
+  /* Kernel nexthop object of the group, 0 if there is none, and the
+     objects of its members as last programmed. */
+  u_int32_t kernel_id;
+  u_char kernel_num;
+  struct nhg_kernel_hop *kernel_hop;
+};
+
+/* A member of a kernel nexthop object. */
+struct nhg_kernel_hop
+{
+  u_int32_t id;
+  u_char family;
+  u_char flags;
+#define NHG_KERNEL_GATE       (1 << 0)
+#define NHG_KERNEL_ONLINK     (1 << 1)
+  unsigned int ifindex;
+  union g_addr gate;
+};
+
+/* Bumped whenever nexthops may resolve differently. */
+extern u_int32_t nhg_generation;
+
+#define NHG_RESOLVED(nhg)     ((nhg)->generation == nhg_generation)
+
+extern void nhg_init (void);
+extern struct nexthop_group *nhg_get (struct rib *, u_char);
+extern int nhg_match (const struct nexthop_group *, const struct rib *,
+                      u_char);
+extern struct nexthop_group *nhg_lock (struct nexthop_group *);
+extern void nhg_release (struct nexthop_group *);
+extern void nhg_invalidate (void);
+extern void nhg_iterate (void (*) (struct nexthop_group *, void *), void *);
+extern void nhg_show (struct vty *);
+
+#endif /* _ZEBRA_NHG_H */
@@ -41,6 +41,7 @@
 #include "zebra/redistribute.h"
 #include "zebra/debug.h"
 #include "zebra/zebra_fpm.h"
+#include "zebra/zebra_nhg.h"
 
 /* Default rtm_table for all clients */
 extern struct zebra_t zebrad;
@@ -51,6 +52,15 @@ extern struct zebra_t zebrad;
  */
 int rib_process_hold_time = 10;
 
+/* Called as a route node is queued for processing (queued set) and as
+   it is taken off the queue to be processed.  Private export for use
+   by test code only */
+void (*rib_queue_hook) (struct route_node *, int queued);
+
+/* Bumped whenever a route node has been processed, so that copies of
+   the RIB can tell whether they are out of date. */
+u_int32_t rib_generation;
+
 /* Each route type's string and default distance value. */
 static const struct
 {  
@@ -75,6 +85,8 @@ static const struct
 /* Vector for routing table.  */
 static vector vrf_vector;
 
+static struct meta_queue *meta_queue_new (void);
+
 /* RPF lookup behaviour */
 static enum multicast_mode ipv4_multicast_mode = MCAST_NO_CONFIG;
 
@@ -155,6 +167,7 @@ vrf_alloc (const char *name)
   vrf->stable[AFI_IP][SAFI_MULTICAST] = route_table_init ();
   vrf->stable[AFI_IP6][SAFI_MULTICAST] = route_table_init ();
 
+  vrf->mq = meta_queue_new ();
 
   return vrf;
 }
@@ -166,6 +179,36 @@ vrf_lookup (u_int32_t id)
   return vector_lookup (vrf_vector, id);
 }
 
+/* Lookup VRF, creating it if it does not exist yet.  VRFs other than
+   the default one come into being with the first route a client adds
+   to them. */
+struct vrf *
+vrf_get (u_int32_t id)
+{
+  struct vrf *vrf;
+  char name[16];
+
+  if ((vrf = vrf_lookup (id)) != NULL)
+    return vrf;
+
+  if (id > VRF_ID_MAX || VRF_ID_RESERVED (id)
+      || id == (u_int32_t) zebrad.rtm_table_default)
+    {
+      zlog_warn ("%s: VRF %u would use a reserved kernel table",
+                 __func__, id);
+      return NULL;
+    }
+
+  snprintf (name, sizeof (name), "VRF %u", id);
+  vrf = vrf_alloc (name);
+  vrf->id = id;
+  vector_set_index (vrf_vector, id, vrf);
+
+  if (IS_ZEBRA_DEBUG_RIB)
+    zlog_debug ("%s: created VRF %u", __func__, id);
+  return vrf;
+}
+
 /* Initialize VRF.  */
 static void
 vrf_init (void)
@@ -275,8 +318,6 @@ nexthop_delete (struct rib *rib, struct nexthop *nexthop)
   rib->nexthop_num--;
 }
 
-static void nexthops_free(struct nexthop *nexthop);
-
 /* Free nexthop. */
 static void
 nexthop_free (struct nexthop *nexthop)
@@ -289,7 +330,7 @@ nexthop_free (struct nexthop *nexthop)
 }
 
 /* Frees a list of nexthops */
-static void
+void
 nexthops_free (struct nexthop *nexthop)
 {
   struct nexthop *nh, *next;
@@ -473,7 +514,9 @@ nexthop_active_ipv4 (struct rib *rib, struct nexthop *nexthop, int set,
   p.prefixlen = IPV4_MAX_PREFIXLEN;
   p.prefix = nexthop->gate.ipv4;
 
-  /* Lookup table.  */
+  /* Lookup table.  Interfaces and their connected routes all live in
+     the default VRF, as does the kernel's own nexthop check for routes
+     in other tables, so nexthops resolve there.  */
   table = vrf_table (AFI_IP, SAFI_UNICAST, 0);
   if (! table)
     return 0;
@@ -615,7 +658,9 @@ nexthop_active_ipv6 (struct rib *rib, struct nexthop *nexthop, int set,
   p.prefixlen = IPV6_MAX_PREFIXLEN;
   p.prefix = nexthop->gate.ipv6;
 
-  /* Lookup table.  */
+  /* Lookup table.  Interfaces and their connected routes all live in
+     the default VRF, as does the kernel's own nexthop check for routes
+     in other tables, so nexthops resolve there.  */
   table = vrf_table (AFI_IP6, SAFI_UNICAST, 0);
   if (! table)
     return 0;
@@ -1168,26 +1213,190 @@ nexthop_active_check (struct route_node *rn, struct rib *rib,
   return CHECK_FLAG (nexthop->flags, NEXTHOP_FLAG_ACTIVE);
 }
 
+/* Whether the nexthops of rib resolve the same for any route, so the
+ * resolution of its nexthop group can be used.  A route-map filtering
+ * the routes of its protocol looks at the prefix, and so do the checks
+ * that a nexthop is of the route's family and does not resolve through
+ * the route itself.
+ */
+static int
+nexthop_group_usable (struct route_node *rn, struct rib *rib)
+{
+  extern char *proto_rm[AFI_MAX][ZEBRA_ROUTE_MAX+1];
+  struct nexthop *nexthop;
+  struct prefix p;
+  afi_t afi;
+
+  for (afi = AFI_IP; afi < AFI_MAX; afi++)
+    if (proto_rm[afi][ZEBRA_ROUTE_MAX]
+        || (rib->type >= 0 && rib->type < ZEBRA_ROUTE_MAX
+            && proto_rm[afi][rib->type]))
+      return 0;
+
+  for (nexthop = rib->nexthop; nexthop; nexthop = nexthop->next)
+    {
+      memset (&p, 0, sizeof (p));
+      switch (nexthop->type)
+        {
+        case NEXTHOP_TYPE_IPV4:
+        case NEXTHOP_TYPE_IPV4_IFINDEX:
+          p.family = AF_INET;
+          p.prefixlen = IPV4_MAX_PREFIXLEN;
+          p.u.prefix4 = nexthop->gate.ipv4;
+          break;
+#ifdef HAVE_IPV6
+        case NEXTHOP_TYPE_IPV6:
+        case NEXTHOP_TYPE_IPV6_IFINDEX:
+          p.family = AF_INET6;
+          p.prefixlen = IPV6_MAX_PREFIXLEN;
+          p.u.prefix6 = nexthop->gate.ipv6;
+          break;
+        case NEXTHOP_TYPE_IPV6_IFNAME:
+          if (rn->p.family != AF_INET6)
+            return 0;
+          continue;
+#endif /* HAVE_IPV6 */
+        default:
+          continue;
+        }
+      if (p.family != rn->p.family || prefix_match (&rn->p, &p))
+        return 0;
+    }
+  return 1;
+}
+
+/* Resolve the nexthops of rib's group, unless they have been since
+ * the routes they resolve through last changed.  rib and rn only stand
+ * in for all routes of the group, see nexthop_group_usable().
+ */
+static struct nexthop_group *
+nexthop_group_resolve (struct route_node *rn, struct rib *rib)
+{
+  struct nexthop_group *nhg;
+  struct nexthop *nexthop;
+
+  if (rib->nhg && ! nhg_match (rib->nhg, rib, rn->p.family))
+    {
+      nhg_release (rib->nhg);
+      rib->nhg = NULL;
+    }
+  if (! rib->nhg)
+    rib->nhg = nhg_get (rib, rn->p.family);
+  nhg = rib->nhg;
+
+  if (NHG_RESOLVED (nhg))
+    {
+      nhg->hit_cnt++;
+      return nhg;
+    }
+
+  nhg->active_num = 0;
+  for (nexthop = nhg->nexthop; nexthop; nexthop = nexthop->next)
+    if (nexthop_active_check (rn, rib, nexthop, 1))
+      nhg->active_num++;
+  nhg->generation = nhg_generation;
+  nhg->resolve_cnt++;
+  return nhg;
+}
+
+/* Give nexthop the resolution of its counterpart in the group.  The
+ * resolved nexthops are copied afresh, as nexthop_active_ipv4() would
+ * build them, only if they differ.
+ */
+static void
+nexthop_group_apply (struct nexthop *nexthop, struct nexthop *gnh, int set)
+{
+  struct nexthop *nh, *gh;
+
+  nexthop->ifindex = gnh->ifindex;
+  if (CHECK_FLAG (gnh->flags, NEXTHOP_FLAG_ACTIVE))
+    SET_FLAG (nexthop->flags, NEXTHOP_FLAG_ACTIVE);
+  else
+    UNSET_FLAG (nexthop->flags, NEXTHOP_FLAG_ACTIVE);
+
+  if (! set)
+    return;
+
+  if (CHECK_FLAG (gnh->flags, NEXTHOP_FLAG_RECURSIVE))
+    SET_FLAG (nexthop->flags, NEXTHOP_FLAG_RECURSIVE);
+  else
+    UNSET_FLAG (nexthop->flags, NEXTHOP_FLAG_RECURSIVE);
+
+  for (nh = nexthop->resolved, gh = gnh->resolved; nh && gh;
+       nh = nh->next, gh = gh->next)
+    if (nh->type != gh->type || nh->ifindex != gh->ifindex
+        || memcmp (&nh->gate, &gh->gate, sizeof (nh->gate)))
+      break;
+  if (nh || gh)
+    {
+      nexthops_free (nexthop->resolved);
+      nexthop->resolved = NULL;
+      for (gh = gnh->resolved; gh; gh = gh->next)
+        {
+          nh = XCALLOC (MTYPE_NEXTHOP, sizeof (struct nexthop));
+          nh->type = gh->type;
+          nh->ifindex = gh->ifindex;
+          nh->gate = gh->gate;
+          _nexthop_add (&nexthop->resolved, nh);
+        }
+    }
+  for (nh = nexthop->resolved, gh = gnh->resolved; nh && gh;
+       nh = nh->next, gh = gh->next)
+    nh->flags = gh->flags;
+}
+
 /* Iterate over all nexthops of the given RIB entry and refresh their
  * ACTIVE flag. rib->nexthop_active_num is updated accordingly. If any
  * nexthop is found to toggle the ACTIVE flag, the whole rib structure
  * is flagged with ZEBRA_FLAG_CHANGED. The 4th 'set' argument is
  * transparently passed to nexthop_active_check().
  *
+ * Where it can, this takes the resolution from the route's nexthop
+ * group, so the routes sharing the nexthops are resolved only once.
+ *
  * Return value is the new number of active nexthops.
  */
 
 static int
 nexthop_active_update (struct route_node *rn, struct rib *rib, int set)
 {
-  struct nexthop *nexthop;
+  struct nexthop *nexthop, *gnh = NULL;
+  struct nexthop_group *nhg = NULL;
   unsigned int prev_active, prev_index, new_active;
 
   rib->nexthop_active_num = 0;
   UNSET_FLAG (rib->flags, ZEBRA_FLAG_CHANGED);
 
+  if (nexthop_group_usable (rn, rib))
+    {
+      nhg = nexthop_group_resolve (rn, rib);
+      gnh = nhg->nexthop;
+    }
+  else if (rib->nhg)
+    {
+      /* Installed with the group's object, the route is to be
+         installed again with nexthops of its own. */
+      if (rib->kernel_nhid)
+        SET_FLAG (rib->flags, ZEBRA_FLAG_CHANGED);
+      nhg_release (rib->nhg);
+      rib->nhg = NULL;
+    }
+
   for (nexthop = rib->nexthop; nexthop; nexthop = nexthop->next)
   {
+    if (nhg)
+      {
+        prev_active = CHECK_FLAG (nexthop->flags, NEXTHOP_FLAG_ACTIVE);
+        prev_index = nexthop->ifindex;
+        nexthop_group_apply (nexthop, gnh, set);
+        if ((new_active = CHECK_FLAG (nexthop->flags, NEXTHOP_FLAG_ACTIVE)))
+          rib->nexthop_active_num++;
+        if (prev_active != new_active || prev_index != nexthop->ifindex)
+          SET_FLAG (rib->flags, ZEBRA_FLAG_CHANGED);
+        gnh = gnh->next;
+        continue;
+      }
+
     prev_active = CHECK_FLAG (nexthop->flags, NEXTHOP_FLAG_ACTIVE);
     prev_index = nexthop->ifindex;
     if ((new_active = nexthop_active_check (rn, rib, nexthop, set)))
@@ -1359,6 +1568,143 @@ rib_gc_dest (struct route_node *rn)
   return 1;
 }
 
+/* Startup reconciliation state, see rib_reconcile_start(). */
+static struct
+{
+  struct thread *t_reconcile;
+  unsigned long kept;
+  unsigned long replaced;
+} rib_reconcile_state;
+
+/* Does a nexthop selected for install match one read from the kernel? */
+static int
+rib_reconcile_nexthop_same (struct nexthop *nexthop, struct nexthop *knh)
+{
+  if (nexthop->ifindex && knh->ifindex && nexthop->ifindex != knh->ifindex)
+    return 0;
+
+  switch (nexthop->type)
+    {
+    case NEXTHOP_TYPE_IFINDEX:
+    case NEXTHOP_TYPE_IFNAME:
+      return (knh->type == NEXTHOP_TYPE_IFINDEX
+              || knh->type == NEXTHOP_TYPE_IFNAME)
+             && nexthop->ifindex == knh->ifindex;
+    case NEXTHOP_TYPE_IPV4:
+    case NEXTHOP_TYPE_IPV4_IFINDEX:
+    case NEXTHOP_TYPE_IPV4_IFNAME:
+      return (knh->type == NEXTHOP_TYPE_IPV4
+              || knh->type == NEXTHOP_TYPE_IPV4_IFINDEX
+              || knh->type == NEXTHOP_TYPE_IPV4_IFNAME)
+             && IPV4_ADDR_SAME (&nexthop->gate.ipv4, &knh->gate.ipv4)
+             && IPV4_ADDR_SAME (&nexthop->src.ipv4, &knh->src.ipv4);
+#ifdef HAVE_IPV6
+    case NEXTHOP_TYPE_IPV6:
+    case NEXTHOP_TYPE_IPV6_IFINDEX:
+    case NEXTHOP_TYPE_IPV6_IFNAME:
+      return (knh->type == NEXTHOP_TYPE_IPV6
+              || knh->type == NEXTHOP_TYPE_IPV6_IFINDEX
+              || knh->type == NEXTHOP_TYPE_IPV6_IFNAME)
+             && IPV6_ADDR_SAME (&nexthop->gate.ipv6, &knh->gate.ipv6);
+#endif /* HAVE_IPV6 */
+    default:
+      return 0;
+    }
+}
+
+/* Would installing 'rib' leave the kernel with exactly the route 'krib'
+ * read from it at startup?  Walks the nexthops the same way the kernel
+ * install does, so 'rib' must have had nexthop_active_update() done.
+ */
+static int
+rib_reconcile_same (struct rib *rib, struct rib *krib)
+{
+  struct nexthop *nexthop, *tnexthop;
+  struct nexthop *knh = krib->nexthop;
+  int recursing;
+  int num = 0;
+
+  /* Kernel routes are keyed on metric, so a different one is a
+     different route rather than a replacement.  Table 0 means the
+     main table to the kernel. */
+  if (rib->metric != krib->metric
+      || (rib->table ? rib->table : RT_TABLE_MAIN) != krib->table
+      || CHECK_FLAG (rib->flags, ZEBRA_FLAG_BLACKHOLE | ZEBRA_FLAG_REJECT))
+    return 0;
+
+  for (ALL_NEXTHOPS_RO(rib->nexthop, nexthop, tnexthop, recursing))
+    {
+      if (CHECK_FLAG (nexthop->flags, NEXTHOP_FLAG_RECURSIVE)
+          || ! CHECK_FLAG (nexthop->flags, NEXTHOP_FLAG_ACTIVE))
+        continue;
+      if (MULTIPATH_NUM != 0 && num >= MULTIPATH_NUM)
+        break;
+      if (! knh || ! rib_reconcile_nexthop_same (nexthop, knh))
+        return 0;
+      knh = knh->next;
+      num++;
+    }
+
+  return num > 0 && knh == NULL;
+}
+
+/* Install 'select' against a provisional kernel route for the same
+ * prefix left over from the previous zebra, if there is one.  An
+ * identical route is adopted as is.  A different one is replaced;
+ * netlink adds do not replace, so when both share a metric the old
+ * route has to go first.  Returns 0 if the caller should install.
+ */
+static int
+rib_reconcile_install (struct route_node *rn, struct rib *select)
+{
+  struct rib *krib;
+  struct nexthop *nexthop, *tnexthop;
+  int recursing;
+  int num = 0;
+
+  RNODE_FOREACH_RIB (rn, krib)
+    if (CHECK_FLAG (krib->status, RIB_ENTRY_PROVISIONAL)
+        && ! CHECK_FLAG (krib->status, RIB_ENTRY_REMOVED))
+      break;
+  if (! krib)
+    return 0;
+
+  if (rib_reconcile_same (select, krib))
+    {
+      if (IS_ZEBRA_DEBUG_RIB)
+        rnode_debug (rn, "keeping kernel route %p for %p", krib, select);
+      for (ALL_NEXTHOPS_RO(select->nexthop, nexthop, tnexthop, recursing))
+        {
+          if (CHECK_FLAG (nexthop->flags, NEXTHOP_FLAG_RECURSIVE)
+              || ! CHECK_FLAG (nexthop->flags, NEXTHOP_FLAG_ACTIVE))
+            continue;
+          if (MULTIPATH_NUM != 0 && num++ >= MULTIPATH_NUM)
+            break;
+          SET_FLAG (nexthop->flags, NEXTHOP_FLAG_FIB);
+        }
+      rib_reconcile_state.kept++;
+    }
+  else
+    {
+      if (IS_ZEBRA_DEBUG_RIB)
+        rnode_debug (rn, "replacing kernel route %p with %p", krib, select);
+      if (select->metric != krib->metric)
+        {
+          rib_install_kernel (rn, select);
+          rib_uninstall_kernel (rn, krib);
+        }
+      else
+        {
+          rib_uninstall_kernel (rn, krib);
+          rib_install_kernel (rn, select);
+        }
+      rib_reconcile_state.replaced++;
+    }
+
+  rib_unlink (rn, krib);
+  return 1;
+}
+
 /* Core function for processing routing information base. */
 static void
 rib_process (struct route_node *rn)
@@ -1371,11 +1717,25 @@ rib_process (struct route_node *rn)
   int installed = 0;
   struct nexthop *nexthop = NULL, *tnexthop;
   int recursing;
+  int resolves = 0;
   rib_table_info_t *info;
 
   assert (rn);
 
   info = rn->table->info;
+  rib_generation++;
+
+  /* Nexthops resolve through the non-BGP unicast routes of the default
+   * VRF, so the resolution of every nexthop group may change with them.
+   */
+  if (info->vrf->id == 0 && info->safi == SAFI_UNICAST)
+    RNODE_FOREACH_RIB (rn, rib)
+      if (rib->type != ZEBRA_ROUTE_BGP)
+        {
+          resolves = 1;
+          nhg_invalidate ();
+          break;
+        }
 
   RNODE_FOREACH_RIB_SAFE (rn, rib, next)
     {
@@ -1403,6 +1763,11 @@ rib_process (struct route_node *rn)
           continue;
         }
       
+      /* Kernel routes of a previous zebra only stand in for the
+         routes clients are yet to send again. */
+      if (CHECK_FLAG (rib->status, RIB_ENTRY_PROVISIONAL))
+        continue;
+
       /* Skip unreachable nexthop. */
       if (! nexthop_active_update (rn, rib, 0))
         continue;
@@ -1473,14 +1838,30 @@ rib_process (struct route_node *rn)
 	    zfpm_trigger_update (rn, "updating existing route");
 
           redistribute_delete (&rn->p, select);
-          if (! RIB_SYSTEM_ROUTE (select))
-            rib_uninstall_kernel (rn, select);
+          if (! RIB_SYSTEM_ROUTE (select) && select->kernel_nhid)
+            {
+              /* Installed with the kernel object of its nexthop group,
+               * the route follows the object, unless it has moved to
+               * another group or the object is gone.
+               */
+              nexthop_active_update (rn, select, 1);
+              if (kernel_nhg_update (&rn->p, select) < 0)
+                {
+                  rib_uninstall_kernel (rn, select);
+                  rib_install_kernel (rn, select);
+                }
+            }
+          else
+            {
+              if (! RIB_SYSTEM_ROUTE (select))
+                rib_uninstall_kernel (rn, select);
 
-          /* Set real nexthop. */
-          nexthop_active_update (rn, select, 1);
-  
-          if (! RIB_SYSTEM_ROUTE (select))
-            rib_install_kernel (rn, select);
+              /* Set real nexthop. */
+              nexthop_active_update (rn, select, 1);
+
+              if (! RIB_SYSTEM_ROUTE (select))
+                rib_install_kernel (rn, select);
+            }
           redistribute_add (&rn->p, select);
         }
       else if (! RIB_SYSTEM_ROUTE (select))
@@ -1540,7 +1921,8 @@ rib_process (struct route_node *rn)
       /* Set real nexthop. */
       nexthop_active_update (rn, select, 1);
 
-      if (! RIB_SYSTEM_ROUTE (select))
+      if (! RIB_SYSTEM_ROUTE (select)
+          && ! rib_reconcile_install (rn, select))
         rib_install_kernel (rn, select);
       SET_FLAG (select->flags, ZEBRA_FLAG_SELECTED);
       redistribute_add (&rn->p, select);
@@ -1555,6 +1937,9 @@ rib_process (struct route_node *rn)
     }
 
 end:
+  if (resolves)
+    nhg_invalidate ();
+
   if (IS_ZEBRA_DEBUG_RIB_Q)
     rnode_debug (rn, "rn %p dequeued", rn);
 
@@ -1564,20 +1949,90 @@ end:
   rib_gc_dest (rn);
 }
 
+/* Scheduling of the meta-queue sub-queues.  Connected routes, which
+ * everything else resolves through, get the biggest share and the
+ * tightest target; BGP, which comes in floods, the smallest share, so
+ * that a flood cannot hold up the other classes, yet it is never
+ * starved by them.
+ */
+const struct meta_queue_class mq_class_default[MQ_SIZE] =
+{
+  { .name = "connected", .weight = 8, .target = 100 },
+  { .name = "static",    .weight = 4, .target = 250 },
+  { .name = "igp",       .weight = 4, .target = 500 },
+  { .name = "bgp",       .weight = 1, .target = 5000 },
+  { .name = "other",     .weight = 1, .target = 5000 },
+};
+
+struct meta_queue_class mq_class[MQ_SIZE];
+
+static u_int32_t
+meta_queue_now (void)
+{
+  struct timeval tv;
+
+  quagga_gettime (QUAGGA_CLK_MONOTONIC, &tv);
+  return tv.tv_sec * 1000 + tv.tv_usec / 1000;
+}
+
+static void
+meta_queue_times_push (struct meta_queue_times *times, u_int32_t now)
+{
+  if (times->num == times->size)
+    {
+      u_int32_t size = times->size ? times->size * 2 : 64;
+      u_int32_t *ms = XMALLOC (MTYPE_WORK_QUEUE, size * sizeof (u_int32_t));
+      u_int32_t i;
+
+      for (i = 0; i < times->num; i++)
+        ms[i] = times->ms[(times->head + i) % times->size];
+      if (times->ms)
+        XFREE (MTYPE_WORK_QUEUE, times->ms);
+      times->ms = ms;
+      times->head = 0;
+      times->size = size;
+    }
+  times->ms[(times->head + times->num++) % times->size] = now;
+}
+
+static u_int32_t
+meta_queue_times_pop (struct meta_queue_times *times)
+{
+  u_int32_t ms = times->ms[times->head];
+
+  times->head = (times->head + 1) % times->size;
+  times->num--;
+  return ms;
+}
+
 /* Take a list of route_node structs and return 1, if there was a record
  * picked from it and processed by rib_process(). Don't process more, 
  * than one RN record; operate only in the specified sub-queue.
  */
 static unsigned int
-process_subq (struct list * subq, u_char qindex)
+process_subq (struct meta_queue *mq, u_char qindex)
 {
+  struct list *subq = mq->subq[qindex];
   struct listnode *lnode  = listhead (subq);
   struct route_node *rnode;
+  struct meta_queue_class *class = &mq_class[qindex];
+  u_int32_t wait;
 
   if (!lnode)
     return 0;
 
+  wait = meta_queue_now () - meta_queue_times_pop (&mq->times[qindex]);
+  class->queued--;
+  class->processed++;
+  class->wait_total += wait;
+  if (wait > class->wait_max)
+    class->wait_max = wait;
+  if (wait > class->target)
+    class->late++;
+
   rnode = listgetdata (lnode);
+  if (rib_queue_hook)
+    (*rib_queue_hook) (rnode, 0);
   rib_process (rnode);
 
   if (rnode->info)
@@ -1596,23 +2051,95 @@ process_subq (struct list * subq, u_char qindex)
   return 1;
 }
 
-/* Dispatch the meta queue by picking, processing and unlocking the next RN from
- * a non-empty sub-queue with lowest priority. wq is equal to zebra->ribq and data
- * is pointed to the meta queue structure.
+/* The sub-queue of mq to take the next route node from.  Each sub-queue
+ * with nodes takes up to its class's weight of them in turn.  When a turn
+ * ends, the next one goes to the sub-queue whose oldest node is latest
+ * against its class's latency target, if any is late, so that a class
+ * falling behind catches up without taking more than its share.
+ */
+static u_char
+meta_queue_pick (struct meta_queue *mq)
+{
+  u_int32_t now, wait, target;
+  u_int64_t late, latest = 0;
+  int i, next, pick = -1;
+
+  if (mq->credit && listcount (mq->subq[mq->turn]))
+    {
+      mq->credit--;
+      return mq->turn;
+    }
+
+  next = mq->turn;
+  do
+    next = (next + 1) % MQ_SIZE;
+  while (! listcount (mq->subq[next]));
+
+  now = meta_queue_now ();
+  for (i = 0; i < MQ_SIZE; i++)
+    {
+      if (i == mq->turn || ! mq->times[i].num)
+        continue;
+      wait = now - mq->times[i].ms[mq->times[i].head];
+      target = mq_class[i].target;
+      if (wait <= target)
+        continue;
+
+      /* Compare how late they are relative to their targets. */
+      late = (u_int64_t) (wait - target) * MQ_TARGET_MAX / target;
+      if (pick < 0 || late > latest)
+        {
+          pick = i;
+          latest = late;
+        }
+    }
+  if (pick >= 0 && pick != next)
+    {
+      mq_class[pick].promoted++;
+      next = pick;
+    }
+
+  mq->turn = next;
+  mq->credit = mq_class[next].weight - 1;
+  return mq->turn;
+}
+
+/* Dispatch the meta queues by picking, processing and unlocking the next RN
+ * of the VRF at the head of the list, which then goes to the back of the
+ * list, so every VRF with work gets a turn.  meta_queue_pick() chooses the
+ * sub-queue.  wq is equal to zebra->ribq and data is pointed to the list of
+ * VRFs with queued route nodes.
  */
 static wq_item_status
 meta_queue_process (struct work_queue *dummy, void *data)
 {
-  struct meta_queue * mq = data;
-  unsigned i;
+  struct list *vrfs = data;
+  struct listnode *node;
+  struct vrf *vrf;
+  struct meta_queue *mq;
 
-  for (i = 0; i < MQ_SIZE; i++)
-    if (process_subq (mq->subq[i], i))
-      {
-	mq->size--;
-	break;
-      }
-  return mq->size ? WQ_REQUEUE : WQ_SUCCESS;
+  if ((node = listhead (vrfs)) == NULL)
+    return WQ_SUCCESS;
+  vrf = listgetdata (node);
+  mq = vrf->mq;
+
+  if (mq->size && process_subq (mq, meta_queue_pick (mq)))
+    {
+      mq->size--;
+      vrf->processed++;
+    }
+
+  if (! mq->size)
+    {
+      vrf->mq_scheduled = 0;
+      list_delete_node (vrfs, node);
+    }
+  else if (listnextnode (node))
+    {
+      list_delete_node (vrfs, node);
+      listnode_add (vrfs, vrf);
+    }
+  return listhead (vrfs) ? WQ_REQUEUE : WQ_SUCCESS;
 }
 
 /*
@@ -1657,8 +2184,12 @@ rib_meta_queue_add (struct meta_queue *mq, struct route_node *rn)
 
       SET_FLAG (rib_dest_from_rnode (rn)->flags, RIB_ROUTE_QUEUED (qindex));
       listnode_add (mq->subq[qindex], rn);
+      meta_queue_times_push (&mq->times[qindex], meta_queue_now ());
+      mq_class[qindex].queued++;
       route_lock_node (rn);
       mq->size++;
+      if (rib_queue_hook)
+        (*rib_queue_hook) (rn, 1);
 
       if (IS_ZEBRA_DEBUG_RIB_Q)
 	rnode_debug (rn, "queued rn %p into sub-queue %u",
@@ -1670,6 +2201,8 @@ rib_meta_queue_add (struct meta_queue *mq, struct route_node *rn)
 static void
 rib_queue_add (struct zebra_t *zebra, struct route_node *rn)
 {
+  struct vrf *vrf;
+
   assert (zebra && rn);
 
   /* Pointless to queue a route_node with no RIB entries to add or remove */
@@ -1695,15 +2228,21 @@ rib_queue_add (struct zebra_t *zebra, struct route_node *rn)
   /*
    * The RIB queue should normally be either empty or holding the only
    * work_queue_item element. In the latter case this element would
-   * hold a pointer to the meta queue structure, which must be used to
-   * actually queue the route nodes to process. So create the MQ
-   * holder, if necessary, then push the work into it in any case.
-   * This semantics was introduced after 0.99.9 release.
+   * hold a pointer to the list of VRFs with queued route nodes, each
+   * of which has its own meta queue that the route nodes of the VRF go
+   * into. So create the holder, if necessary, then push the work into
+   * the VRF's meta queue and make sure the VRF is on the list.
    */
   if (!zebra->ribq->items->count)
-    work_queue_add (zebra->ribq, zebra->mq);
+    work_queue_add (zebra->ribq, zebra->mq_vrfs);
 
-  rib_meta_queue_add (zebra->mq, rn);
+  vrf = rib_dest_vrf (rib_dest_from_rnode (rn));
+  rib_meta_queue_add (vrf->mq, rn);
+  if (vrf->mq->size && ! vrf->mq_scheduled)
+    {
+      listnode_add (zebra->mq_vrfs, vrf);
+      vrf->mq_scheduled = 1;
+    }
 
   if (IS_ZEBRA_DEBUG_RIB_Q)
     rnode_debug (rn, "rn %p queued", rn);
@@ -1732,6 +2271,27 @@ meta_queue_new (void)
   return new;
 }
 
+/* The sub-queues of the RIB queue in "show work-queues". */
+static void
+meta_queue_show (struct vty *vty, struct work_queue *wq)
+{
+  struct meta_queue_class *class;
+  int i;
+
+  vty_out (vty, "  %-10s %6s %8s %8s %10s %8s %8s %8s %8s%s",
+           "Class", "Weight", "Tgt(ms)", "Queued", "Processed", "Promoted",
+           "Late", "Avg(ms)", "Max(ms)", VTY_NEWLINE);
+  for (i = 0; i < MQ_SIZE; i++)
+    {
+      class = &mq_class[i];
+      vty_out (vty, "  %-10s %6u %8u %8u %10lu %8lu %8lu %8llu %8u%s",
+               class->name, class->weight, class->target, class->queued,
+               class->processed, class->promoted, class->late,
+               class->processed ? class->wait_total / class->processed : 0,
+               class->wait_max, VTY_NEWLINE);
+    }
+}
+
 /* initialise zebra rib work queue */
 static void
 rib_queue_init (struct zebra_t *zebra)
@@ -1748,15 +2308,13 @@ rib_queue_init (struct zebra_t *zebra)
   /* fill in the work queue spec */
   zebra->ribq->spec.workfunc = &meta_queue_process;
   zebra->ribq->spec.errorfunc = NULL;
+  zebra->ribq->spec.show_func = &meta_queue_show;
   /* XXX: TODO: These should be runtime configurable via vty */
   zebra->ribq->spec.max_retries = 3;
   zebra->ribq->spec.hold = rib_process_hold_time;
   
-  if (!(zebra->mq = meta_queue_new ()))
-  {
-    zlog_err ("%s: could not initialise meta queue!", __func__);
-    return;
-  }
+  zebra->mq_vrfs = list_new ();
+  memcpy (mq_class, mq_class_default, sizeof (mq_class));
   return;
 }
 
@@ -1803,6 +2361,7 @@ rib_link (struct route_node *rn, struct rib *rib)
 {
   struct rib *head;
   rib_dest_t *dest;
+  rib_table_info_t *info;
 
   assert (rib && rn);
   
@@ -1828,6 +2387,11 @@ rib_link (struct route_node *rn, struct rib *rib)
     }
   rib->next = head;
   dest->routes = rib;
+
+  info = rib_table_info (rn->table);
+  rib->vrf_id = info->vrf->id;
+  info->vrf->rib_cnt[info->afi]++;
+
   rib_queue_add (&zebrad, rn);
 }
 
@@ -1861,6 +2425,7 @@ static void
 rib_unlink (struct route_node *rn, struct rib *rib)
 {
   rib_dest_t *dest;
+  rib_table_info_t *info;
 
   assert (rn && rib);
 
@@ -1879,7 +2444,14 @@ rib_unlink (struct route_node *rn, struct rib *rib)
       dest->routes = rib->next;
     }
 
+  info = rib_table_info (rn->table);
+  info->vrf->rib_cnt[info->afi]--;
+
   /* free RIB and nexthops */
+  if (rib->nhg)
+    nhg_release (rib->nhg);
+  if (rib->kernel_nhg)
+    nhg_release (rib->kernel_nhg);
   nexthops_free(rib->nexthop);
   XFREE (MTYPE_RIB, rib);
 
@@ -1897,7 +2469,7 @@ rib_delnode (struct route_node *rn, struct rib *rib)
 int
 rib_add_ipv4 (int type, int flags, struct prefix_ipv4 *p, 
 	      struct in_addr *gate, struct in_addr *src,
-	      unsigned int ifindex, u_int32_t vrf_id,
+	      unsigned int ifindex, u_int32_t kernel_table, u_int32_t vrf_id,
 	      u_int32_t metric, u_char distance, safi_t safi)
 {
   struct rib *rib;
@@ -1907,7 +2479,9 @@ rib_add_ipv4 (int type, int flags, struct prefix_ipv4 *p,
   struct nexthop *nexthop;
 
   /* Lookup table.  */
-  table = vrf_table (AFI_IP, safi, 0);
+  if (! vrf_get (vrf_id))
+    return 0;
+  table = vrf_table (AFI_IP, safi, vrf_id);
   if (! table)
     return 0;
 
@@ -1961,7 +2535,7 @@ rib_add_ipv4 (int type, int flags, struct prefix_ipv4 *p,
   rib->distance = distance;
   rib->flags = flags;
   rib->metric = metric;
-  rib->table = vrf_id;
+  rib->table = vrf_id ? vrf_id : kernel_table;
   rib->nexthop_num = 0;
   rib->uptime = time (NULL);
 
@@ -2166,11 +2740,21 @@ rib_add_ipv4_multipath (struct prefix_ipv4 *p, struct rib *rib, safi_t safi)
   struct rib *same;
   struct nexthop *nexthop;
   
-  /* Lookup table.  */
-  table = vrf_table (AFI_IP, safi, 0);
+  /* Lookup table, which rib->vrf_id selects.  */
+  if (! vrf_get (rib->vrf_id))
+    {
+      nexthops_free (rib->nexthop);
+      XFREE (MTYPE_RIB, rib);
+      return 0;
+    }
+  table = vrf_table (AFI_IP, safi, rib->vrf_id);
   if (! table)
     return 0;
 
+  /* VRFs other than the default install into their own kernel table. */
+  if (rib->vrf_id)
+    rib->table = rib->vrf_id;
+
   /* Make it sure prefixlen is applied to the prefix. */
   apply_mask_ipv4 (p);
 
@@ -2233,7 +2817,8 @@ rib_add_ipv4_multipath (struct prefix_ipv4 *p, struct rib *rib, safi_t safi)
 /* XXX factor with rib_delete_ipv6 */
 int
 rib_delete_ipv4 (int type, int flags, struct prefix_ipv4 *p,
-		 struct in_addr *gate, unsigned int ifindex, u_int32_t vrf_id, safi_t safi)
+		 struct in_addr *gate, unsigned int ifindex,
+		 u_int32_t kernel_table, u_int32_t vrf_id, safi_t safi)
 {
   struct route_table *table;
   struct route_node *rn;
@@ -2246,7 +2831,7 @@ rib_delete_ipv4 (int type, int flags, struct prefix_ipv4 *p,
   char buf2[INET_ADDRSTRLEN];
 
   /* Lookup table.  */
-  table = vrf_table (AFI_IP, safi, 0);
+  table = vrf_table (AFI_IP, safi, vrf_id);
   if (! table)
     return 0;
 
@@ -2689,8 +3274,8 @@ static_delete_ipv4_safi (safi_t safi, struct prefix *p, struct in_addr *gate,
 #ifdef HAVE_IPV6
 int
 rib_add_ipv6 (int type, int flags, struct prefix_ipv6 *p,
-	      struct in6_addr *gate, unsigned int ifindex, u_int32_t vrf_id,
-	      u_int32_t metric, u_char distance, safi_t safi)
+	      struct in6_addr *gate, unsigned int ifindex, u_int32_t kernel_table,
+	      u_int32_t vrf_id, u_int32_t metric, u_char distance, safi_t safi)
 {
   struct rib *rib;
   struct rib *same = NULL;
@@ -2699,7 +3284,9 @@ rib_add_ipv6 (int type, int flags, struct prefix_ipv6 *p,
   struct nexthop *nexthop;
 
   /* Lookup table.  */
-  table = vrf_table (AFI_IP6, safi, 0);
+  if (! vrf_get (vrf_id))
+    return 0;
+  table = vrf_table (AFI_IP6, safi, vrf_id);
   if (! table)
     return 0;
 
@@ -2746,7 +3333,7 @@ rib_add_ipv6 (int type, int flags, struct prefix_ipv6 *p,
   rib->distance = distance;
   rib->flags = flags;
   rib->metric = metric;
-  rib->table = vrf_id;
+  rib->table = vrf_id ? vrf_id : kernel_table;
   rib->nexthop_num = 0;
   rib->uptime = time (NULL);
 
@@ -2794,7 +3381,8 @@ rib_add_ipv6 (int type, int flags, struct prefix_ipv6 *p,
 /* XXX factor with rib_delete_ipv6 */
 int
 rib_delete_ipv6 (int type, int flags, struct prefix_ipv6 *p,
-		 struct in6_addr *gate, unsigned int ifindex, u_int32_t vrf_id, safi_t safi)
+		 struct in6_addr *gate, unsigned int ifindex,
+		 u_int32_t kernel_table, u_int32_t vrf_id, safi_t safi)
 {
   struct route_table *table;
   struct route_node *rn;
@@ -2810,7 +3398,7 @@ rib_delete_ipv6 (int type, int flags, struct prefix_ipv6 *p,
   apply_mask_ipv6 (p);
 
   /* Lookup table.  */
-  table = vrf_table (AFI_IP6, safi, 0);
+  table = vrf_table (AFI_IP6, safi, vrf_id);
   if (! table)
     return 0;
   
@@ -3227,18 +3815,17 @@ rib_update (void)
 {
   struct route_node *rn;
   struct route_table *table;
-  
-  table = vrf_table (AFI_IP, SAFI_UNICAST, 0);
-  if (table)
-    for (rn = route_top (table); rn; rn = route_next (rn))
-      if (rnode_to_ribs (rn))
-        rib_queue_add (&zebrad, rn);
+  rib_tables_iter_t iter;
 
-  table = vrf_table (AFI_IP6, SAFI_UNICAST, 0);
-  if (table)
-    for (rn = route_top (table); rn; rn = route_next (rn))
-      if (rnode_to_ribs (rn))
-        rib_queue_add (&zebrad, rn);
+  nhg_invalidate ();
+
+  rib_tables_iter_init (&iter);
+  while ((table = rib_tables_iter_next (&iter)))
+    if (rib_table_info (table)->safi == SAFI_UNICAST)
+      for (rn = route_top (table); rn; rn = route_next (rn))
+        if (rnode_to_ribs (rn))
+          rib_queue_add (&zebrad, rn);
+  rib_tables_iter_cleanup (&iter);
 }
 
 
@@ -3272,13 +3859,14 @@ rib_weed_tables (void)
 }
 
 /* Delete self installed routes after zebra is relaunched.  */
-static void
+static unsigned long
 rib_sweep_table (struct route_table *table)
 {
   struct route_node *rn;
   struct rib *rib;
   struct rib *next;
   int ret = 0;
+  unsigned long n = 0;
 
   if (table)
     for (rn = route_top (table); rn; rn = route_next (rn))
@@ -3290,11 +3878,15 @@ rib_sweep_table (struct route_table *table)
 	  if (rib->type == ZEBRA_ROUTE_KERNEL && 
 	      CHECK_FLAG (rib->flags, ZEBRA_FLAG_SELFROUTE))
 	    {
+	      UNSET_FLAG (rib->status, RIB_ENTRY_PROVISIONAL);
 	      ret = rib_uninstall_kernel (rn, rib);
 	      if (! ret)
                 rib_delnode (rn, rib);
+	      n++;
 	    }
 	}
+
+  return n;
 }
 
 /* Sweep all RIB tables.  */
@@ -3305,6 +3897,136 @@ rib_sweep_route (void)
   rib_sweep_table (vrf_table (AFI_IP6, SAFI_UNICAST, 0));
 }
 
+/* End of the reconcile window: whatever clients did not claim is stale. */
+static int
+rib_reconcile_timer (struct thread *thread)
+{
+  unsigned long swept;
+
+  rib_reconcile_state.t_reconcile = NULL;
+
+  swept = rib_sweep_table (vrf_table (AFI_IP, SAFI_UNICAST, 0))
+          + rib_sweep_table (vrf_table (AFI_IP6, SAFI_UNICAST, 0));
+
+  zlog_info ("Startup reconcile done: %lu kernel routes kept, "
+             "%lu replaced, %lu swept", rib_reconcile_state.kept,
+             rib_reconcile_state.replaced, swept);
+  return 0;
+}
+
+/* Mark the routes a previous zebra left in a table as provisional, and
+   weed out those from other tables while walking it anyway. */
+static unsigned long
+rib_reconcile_table (struct route_table *table)
+{
+  struct route_node *rn;
+  struct rib *rib;
+  struct rib *next;
+  unsigned long n = 0;
+
+  if (table)
+    for (rn = route_top (table); rn; rn = route_next (rn))
+      RNODE_FOREACH_RIB_SAFE (rn, rib, next)
+	{
+	  if (CHECK_FLAG (rib->status, RIB_ENTRY_REMOVED))
+	    continue;
+
+	  if (rib->table != zebrad.rtm_table_default &&
+	      rib->table != RT_TABLE_MAIN)
+            rib_delnode (rn, rib);
+	  else if (rib->type == ZEBRA_ROUTE_KERNEL && 
+		   CHECK_FLAG (rib->flags, ZEBRA_FLAG_SELFROUTE))
+	    {
+	      SET_FLAG (rib->status, RIB_ENTRY_PROVISIONAL);
+	      n++;
+	    }
+	}
+
+  return n;
+}
+
+/* Reconcile instead of weed and sweep at startup.  Routes zebra
+ * installed before a restart are left in the kernel for 'secs' seconds.
+ * As clients send their routes again, each one either matches the
+ * kernel route and is adopted without touching the kernel, or replaces
+ * it.  Routes not claimed by then are swept as usual.
+ */
+void
+rib_reconcile_start (int secs)
+{
+  unsigned long n;
+
+  n = rib_reconcile_table (vrf_table (AFI_IP, SAFI_UNICAST, 0))
+      + rib_reconcile_table (vrf_table (AFI_IP6, SAFI_UNICAST, 0));
+
+  zlog_info ("Startup reconcile: %lu kernel routes held for %d seconds",
+             n, secs);
+
+  rib_reconcile_state.kept = rib_reconcile_state.replaced = 0;
+  THREAD_OFF (rib_reconcile_state.t_reconcile);
+  rib_reconcile_state.t_reconcile =
+    thread_add_timer (zebrad.master, rib_reconcile_timer, NULL, secs);
+}
+
+/* Mark the kernel routes of an address family as stale ahead of a
+ * fresh dump of the kernel table.  Routes in the dump replace their
+ * stale copies as they are added again, see rib_sweep_kernel_stale().
+ */
+unsigned long
+rib_mark_kernel_stale (afi_t afi)
+{
+  struct route_table *table;
+  struct route_node *rn;
+  struct rib *rib;
+  unsigned long n = 0;
+
+  table = vrf_table (afi, SAFI_UNICAST, 0);
+  if (table)
+    for (rn = route_top (table); rn; rn = route_next (rn))
+      RNODE_FOREACH_RIB (rn, rib)
+        {
+          if (CHECK_FLAG (rib->status, RIB_ENTRY_REMOVED))
+            continue;
+          if (rib->type == ZEBRA_ROUTE_KERNEL
+              && ! CHECK_FLAG (rib->flags, ZEBRA_FLAG_SELFROUTE))
+            {
+              SET_FLAG (rib->status, RIB_ENTRY_STALE);
+              n++;
+            }
+        }
+
+  return n;
+}
+
+/* After the dump, remove the kernel routes it did not contain, or just
+   unmark them all if 'remove' is 0 because the dump failed. */
+unsigned long
+rib_sweep_kernel_stale (afi_t afi, int remove)
+{
+  struct route_table *table;
+  struct route_node *rn;
+  struct rib *rib;
+  struct rib *next;
+  unsigned long n = 0;
+
+  table = vrf_table (afi, SAFI_UNICAST, 0);
+  if (table)
+    for (rn = route_top (table); rn; rn = route_next (rn))
+      RNODE_FOREACH_RIB_SAFE (rn, rib, next)
+        {
+          if (! CHECK_FLAG (rib->status, RIB_ENTRY_STALE))
+            continue;
+          UNSET_FLAG (rib->status, RIB_ENTRY_STALE);
+          if (remove && ! CHECK_FLAG (rib->status, RIB_ENTRY_REMOVED))
+            {
+              rib_delnode (rn, rib);
+              n++;
+            }
+        }
+
+  return n;
+}
+
 /* Remove specific by protocol routes from 'table'. */
 static unsigned long
 rib_score_proto_table (u_char proto, struct route_table *table)
@@ -3334,8 +4056,17 @@ rib_score_proto_table (u_char proto, struct route_table *table)
 unsigned long
 rib_score_proto (u_char proto)
 {
-  return  rib_score_proto_table (proto, vrf_table (AFI_IP,  SAFI_UNICAST, 0))
-         +rib_score_proto_table (proto, vrf_table (AFI_IP6, SAFI_UNICAST, 0));
+  struct route_table *table;
+  rib_tables_iter_t iter;
+  unsigned long n = 0;
+
+  rib_tables_iter_init (&iter);
+  while ((table = rib_tables_iter_next (&iter)))
+    if (rib_table_info (table)->safi == SAFI_UNICAST)
+      n += rib_score_proto_table (proto, table);
+  rib_tables_iter_cleanup (&iter);
+
+  return n;
 }
 
 /* Close RIB and clean up kernel routes. */
@@ -3365,8 +4096,14 @@ rib_close_table (struct route_table *table)
 void
 rib_close (void)
 {
-  rib_close_table (vrf_table (AFI_IP, SAFI_UNICAST, 0));
-  rib_close_table (vrf_table (AFI_IP6, SAFI_UNICAST, 0));
+  struct route_table *table;
+  rib_tables_iter_t iter;
+
+  rib_tables_iter_init (&iter);
+  while ((table = rib_tables_iter_next (&iter)))
+    if (rib_table_info (table)->safi == SAFI_UNICAST)
+      rib_close_table (table);
+  rib_tables_iter_cleanup (&iter);
 }
 
 /* Routing information base initialize. */
@@ -3374,6 +4111,7 @@ void
 rib_init (void)
 {
   rib_queue_init (&zebrad);
+  nhg_init ();
   /* VRF initialization.  */
   vrf_init ();
 }
@@ -3385,7 +4123,7 @@ rib_init (void)
  *
  * Returns TRUE if a vrf id was found, FALSE otherwise.
  */
-static inline int
+int
 vrf_id_get_next (uint32_t id, uint32_t *next_id_p)
 {
   while (++id < vector_active (vrf_vector))
@@ -29,8 +29,12 @@
 #include "rib.h"
 
 #include "zebra/zserv.h"
+#include "zebra/zebra_nhg.h"
+#include "zebra/rt.h"
 
-static int do_show_ip_route(struct vty *vty, safi_t safi);
+extern struct zebra_t zebrad;
+
+static int do_show_ip_route(struct vty *vty, safi_t safi, u_int32_t vrf_id);
 static void vty_show_ip_route_detail (struct vty *vty, struct route_node *rn,
                                       int mcast);
 
@@ -259,7 +263,7 @@ DEFUN (show_ip_rpf,
        "Display RPF information for multicast source\n")
 {
   VTY_WARN_EXPERIMENTAL();
-  return do_show_ip_route(vty, SAFI_MULTICAST);
+  return do_show_ip_route(vty, SAFI_MULTICAST, 0);
 }
 
 DEFUN (show_ip_rpf_addr,
@@ -960,16 +964,31 @@ DEFUN (show_ip_route,
        IP_STR
        "IP routing table\n")
 {
-  return do_show_ip_route(vty, SAFI_UNICAST);
+  return do_show_ip_route(vty, SAFI_UNICAST, 0);
 }
 
-static int do_show_ip_route(struct vty *vty, safi_t safi) {
+DEFUN (show_ip_route_vrf,
+       show_ip_route_vrf_cmd,
+       "show ip route vrf <1-65535>",
+       SHOW_STR
+       IP_STR
+       "IP routing table\n"
+       "Routing table of a VRF\n"
+       "VRF id\n")
+{
+  u_int32_t vrf_id;
+
+  VTY_GET_INTEGER_RANGE ("VRF id", vrf_id, argv[0], 1, VRF_ID_MAX);
+  return do_show_ip_route(vty, SAFI_UNICAST, vrf_id);
+}
+
+static int do_show_ip_route(struct vty *vty, safi_t safi, u_int32_t vrf_id) {
   struct route_table *table;
   struct route_node *rn;
   struct rib *rib;
   int first = 1;
 
-  table = vrf_table (AFI_IP, safi, 0);
+  table = vrf_table (AFI_IP, safi, vrf_id);
   if (! table)
     return CMD_SUCCESS;
 
@@ -1369,6 +1388,154 @@ DEFUN (show_ip_route_summary_prefix,
   return CMD_SUCCESS;
 }
 
+DEFUN (show_zebra_vrf,
+       show_zebra_vrf_cmd,
+       "show zebra vrf",
+       SHOW_STR
+       "Zebra information\n"
+       "VRFs with their routes and RIB queue\n")
+{
+  struct vrf *vrf;
+  u_int32_t vrf_id = 0;
+
+  vty_out (vty, "%-6s %-24s %-6s %10s %10s %8s %12s%s", "Id", "Name",
+           "Table", "IPv4", "IPv6", "Queued", "Processed", VTY_NEWLINE);
+  do
+    {
+      if ((vrf = vrf_lookup (vrf_id)) == NULL)
+        continue;
+      if (vrf_id)
+        vty_out (vty, "%-6u %-24s %-6u", vrf->id, vrf->name, vrf->id);
+      else
+        vty_out (vty, "%-6u %-24s %-6d", vrf->id, vrf->name,
+                 zebrad.rtm_table_default);
+      vty_out (vty, " %10lu %10lu %8u %12lu%s", vrf->rib_cnt[AFI_IP],
+               vrf->rib_cnt[AFI_IP6], vrf->mq->size, vrf->processed,
+               VTY_NEWLINE);
+    }
+  while (vrf_id_get_next (vrf_id, &vrf_id));
+
+  return CMD_SUCCESS;
+}
+
+DEFUN (show_zebra_nexthop_group,
+       show_zebra_nexthop_group_cmd,
+       "show zebra nexthop-group",
+       SHOW_STR
+       "Zebra information\n"
+       "Nexthop groups shared by routes\n")
+{
+  nhg_show (vty);
+  return CMD_SUCCESS;
+}
+
+#ifdef HAVE_NETLINK
+DEFUN (show_zebra_netlink,
+       show_zebra_netlink_cmd,
+       "show zebra netlink",
+       SHOW_STR
+       "Zebra information\n"
+       "Netlink listen socket statistics\n")
+{
+  kernel_netlink_show (vty);
+  return CMD_SUCCESS;
+}
+
+DEFUN (clear_zebra_netlink,
+       clear_zebra_netlink_cmd,
+       "clear zebra netlink",
+       CLEAR_STR
+       "Zebra information\n"
+       "Clear netlink listen socket statistics\n")
+{
+  kernel_netlink_clear ();
+  return CMD_SUCCESS;
+}
+#endif /* HAVE_NETLINK */
+
+#define RIB_QUEUE_CLASS_STR \
+  "Connected and kernel routes\n" \
+  "Static routes\n" \
+  "RIP, OSPF and IS-IS routes\n" \
+  "BGP routes\n" \
+  "Routes of other protocols\n"
+
+static struct meta_queue_class *
+rib_queue_class_lookup (const char *name)
+{
+  int i;
+
+  for (i = 0; i < MQ_SIZE; i++)
+    if (! strcmp (mq_class[i].name, name))
+      return &mq_class[i];
+  return NULL;
+}
+
+DEFUN (zebra_rib_queue,
+       zebra_rib_queue_cmd,
+       "zebra rib-queue (connected|static|igp|bgp|other) weight <1-1000> "
+       "target <1-600000>",
+       "Zebra configuration\n"
+       "RIB queue scheduling\n"
+       RIB_QUEUE_CLASS_STR
+       "Route nodes to process in each turn\n"
+       "Route nodes\n"
+       "Latency target\n"
+       "Milliseconds\n")
+{
+  struct meta_queue_class *class = rib_queue_class_lookup (argv[0]);
+
+  VTY_GET_INTEGER_RANGE ("weight", class->weight, argv[1], 1, MQ_WEIGHT_MAX);
+  VTY_GET_INTEGER_RANGE ("target", class->target, argv[2], 1, MQ_TARGET_MAX);
+  return CMD_SUCCESS;
+}
+
+DEFUN (no_zebra_rib_queue,
+       no_zebra_rib_queue_cmd,
+       "no zebra rib-queue (connected|static|igp|bgp|other)",
+       NO_STR
+       "Zebra configuration\n"
+       "RIB queue scheduling\n"
+       RIB_QUEUE_CLASS_STR)
+{
+  struct meta_queue_class *class = rib_queue_class_lookup (argv[0]);
+
+  class->weight = mq_class_default[class - mq_class].weight;
+  class->target = mq_class_default[class - mq_class].target;
+  return CMD_SUCCESS;
+}
+
+ALIAS (no_zebra_rib_queue,
+       no_zebra_rib_queue_weight_cmd,
+       "no zebra rib-queue (connected|static|igp|bgp|other) weight <1-1000> "
+       "target <1-600000>",
+       NO_STR
+       "Zebra configuration\n"
+       "RIB queue scheduling\n"
+       RIB_QUEUE_CLASS_STR
+       "Route nodes to process in each turn\n"
+       "Route nodes\n"
+       "Latency target\n"
+       "Milliseconds\n")
+
+DEFUN (clear_zebra_rib_queue,
+       clear_zebra_rib_queue_cmd,
+       "clear zebra rib-queue",
+       CLEAR_STR
+       "Zebra information\n"
+       "Clear RIB queue statistics\n")
+{
+  int i;
+
+  for (i = 0; i < MQ_SIZE; i++)
+    {
+      mq_class[i].processed = mq_class[i].promoted = mq_class[i].late = 0;
+      mq_class[i].wait_total = 0;
+      mq_class[i].wait_max = 0;
+    }
+  return CMD_SUCCESS;
+}
+
 /* Write IPv4 static route configuration. */
 static int
 static_config_ipv4 (struct vty *vty, safi_t safi, const char *cmd)
@@ -1996,19 +2163,15 @@ vty_show_ipv6_route (struct vty *vty, struct route_node *rn,
     }
 }
 
-DEFUN (show_ipv6_route,
-       show_ipv6_route_cmd,
-       "show ipv6 route",
-       SHOW_STR
-       IP_STR
-       "IPv6 routing table\n")
+static int
+do_show_ipv6_route (struct vty *vty, u_int32_t vrf_id)
 {
   struct route_table *table;
   struct route_node *rn;
   struct rib *rib;
   int first = 1;
 
-  table = vrf_table (AFI_IP6, SAFI_UNICAST, 0);
+  table = vrf_table (AFI_IP6, SAFI_UNICAST, vrf_id);
   if (! table)
     return CMD_SUCCESS;
 
@@ -2026,6 +2189,31 @@ DEFUN (show_ipv6_route,
   return CMD_SUCCESS;
 }
 
+DEFUN (show_ipv6_route,
+       show_ipv6_route_cmd,
+       "show ipv6 route",
+       SHOW_STR
+       IP_STR
+       "IPv6 routing table\n")
+{
+  return do_show_ipv6_route (vty, 0);
+}
+
+DEFUN (show_ipv6_route_vrf,
+       show_ipv6_route_vrf_cmd,
+       "show ipv6 route vrf <1-65535>",
+       SHOW_STR
+       IP_STR
+       "IPv6 routing table\n"
+       "Routing table of a VRF\n"
+       "VRF id\n")
+{
+  u_int32_t vrf_id;
+
+  VTY_GET_INTEGER_RANGE ("VRF id", vrf_id, argv[0], 1, VRF_ID_MAX);
+  return do_show_ipv6_route (vty, vrf_id);
+}
+
 DEFUN (show_ipv6_route_prefix_longer,
        show_ipv6_route_prefix_longer_cmd,
        "show ipv6 route X:X::X:X/M longer-prefixes",
@@ -2355,6 +2543,13 @@ static int config_write_vty(struct vty *vty)
       vty_out (vty, "ip protocol %s route-map %s%s", "any",
                proto_rm[AFI_IP][ZEBRA_ROUTE_MAX], VTY_NEWLINE);
 
+  for (i = 0; i < MQ_SIZE; i++)
+    if (mq_class[i].weight != mq_class_default[i].weight
+        || mq_class[i].target != mq_class_default[i].target)
+      vty_out (vty, "zebra rib-queue %s weight %u target %u%s",
+               mq_class[i].name, mq_class[i].weight, mq_class[i].target,
+               VTY_NEWLINE);
+
   return 1;
 }   
 
@@ -2422,6 +2617,21 @@ zebra_vty_init (void)
   install_element (ENABLE_NODE, &show_ip_route_supernets_cmd);
   install_element (ENABLE_NODE, &show_ip_route_summary_cmd);
   install_element (ENABLE_NODE, &show_ip_route_summary_prefix_cmd);
+  install_element (VIEW_NODE, &show_ip_route_vrf_cmd);
+  install_element (ENABLE_NODE, &show_ip_route_vrf_cmd);
+  install_element (VIEW_NODE, &show_zebra_vrf_cmd);
+  install_element (ENABLE_NODE, &show_zebra_vrf_cmd);
+  install_element (VIEW_NODE, &show_zebra_nexthop_group_cmd);
+  install_element (ENABLE_NODE, &show_zebra_nexthop_group_cmd);
+#ifdef HAVE_NETLINK
+  install_element (VIEW_NODE, &show_zebra_netlink_cmd);
+  install_element (ENABLE_NODE, &show_zebra_netlink_cmd);
+  install_element (ENABLE_NODE, &clear_zebra_netlink_cmd);
+#endif /* HAVE_NETLINK */
+  install_element (CONFIG_NODE, &zebra_rib_queue_cmd);
+  install_element (CONFIG_NODE, &no_zebra_rib_queue_cmd);
+  install_element (CONFIG_NODE, &no_zebra_rib_queue_weight_cmd);
+  install_element (ENABLE_NODE, &clear_zebra_rib_queue_cmd);
 
   install_element (VIEW_NODE, &show_ip_mroute_cmd);
   install_element (ENABLE_NODE, &show_ip_mroute_cmd);
@@ -2462,6 +2672,8 @@ zebra_vty_init (void)
   install_element (ENABLE_NODE, &show_ipv6_route_prefix_longer_cmd);
   install_element (ENABLE_NODE, &show_ipv6_route_summary_cmd);
   install_element (ENABLE_NODE, &show_ipv6_route_summary_prefix_cmd);
+  install_element (VIEW_NODE, &show_ipv6_route_vrf_cmd);
+  install_element (ENABLE_NODE, &show_ipv6_route_vrf_cmd);
 
   install_element (VIEW_NODE, &show_ipv6_mroute_cmd);
   install_element (ENABLE_NODE, &show_ipv6_mroute_cmd);
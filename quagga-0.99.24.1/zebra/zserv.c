@@ -36,6 +36,7 @@
 #include "privs.h"
 #include "network.h"
 #include "buffer.h"
+#include "zring.h"
 
 #include "zebra/zserv.h"
 #include "zebra/router-id.h"
@@ -73,10 +74,231 @@ zserv_delayed_close(struct thread *thread)
  */
 static int route_type_oaths[ZEBRA_ROUTE_MAX];
 
+/* Route updates for a client whose socket is backed up are held in a
+ * per-client table, one entry per prefix and route type, rather than
+ * appended to its write buffer.  A later update for the same route
+ * replaces the queued message, so churn while the client is not reading
+ * costs at most one message per route, and an add, delete and add again
+ * reaches the client as the final add.  The queue drains in the order
+ * routes were first queued once the write buffer empties.
+ *
+ * Other messages, interface and address updates, router-id and lookup
+ * replies, join the same queue while it is not empty, so none overtakes
+ * a route update queued before it.  They are not coalesced, and a route
+ * update replacing one queued before such a message moves behind it.
+ */
+struct zserv_pending
+{
+  /* Other route types and VRFs queued for the same prefix.  rn is NULL
+     for a message other than a route update. */
+  struct zserv_pending *next;
+  struct route_node *rn;
+
+  /* Position in the client's pending_fifo, and order of queueing. */
+  struct listnode *fifo;
+  u_int32_t seq;
+
+  /* When the route was first queued. */
+  struct timeval queued;
+
+  u_char type;
+  u_int32_t vrf_id;
+  u_int16_t len;
+  u_char *data;
+};
+
+/* Queued bytes above which a client is disconnected, 0 for no limit. */
+static unsigned long zserv_queue_limit;
+
+/* Bytes moved from the queue to the write buffer per write event. */
+#define ZSERV_PENDING_FLUSH   65536
+
+static int zserv_flush_data (struct thread *);
+static int zebra_server_send_message (struct zserv *);
+
+static unsigned long
+zserv_pending_size (struct zserv_pending *zp)
+{
+  return sizeof (struct zserv_pending) + zp->len;
+}
+
+static void
+zserv_pending_free (struct zserv *client, struct zserv_pending *zp)
+{
+  struct zserv_pending **prev;
+
+  if (zp->rn)
+    {
+      for (prev = (struct zserv_pending **) &zp->rn->info; *prev;
+           prev = &(*prev)->next)
+        if (*prev == zp)
+          {
+            *prev = zp->next;
+            break;
+          }
+      route_unlock_node (zp->rn);
+    }
+  list_delete_node (client->pending_fifo, zp->fifo);
+
+  client->pending_bytes -= zserv_pending_size (zp);
+  XFREE (MTYPE_ZSERV_PENDING, zp->data);
+  XFREE (MTYPE_ZSERV_PENDING, zp);
+
+  /* Order is only compared among queued messages. */
+  if (! listhead (client->pending_fifo))
+    client->pending_seq = client->pending_barrier = 0;
+}
+
+static void
+zserv_pending_clear (struct zserv *client)
+{
+  while (listhead (client->pending_fifo))
+    zserv_pending_free (client, listgetdata (listhead (client->pending_fifo)));
+}
+
+/* Put ZP at the end of the queue. */
+static void
+zserv_pending_append (struct zserv *client, struct zserv_pending *zp)
+{
+  listnode_add (client->pending_fifo, zp);
+  zp->fifo = listtail (client->pending_fifo);
+  zp->seq = ++client->pending_seq;
+  if (listcount (client->pending_fifo) > client->pending_max)
+    client->pending_max = listcount (client->pending_fifo);
+}
+
+/* Copy the message in client->obuf into ZP, and disconnect the client
+   if that takes its queue over the limit. */
+static int
+zserv_pending_store (struct zserv *client, struct zserv_pending *zp)
+{
+  u_int16_t len = stream_get_endp (client->obuf);
+
+  zp->data = XREALLOC (MTYPE_ZSERV_PENDING, zp->data, len);
+  memcpy (zp->data, STREAM_DATA (client->obuf), len);
+  zp->len = len;
+  client->pending_bytes += zserv_pending_size (zp);
+
+  if (zserv_queue_limit && client->pending_bytes > zserv_queue_limit)
+    {
+      zlog_warn ("%s: zserv client fd %d has %lu bytes of updates "
+                 "(%u messages) pending, over the limit of %lu, closing",
+                 __func__, client->sock, client->pending_bytes,
+                 listcount (client->pending_fifo), zserv_queue_limit);
+      zserv_pending_clear (client);
+      THREAD_OFF (client->t_write);
+      client->t_suicide = thread_add_event (zebrad.master, zserv_delayed_close,
+                                            client, 0);
+      return -1;
+    }
+
+  THREAD_WRITE_ON (zebrad.master, client->t_write,
+                   zserv_flush_data, client, client->sock);
+  return 0;
+}
+
+/* Queue the message in client->obuf, other than a route update, behind
+   those waiting to be sent. */
+static int
+zserv_pending_message (struct zserv *client)
+{
+  struct zserv_pending *zp;
+
+  zp = XCALLOC (MTYPE_ZSERV_PENDING, sizeof (struct zserv_pending));
+  zp->queued = recent_relative_time ();
+  zserv_pending_append (client, zp);
+  client->pending_barrier = zp->seq;
+  return zserv_pending_store (client, zp);
+}
+
+/* Queue the route message in client->obuf, replacing any update for the
+   same prefix, route type and VRF still waiting to be sent. */
+static int
+zserv_pending_add (struct zserv *client, struct prefix *p, u_char type,
+                   u_int32_t vrf_id)
+{
+  struct route_table *table;
+  struct route_node *rn;
+  struct zserv_pending *zp;
+
+  if ((table = client->pending[family2afi (p->family)]) == NULL)
+    return zebra_server_send_message (client);
+
+  rn = route_node_get (table, p);
+  for (zp = rn->info; zp; zp = zp->next)
+    if (zp->type == type && zp->vrf_id == vrf_id)
+      break;
+
+  if (zp)
+    {
+      route_unlock_node (rn);
+      client->pending_bytes -= zserv_pending_size (zp);
+      client->pending_coalesced++;
+
+      /* Not ahead of a message queued after the update it replaces. */
+      if (zp->seq < client->pending_barrier)
+        {
+          list_delete_node (client->pending_fifo, zp->fifo);
+          zserv_pending_append (client, zp);
+        }
+    }
+  else
+    {
+      zp = XCALLOC (MTYPE_ZSERV_PENDING, sizeof (struct zserv_pending));
+      zp->rn = rn;
+      zp->type = type;
+      zp->vrf_id = vrf_id;
+      zp->queued = recent_relative_time ();
+      zp->next = rn->info;
+      rn->info = zp;
+      zserv_pending_append (client, zp);
+    }
+
+  client->pending_queued++;
+  return zserv_pending_store (client, zp);
+}
+
+/* Move the oldest queued updates into the empty write buffer and write
+   what the socket takes. */
+static buffer_status_t
+zserv_pending_flush (struct zserv *client)
+{
+  struct zserv_pending *zp;
+  unsigned long size = 0;
+  buffer_status_t status;
+
+  while (size < ZSERV_PENDING_FLUSH && listhead (client->pending_fifo))
+    {
+      zp = listgetdata (listhead (client->pending_fifo));
+      buffer_put (client->wb, zp->data, zp->len);
+      size += zp->len;
+      zserv_pending_free (client, zp);
+    }
+
+  status = buffer_flush_available (client->wb, client->sock);
+  if (status == BUFFER_EMPTY && listhead (client->pending_fifo))
+    status = BUFFER_PENDING;
+  return status;
+}
+
+/* Send the route message in client->obuf now if nothing is waiting to be
+   written to the client, or queue it otherwise. */
+static int
+zserv_route_send (struct zserv *client, struct prefix *p, u_char type,
+                  u_int32_t vrf_id)
+{
+  if (client->t_suicide)
+    return -1;
+  if (! listhead (client->pending_fifo) && buffer_empty (client->wb))
+    return zebra_server_send_message (client);
+  return zserv_pending_add (client, p, type, vrf_id);
+}
+
 static int
 zserv_flush_data(struct thread *thread)
 {
   struct zserv *client = THREAD_ARG(thread);
+  buffer_status_t status;
 
   client->t_write = NULL;
   if (client->t_suicide)
@@ -84,7 +306,10 @@ zserv_flush_data(struct thread *thread)
       zebra_client_close(client);
       return -1;
     }
-  switch (buffer_flush_available(client->wb, client->sock))
+  status = buffer_flush_available(client->wb, client->sock);
+  if (status == BUFFER_EMPTY && listhead (client->pending_fifo))
+    status = zserv_pending_flush (client);
+  switch (status)
     {
     case BUFFER_ERROR:
       zlog_warn("%s: buffer_flush_available failed on zserv client fd %d, "
@@ -96,6 +321,7 @@ zserv_flush_data(struct thread *thread)
       					 client, client->sock);
       break;
     case BUFFER_EMPTY:
+      zebra_redistribute_resume (client);
       break;
     }
   return 0;
@@ -106,6 +332,8 @@ zebra_server_send_message(struct zserv *client)
 {
   if (client->t_suicide)
     return -1;
+  if (listhead (client->pending_fifo))
+    return zserv_pending_message (client);
   switch (buffer_write(client->wb, client->sock, STREAM_DATA(client->obuf),
 		       stream_get_endp(client->obuf)))
     {
@@ -120,8 +348,13 @@ zebra_server_send_message(struct zserv *client)
 					   client, 0);
       return -1;
     case BUFFER_EMPTY:
-      THREAD_OFF(client->t_write);
-      break;
+      if (! listhead (client->pending_fifo))
+        {
+          THREAD_OFF(client->t_write);
+          zebra_redistribute_resume (client);
+          break;
+        }
+      /* Fall through, queued route updates are still to be sent. */
     case BUFFER_PENDING:
       THREAD_WRITE_ON(zebrad.master, client->t_write,
 		      zserv_flush_data, client, client->sock);
@@ -140,6 +373,23 @@ zserv_create_header (struct stream *s, uint16_t cmd)
   stream_putw (s, cmd);
 }
 
+/* Header for a message about a VRF other than the default. */
+static void
+zserv_create_header_vrf (struct stream *s, uint16_t cmd, u_int32_t vrf_id)
+{
+  if (! vrf_id)
+    {
+      zserv_create_header (s, cmd);
+      return;
+    }
+
+  stream_putw (s, ZEBRA_VRF_HEADER_SIZE);
+  stream_putc (s, ZEBRA_HEADER_MARKER);
+  stream_putc (s, ZSERV_VERSION_VRF);
+  stream_putw (s, cmd);
+  stream_putw (s, vrf_id);
+}
+
 static void
 zserv_encode_interface (struct stream *s, struct interface *ifp)
 {
@@ -362,7 +612,9 @@ zsend_route_multipath (int cmd, struct zserv *client, struct prefix *p,
   s = client->obuf;
   stream_reset (s);
   
-  zserv_create_header (s, cmd);
+  /* Only clients that subscribed in a VRF are sent its routes, so they
+     understand the VRF header. */
+  zserv_create_header_vrf (s, cmd, rib->vrf_id);
   
   /* Put type and nexthop. */
   stream_putc (s, rib->type);
@@ -459,7 +711,7 @@ zsend_route_multipath (int cmd, struct zserv *client, struct prefix *p,
   /* Write packet size. */
   stream_putw_at (s, 0, stream_get_endp (s));
 
-  return zebra_server_send_message(client);
+  return zserv_route_send (client, p, rib->type, rib->vrf_id);
 }
 
 #ifdef HAVE_IPV6
@@ -805,10 +1057,12 @@ zread_interface_delete (struct zserv *client, u_short length)
 /* This function support multiple nexthop. */
 /* 
  * Parse the ZEBRA_IPV4_ROUTE_ADD sent from client. Update rib and
- * add kernel route. 
+ * add kernel route.  If bulk is non-NULL, the attributes come from a
+ * ZEBRA_ROUTE_BULK message, which carries the prefix separately.
  */
 static int
-zread_ipv4_add (struct zserv *client, u_short length)
+zread_ipv4_add (struct zserv *client, u_short length,
+                struct prefix_ipv4 *bulk)
 {
   int i;
   struct rib *rib;
@@ -839,8 +1093,13 @@ zread_ipv4_add (struct zserv *client, u_short length)
   /* IPv4 prefix. */
   memset (&p, 0, sizeof (struct prefix_ipv4));
   p.family = AF_INET;
-  p.prefixlen = stream_getc (s);
-  stream_get (&p.prefix, s, PSIZE (p.prefixlen));
+  if (bulk)
+    p = *bulk;
+  else
+    {
+      p.prefixlen = stream_getc (s);
+      stream_get (&p.prefix, s, PSIZE (p.prefixlen));
+    }
 
   /* Nexthop parse. */
   if (CHECK_FLAG (message, ZAPI_MESSAGE_NEXTHOP))
@@ -890,13 +1149,15 @@ zread_ipv4_add (struct zserv *client, u_short length)
     
   /* Table */
   rib->table=zebrad.rtm_table_default;
+  rib->vrf_id = client->vrf_id;
   rib_add_ipv4_multipath (&p, rib, safi);
   return 0;
 }
 
 /* Zebra server IPv4 prefix delete function. */
 static int
-zread_ipv4_delete (struct zserv *client, u_short length)
+zread_ipv4_delete (struct zserv *client, u_short length,
+                   struct prefix_ipv4 *bulk)
 {
   int i;
   struct stream *s;
@@ -922,8 +1183,13 @@ zread_ipv4_delete (struct zserv *client, u_short length)
   /* IPv4 prefix. */
   memset (&p, 0, sizeof (struct prefix_ipv4));
   p.family = AF_INET;
-  p.prefixlen = stream_getc (s);
-  stream_get (&p.prefix, s, PSIZE (p.prefixlen));
+  if (bulk)
+    p = *bulk;
+  else
+    {
+      p.prefixlen = stream_getc (s);
+      stream_get (&p.prefix, s, PSIZE (p.prefixlen));
+    }
 
   /* Nexthop, ifindex, distance, metric. */
   if (CHECK_FLAG (api.message, ZAPI_MESSAGE_NEXTHOP))
@@ -972,7 +1238,7 @@ zread_ipv4_delete (struct zserv *client, u_short length)
     api.metric = 0;
     
   rib_delete_ipv4 (api.type, api.flags, &p, nexthop_p, ifindex,
-		   client->rtm_table, api.safi);
+		   client->rtm_table, client->vrf_id, api.safi);
   return 0;
 }
 
@@ -1018,7 +1284,8 @@ zread_ipv4_import_lookup (struct zserv *client, u_short length)
 #ifdef HAVE_IPV6
 /* Zebra server IPv6 prefix add function. */
 static int
-zread_ipv6_add (struct zserv *client, u_short length)
+zread_ipv6_add (struct zserv *client, u_short length,
+                struct prefix_ipv6 *bulk)
 {
   int i;
   struct stream *s;
@@ -1037,11 +1304,16 @@ zread_ipv6_add (struct zserv *client, u_short length)
   api.message = stream_getc (s);
   api.safi = stream_getw (s);
 
-  /* IPv4 prefix. */
+  /* IPv6 prefix. */
   memset (&p, 0, sizeof (struct prefix_ipv6));
   p.family = AF_INET6;
-  p.prefixlen = stream_getc (s);
-  stream_get (&p.prefix, s, PSIZE (p.prefixlen));
+  if (bulk)
+    p = *bulk;
+  else
+    {
+      p.prefixlen = stream_getc (s);
+      stream_get (&p.prefix, s, PSIZE (p.prefixlen));
+    }
 
   /* Nexthop, ifindex, distance, metric. */
   if (CHECK_FLAG (api.message, ZAPI_MESSAGE_NEXTHOP))
@@ -1076,17 +1348,20 @@ zread_ipv6_add (struct zserv *client, u_short length)
     api.metric = 0;
     
   if (IN6_IS_ADDR_UNSPECIFIED (&nexthop))
-    rib_add_ipv6 (api.type, api.flags, &p, NULL, ifindex, zebrad.rtm_table_default, api.metric,
+    rib_add_ipv6 (api.type, api.flags, &p, NULL, ifindex,
+		  zebrad.rtm_table_default, client->vrf_id, api.metric,
 		  api.distance, api.safi);
   else
-    rib_add_ipv6 (api.type, api.flags, &p, &nexthop, ifindex, zebrad.rtm_table_default, api.metric,
+    rib_add_ipv6 (api.type, api.flags, &p, &nexthop, ifindex,
+		  zebrad.rtm_table_default, client->vrf_id, api.metric,
 		  api.distance, api.safi);
   return 0;
 }
 
 /* Zebra server IPv6 prefix delete function. */
 static int
-zread_ipv6_delete (struct zserv *client, u_short length)
+zread_ipv6_delete (struct zserv *client, u_short length,
+                   struct prefix_ipv6 *bulk)
 {
   int i;
   struct stream *s;
@@ -1105,11 +1380,16 @@ zread_ipv6_delete (struct zserv *client, u_short length)
   api.message = stream_getc (s);
   api.safi = stream_getw (s);
 
-  /* IPv4 prefix. */
+  /* IPv6 prefix. */
   memset (&p, 0, sizeof (struct prefix_ipv6));
   p.family = AF_INET6;
-  p.prefixlen = stream_getc (s);
-  stream_get (&p.prefix, s, PSIZE (p.prefixlen));
+  if (bulk)
+    p = *bulk;
+  else
+    {
+      p.prefixlen = stream_getc (s);
+      stream_get (&p.prefix, s, PSIZE (p.prefixlen));
+    }
 
   /* Nexthop, ifindex, distance, metric. */
   if (CHECK_FLAG (api.message, ZAPI_MESSAGE_NEXTHOP))
@@ -1143,9 +1423,11 @@ zread_ipv6_delete (struct zserv *client, u_short length)
     api.metric = 0;
     
   if (IN6_IS_ADDR_UNSPECIFIED (&nexthop))
-    rib_delete_ipv6 (api.type, api.flags, &p, NULL, ifindex, client->rtm_table, api.safi);
+    rib_delete_ipv6 (api.type, api.flags, &p, NULL, ifindex,
+		     client->rtm_table, client->vrf_id, api.safi);
   else
-    rib_delete_ipv6 (api.type, api.flags, &p, &nexthop, ifindex, client->rtm_table, api.safi);
+    rib_delete_ipv6 (api.type, api.flags, &p, &nexthop, ifindex,
+		     client->rtm_table, client->vrf_id, api.safi);
   return 0;
 }
 
@@ -1164,6 +1446,368 @@ zread_ipv6_nexthop_lookup (struct zserv *client, u_short length)
 }
 #endif /* HAVE_IPV6 */
 
+/* Parse a ZEBRA_ROUTE_BULK message.  The shared attribute block is
+ * handed to the single route reader once per prefix, so every route is
+ * treated exactly as if it had arrived in its own message. */
+static int
+zread_route_bulk (struct zserv *client, u_short length)
+{
+  struct stream *s = client->ibuf;
+  u_char version;
+  uint16_t cmd, alen, count, i;
+  size_t attr, end;
+  int family, maxlen;
+  struct prefix p;
+
+  if (length < ZAPI_BULK_HEADER_SIZE)
+    goto malformed;
+
+  version = stream_getc (s);
+  cmd = stream_getw (s);
+  alen = stream_getw (s);
+  attr = stream_get_getp (s);
+  end = stream_get_endp (s);
+
+  if (! client->bulk_version || version != client->bulk_version)
+    {
+      zlog_warn ("%s: socket %d unexpected bulk version %d",
+                 __func__, client->sock, version);
+      return -1;
+    }
+
+  switch (cmd)
+    {
+    case ZEBRA_IPV4_ROUTE_ADD:
+    case ZEBRA_IPV4_ROUTE_DELETE:
+      family = AF_INET;
+      maxlen = IPV4_MAX_BITLEN;
+      break;
+#ifdef HAVE_IPV6
+    case ZEBRA_IPV6_ROUTE_ADD:
+    case ZEBRA_IPV6_ROUTE_DELETE:
+      family = AF_INET6;
+      maxlen = IPV6_MAX_BITLEN;
+      break;
+#endif /* HAVE_IPV6 */
+    default:
+      zlog_warn ("%s: socket %d unsupported bulk command %s",
+                 __func__, client->sock, zserv_command_string (cmd));
+      return -1;
+    }
+
+  if (attr + alen + 2 > end)
+    goto malformed;
+
+  stream_set_getp (s, attr + alen);
+  count = stream_getw (s);
+
+  if (IS_ZEBRA_DEBUG_PACKET && IS_ZEBRA_DEBUG_RECV)
+    zlog_debug ("zebra bulk %s with %u prefixes",
+                zserv_command_string (cmd), count);
+
+  client->bulk_msg_cnt++;
+
+  for (i = 0; i < count; i++)
+    {
+      size_t next;
+
+      memset (&p, 0, sizeof (struct prefix));
+      p.family = family;
+      if (stream_get_getp (s) >= end)
+        goto malformed;
+      p.prefixlen = stream_getc (s);
+      if (p.prefixlen > maxlen
+          || stream_get_getp (s) + PSIZE (p.prefixlen) > end)
+        goto malformed;
+      stream_get (&p.u.prefix, s, PSIZE (p.prefixlen));
+      next = stream_get_getp (s);
+
+      stream_set_getp (s, attr);
+      switch (cmd)
+        {
+        case ZEBRA_IPV4_ROUTE_ADD:
+          zread_ipv4_add (client, length, (struct prefix_ipv4 *) &p);
+          break;
+        case ZEBRA_IPV4_ROUTE_DELETE:
+          zread_ipv4_delete (client, length, (struct prefix_ipv4 *) &p);
+          break;
+#ifdef HAVE_IPV6
+        case ZEBRA_IPV6_ROUTE_ADD:
+          zread_ipv6_add (client, length, (struct prefix_ipv6 *) &p);
+          break;
+        case ZEBRA_IPV6_ROUTE_DELETE:
+          zread_ipv6_delete (client, length, (struct prefix_ipv6 *) &p);
+          break;
+#endif /* HAVE_IPV6 */
+        }
+      if (stream_get_getp (s) > attr + alen)
+        goto malformed;
+      stream_set_getp (s, next);
+      client->bulk_route_cnt++;
+    }
+  return 0;
+
+ malformed:
+  zlog_warn ("%s: socket %d malformed bulk message, length %u",
+             __func__, client->sock, length);
+  return -1;
+}
+
+#ifdef HAVE_ZEBRA_RING
+/* Close descriptors received with a message that did not use them. */
+static void
+zserv_ring_fds_close (struct zserv *client)
+{
+  int i;
+
+  for (i = 0; i < 2; i++)
+    if (client->ring_fds[i] >= 0)
+      {
+        close (client->ring_fds[i]);
+        client->ring_fds[i] = -1;
+      }
+}
+
+/* Apply one route record from a client's shared-memory ring.  The
+   record is copied out first, since the client can still write to it. */
+static void
+zserv_ring_route (struct zserv *client, struct zring_route *shared)
+{
+  struct zring_route r;
+  struct rib *rib;
+  struct prefix_ipv4 p;
+  struct in_addr *nexthop;
+  unsigned int ifindex;
+#ifdef HAVE_IPV6
+  struct prefix_ipv6 p6;
+  struct in6_addr *nexthop6;
+#endif /* HAVE_IPV6 */
+  int i;
+
+  r = *shared;
+
+  if (r.nexthop_num > ZRING_NEXTHOP_MAX)
+    goto bad;
+  if (! CHECK_FLAG (r.message, ZAPI_MESSAGE_DISTANCE))
+    r.distance = 0;
+  if (! CHECK_FLAG (r.message, ZAPI_MESSAGE_METRIC))
+    r.metric = 0;
+
+  switch (r.cmd)
+    {
+    case ZEBRA_IPV4_ROUTE_ADD:
+    case ZEBRA_IPV4_ROUTE_DELETE:
+      if (r.prefixlen > IPV4_MAX_PREFIXLEN)
+        goto bad;
+      memset (&p, 0, sizeof (struct prefix_ipv4));
+      p.family = AF_INET;
+      p.prefixlen = r.prefixlen;
+      memcpy (&p.prefix, &r.prefix, PSIZE (r.prefixlen));
+      break;
+#ifdef HAVE_IPV6
+    case ZEBRA_IPV6_ROUTE_ADD:
+    case ZEBRA_IPV6_ROUTE_DELETE:
+      if (r.prefixlen > IPV6_MAX_PREFIXLEN)
+        goto bad;
+      memset (&p6, 0, sizeof (struct prefix_ipv6));
+      p6.family = AF_INET6;
+      p6.prefixlen = r.prefixlen;
+      memcpy (&p6.prefix, &r.prefix, PSIZE (r.prefixlen));
+      break;
+#endif /* HAVE_IPV6 */
+    default:
+      goto bad;
+    }
+
+  client->ring_route_cnt++;
+
+  /* The same semantics as zread_ipv4_add() and friends. */
+  switch (r.cmd)
+    {
+    case ZEBRA_IPV4_ROUTE_ADD:
+      rib = XCALLOC (MTYPE_RIB, sizeof (struct rib));
+      rib->type = r.type;
+      rib->flags = r.flags;
+      rib->uptime = time (NULL);
+      for (i = 0; i < r.nexthop_num; i++)
+        switch (r.nexthop[i].type)
+          {
+          case ZEBRA_NEXTHOP_IFINDEX:
+            nexthop_ifindex_add (rib, r.nexthop[i].ifindex);
+            break;
+          case ZEBRA_NEXTHOP_IPV4:
+            nexthop_ipv4_add (rib, &r.nexthop[i].gate.ipv4, NULL);
+            break;
+          case ZEBRA_NEXTHOP_BLACKHOLE:
+            nexthop_blackhole_add (rib);
+            break;
+          }
+      rib->distance = r.distance;
+      rib->metric = r.metric;
+      rib->table = zebrad.rtm_table_default;
+      rib_add_ipv4_multipath (&p, rib, r.safi);
+      break;
+    case ZEBRA_IPV4_ROUTE_DELETE:
+      nexthop = NULL;
+      ifindex = 0;
+      for (i = 0; i < r.nexthop_num; i++)
+        switch (r.nexthop[i].type)
+          {
+          case ZEBRA_NEXTHOP_IFINDEX:
+            ifindex = r.nexthop[i].ifindex;
+            break;
+          case ZEBRA_NEXTHOP_IPV4:
+            nexthop = &r.nexthop[i].gate.ipv4;
+            break;
+          }
+      rib_delete_ipv4 (r.type, r.flags, &p, nexthop, ifindex,
+                       client->rtm_table, 0, r.safi);
+      break;
+#ifdef HAVE_IPV6
+    case ZEBRA_IPV6_ROUTE_ADD:
+    case ZEBRA_IPV6_ROUTE_DELETE:
+      nexthop6 = NULL;
+      ifindex = 0;
+      for (i = 0; i < r.nexthop_num; i++)
+        switch (r.nexthop[i].type)
+          {
+          case ZEBRA_NEXTHOP_IFINDEX:
+            ifindex = r.nexthop[i].ifindex;
+            break;
+          case ZEBRA_NEXTHOP_IPV6:
+            nexthop6 = &r.nexthop[i].gate.ipv6;
+            break;
+          }
+      if (nexthop6 && IN6_IS_ADDR_UNSPECIFIED (nexthop6))
+        nexthop6 = NULL;
+      if (r.cmd == ZEBRA_IPV6_ROUTE_ADD)
+        rib_add_ipv6 (r.type, r.flags, &p6, nexthop6, ifindex,
+                      zebrad.rtm_table_default, 0, r.metric, r.distance,
+                      r.safi);
+      else
+        rib_delete_ipv6 (r.type, r.flags, &p6, nexthop6, ifindex,
+                         client->rtm_table, 0, r.safi);
+      break;
+#endif /* HAVE_IPV6 */
+    }
+  return;
+
+ bad:
+  zlog_warn ("%s: socket %d malformed ring record, command %d, "
+             "prefix length %d, %d nexthops", __func__, client->sock,
+             r.cmd, r.prefixlen, r.nexthop_num);
+}
+
+/* Apply every ring record the client wrote before its socket messages
+   that have not been read yet. */
+static void
+zserv_ring_drain (struct zserv *client)
+{
+  struct zring_route *rec;
+
+  if (! client->ring)
+    return;
+
+  while ((rec = zring_peek (client->ring)) != NULL)
+    {
+      /* Signed difference, as both counters wrap. */
+      if ((int32_t) (rec->seq - client->msg_read) > 0)
+        break;
+      zserv_ring_route (client, rec);
+      zring_release (client->ring);
+    }
+}
+
+/* The client rang the ring's doorbell. */
+static int
+zserv_ring_read (struct thread *thread)
+{
+  struct zserv *client = THREAD_ARG (thread);
+
+  client->t_ring = NULL;
+  if (zring_doorbell_clear (client->ring) < 0)
+    {
+      zlog_warn ("%s: socket %d doorbell read failed: %s", __func__,
+                 client->sock, safe_strerror (errno));
+      /* Routes left in the ring would never be read. */
+      zebra_client_close (client);
+      return -1;
+    }
+
+  zserv_ring_drain (client);
+
+  client->t_ring = thread_add_read (zebrad.master, zserv_ring_read, client,
+                                    client->ring->doorbell);
+  return 0;
+}
+#endif /* HAVE_ZEBRA_RING */
+
+/* Accept the shared-memory route ring whose descriptors came with a
+ * ZEBRA_ROUTE_RING message:
+ *
+ * +-+-+-+-+-+-+-+-+
+ * | Ring version  |  plus SCM_RIGHTS {ring memfd, doorbell eventfd}
+ * +-+-+-+-+-+-+-+-+
+ */
+static int
+zread_route_ring (struct zserv *client, u_short length)
+{
+#ifdef HAVE_ZEBRA_RING
+  u_char version;
+
+  if (length < 1)
+    return -1;
+  version = stream_getc (client->ibuf);
+
+  if (version != ZRING_VERSION || client->ring
+      || client->ring_fds[0] < 0 || client->ring_fds[1] < 0)
+    {
+      zlog_warn ("%s: socket %d unexpected route ring version %d",
+                 __func__, client->sock, version);
+      return -1;
+    }
+
+  client->ring = zring_attach (client->ring_fds[0], client->ring_fds[1]);
+  client->ring_fds[0] = client->ring_fds[1] = -1;
+  if (! client->ring)
+    return -1;
+
+  client->t_ring = thread_add_read (zebrad.master, zserv_ring_read, client,
+                                    client->ring->doorbell);
+
+  if (IS_ZEBRA_DEBUG_EVENT)
+    zlog_debug ("zebra route ring of %u slots from socket [%d]",
+                client->ring->slots, client->sock);
+  return 0;
+#else
+  zlog_warn ("%s: socket %d route ring is not supported",
+             __func__, client->sock);
+  return -1;
+#endif /* HAVE_ZEBRA_RING */
+}
+
+/* Tell the client which ZEBRA_ROUTE_BULK version we accept from it,
+   and which route ring version we support, 0 if none. */
+static int
+zsend_hello (struct zserv *client)
+{
+  struct stream *s;
+
+  s = client->obuf;
+  stream_reset (s);
+
+  zserv_create_header (s, ZEBRA_HELLO);
+  stream_putc (s, client->bulk_version);
+#ifdef HAVE_ZEBRA_RING
+  stream_putc (s, ZRING_VERSION);
+#else
+  stream_putc (s, 0);
+#endif /* HAVE_ZEBRA_RING */
+  stream_putw_at (s, 0, stream_get_endp (s));
+
+  return zebra_server_send_message (client);
+}
+
 /* Register zebra server router-id information.  Send current router-id */
 static int
 zread_router_id_add (struct zserv *client, u_short length)
@@ -1188,12 +1832,21 @@ zread_router_id_delete (struct zserv *client, u_short length)
 
 /* Tie up route-type and client->sock */
 static void
-zread_hello (struct zserv *client)
+zread_hello (struct zserv *client, u_short length)
 {
   /* type of protocol (lib/zebra.h) */
   u_char proto;
+  u_char version;
   proto = stream_getc (client->ibuf);
 
+  /* Newer clients append the highest bulk route version they speak. */
+  if (length > 1)
+    {
+      version = stream_getc (client->ibuf);
+      client->bulk_version = MIN (version, ZAPI_BULK_VERSION);
+      zsend_hello (client);
+    }
+
   /* accept only dynamic routing protocols */
   if ((proto < ZEBRA_ROUTE_MAX)
   &&  (proto > ZEBRA_ROUTE_STATIC))
@@ -1249,6 +1902,15 @@ zebra_client_close (struct zserv *client)
   if (client->wb)
     buffer_free(client->wb);
 
+  /* Free queued route updates and unfinished dumps. */
+  zebra_redistribute_stop (client);
+  list_delete (client->redist_dump);
+  vector_free (client->redist_vrf);
+  zserv_pending_clear (client);
+  list_delete (client->pending_fifo);
+  route_table_finish (client->pending[AFI_IP]);
+  route_table_finish (client->pending[AFI_IP6]);
+
   /* Release threads. */
   if (client->t_read)
     thread_cancel (client->t_read);
@@ -1257,6 +1919,14 @@ zebra_client_close (struct zserv *client)
   if (client->t_suicide)
     thread_cancel (client->t_suicide);
 
+#ifdef HAVE_ZEBRA_RING
+  if (client->t_ring)
+    thread_cancel (client->t_ring);
+  if (client->ring)
+    zring_free (client->ring);
+  zserv_ring_fds_close (client);
+#endif /* HAVE_ZEBRA_RING */
+
   /* Free client structure. */
   listnode_delete (zebrad.client_list, client);
   XFREE (0, client);
@@ -1275,10 +1945,18 @@ zebra_client_create (int sock)
   client->ibuf = stream_new (ZEBRA_MAX_PACKET_SIZ);
   client->obuf = stream_new (ZEBRA_MAX_PACKET_SIZ);
   client->wb = buffer_new(0);
+  client->pending[AFI_IP] = route_table_init ();
+  client->pending[AFI_IP6] = route_table_init ();
+  client->pending_fifo = list_new ();
+  client->redist_dump = list_new ();
+  client->redist_vrf = vector_init (1);
 
   /* Set table number. */
   client->rtm_table = zebrad.rtm_table_default;
 
+  /* No descriptors received yet. */
+  client->ring_fds[0] = client->ring_fds[1] = -1;
+
   /* Add this client to linked list. */
   listnode_add (zebrad.client_list, client);
   
@@ -1286,6 +1964,48 @@ zebra_client_create (int sock)
   zebra_event (ZEBRA_READ, sock, client);
 }
 
+/* Read (part of) a message header.  A ZEBRA_ROUTE_RING message passes
+   descriptors, which arrive with its first byte.  Returns as
+   stream_read_try(). */
+static ssize_t
+zserv_read_header (struct zserv *client, int sock, size_t size)
+{
+#ifdef HAVE_ZEBRA_RING
+  struct msghdr msg;
+  struct iovec iov;
+  struct cmsghdr *cmsg;
+  char cbuf[CMSG_SPACE (2 * sizeof (int))];
+  ssize_t nbyte;
+  int nfds, *fds, i;
+
+  memset (&msg, 0, sizeof (msg));
+  msg.msg_iov = &iov;
+  msg.msg_iovlen = 1;
+  msg.msg_control = cbuf;
+  msg.msg_controllen = sizeof (cbuf);
+
+  nbyte = stream_recvmsg (client->ibuf, sock, &msg, 0, size);
+  if (nbyte < 0)
+    return ERRNO_IO_RETRY (errno) ? -2 : -1;
+
+  for (cmsg = CMSG_FIRSTHDR (&msg); cmsg; cmsg = CMSG_NXTHDR (&msg, cmsg))
+    if (cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SCM_RIGHTS)
+      {
+        nfds = (cmsg->cmsg_len - CMSG_LEN (0)) / sizeof (int);
+        fds = (int *) CMSG_DATA (cmsg);
+        zserv_ring_fds_close (client);
+        for (i = 0; i < nfds; i++)
+          if (nfds == 2)
+            client->ring_fds[i] = fds[i];
+          else
+            close (fds[i]);
+      }
+  return nbyte;
+#else
+  return stream_read_try (client->ibuf, sock, size);
+#endif /* HAVE_ZEBRA_RING */
+}
+
 /* Handler of zebra service request. */
 static int
 zebra_client_read (struct thread *thread)
@@ -1295,6 +2015,7 @@ zebra_client_read (struct thread *thread)
   size_t already;
   uint16_t length, command;
   uint8_t marker, version;
+  int hdrsize;
 
   /* Get thread data.  Reset reading thread because I'm running. */
   sock = THREAD_FD (thread);
@@ -1311,8 +2032,8 @@ zebra_client_read (struct thread *thread)
   if ((already = stream_get_endp(client->ibuf)) < ZEBRA_HEADER_SIZE)
     {
       ssize_t nbyte;
-      if (((nbyte = stream_read_try (client->ibuf, sock,
-				     ZEBRA_HEADER_SIZE-already)) == 0) ||
+      if (((nbyte = zserv_read_header (client, sock,
+				       ZEBRA_HEADER_SIZE-already)) == 0) ||
 	  (nbyte == -1))
 	{
 	  if (IS_ZEBRA_DEBUG_EVENT)
@@ -1338,17 +2059,20 @@ zebra_client_read (struct thread *thread)
   version = stream_getc (client->ibuf);
   command = stream_getw (client->ibuf);
 
-  if (marker != ZEBRA_HEADER_MARKER || version != ZSERV_VERSION)
+  if (marker != ZEBRA_HEADER_MARKER
+      || (version != ZSERV_VERSION && version != ZSERV_VERSION_VRF))
     {
       zlog_err("%s: socket %d version mismatch, marker %d, version %d",
                __func__, sock, marker, version);
       zebra_client_close (client);
       return -1;
     }
-  if (length < ZEBRA_HEADER_SIZE) 
+  hdrsize = (version == ZSERV_VERSION_VRF
+             ? ZEBRA_VRF_HEADER_SIZE : ZEBRA_HEADER_SIZE);
+  if (length < hdrsize) 
     {
       zlog_warn("%s: socket %d message length %u is less than header size %d",
-	        __func__, sock, length, ZEBRA_HEADER_SIZE);
+	        __func__, sock, length, hdrsize);
       zebra_client_close (client);
       return -1;
     }
@@ -1381,7 +2105,11 @@ zebra_client_read (struct thread *thread)
 	}
     }
 
-  length -= ZEBRA_HEADER_SIZE;
+  /* The rest of the message is about this VRF. */
+  client->vrf_id = 0;
+  if (version == ZSERV_VERSION_VRF)
+    client->vrf_id = stream_getw (client->ibuf);
+  length -= hdrsize;
 
   /* Debug packet information. */
   if (IS_ZEBRA_DEBUG_EVENT)
@@ -1391,6 +2119,11 @@ zebra_client_read (struct thread *thread)
     zlog_debug ("zebra message received [%s] %d", 
 	       zserv_command_string (command), length);
 
+#ifdef HAVE_ZEBRA_RING
+  /* Ring records written before this message go first. */
+  zserv_ring_drain (client);
+#endif /* HAVE_ZEBRA_RING */
+
   switch (command) 
     {
     case ZEBRA_ROUTER_ID_ADD:
@@ -1406,19 +2139,25 @@ zebra_client_read (struct thread *thread)
       zread_interface_delete (client, length);
       break;
     case ZEBRA_IPV4_ROUTE_ADD:
-      zread_ipv4_add (client, length);
+      zread_ipv4_add (client, length, NULL);
       break;
     case ZEBRA_IPV4_ROUTE_DELETE:
-      zread_ipv4_delete (client, length);
+      zread_ipv4_delete (client, length, NULL);
       break;
 #ifdef HAVE_IPV6
     case ZEBRA_IPV6_ROUTE_ADD:
-      zread_ipv6_add (client, length);
+      zread_ipv6_add (client, length, NULL);
       break;
     case ZEBRA_IPV6_ROUTE_DELETE:
-      zread_ipv6_delete (client, length);
+      zread_ipv6_delete (client, length, NULL);
       break;
 #endif /* HAVE_IPV6 */
+    case ZEBRA_ROUTE_BULK:
+      zread_route_bulk (client, length);
+      break;
+    case ZEBRA_ROUTE_RING:
+      zread_route_ring (client, length);
+      break;
     case ZEBRA_REDISTRIBUTE_ADD:
       zebra_redistribute_add (command, client, length);
       break;
@@ -1446,13 +2185,22 @@ zebra_client_read (struct thread *thread)
       zread_ipv4_import_lookup (client, length);
       break;
     case ZEBRA_HELLO:
-      zread_hello (client);
+      zread_hello (client, length);
       break;
     default:
       zlog_info ("Zebra received unknown command %d", command);
       break;
     }
 
+#ifdef HAVE_ZEBRA_RING
+  /* Descriptors are only expected with ZEBRA_ROUTE_RING. */
+  zserv_ring_fds_close (client);
+
+  /* And ring records that were waiting for it can follow. */
+  client->msg_read++;
+  zserv_ring_drain (client);
+#endif /* HAVE_ZEBRA_RING */
+
   if (client->t_suicide)
     {
       /* No need to wait for thread callback, just kill immediately. */
@@ -1719,13 +2467,81 @@ DEFUN (show_zebra_client,
 {
   struct listnode *node;
   struct zserv *client;
+  struct zserv_pending *zp;
+  struct timeval now;
 
+  now = recent_relative_time ();
   for (ALL_LIST_ELEMENTS_RO (zebrad.client_list, node, client))
-    vty_out (vty, "Client fd %d%s", client->sock, VTY_NEWLINE);
+    {
+      vty_out (vty, "Client fd %d%s", client->sock, VTY_NEWLINE);
+      vty_out (vty, "  Pending messages %u (max %u), %lu bytes",
+               listcount (client->pending_fifo), client->pending_max,
+               client->pending_bytes);
+      if (listhead (client->pending_fifo))
+        {
+          zp = listgetdata (listhead (client->pending_fifo));
+          vty_out (vty, ", oldest %ld ms",
+                   (now.tv_sec - zp->queued.tv_sec) * 1000
+                   + (now.tv_usec - zp->queued.tv_usec) / 1000);
+        }
+      vty_out (vty, "%s", VTY_NEWLINE);
+      vty_out (vty, "  Queued %u route updates, %u coalesced%s",
+               client->pending_queued, client->pending_coalesced,
+               VTY_NEWLINE);
+      if (listcount (client->redist_dump))
+        vty_out (vty, "  Redistribution dump of %u route types in progress%s",
+                 listcount (client->redist_dump), VTY_NEWLINE);
+      if (client->bulk_version)
+        vty_out (vty, "  Bulk version %d, %u messages, %u routes%s",
+                 client->bulk_version, client->bulk_msg_cnt,
+                 client->bulk_route_cnt, VTY_NEWLINE);
+#ifdef HAVE_ZEBRA_RING
+      if (client->ring)
+        vty_out (vty, "  Route ring %u slots, %u pending, %u routes%s",
+                 client->ring->slots, ZRING_COUNT (client->ring),
+                 client->ring_route_cnt, VTY_NEWLINE);
+#endif /* HAVE_ZEBRA_RING */
+    }
   
   return CMD_SUCCESS;
 }
 
+DEFUN (zebra_client_queue_limit,
+       zebra_client_queue_limit_cmd,
+       "zebra client queue-limit <65536-1073741824>",
+       "Zebra information\n"
+       "Client information\n"
+       "Limit route updates queued for a client that is not reading\n"
+       "Bytes of queued updates before the client is disconnected\n")
+{
+  unsigned long limit;
+
+  VTY_GET_INTEGER_RANGE ("queue limit", limit, argv[0], 65536, 1073741824);
+  zserv_queue_limit = limit;
+  return CMD_SUCCESS;
+}
+
+DEFUN (no_zebra_client_queue_limit,
+       no_zebra_client_queue_limit_cmd,
+       "no zebra client queue-limit",
+       NO_STR
+       "Zebra information\n"
+       "Client information\n"
+       "Limit route updates queued for a client that is not reading\n")
+{
+  zserv_queue_limit = 0;
+  return CMD_SUCCESS;
+}
+
+ALIAS (no_zebra_client_queue_limit,
+       no_zebra_client_queue_limit_val_cmd,
+       "no zebra client queue-limit <65536-1073741824>",
+       NO_STR
+       "Zebra information\n"
+       "Client information\n"
+       "Limit route updates queued for a client that is not reading\n"
+       "Bytes of queued updates before the client is disconnected\n")
+
 /* Table configuration write function. */
 static int
 config_write_table (struct vty *vty)
@@ -1733,6 +2549,9 @@ config_write_table (struct vty *vty)
   if (zebrad.rtm_table_default)
     vty_out (vty, "table %d%s", zebrad.rtm_table_default,
 	     VTY_NEWLINE);
+  if (zserv_queue_limit)
+    vty_out (vty, "zebra client queue-limit %lu%s", zserv_queue_limit,
+             VTY_NEWLINE);
   return 0;
 }
 
@@ -1881,6 +2700,9 @@ zebra_init (void)
   install_element (CONFIG_NODE, &ip_forwarding_cmd);
   install_element (CONFIG_NODE, &no_ip_forwarding_cmd);
   install_element (ENABLE_NODE, &show_zebra_client_cmd);
+  install_element (CONFIG_NODE, &zebra_client_queue_limit_cmd);
+  install_element (CONFIG_NODE, &no_zebra_client_queue_limit_cmd);
+  install_element (CONFIG_NODE, &no_zebra_client_queue_limit_val_cmd);
 
 #ifdef HAVE_NETLINK
   install_element (VIEW_NODE, &show_table_cmd);
@@ -25,6 +25,7 @@
 #include "rib.h"
 #include "if.h"
 #include "workqueue.h"
+#include "vector.h"
 
 /* Default port information. */
 #define ZEBRA_VTY_PORT                2601
@@ -55,9 +56,21 @@ struct zserv
   /* default routing table this client munges */
   int rtm_table;
 
+  /* VRF of the message being read, 0 for the default VRF. */
+  u_int32_t vrf_id;
+
+  /* Redistribute flags in VRFs other than the default, indexed by VRF
+     id, allocated as the client subscribes. */
+  vector redist_vrf;
+
   /* This client's redistribute flag. */
   u_char redist[ZEBRA_ROUTE_MAX];
 
+  /* Unfinished dumps of route types the client asked for, and the
+     thread sending them. */
+  struct list *redist_dump;
+  struct thread *t_redist;
+
   /* Redistribute default route flag. */
   u_char redist_default;
 
@@ -66,6 +79,42 @@ struct zserv
 
   /* Router-id information. */
   u_char ridinfo;
+
+  /* ZEBRA_ROUTE_BULK version agreed in ZEBRA_HELLO, 0 if none. */
+  u_char bulk_version;
+
+  /* ZEBRA_ROUTE_BULK statistics. */
+  u_int32_t bulk_msg_cnt;
+  u_int32_t bulk_route_cnt;
+
+  /* Shared-memory route ring from ZEBRA_ROUTE_RING, and its doorbell
+     read thread. */
+  struct zring *ring;
+  struct thread *t_ring;
+
+  /* Messages read from the socket, to order ring records against. */
+  u_int32_t msg_read;
+
+  /* Descriptors received with the message being read, or -1. */
+  int ring_fds[2];
+
+  /* Route ring statistics. */
+  u_int32_t ring_route_cnt;
+
+  /* Route updates held back while the client is not reading, one per
+     prefix and route type, keyed by prefix and queued oldest first,
+     with the other messages sent meanwhile.  pending_barrier is the
+     order of the last of those. */
+  struct route_table *pending[AFI_MAX];
+  struct list *pending_fifo;
+  unsigned long pending_bytes;
+  u_int32_t pending_seq;
+  u_int32_t pending_barrier;
+
+  /* Pending update statistics. */
+  u_int32_t pending_max;
+  u_int32_t pending_queued;
+  u_int32_t pending_coalesced;
 };
 
 /* Zebra instance */
@@ -78,9 +127,10 @@ struct zebra_t
   /* default table */
   int rtm_table_default;
 
-  /* rib work queue */
+  /* rib work queue, and the VRFs with route nodes queued, which it
+     serves in turn */
   struct work_queue *ribq;
-  struct meta_queue *mq;
+  struct list *mq_vrfs;
 };
 
 /* Count prefix size from mask length */